@@ -51,14 +51,14 @@ def load_connections_config(datastore, region):
         rendezvous_address = info['rendezvous'][region]
         return info_datastore, rendezvous_address 
 
-def init_monitor(datastore, region, no_consistency_checks):
+def init_monitor(datastore, region, no_consistency_checks, group):
     region = REGIONS_FULL_NAMES[region]
     client_config = load_client_config()
     info_datastore, rendezvous_address = load_connections_config(datastore, region)
     shim_layers = {
         '': SHIM_LAYERS[datastore](**info_datastore) # empty tag for testing purposes
     }
-    monitor = DatastoreMonitor(shim_layers, rendezvous_address, client_config['service'], region, no_consistency_checks)
+    monitor = DatastoreMonitor(shim_layers, rendezvous_address, client_config['service'], region, no_consistency_checks, group)
 
     if no_consistency_checks:
         print(f'> Starting datastore monitor for {datastore} @ {region} (no consistency checks)')
@@ -78,5 +78,8 @@ if __name__ == '__main__':
     # disable consistency checks
     parser.add_argument('-ncc', '--no-consistency-checks', action='store_true', help="Disables consistency checks")
 
+    # consumer group shared by multiple monitor instances
+    parser.add_argument('-g', '--group', default='', help="Partition branches among all monitors of the same group")
+
     args = vars(parser.parse_args())
     init_monitor(**args)
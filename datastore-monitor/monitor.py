@@ -1,12 +1,13 @@
 import threading
 import grpc
 import threading
+import queue
 from proto import rendezvous_pb2 as pb
 from proto import rendezvous_pb2_grpc as rv
 import time
 
 class DatastoreMonitor:
-  def __init__(self, shim_layers, rendezvous_address, service, region, no_consistency_checks):
+  def __init__(self, shim_layers, rendezvous_address, service, region, no_consistency_checks, group=''):
     self.running = True
     self.threads = []
     self.shim_layers = shim_layers
@@ -16,9 +17,15 @@ class DatastoreMonitor:
     self.stub = rv.ClientServiceStub(self.channel)
     self.service = service
     self.region = region
+    self.group = group
 
     # config values
     self.server_unavailable_sleep_time_s = 5
+    self.subscribe_batch_size = 128
+    self.acks_wait_time_s = 1
+
+    # bids (visible in the datastore) to be acked back to the rendezvous server
+    self.acks = queue.Queue()
 
     # consistency checks
     self.consistency_checks = not no_consistency_checks
@@ -57,18 +64,47 @@ class DatastoreMonitor:
     print("[ERROR] Unexpected grpc exception caught:", details, flush=True)
     exit(-1)
 
+  def _monitor_messages(self, subscription):
+    # first message subscribes and remaining ones ack (in batches) the branches visible in the datastore
+    yield pb.MonitorMessage(subscribe=subscription)
+    while self.running:
+      try:
+        acks = [self.acks.get(timeout=self.acks_wait_time_s)]
+      except queue.Empty:
+        continue
+      while True:
+        try:
+          acks.append(self.acks.get_nowait())
+        except queue.Empty:
+          break
+      # grpc only asks for the next message after writing the previous one, so if the stream is closed
+      # while suspended here the acks were not written and are queued again for the next subscription
+      sent = False
+      try:
+        yield pb.MonitorMessage(acks=[pb.BranchAck(bid=bid, region=self.region) for bid in acks])
+        sent = True
+      finally:
+        if not sent:
+          for bid in acks:
+            self.acks.put(bid)
+
   def _subscribe_branches(self, bids, lock, cond):
+    # offset of the next branch, used to resume the subscription after reconnecting
+    next_offset = 0
     while self.running:
       try: 
-        request = pb.SubscribeMessage(service=self.service, region=self.region)
+        request = pb.SubscribeMessage(service=self.service, region=self.region, batch_size=self.subscribe_batch_size, offset=next_offset, group=self.group,
+          tags=[tag for tag in self.shim_layers if tag])
         print("[INFO] Subcription: going to subscribe...", flush=True)
-        reader = self.stub.Subscribe(request)
+        reader = self.stub.Monitor(self._monitor_messages(request))
         for response in reader:
-          bid = response.bid
-          tag = response.tag
-          #print(f"[DEBUG] Subcription: received bid: {bid}", flush=True)
+          #print(f"[DEBUG] Subcription: received #{len(response.bids)} bids", flush=True)
+          next_offset = response.next_offset
           with lock:
-            bids.add((bid, tag))
+            for bid, tag in zip(response.bids, response.tags):
+              bids.add((bid, tag))
+            if response.bid:
+              bids.add((response.bid, response.tag))
             cond.notify_all()
 
       except grpc.RpcError as e:
@@ -76,8 +112,9 @@ class DatastoreMonitor:
         self._handle_grpc_error(e.code(), e.details())
 
     # notify to join second thread at the end
-    bids.clear()
-    cond.notify_all()
+    with lock:
+      bids.clear()
+      cond.notify_all()
 
   def _close_branches(self, bids, lock, cond):
     while self.running:
@@ -93,7 +130,7 @@ class DatastoreMonitor:
         try:
           if self.shim_layers[tag].find_metadata(bid):
            #print(f"[DEBUG] Closing branch for bid = {bid}, service = {self.service}, region = {self.region}", flush=True)
-            self.stub.CloseBranch(pb.CloseBranchMessage(bid=bid, region=self.region))
+            self.acks.put(bid)
             closed.append((bid, tag))
           #else:
            #print(f"[DEBUG] Bid not found {bid}")
@@ -122,7 +159,7 @@ class DatastoreMonitor:
       for bid, tag in copy:
         try:
            #print(f"[DEBUG] Closing branch for bid = {bid}, service = {self.service}, region = {self.region}", flush=True)
-            self.stub.CloseBranch(pb.CloseBranchMessage(bid=bid, region=self.region))
+            self.acks.put(bid)
             closed.append((bid, tag))
           #else:
            #print(f"[DEBUG] Bid not found {bid}")
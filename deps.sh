@@ -60,6 +60,17 @@ sudo make
 sudo make install
 sudo rm -r ~/rendezvous_deps/googletest
 
+# Install Google Benchmark (optional, for microbenchmarks)
+echo '(4.1) Installing Google Benchmark...'
+cd ~/rendezvous_deps
+sudo git clone https://github.com/google/benchmark.git -b v1.7.1
+cd benchmark
+sudo cmake -E make_directory build
+sudo cmake -S . -B build -DCMAKE_BUILD_TYPE=Release -DBENCHMARK_ENABLE_TESTING=OFF
+sudo cmake --build build --config Release
+sudo cmake --install build
+sudo rm -r ~/rendezvous_deps/benchmark
+
 # Install JSON for C++
 echo '(5) Installing JSON for C++...'
 cd ~/rendezvous_deps
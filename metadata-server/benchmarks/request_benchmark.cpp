@@ -0,0 +1,486 @@
+#include "../src/server.h"
+#include "../src/metadata/request.h"
+#include "benchmark/benchmark.h"
+#include <malloc.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// ------------------------
+// REQUEST HOT PATHS BENCHMARKS
+// ------------------------
+
+static const std::string SID = "eu";
+static const std::string ROOT_ACSL = "";
+static const std::string TAG = "";
+// branches registered in advance when benchmarking closures
+static const int BRANCHES_POOL_SIZE = 1024;
+// requests are renewed so that their structures do not grow with the number of iterations
+static const int BRANCHES_PER_REQUEST = 1024;
+// branches of the requests whose memory is measured
+static const int BRANCHES_PER_MEASURED_REQUEST = 64;
+
+// heap allocations made by the process (see BM_BranchIdsAllocations)
+static std::atomic<uint64_t> num_allocations(0);
+
+void * operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void * ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void * ptr) noexcept {
+  std::free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept {
+  std::free(ptr);
+}
+
+static std::unique_ptr<rendezvous::Server> newServer() {
+  auto server = std::make_unique<rendezvous::Server>(SID);
+  // logging would dominate the measured operations
+  spdlog::set_level(spdlog::level::off);
+  return server;
+}
+
+static std::string getService(int i) {
+  return "service_" + std::to_string(i);
+}
+
+static utils::ProtoVec getRegions(int num_regions) {
+  utils::ProtoVec regions;
+  for (int i = 0; i < num_regions; i++) {
+    regions.Add("region_" + std::to_string(i));
+  }
+  return regions;
+}
+
+static std::string getRid(int i) {
+  return "rv_bench_" + std::to_string(i);
+}
+
+/**
+ * Register one branch per service in a chain of nested ACSLs
+ *
+ * @param bids Set to the identifiers of the registered branches (if provided)
+ * @return The deepest ACSL
+ */
+static std::string registerServices(rendezvous::Server * server, metadata::Request * request,
+  int num_services, const utils::ProtoVec& regions, int acsl_depth, std::vector<std::string> * bids = nullptr) {
+
+  std::string acsl_id = ROOT_ACSL;
+  for (int depth = 0; depth <= acsl_depth; depth++) {
+    if (depth > 0) {
+      acsl_id = server->addNextACSL(request, acsl_id);
+    }
+    for (int i = 0; i < num_services; i++) {
+      // each service is called by the previous one to build the dependency graph
+      const std::string& current_service = i == 0 ? "" : getService(i - 1);
+      const std::string& bid = server->genBid(request);
+      server->registerBranch(request, acsl_id, getService(i), regions, TAG, current_service, bid, false);
+      if (bids != nullptr) {
+        bids->emplace_back(bid);
+      }
+    }
+  }
+  return acsl_id;
+}
+
+// Args: number of services, regions per branch
+static void BM_RegisterBranch(benchmark::State& state) {
+  auto server = newServer();
+  const int num_services = state.range(0);
+  const utils::ProtoVec& regions = getRegions(state.range(1));
+
+  int next_rid = 0, num_branches = 0;
+  metadata::Request * request = server->getOrRegisterRequest(getRid(next_rid++));
+  for (auto _ : state) {
+    if (num_branches++ == BRANCHES_PER_REQUEST) {
+      request = server->getOrRegisterRequest(getRid(next_rid++));
+      num_branches = 1;
+    }
+    auto branch = server->registerBranch(request, ROOT_ACSL, getService(num_branches % num_services), regions,
+      TAG, "", server->genBid(request), false);
+    benchmark::DoNotOptimize(branch);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RegisterBranch)
+  ->ArgNames({"services", "regions"})
+  ->ArgsProduct({{1, 16}, {1, 4, 16}});
+
+// Args: regions per branch
+static void BM_CloseBranch(benchmark::State& state) {
+  auto server = newServer();
+  const utils::ProtoVec& regions = getRegions(state.range(0));
+
+  int next_rid = 0;
+  metadata::Request * request = nullptr;
+  std::vector<std::string> bids;
+  for (auto _ : state) {
+    if (bids.empty()) {
+      state.PauseTiming();
+      request = server->getOrRegisterRequest(getRid(next_rid++));
+      for (int i = 0; i < BRANCHES_POOL_SIZE; i++) {
+        const std::string& bid = server->genBid(request);
+        server->registerBranch(request, ROOT_ACSL, getService(0), regions, TAG, "", bid, false);
+        bids.emplace_back(bid);
+      }
+      state.ResumeTiming();
+    }
+    benchmark::DoNotOptimize(server->closeBranch(request, bids.back(), regions.empty() ? "" : regions[0]));
+    bids.pop_back();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CloseBranch)
+  ->ArgName("regions")
+  ->Arg(0)->Arg(1)->Arg(4)->Arg(16);
+
+// Args: number of services, ACSL depth
+static void BM_CheckStatus(benchmark::State& state) {
+  auto server = newServer();
+  const int num_services = state.range(0);
+  metadata::Request * request = server->getOrRegisterRequest(getRid(0));
+  const std::string& acsl_id = registerServices(server.get(), request, num_services, getRegions(1), state.range(1));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(server->checkStatus(request, acsl_id, "", ""));
+    benchmark::DoNotOptimize(server->checkStatus(request, acsl_id, getService(num_services - 1), ""));
+    benchmark::DoNotOptimize(server->checkStatus(request, acsl_id, getService(num_services - 1), "region_0", true));
+  }
+  state.SetItemsProcessed(state.iterations() * 3);
+}
+BENCHMARK(BM_CheckStatus)
+  ->ArgNames({"services", "depth"})
+  ->ArgsProduct({{1, 16, 64}, {0, 4, 16}});
+
+// Args: branches of the tag
+// Tag waits and detailed status when all branches of the tag are closed (calls never block)
+static void BM_TagWaitAndStatus(benchmark::State& state) {
+  auto server = newServer();
+  const utils::ProtoVec& regions = getRegions(1);
+  const std::string& service = getService(0);
+  const std::string& tag = "tag";
+  metadata::Request * request = server->getOrRegisterRequest(getRid(0));
+  for (int i = 0; i < state.range(0); i++) {
+    const std::string& bid = server->genBid(request);
+    server->registerBranch(request, ROOT_ACSL, service, regions, tag, "", bid, false);
+    server->closeBranch(request, bid, regions[0]);
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(server->wait(request, ROOT_ACSL, service, "", tag, false, 1));
+    benchmark::DoNotOptimize(server->wait(request, ROOT_ACSL, service, regions[0], tag, false, 1));
+    benchmark::DoNotOptimize(server->checkStatus(request, ROOT_ACSL, service, "", true));
+    benchmark::DoNotOptimize(server->checkStatus(request, ROOT_ACSL, service, regions[0], true));
+  }
+  state.SetItemsProcessed(state.iterations() * 4);
+}
+BENCHMARK(BM_TagWaitAndStatus)
+  ->ArgName("branches")
+  ->Arg(1)->Arg(64)->Arg(1024);
+
+// Args: number of services, ACSL depth
+static void BM_WaitClosed(benchmark::State& state) {
+  auto server = newServer();
+  const int num_services = state.range(0);
+  metadata::Request * request = server->getOrRegisterRequest(getRid(0));
+  std::vector<std::string> bids;
+  const std::string& acsl_id = registerServices(server.get(), request, num_services, getRegions(1), state.range(1), &bids);
+  for (const auto& bid : bids) {
+    server->closeBranch(request, bid, "region_0");
+  }
+
+  // all branches are closed so calls never block
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(server->wait(request, acsl_id, "", "", "", false, 1));
+    benchmark::DoNotOptimize(server->wait(request, acsl_id, "", "region_0", "", false, 1));
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_WaitClosed)
+  ->ArgNames({"services", "depth"})
+  ->ArgsProduct({{1, 16, 64}, {0, 4, 16}});
+
+// Args: number of concurrent waiters
+static void BM_WaitWakeup(benchmark::State& state) {
+  auto server = newServer();
+  const int num_waiters = state.range(0);
+  const utils::ProtoVec& regions = getRegions(1);
+
+  int next_rid = 0;
+  std::atomic<int> num_prevented(0);
+  for (auto _ : state) {
+    state.PauseTiming();
+    metadata::Request * request = server->getOrRegisterRequest(getRid(next_rid++));
+    // branches of the current ACSL are ignored so waiters block on a branch of a child ACSL
+    const std::string& acsl_id = server->addNextACSL(request, ROOT_ACSL);
+    const std::string& bid = server->genBid(request);
+    server->registerBranch(request, acsl_id, getService(0), regions, TAG, "", bid, false);
+    std::vector<std::thread> waiters;
+    for (int i = 0; i < num_waiters; i++) {
+      waiters.emplace_back([&server, &num_prevented, request]() {
+        if (server->wait(request, ROOT_ACSL, getService(0), "", "", false, 5) == 1) {
+          num_prevented.fetch_add(1);
+        }
+      });
+    }
+    // give waiters time to block
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    state.ResumeTiming();
+
+    // time until all waiters are woken up by the closure
+    server->closeBranch(request, bid, regions[0]);
+    for (auto& waiter : waiters) {
+      waiter.join();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * num_waiters);
+  // waiters that were blocked by the branch
+  state.counters["prevented"] = benchmark::Counter(num_prevented.load(), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_WaitWakeup)
+  ->ArgName("waiters")
+  ->Arg(1)->Arg(8)->Arg(64)
+  ->UseRealTime();
+
+// Args: number of services, ACSL depth
+static void BM_FetchDependencies(benchmark::State& state) {
+  auto server = newServer();
+  const int num_services = state.range(0);
+  metadata::Request * request = server->getOrRegisterRequest(getRid(0));
+  registerServices(server.get(), request, num_services, getRegions(1), state.range(1));
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(server->fetchDependencies(request, "", ROOT_ACSL));
+    benchmark::DoNotOptimize(server->fetchDependencies(request, getService(0), ROOT_ACSL));
+  }
+  state.SetItemsProcessed(state.iterations() * 2);
+}
+BENCHMARK(BM_FetchDependencies)
+  ->ArgNames({"services", "depth"})
+  ->ArgsProduct({{1, 16, 64}, {0, 4}});
+
+// Args: regions per branch
+// Same handling of identifiers as the RegisterBranch and CloseBranch calls (composed bid returned to
+// the client and parsed back when closing) and reports the heap allocations of each pair of calls
+static void BM_BranchIdsAllocations(benchmark::State& state) {
+  auto server = newServer();
+  const utils::ProtoVec& regions = getRegions(state.range(0));
+  const std::string& region = regions.empty() ? "" : regions[0];
+  const std::string& service = getService(0);
+
+  // client-provided rids (e.g. trace ids) do not fit in the inline buffer of strings
+  auto getTraceRid = [](int i) { return getRid(i) + "_0123456789abcdef0123456789abcdef"; };
+
+  int next_rid = 0, num_branches = 0;
+  metadata::Request * request = server->getOrRegisterRequest(getTraceRid(next_rid++));
+  std::string composed_bid;
+  uint64_t allocations_before = num_allocations.load();
+  for (auto _ : state) {
+    if (num_branches++ == BRANCHES_PER_REQUEST) {
+      request = server->getOrRegisterRequest(getTraceRid(next_rid++));
+      num_branches = 1;
+    }
+    // register branch
+    const std::string& core_bid = server->genBid(request);
+    server->registerBranch(request, ROOT_ACSL, service, regions, TAG, "", core_bid, false);
+    server->composeFullId(core_bid, request->getRid(), composed_bid);
+
+    // close branch
+    auto ids = server->parseFullId(composed_bid);
+    metadata::Request * rv_request = server->getRequest(ids.second);
+    benchmark::DoNotOptimize(server->closeBranch(rv_request, ids.first, region));
+  }
+  state.counters["allocs_per_op"] = benchmark::Counter(num_allocations.load() - allocations_before,
+    benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_BranchIdsAllocations)
+  ->ArgName("regions")
+  ->Arg(0)->Arg(1);
+
+// Args: number of services, regions per branch
+// Reports the heap bytes taken by each request (measured by the allocator) and the bytes accounted by the request
+static void BM_RequestBytes(benchmark::State& state) {
+  auto server = newServer();
+  const int num_services = state.range(0);
+  const utils::ProtoVec& regions = getRegions(state.range(1));
+
+  int next_rid = 0;
+  size_t heap_bytes = 0, accounted_bytes = 0;
+  for (auto _ : state) {
+    size_t heap_before = mallinfo2().uordblks;
+    metadata::Request * request = server->getOrRegisterRequest(getRid(next_rid++));
+    for (int i = 0; i < BRANCHES_PER_MEASURED_REQUEST; i++) {
+      server->registerBranch(request, ROOT_ACSL, getService(i % num_services), regions, TAG, "", server->genBid(request), false);
+    }
+    heap_bytes += mallinfo2().uordblks - heap_before;
+    accounted_bytes += request->getFootprint().bytes;
+  }
+  state.counters["heap_bytes"] = benchmark::Counter(heap_bytes, benchmark::Counter::kAvgIterations);
+  state.counters["accounted_bytes"] = benchmark::Counter(accounted_bytes, benchmark::Counter::kAvgIterations);
+  state.SetItemsProcessed(state.iterations() * BRANCHES_PER_MEASURED_REQUEST);
+}
+BENCHMARK(BM_RequestBytes)
+  ->ArgNames({"services", "regions"})
+  ->ArgsProduct({{1, 16}, {0, 4}})
+  ->Iterations(2000);
+
+// shared by all threads of the concurrent benchmark
+static std::unique_ptr<rendezvous::Server> concurrent_server;
+static metadata::Request * concurrent_request;
+
+// Threads register and close branches of the same request
+static void BM_RegisterCloseConcurrent(benchmark::State& state) {
+  if (state.thread_index() == 0) {
+    concurrent_server = newServer();
+    concurrent_request = concurrent_server->getOrRegisterRequest(getRid(0));
+  }
+  const utils::ProtoVec& regions = getRegions(1);
+  const std::string& service = getService(state.thread_index());
+
+  for (auto _ : state) {
+    const std::string& bid = concurrent_server->genBid(concurrent_request);
+    concurrent_server->registerBranch(concurrent_request, ROOT_ACSL, service, regions, TAG, "", bid, false);
+    concurrent_server->closeBranch(concurrent_request, bid, regions[0]);
+    benchmark::DoNotOptimize(concurrent_server->checkStatus(concurrent_request, ROOT_ACSL, service, ""));
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0) {
+    concurrent_server.reset();
+  }
+}
+BENCHMARK(BM_RegisterCloseConcurrent)
+  ->ThreadRange(1, 8)
+  ->UseRealTime();
+
+// acsls of the concurrent benchmark (one per thread, created together as in a fan-out)
+static std::vector<std::string> concurrent_acsls;
+
+// Threads register and close branches in their own ACSL of the same request, so that
+// the counters of each ACSL are only written by one thread (exposes false sharing)
+static void BM_RegisterCloseConcurrentACSLs(benchmark::State& state) {
+  if (state.thread_index() == 0) {
+    concurrent_server = newServer();
+    concurrent_request = concurrent_server->getOrRegisterRequest(getRid(0));
+    concurrent_acsls.clear();
+    for (int i = 0; i < state.threads(); i++) {
+      concurrent_acsls.emplace_back(concurrent_server->addNextACSL(concurrent_request, ROOT_ACSL));
+    }
+  }
+  const utils::ProtoVec& regions = getRegions(state.range(0));
+  const std::string& service = getService(state.thread_index());
+  const std::string& region = regions.empty() ? "" : regions[0];
+
+  for (auto _ : state) {
+    const std::string& acsl_id = concurrent_acsls[state.thread_index()];
+    const std::string& bid = concurrent_server->genBid(concurrent_request);
+    concurrent_server->registerBranch(concurrent_request, acsl_id, service, regions, TAG, "", bid, false);
+    concurrent_server->closeBranch(concurrent_request, bid, region);
+  }
+  state.SetItemsProcessed(state.iterations());
+
+  if (state.thread_index() == 0) {
+    concurrent_server.reset();
+  }
+}
+BENCHMARK(BM_RegisterCloseConcurrentACSLs)
+  ->ArgName("regions")
+  ->Arg(0)->Arg(1)
+  ->ThreadRange(1, 8)
+  ->UseRealTime();
+
+// one in every WRITERS_RATIO threads of the mixed benchmark registers and closes branches
+static const int WRITERS_RATIO = 4;
+
+// Threads poll the status of the request (globally and in a region) while the other threads
+// register and close branches of the same request
+static void BM_CheckStatusMixed(benchmark::State& state) {
+  const utils::ProtoVec& regions = getRegions(1);
+  if (state.thread_index() == 0) {
+    concurrent_server = newServer();
+    concurrent_request = concurrent_server->getOrRegisterRequest(getRid(0));
+    // region must be known by the request for its status to be checked
+    concurrent_server->registerBranch(concurrent_request, ROOT_ACSL, getService(0), regions, TAG, "",
+      concurrent_server->genBid(concurrent_request), false);
+  }
+  const bool writer = state.thread_index() % WRITERS_RATIO == 0;
+  const std::string& service = getService(state.thread_index());
+
+  int64_t num_reads = 0, num_writes = 0;
+  for (auto _ : state) {
+    if (writer) {
+      const std::string& bid = concurrent_server->genBid(concurrent_request);
+      concurrent_server->registerBranch(concurrent_request, ROOT_ACSL, service, regions, TAG, "", bid, false);
+      concurrent_server->closeBranch(concurrent_request, bid, regions[0]);
+      num_writes++;
+    }
+    else {
+      benchmark::DoNotOptimize(concurrent_server->checkStatus(concurrent_request, ROOT_ACSL, "", ""));
+      benchmark::DoNotOptimize(concurrent_server->checkStatus(concurrent_request, ROOT_ACSL, "", regions[0]));
+      num_reads += 2;
+    }
+  }
+  state.counters["reads"] = benchmark::Counter(num_reads, benchmark::Counter::kIsRate);
+  state.counters["writes"] = benchmark::Counter(num_writes, benchmark::Counter::kIsRate);
+
+  if (state.thread_index() == 0) {
+    concurrent_server.reset();
+  }
+}
+BENCHMARK(BM_CheckStatusMixed)
+  ->Threads(4)->Threads(16)->Threads(64)
+  ->UseRealTime();
+
+// Threads poll the status of a service (globally and in a region) while the other threads
+// register and close branches of the same service
+static void BM_CheckServiceStatusMixed(benchmark::State& state) {
+  const utils::ProtoVec& regions = getRegions(1);
+  const std::string& service = getService(0);
+  if (state.thread_index() == 0) {
+    concurrent_server = newServer();
+    concurrent_request = concurrent_server->getOrRegisterRequest(getRid(0));
+    // region must be known by the service node for its status to be checked
+    concurrent_server->registerBranch(concurrent_request, ROOT_ACSL, service, regions, TAG, "",
+      concurrent_server->genBid(concurrent_request), false);
+  }
+  const bool writer = state.thread_index() % WRITERS_RATIO == 0;
+
+  int64_t num_reads = 0, num_writes = 0;
+  for (auto _ : state) {
+    if (writer) {
+      const std::string& bid = concurrent_server->genBid(concurrent_request);
+      concurrent_server->registerBranch(concurrent_request, ROOT_ACSL, service, regions, TAG, "", bid, false);
+      concurrent_server->closeBranch(concurrent_request, bid, regions[0]);
+      num_writes++;
+    }
+    else {
+      benchmark::DoNotOptimize(concurrent_server->checkStatus(concurrent_request, ROOT_ACSL, service, ""));
+      benchmark::DoNotOptimize(concurrent_server->checkStatus(concurrent_request, ROOT_ACSL, service, regions[0]));
+      num_reads += 2;
+    }
+  }
+  state.counters["reads"] = benchmark::Counter(num_reads, benchmark::Counter::kIsRate);
+  state.counters["writes"] = benchmark::Counter(num_writes, benchmark::Counter::kIsRate);
+
+  if (state.thread_index() == 0) {
+    concurrent_server.reset();
+  }
+}
+BENCHMARK(BM_CheckServiceStatusMixed)
+  ->Threads(4)->Threads(16)->Threads(64)
+  ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,126 @@
+#include "cluster.h"
+#include "../src/utils/settings.h"
+#include "spdlog/fmt/fmt.h"
+#include <thread>
+
+using namespace loadgen;
+using json = nlohmann::json;
+
+static const std::string REPLICATION_SERVICE_PREFIX = "/rendezvous_server.ServerService/";
+
+// time given to detached replication calls before replicas are destroyed
+static const std::chrono::milliseconds DRAIN_TIMEOUT(1000);
+
+// -----------------------
+// Link Latency Interceptor
+//------------------------
+
+LinkLatencyInterceptor::LinkLatencyInterceptor(std::chrono::milliseconds latency, grpc::experimental::ServerRpcInfo * info)
+    : _latency(latency), _replication(std::string(info->method()).rfind(REPLICATION_SERVICE_PREFIX, 0) == 0) {
+}
+
+void LinkLatencyInterceptor::Intercept(grpc::experimental::InterceptorBatchMethods * methods) {
+    if (_replication) {
+        // request travels from the sender (before being handled) and the response travels back to it
+        if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::POST_RECV_MESSAGE)
+            || methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_STATUS)) {
+            std::this_thread::sleep_for(_latency);
+        }
+    }
+    methods->Proceed();
+}
+
+LinkLatencyInterceptorFactory::LinkLatencyInterceptorFactory(std::chrono::milliseconds latency) : _latency(latency) {
+}
+
+grpc::experimental::Interceptor * LinkLatencyInterceptorFactory::CreateServerInterceptor(grpc::experimental::ServerRpcInfo * info) {
+    return new LinkLatencyInterceptor(_latency, info);
+}
+
+// -------
+// Cluster
+//--------
+
+Cluster::Cluster(int num_replicas, int base_port, bool async_replication, int link_latency_ms)
+    : _link_latency(link_latency_ms) {
+
+    // same defaults as config/settings.json (garbage collectors are not started)
+    json settings = {
+        {"cleanup_requests_interval_m", 60},
+        {"cleanup_requests_validity_m", 60},
+        {"cleanup_subscribers_interval_m", 60},
+        {"cleanup_subscribers_validity_m", 60},
+        {"subscribers_refresh_interval_s", 30},
+        {"subscribers_queue_capacity", 65536},
+        {"subscribers_overflow_policy", "drop_oldest"},
+        {"subscribers_spill_dir", "/tmp/rendezvous"},
+        {"wait_replica_timeout_s", 30},
+        {"selective_replication", false},
+        {"partitioned_mode", false},
+        {"wait_traces_file", ""}
+    };
+    utils::ASYNC_REPLICATION = async_replication;
+    utils::CONTEXT_VERSIONING = false;
+    utils::CONSISTENCY_CHECKS = true;
+
+    // sids must have the same size
+    std::vector<replicas::ReplicaClient::Replica> replicas;
+    for (int i = 0; i < num_replicas; i++) {
+        const std::string& sid = fmt::format("r{:02d}", i);
+        replicas.push_back({sid, "localhost:" + std::to_string(base_port + i), {sid}});
+    }
+
+    for (int i = 0; i < num_replicas; i++) {
+        auto node = std::make_unique<Node>();
+        node->sid = replicas[i].sid;
+        node->addr = replicas[i].addr;
+
+        std::vector<replicas::ReplicaClient::Replica> peers = replicas;
+        peers.erase(peers.begin() + i);
+        node->server = std::make_shared<rendezvous::Server>(node->sid, settings);
+        node->client_service = std::make_unique<service::ClientServiceImpl>(node->server, peers, true);
+        node->server_service = std::make_unique<service::ServerServiceImpl>(node->server, true);
+
+        grpc::ServerBuilder builder;
+        builder.AddListeningPort(node->addr, grpc::InsecureServerCredentials());
+        builder.RegisterService(node->client_service.get());
+        builder.RegisterService(node->server_service.get());
+        if (_link_latency.count() > 0) {
+            std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> interceptor_creators;
+            interceptor_creators.push_back(std::make_unique<LinkLatencyInterceptorFactory>(_link_latency));
+            builder.experimental().SetInterceptorCreators(std::move(interceptor_creators));
+        }
+        node->grpc_server = builder.BuildAndStart();
+        if (node->grpc_server == nullptr) {
+            spdlog::critical("[CLUSTER] could not start replica {} on {}", node->sid, node->addr);
+            exit(-1);
+        }
+        spdlog::info("[CLUSTER] replica {} listening on {}", node->sid, node->addr);
+        _nodes.emplace_back(std::move(node));
+    }
+}
+
+Cluster::~Cluster() {
+    // replicas reply to clients before async replication (and removal of wait logs) completes
+    std::this_thread::sleep_for(DRAIN_TIMEOUT + 2 * _link_latency);
+    for (auto& node : _nodes) {
+        node->grpc_server->Shutdown(std::chrono::system_clock::now() + DRAIN_TIMEOUT);
+    }
+    for (auto& node : _nodes) {
+        node->grpc_server->Wait();
+    }
+    _nodes.clear();
+}
+
+const std::vector<std::unique_ptr<Cluster::Node>>& Cluster::getNodes() {
+    return _nodes;
+}
+
+std::map<std::string, metrics::Histogram::Snapshot> Cluster::getReplicationLag() {
+    std::map<std::string, metrics::Histogram::Snapshot> lag;
+    for (const auto& node : _nodes) {
+        lag[node->sid] = metrics::Registry::get().histogram("rendezvous_replication_lag_seconds",
+            "Time until replicated requests and branches are acknowledged by each peer", {{"peer", node->sid}})->snapshot();
+    }
+    return lag;
+}
@@ -0,0 +1,94 @@
+#ifndef LOADGEN_CLUSTER_H
+#define LOADGEN_CLUSTER_H
+
+#include "../src/server.h"
+#include "../src/services/client_service_impl.h"
+#include "../src/services/server_service_impl.h"
+#include "../src/metrics/metrics.h"
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/support/server_interceptor.h>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace loadgen {
+
+    /**
+     * Delays replication RPCs (ServerService) in both directions, simulating the link between two replicas
+     * RPCs of clients (ClientService) are not delayed since clients are co-located with their replica
+     */
+    class LinkLatencyInterceptor : public grpc::experimental::Interceptor {
+
+        private:
+            const std::chrono::milliseconds _latency;
+            const bool _replication;
+
+        public:
+            LinkLatencyInterceptor(std::chrono::milliseconds latency, grpc::experimental::ServerRpcInfo * info);
+
+            void Intercept(grpc::experimental::InterceptorBatchMethods * methods) override;
+    };
+
+    class LinkLatencyInterceptorFactory : public grpc::experimental::ServerInterceptorFactoryInterface {
+
+        private:
+            const std::chrono::milliseconds _latency;
+
+        public:
+            LinkLatencyInterceptorFactory(std::chrono::milliseconds latency);
+
+            grpc::experimental::Interceptor * CreateServerInterceptor(grpc::experimental::ServerRpcInfo * info) override;
+    };
+
+    /**
+     * Replicated metadata servers running in the current process, each one listening on its own localhost port
+     * REMINDER: replication settings are process-wide so only one cluster can run at a time
+     */
+    class Cluster {
+
+        public:
+            // Helper structure for each replica of the cluster
+            typedef struct NodeStruct {
+                std::string sid;
+                std::string addr;
+                std::shared_ptr<rendezvous::Server> server;
+                std::unique_ptr<service::ClientServiceImpl> client_service;
+                std::unique_ptr<service::ServerServiceImpl> server_service;
+                std::unique_ptr<grpc::Server> grpc_server;
+            } Node;
+
+        private:
+            const std::chrono::milliseconds _link_latency;
+            std::vector<std::unique_ptr<Node>> _nodes;
+
+        public:
+            /**
+             * Start all replicas (each one replicates to all the others)
+             *
+             * @param num_replicas Number of replicas
+             * @param base_port Port of the first replica (the others use the following ports)
+             * @param async_replication Whether replicas replicate in background or before replying to clients
+             * @param link_latency_ms One-way latency between replicas (0 to disable)
+             */
+            Cluster(int num_replicas, int base_port, bool async_replication, int link_latency_ms);
+
+            /**
+             * Stop all replicas, after giving in-flight (async) replication calls time to complete
+             */
+            ~Cluster();
+
+            const std::vector<std::unique_ptr<Node>>& getNodes();
+
+            /**
+             * Snapshot the replication lag histograms of all replicas (lag is accumulated in the
+             * process-wide registry so callers should subtract a previous snapshot)
+             *
+             * @return <sid, snapshot> with the time until each replica acknowledged replicated calls
+             */
+            std::map<std::string, metrics::Histogram::Snapshot> getReplicationLag();
+    };
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include "driver.h"
+
+using namespace loadgen;
+
+// -----------------
+// In-Process Driver
+//------------------
+
+InProcessDriver::InProcessDriver(const std::string& sid) : _server(sid) {
+    // constructor for GTests enables tracing
+    spdlog::set_level(spdlog::level::info);
+}
+
+bool InProcessDriver::registerRequest(std::string& rid) {
+    metadata::Request * request = _server.getOrRegisterRequest("");
+    if (request == nullptr) {
+        return false;
+    }
+    rid = request->getRid();
+    return true;
+}
+
+bool InProcessDriver::registerBranch(const std::string& rid, const std::string& acsl, const std::string& service,
+    const std::vector<std::string>& regions, std::string& bid) {
+
+    metadata::Request * request = _server.getRequest(rid);
+    if (request == nullptr) {
+        return false;
+    }
+    utils::ProtoVec proto_regions;
+    for (const auto& region : regions) {
+        proto_regions.Add(std::string(region));
+    }
+    const std::string& core_bid = _server.genBid(request);
+    if (_server.registerBranch(request, acsl, service, proto_regions, "", "", core_bid, false) == nullptr) {
+        return false;
+    }
+    bid = _server.composeFullId(core_bid, rid);
+    return true;
+}
+
+bool InProcessDriver::closeBranch(const std::string& bid, const std::string& region) {
+    auto ids = _server.parseFullId(bid);
+    metadata::Request * request = _server.getRequest(ids.second);
+    if (request == nullptr) {
+        return false;
+    }
+    return _server.closeBranch(request, ids.first, region) != -1;
+}
+
+bool InProcessDriver::wait(const std::string& rid, const std::string& acsl, const std::string& service,
+    const std::string& region, int timeout) {
+    metadata::Request * request = _server.getRequest(rid);
+    if (request == nullptr) {
+        return false;
+    }
+    return _server.wait(request, acsl, service, region, "", false, timeout) >= 0;
+}
+
+// -----------
+// gRPC Driver
+//------------
+
+GrpcDriver::GrpcDriver(const std::string& addr)
+    : _stub(rendezvous::ClientService::NewStub(grpc::CreateChannel(addr, grpc::InsecureChannelCredentials()))) {
+}
+
+bool GrpcDriver::registerRequest(std::string& rid) {
+    grpc::ClientContext context;
+    rendezvous::RegisterRequestMessage request;
+    rendezvous::RegisterRequestResponse response;
+    grpc::Status status = _stub->RegisterRequest(&context, request, &response);
+    if (!status.ok()) {
+        spdlog::error("[LOADGEN] register request failed: {}", status.error_message());
+        return false;
+    }
+    rid = response.rid();
+    return true;
+}
+
+bool GrpcDriver::registerBranch(const std::string& rid, const std::string& acsl, const std::string& service,
+    const std::vector<std::string>& regions, std::string& bid) {
+
+    grpc::ClientContext context;
+    rendezvous::RegisterBranchMessage request;
+    rendezvous::RegisterBranchResponse response;
+    request.set_rid(rid);
+    request.set_acsl(acsl);
+    request.set_service(service);
+    for (const auto& region : regions) {
+        request.add_regions(region);
+    }
+    grpc::Status status = _stub->RegisterBranch(&context, request, &response);
+    if (!status.ok()) {
+        spdlog::error("[LOADGEN] register branch failed: {}", status.error_message());
+        return false;
+    }
+    bid = response.bid();
+    return true;
+}
+
+bool GrpcDriver::closeBranch(const std::string& bid, const std::string& region) {
+    grpc::ClientContext context;
+    rendezvous::CloseBranchMessage request;
+    rendezvous::Empty response;
+    request.set_bid(bid);
+    request.set_region(region);
+    grpc::Status status = _stub->CloseBranch(&context, request, &response);
+    if (!status.ok()) {
+        spdlog::error("[LOADGEN] close branch failed: {}", status.error_message());
+        return false;
+    }
+    return true;
+}
+
+bool GrpcDriver::wait(const std::string& rid, const std::string& acsl, const std::string& service,
+    const std::string& region, int timeout) {
+    grpc::ClientContext context;
+    rendezvous::WaitRequestMessage request;
+    rendezvous::WaitRequestResponse response;
+    request.set_rid(rid);
+    request.set_acsl(acsl);
+    request.set_service(service);
+    request.set_region(region);
+    request.set_timeout(timeout);
+    grpc::Status status = _stub->WaitRequest(&context, request, &response);
+    if (!status.ok()) {
+        spdlog::error("[LOADGEN] wait request failed: {}", status.error_message());
+        return false;
+    }
+    return !response.timed_out();
+}
+
+// --------------
+// Cluster Driver
+//---------------
+
+ClusterDriver::ClusterDriver(int num_replicas, int base_port, bool async_replication, int link_latency_ms)
+    : _cluster(num_replicas, base_port, async_replication, link_latency_ms),
+    _writer(_cluster.getNodes().front()->addr), _reader(_cluster.getNodes().back()->addr) {
+}
+
+Cluster& ClusterDriver::getCluster() {
+    return _cluster;
+}
+
+bool ClusterDriver::registerRequest(std::string& rid) {
+    return _writer.registerRequest(rid);
+}
+
+bool ClusterDriver::registerBranch(const std::string& rid, const std::string& acsl, const std::string& service,
+    const std::vector<std::string>& regions, std::string& bid) {
+    return _writer.registerBranch(rid, acsl, service, regions, bid);
+}
+
+bool ClusterDriver::closeBranch(const std::string& bid, const std::string& region) {
+    return _writer.closeBranch(bid, region);
+}
+
+bool ClusterDriver::wait(const std::string& rid, const std::string& acsl, const std::string& service,
+    const std::string& region, int timeout) {
+    return _reader.wait(rid, acsl, service, region, timeout);
+}
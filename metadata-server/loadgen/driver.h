@@ -0,0 +1,128 @@
+#ifndef LOADGEN_DRIVER_H
+#define LOADGEN_DRIVER_H
+
+#include "../src/server.h"
+#include "cluster.h"
+#include "client.grpc.pb.h"
+#include <grpcpp/grpcpp.h>
+#include <memory>
+#include <string>
+
+namespace loadgen {
+
+    /**
+     * Issues the calls of a workload to a metadata server
+     */
+    class Driver {
+
+        public:
+            virtual ~Driver() = default;
+
+            /**
+             * Register a new request
+             *
+             * @param rid Set to the identifier of the new request
+             * @return true if request was registered and false otherwise
+             */
+            virtual bool registerRequest(std::string& rid) = 0;
+
+            /**
+             * Register a new branch
+             *
+             * @param rid The identifier of the request
+             * @param acsl The ACSL where the branch is registered (empty for root)
+             * @param service The service of the branch
+             * @param regions The regions of the branch
+             * @param bid Set to the full identifier of the new branch
+             * @return true if branch was registered and false otherwise
+             */
+            virtual bool registerBranch(const std::string& rid, const std::string& acsl, const std::string& service,
+                const std::vector<std::string>& regions, std::string& bid) = 0;
+
+            /**
+             * Close a branch in a region
+             *
+             * @param bid The full identifier of the branch
+             * @param region The region where the branch is closed
+             * @return true if branch was closed and false otherwise
+             */
+            virtual bool closeBranch(const std::string& bid, const std::string& region) = 0;
+
+            /**
+             * Wait until a service is closed in a region
+             *
+             * @param rid The identifier of the request
+             * @param acsl The ACSL of the caller (its own branches are ignored)
+             * @param service The service context
+             * @param region The region context
+             * @param timeout Timeout in seconds
+             * @return true if wait did not time out or fail and false otherwise
+             */
+            virtual bool wait(const std::string& rid, const std::string& acsl, const std::string& service,
+                const std::string& region, int timeout) = 0;
+    };
+
+    /**
+     * Calls the rendezvous server directly (no network or serialization)
+     */
+    class InProcessDriver : public Driver {
+
+        private:
+            rendezvous::Server _server;
+
+        public:
+            InProcessDriver(const std::string& sid);
+
+            bool registerRequest(std::string& rid) override;
+            bool registerBranch(const std::string& rid, const std::string& acsl, const std::string& service,
+                const std::vector<std::string>& regions, std::string& bid) override;
+            bool closeBranch(const std::string& bid, const std::string& region) override;
+            bool wait(const std::string& rid, const std::string& acsl, const std::string& service,
+                const std::string& region, int timeout) override;
+    };
+
+    /**
+     * Calls a (local or remote) rendezvous server through the client gRPC service
+     */
+    class GrpcDriver : public Driver {
+
+        private:
+            std::unique_ptr<rendezvous::ClientService::Stub> _stub;
+
+        public:
+            GrpcDriver(const std::string& addr);
+
+            bool registerRequest(std::string& rid) override;
+            bool registerBranch(const std::string& rid, const std::string& acsl, const std::string& service,
+                const std::vector<std::string>& regions, std::string& bid) override;
+            bool closeBranch(const std::string& bid, const std::string& region) override;
+            bool wait(const std::string& rid, const std::string& acsl, const std::string& service,
+                const std::string& region, int timeout) override;
+    };
+
+    /**
+     * Starts a cluster of replicas in the current process: the writer calls one replica and
+     * the reader waits on another one, so that waits depend on replication
+     */
+    class ClusterDriver : public Driver {
+
+        private:
+            Cluster _cluster;
+            GrpcDriver _writer;
+            GrpcDriver _reader;
+
+        public:
+            ClusterDriver(int num_replicas, int base_port, bool async_replication, int link_latency_ms);
+
+            Cluster& getCluster();
+
+            bool registerRequest(std::string& rid) override;
+            bool registerBranch(const std::string& rid, const std::string& acsl, const std::string& service,
+                const std::vector<std::string>& regions, std::string& bid) override;
+            bool closeBranch(const std::string& bid, const std::string& region) override;
+            bool wait(const std::string& rid, const std::string& acsl, const std::string& service,
+                const std::string& region, int timeout) override;
+    };
+}
+
+#endif
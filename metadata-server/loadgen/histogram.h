@@ -0,0 +1,117 @@
+#ifndef LOADGEN_HISTOGRAM_H
+#define LOADGEN_HISTOGRAM_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace loadgen {
+
+    /**
+     * High dynamic range histogram of latencies (in microseconds).
+     * Values are grouped in buckets of powers of two, each one split in linear sub-buckets,
+     * so that the relative error of any recorded value is below 1%
+     */
+    class Histogram {
+
+        private:
+            // 2^7 sub-buckets per power of two
+            static const int SUB_BUCKET_BITS = 7;
+            static const uint64_t SUB_BUCKET_COUNT = 1ULL << SUB_BUCKET_BITS;
+            // values up to 2^40 us (~12 days)
+            static const int MAX_BITS = 40;
+
+            std::vector<uint64_t> _counts;
+            uint64_t _total_count;
+            uint64_t _sum;
+            uint64_t _min;
+            uint64_t _max;
+
+            static int _msb(uint64_t value) {
+                return 63 - __builtin_clzll(value);
+            }
+
+            static size_t _index(uint64_t value) {
+                // first bucket is linear
+                if (value < SUB_BUCKET_COUNT) {
+                    return value;
+                }
+                int shift = _msb(value) - SUB_BUCKET_BITS;
+                uint64_t sub_bucket = (value >> shift) - SUB_BUCKET_COUNT;
+                return (shift + 1) * SUB_BUCKET_COUNT + sub_bucket;
+            }
+
+            // highest value of a bucket
+            static uint64_t _value(size_t index) {
+                if (index < SUB_BUCKET_COUNT) {
+                    return index;
+                }
+                int shift = index / SUB_BUCKET_COUNT - 1;
+                uint64_t sub_bucket = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+                return ((sub_bucket + 1) << shift) - 1;
+            }
+
+        public:
+            Histogram()
+                : _counts((MAX_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT, 0),
+                _total_count(0), _sum(0), _min(UINT64_MAX), _max(0) {
+            }
+
+            void record(uint64_t value) {
+                size_t index = std::min(_index(value), _counts.size() - 1);
+                _counts[index]++;
+                _total_count++;
+                _sum += value;
+                _min = std::min(_min, value);
+                _max = std::max(_max, value);
+            }
+
+            void merge(const Histogram& other) {
+                for (size_t i = 0; i < _counts.size(); i++) {
+                    _counts[i] += other._counts[i];
+                }
+                _total_count += other._total_count;
+                _sum += other._sum;
+                _min = std::min(_min, other._min);
+                _max = std::max(_max, other._max);
+            }
+
+            /**
+             * Return the value below which a given percentage of the recorded values fall
+             *
+             * @param percentile The percentile between 0 and 100
+             */
+            uint64_t percentile(double percentile) const {
+                if (_total_count == 0) {
+                    return 0;
+                }
+                uint64_t target = std::max<uint64_t>(1, (uint64_t) (percentile / 100.0 * _total_count + 0.5));
+                uint64_t count = 0;
+                for (size_t i = 0; i < _counts.size(); i++) {
+                    count += _counts[i];
+                    if (count >= target) {
+                        return std::min(_value(i), _max);
+                    }
+                }
+                return _max;
+            }
+
+            double mean() const {
+                return _total_count == 0 ? 0 : (double) _sum / _total_count;
+            }
+
+            uint64_t count() const {
+                return _total_count;
+            }
+
+            uint64_t min() const {
+                return _total_count == 0 ? 0 : _min;
+            }
+
+            uint64_t max() const {
+                return _max;
+            }
+    };
+}
+
+#endif
@@ -0,0 +1,461 @@
+#include "driver.h"
+#include "histogram.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spdlog/spdlog.h"
+
+using namespace loadgen;
+using Clock = std::chrono::steady_clock;
+
+// ACSL of the reader (e.g. notifier) that waits for the branches of the writer (e.g. post-storage)
+static const std::string READER_ACSL = "loadgen_reader";
+
+typedef struct ConfigStruct {
+    std::string mode = "inprocess";
+    std::string addr = "localhost:8001";
+    std::string loop = "closed";
+    std::vector<int> threads = {1};
+    std::vector<int> rates = {1000};
+    int duration_s = 10;
+    int warmup_s = 1;
+    // branches (services) registered in each ACSL
+    int fanout = 2;
+    // ACSLs per request (the first one is the root)
+    int acsls = 1;
+    int regions = 1;
+    // if greater than 0, branches are closed in background after this delay (so that waits block)
+    int close_delay_ms = 0;
+    int timeout_s = 30;
+    int client_id = 0;
+    std::string output = "loadgen_";
+    // cluster mode: writer calls the first replica and reader waits on the last one
+    int replicas = 2;
+    int base_port = 9001;
+    std::string replication = "async";
+    int link_latency_ms = 0;
+} Config;
+
+typedef struct WorkerResultStruct {
+    Histogram histogram;
+    // latencies (us) of the wait calls
+    Histogram wait_histogram;
+    // latencies (ms) of all measured requests
+    std::vector<double> latencies;
+    uint64_t requests = 0;
+    uint64_t responses = 0;
+} WorkerResult;
+
+// -------
+// Closer
+// -------
+
+/**
+ * Closes branches in background after a delay, simulating datastores that
+ * only make writes visible some time after the branches were registered
+ */
+class Closer {
+
+    private:
+        Driver& _driver;
+        const std::vector<std::string> _regions;
+        const std::chrono::milliseconds _delay;
+        bool _running;
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        // <deadline, bids>
+        std::multimap<Clock::time_point, std::vector<std::string>> _pending;
+        std::vector<std::thread> _threads;
+
+        void _run() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            while (_running || !_pending.empty()) {
+                if (_pending.empty()) {
+                    _cond.wait(lock);
+                    continue;
+                }
+                auto next = _pending.begin();
+                if (next->first > Clock::now()) {
+                    _cond.wait_until(lock, next->first);
+                    continue;
+                }
+                std::vector<std::string> bids = std::move(next->second);
+                _pending.erase(next);
+                lock.unlock();
+                for (const auto& bid : bids) {
+                    for (const auto& region : _regions) {
+                        _driver.closeBranch(bid, region);
+                    }
+                }
+                lock.lock();
+            }
+        }
+
+    public:
+        Closer(Driver& driver, const std::vector<std::string>& regions, int delay_ms, int num_threads)
+            : _driver(driver), _regions(regions), _delay(delay_ms), _running(true) {
+            for (int i = 0; i < num_threads; i++) {
+                _threads.emplace_back(&Closer::_run, this);
+            }
+        }
+
+        ~Closer() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _running = false;
+            _cond.notify_all();
+            lock.unlock();
+            for (auto& thread : _threads) {
+                thread.join();
+            }
+        }
+
+        void schedule(std::vector<std::string> bids) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _pending.emplace(Clock::now() + _delay, std::move(bids));
+            _cond.notify_one();
+        }
+};
+
+// --------
+// Workload
+// --------
+
+static std::vector<std::string> getRegions(int num_regions) {
+    std::vector<std::string> regions;
+    for (int i = 0; i < num_regions; i++) {
+        regions.emplace_back("region_" + std::to_string(i));
+    }
+    return regions;
+}
+
+/**
+ * Post-notification request: the writer registers branches (fan-out services per ACSL),
+ * the branches are closed and the reader waits until the first service is visible
+ *
+ * @param wait_us Set to the duration of the wait call
+ * @return true if all calls succeeded and false otherwise
+ */
+static bool runRequest(Driver& driver, Closer * closer, const Config& config, const std::vector<std::string>& regions,
+    uint64_t& wait_us) {
+    std::string rid;
+    if (!driver.registerRequest(rid)) {
+        return false;
+    }
+
+    std::vector<std::string> bids;
+    for (int a = 0; a < config.acsls; a++) {
+        const std::string& acsl = a == 0 ? "" : "loadgen_" + std::to_string(a);
+        for (int f = 0; f < config.fanout; f++) {
+            std::string bid;
+            if (!driver.registerBranch(rid, acsl, "service_" + std::to_string(f), regions, bid)) {
+                return false;
+            }
+            bids.emplace_back(std::move(bid));
+        }
+    }
+
+    if (closer != nullptr) {
+        closer->schedule(std::move(bids));
+    }
+    else {
+        for (const auto& bid : bids) {
+            for (const auto& region : regions) {
+                if (!driver.closeBranch(bid, region)) {
+                    return false;
+                }
+            }
+        }
+    }
+    auto wait_start = Clock::now();
+    bool ok = driver.wait(rid, READER_ACSL, "service_0", regions[0], config.timeout_s);
+    wait_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - wait_start).count();
+    return ok;
+}
+
+/**
+ * Issue requests until the end of the run
+ *
+ * @param interval Time between the scheduled start of consecutive requests (zero for closed loop)
+ * @param offset Delay of the first request of this worker (open loop)
+ */
+static void runWorker(Driver& driver, Closer * closer, const Config& config, Clock::time_point start,
+    Clock::duration interval, Clock::duration offset, WorkerResult& result) {
+
+    const std::vector<std::string>& regions = getRegions(config.regions);
+    const auto measure_start = start + std::chrono::seconds(config.warmup_s);
+    const auto end = measure_start + std::chrono::seconds(config.duration_s);
+    auto next = start + offset;
+
+    while (true) {
+        // open loop: latency includes the time requests were delayed by previous slow requests
+        Clock::time_point request_start;
+        if (interval != Clock::duration::zero()) {
+            std::this_thread::sleep_until(next);
+            request_start = next;
+            next += interval;
+        }
+        else {
+            request_start = Clock::now();
+        }
+        if (request_start >= end) {
+            break;
+        }
+
+        uint64_t wait_us = 0;
+        bool ok = runRequest(driver, closer, config, regions, wait_us);
+        if (request_start < measure_start) {
+            continue;
+        }
+        result.requests++;
+        if (ok) {
+            auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - request_start).count();
+            result.responses++;
+            result.histogram.record(latency_us);
+            result.wait_histogram.record(wait_us);
+            result.latencies.emplace_back(latency_us / 1000.0);
+        }
+    }
+}
+
+// -------
+// Results
+// -------
+
+/**
+ * Upper bound of the bucket holding a percentile of the observations recorded between two snapshots
+ *
+ * @return The bound in seconds (infinity if the percentile is in the last bucket)
+ */
+static double bucketPercentile(const std::vector<double>& bounds, const metrics::Histogram::Snapshot& before,
+    const metrics::Histogram::Snapshot& after, double percentile) {
+
+    uint64_t count = after.count - before.count;
+    for (size_t i = 0; i < bounds.size(); i++) {
+        if (after.buckets[i] - before.buckets[i] >= count * percentile / 100.0) {
+            return bounds[i];
+        }
+    }
+    return std::numeric_limits<double>::infinity();
+}
+
+static void writeResults(const Config& config, const std::string& prefix, int num_threads, int rate,
+    const std::vector<WorkerResult>& results, const std::map<std::string, metrics::Histogram::Snapshot>& lag_before,
+    const std::map<std::string, metrics::Histogram::Snapshot>& lag_after) {
+
+    Histogram histogram;
+    Histogram wait_histogram;
+    uint64_t requests = 0, responses = 0;
+    for (const auto& result : results) {
+        histogram.merge(result.histogram);
+        wait_histogram.merge(result.wait_histogram);
+        requests += result.requests;
+        responses += result.responses;
+    }
+    double throughput = (double) responses / config.duration_s;
+    double avg_latency_ms = histogram.mean() / 1000.0;
+
+    // all latencies (same format as server-eval)
+    std::ofstream csv(prefix + ".csv");
+    csv << ";client_id;thread_id;latency\n";
+    size_t index = 0;
+    for (size_t thread_id = 0; thread_id < results.size(); thread_id++) {
+        for (double latency : results[thread_id].latencies) {
+            csv << index++ << ';' << config.client_id << ';' << thread_id << ';' << latency << '\n';
+        }
+    }
+
+    // summary parsed by server-eval/plot.py (only 'Throughput' and 'Latency' lines are parsed)
+    std::ostringstream info;
+    info << "Mode: " << config.mode << " (" << config.loop << " loop)\n";
+    if (config.mode == "cluster") {
+        info << "Replicas: " << config.replicas << " (" << config.replication << " replication, "
+            << config.link_latency_ms << " ms link latency)\n";
+    }
+    if (config.loop == "open") {
+        info << "Target rate (req/s): " << rate << "\n";
+    }
+    info << "Duration: " << config.duration_s << "\n";
+    info << "Clients: 1\n";
+    info << "Threads per Client: " << num_threads << "\n";
+    info << "Fan-out: " << config.fanout << ", ACSLs: " << config.acsls << ", Regions: " << config.regions << "\n";
+    info << "Requests: " << requests << "\n";
+    info << "Responses: " << responses << " (" << (requests == 0 ? 0 : responses * 100.0 / requests) << "%)\n";
+    info << "Throughput (req/s): " << throughput << "\n";
+    info << "Latency (ms): " << avg_latency_ms << "\n";
+    info << "p50 (ms): " << histogram.percentile(50) / 1000.0 << "\n";
+    info << "p90 (ms): " << histogram.percentile(90) / 1000.0 << "\n";
+    info << "p99 (ms): " << histogram.percentile(99) / 1000.0 << "\n";
+    info << "p99.9 (ms): " << histogram.percentile(99.9) / 1000.0 << "\n";
+    info << "max (ms): " << histogram.max() / 1000.0 << "\n";
+    info << "Wait mean (ms): " << wait_histogram.mean() / 1000.0 << "\n";
+    info << "Wait p50 (ms): " << wait_histogram.percentile(50) / 1000.0 << "\n";
+    info << "Wait p99 (ms): " << wait_histogram.percentile(99) / 1000.0 << "\n";
+    // bounded by the buckets of the metrics registry (includes warmup but not calls still in flight at the end)
+    const auto& lag_bounds = metrics::DEFAULT_DURATION_BOUNDS;
+    for (const auto& [sid, after] : lag_after) {
+        const auto& before = lag_before.at(sid);
+        uint64_t acks = after.count - before.count;
+        if (acks == 0) {
+            continue;
+        }
+        info << "Replication lag to " << sid << " (ms): mean " << (after.sum - before.sum) * 1000 / acks
+            << ", p50 <= " << bucketPercentile(lag_bounds, before, after, 50) * 1000
+            << ", p99 <= " << bucketPercentile(lag_bounds, before, after, 99) * 1000 << " (" << acks << " acks)\n";
+    }
+    std::ofstream(prefix + ".info") << info.str();
+
+    spdlog::info("[LOADGEN] results written to {}.{{csv,info}}\n{}", prefix, info.str());
+}
+
+// ----
+// Main
+// ----
+
+static std::vector<int> parseList(const std::string& value) {
+    std::vector<int> list;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        list.emplace_back(std::stoi(item));
+    }
+    return list;
+}
+
+static void usage(char * argv[]) {
+    spdlog::error("Usage: {} [--mode inprocess|grpc|cluster] [--addr HOST:PORT] [--loop closed|open] [--threads N,...] [--rates R,...] "
+        "[--duration S] [--warmup S] [--fanout N] [--acsls N] [--regions N] [--close-delay-ms MS] [--timeout S] "
+        "[--client-id ID] [--output PREFIX] [--replicas N] [--base-port PORT] [--replication async|sync] "
+        "[--link-latency-ms MS]", argv[0]);
+    exit(-1);
+}
+
+static Config parseArgs(int argc, char * argv[]) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) usage(argv);
+        std::string value = argv[++i];
+        try {
+            if (arg == "--mode") config.mode = value;
+            else if (arg == "--addr") config.addr = value;
+            else if (arg == "--loop") config.loop = value;
+            else if (arg == "--threads") config.threads = parseList(value);
+            else if (arg == "--rates") config.rates = parseList(value);
+            else if (arg == "--duration") config.duration_s = std::stoi(value);
+            else if (arg == "--warmup") config.warmup_s = std::stoi(value);
+            else if (arg == "--fanout") config.fanout = std::stoi(value);
+            else if (arg == "--acsls") config.acsls = std::stoi(value);
+            else if (arg == "--regions") config.regions = std::stoi(value);
+            else if (arg == "--close-delay-ms") config.close_delay_ms = std::stoi(value);
+            else if (arg == "--timeout") config.timeout_s = std::stoi(value);
+            else if (arg == "--client-id") config.client_id = std::stoi(value);
+            else if (arg == "--output") config.output = value;
+            else if (arg == "--replicas") config.replicas = std::stoi(value);
+            else if (arg == "--base-port") config.base_port = std::stoi(value);
+            else if (arg == "--replication") config.replication = value;
+            else if (arg == "--link-latency-ms") config.link_latency_ms = std::stoi(value);
+            else usage(argv);
+        }
+        catch (const std::exception& e) {
+            usage(argv);
+        }
+    }
+    if ((config.mode != "inprocess" && config.mode != "grpc" && config.mode != "cluster") 
+        || (config.loop != "closed" && config.loop != "open")
+        || (config.replication != "async" && config.replication != "sync") || config.replicas < 2 || config.replicas > 100
+        || config.link_latency_ms < 0
+        || config.threads.empty() || config.rates.empty() || config.fanout < 1 || config.acsls < 1 || config.regions < 1
+        || config.duration_s < 1) {
+        usage(argv);
+    }
+    return config;
+}
+
+int main(int argc, char * argv[]) {
+    Config config = parseArgs(argc, argv);
+
+    // each datapoint of the throughput/latency curve: number of threads (closed loop) or target rate (open loop)
+    std::vector<std::pair<int, int>> datapoints;
+    if (config.loop == "closed") {
+        for (int num_threads : config.threads) {
+            datapoints.emplace_back(num_threads, 0);
+        }
+    }
+    else {
+        for (int rate : config.rates) {
+            datapoints.emplace_back(config.threads.front(), rate);
+        }
+    }
+
+    for (size_t i = 0; i < datapoints.size(); i++) {
+        int num_threads = datapoints[i].first;
+        int rate = datapoints[i].second;
+        spdlog::info("[LOADGEN] running {} loop against {} server with {} threads (rate={})", config.loop, config.mode, num_threads, rate);
+
+        // fresh server for every datapoint
+        std::unique_ptr<Driver> driver;
+        Cluster * cluster = nullptr;
+        if (config.mode == "inprocess") {
+            driver = std::make_unique<InProcessDriver>("lg");
+        }
+        else if (config.mode == "cluster") {
+            auto cluster_driver = std::make_unique<ClusterDriver>(config.replicas, config.base_port,
+                config.replication == "async", config.link_latency_ms);
+            cluster = &cluster_driver->getCluster();
+            driver = std::move(cluster_driver);
+        }
+        else {
+            driver = std::make_unique<GrpcDriver>(config.addr);
+        }
+        std::unique_ptr<Closer> closer;
+        if (config.close_delay_ms > 0) {
+            closer = std::make_unique<Closer>(*driver, getRegions(config.regions), config.close_delay_ms, num_threads);
+        }
+
+        Clock::duration interval = Clock::duration::zero();
+        if (rate > 0) {
+            interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((double) num_threads / rate));
+        }
+
+        std::vector<WorkerResult> results(num_threads);
+        std::vector<std::thread> workers;
+#ifdef LOCK_PROFILING
+        metrics::LockProfiler::get().reset();
+#endif
+        std::map<std::string, metrics::Histogram::Snapshot> lag_before;
+        if (cluster != nullptr) {
+            lag_before = cluster->getReplicationLag();
+        }
+        auto start = Clock::now();
+        for (int t = 0; t < num_threads; t++) {
+            // spread the first request of each worker over the interval
+            auto offset = interval * t / num_threads;
+            workers.emplace_back(runWorker, std::ref(*driver), closer.get(), std::cref(config), start, interval, offset, std::ref(results[t]));
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        closer.reset();
+        std::map<std::string, metrics::Histogram::Snapshot> lag_after;
+        if (cluster != nullptr) {
+            lag_after = cluster->getReplicationLag();
+        }
+
+        writeResults(config, config.output + std::to_string(i), num_threads, rate, results, lag_before, lag_after);
+#ifdef LOCK_PROFILING
+        // locks of the in-process server contended during the datapoint
+        std::ofstream locks_file(config.output + std::to_string(i) + ".locks");
+        locks_file << metrics::LockProfiler::get().dump();
+#endif
+    }
+    return 0;
+}
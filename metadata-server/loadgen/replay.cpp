@@ -0,0 +1,496 @@
+#include "histogram.h"
+#include "../src/metrics/rpc_recorder.h"
+#include "client.grpc.pb.h"
+#include <grpcpp/grpcpp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "spdlog/spdlog.h"
+
+using namespace loadgen;
+using Clock = std::chrono::steady_clock;
+
+typedef struct ConfigStruct {
+    std::string trace;
+    std::string addr = "localhost:8001";
+    // 0 replays as fast as causality allows
+    double speed = 1;
+    // calls of the same request can block each other (e.g. wait and close) so there must be enough threads
+    int threads = 64;
+    // deadline of each replayed call
+    int timeout_s = 60;
+    std::string output = "replay_";
+} Config;
+
+typedef struct WorkerResultStruct {
+    // latencies (us) of each type of call
+    std::map<int, Histogram> histograms;
+    // time (us) between the scheduled arrival of the calls and when they were issued
+    Histogram delay_histogram;
+    uint64_t responses = 0;
+    uint64_t errors = 0;
+    uint64_t code_mismatches = 0;
+    uint64_t wait_mismatches = 0;
+} WorkerResult;
+
+// ----------
+// Causality
+// ----------
+
+/**
+ * Calls of the same request that completed before a call arrived (in the trace) must also complete before it is replayed
+ */
+typedef struct RequestOrderStruct {
+    std::mutex mutex;
+    std::condition_variable cond;
+    // completed calls of the request (ordered by their recorded completion)
+    std::vector<bool> done;
+    // number of calls at the start of 'done' that are all completed
+    size_t prefix = 0;
+} RequestOrder;
+
+typedef struct ReplayCallStruct {
+    rendezvous::TraceRecord record;
+    // nullptr if call does not belong to a known request
+    RequestOrder * order = nullptr;
+    // position in the completion order of the request
+    size_t position = 0;
+    // number of calls of the request that must complete first
+    size_t dependencies = 0;
+} ReplayCall;
+
+static void waitDependencies(const ReplayCall& call) {
+    if (call.order == nullptr) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(call.order->mutex);
+    call.order->cond.wait(lock, [&call] { return call.order->prefix >= call.dependencies; });
+}
+
+static void markDone(const ReplayCall& call) {
+    if (call.order == nullptr) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(call.order->mutex);
+    call.order->done[call.position] = true;
+    while (call.order->prefix < call.order->done.size() && call.order->done[call.order->prefix]) {
+        call.order->prefix++;
+    }
+    call.order->cond.notify_all();
+}
+
+// rid is either a recorded response (registrations) or part of the message
+static std::string recordedRid(const rendezvous::TraceRecord& record, const std::unordered_map<std::string, std::string>& bid_rids) {
+    switch (record.call_case()) {
+        case rendezvous::TraceRecord::kRegisterRequest:
+            return record.rid();
+        case rendezvous::TraceRecord::kRegisterBranch:
+            return record.rid().empty() ? record.register_branch().rid() : record.rid();
+        case rendezvous::TraceRecord::kRegisterBranches:
+            return record.rid().empty() ? record.register_branches().rid() : record.rid();
+        case rendezvous::TraceRecord::kCloseBranch: {
+            const std::string& bid = record.close_branch().bid();
+            auto it = bid_rids.find(bid);
+            if (it != bid_rids.end()) {
+                return it->second;
+            }
+            // FORMAT: <core bid>:<rid>
+            size_t delimiter = bid.find(':');
+            return delimiter == std::string::npos ? "" : bid.substr(delimiter + 1);
+        }
+        case rendezvous::TraceRecord::kWaitRequest:
+            return record.wait_request().rid();
+        case rendezvous::TraceRecord::kCheckStatus:
+            return record.check_status().rid();
+        case rendezvous::TraceRecord::kFetchDependencies:
+            return record.fetch_dependencies().rid();
+        default:
+            return "";
+    }
+}
+
+/**
+ * Sort calls by arrival and compute the dependencies of each one
+ */
+static std::vector<ReplayCall> loadTrace(const std::string& filename,
+        std::unordered_map<std::string, std::unique_ptr<RequestOrder>>& orders) {
+
+    std::vector<ReplayCall> calls;
+    metrics::RpcTraceReader reader(filename);
+    if (!reader.isValid()) {
+        spdlog::critical("[REPLAY] '{}' is not a valid trace file", filename);
+        exit(-1);
+    }
+    ReplayCall call;
+    while (reader.next(call.record)) {
+        if (call.record.call_case() != rendezvous::TraceRecord::CALL_NOT_SET) {
+            calls.push_back(call);
+        }
+    }
+    // records are written when calls complete
+    std::stable_sort(calls.begin(), calls.end(), [](const ReplayCall& a, const ReplayCall& b) {
+        return a.record.arrival_us() < b.record.arrival_us();
+    });
+
+    std::unordered_map<std::string, std::string> bid_rids;
+    std::unordered_map<std::string, std::vector<size_t>> rid_calls;
+    for (size_t i = 0; i < calls.size(); i++) {
+        const rendezvous::TraceRecord& record = calls[i].record;
+        const std::string& rid = recordedRid(record, bid_rids);
+        for (const auto& bid : record.bids()) {
+            bid_rids[bid] = rid;
+        }
+        if (!rid.empty()) {
+            rid_calls[rid].push_back(i);
+        }
+    }
+
+    for (auto& rid_it : rid_calls) {
+        std::vector<size_t>& indexes = rid_it.second;
+        auto order = std::make_unique<RequestOrder>();
+        order->done.resize(indexes.size(), false);
+
+        std::vector<int64_t> ends;
+        std::stable_sort(indexes.begin(), indexes.end(), [&calls](size_t a, size_t b) {
+            return calls[a].record.arrival_us() + calls[a].record.duration_us()
+                < calls[b].record.arrival_us() + calls[b].record.duration_us();
+        });
+        for (size_t position = 0; position < indexes.size(); position++) {
+            const rendezvous::TraceRecord& record = calls[indexes[position]].record;
+            ends.push_back(record.arrival_us() + record.duration_us());
+        }
+        for (size_t position = 0; position < indexes.size(); position++) {
+            ReplayCall& call = calls[indexes[position]];
+            call.order = order.get();
+            call.position = position;
+            call.dependencies = std::lower_bound(ends.begin(), ends.end(), call.record.arrival_us()) - ends.begin();
+        }
+        orders[rid_it.first] = std::move(order);
+    }
+    return calls;
+}
+
+// ---------
+// Replayer
+// ---------
+
+/**
+ * Replays calls with the identifiers generated by the new server (instead of the recorded ones)
+ */
+class Replayer {
+
+    private:
+        std::unique_ptr<rendezvous::ClientService::Stub> _stub;
+        const int _timeout_s;
+        std::mutex _mutex;
+        // <recorded id, replayed id> of requests and branches
+        std::unordered_map<std::string, std::string> _ids;
+
+        std::string _map(const std::string& id) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            auto it = _ids.find(id);
+            return it == _ids.end() ? id : it->second;
+        }
+
+        void _mapRepeated(google::protobuf::RepeatedPtrField<std::string> * ids) {
+            for (auto& id : *ids) {
+                id = _map(id);
+            }
+        }
+
+        void _addMapping(const std::string& recorded_id, const std::string& replayed_id) {
+            if (recorded_id.empty() || replayed_id.empty()) {
+                return;
+            }
+            std::unique_lock<std::mutex> lock(_mutex);
+            _ids[recorded_id] = replayed_id;
+        }
+
+    public:
+        Replayer(const std::string& addr, int timeout_s)
+            : _stub(rendezvous::ClientService::NewStub(grpc::CreateChannel(addr, grpc::InsecureChannelCredentials()))),
+            _timeout_s(timeout_s) {
+        }
+
+        /**
+         * Issue the call of a record
+         *
+         * @param record The recorded call
+         * @param prevented_inconsistency Set to the outcome of wait calls
+         * @return Status of the replayed call
+         */
+        grpc::Status replay(const rendezvous::TraceRecord& record, bool& prevented_inconsistency) {
+            grpc::ClientContext context;
+            context.set_deadline(std::chrono::system_clock::now() + std::chrono::seconds(_timeout_s));
+            grpc::Status status;
+
+            switch (record.call_case()) {
+                case rendezvous::TraceRecord::kRegisterRequest: {
+                    rendezvous::RegisterRequestResponse response;
+                    status = _stub->RegisterRequest(&context, record.register_request(), &response);
+                    if (status.ok()) {
+                        _addMapping(record.rid(), response.rid());
+                    }
+                    break;
+                }
+                case rendezvous::TraceRecord::kRegisterBranch: {
+                    rendezvous::RegisterBranchMessage message = record.register_branch();
+                    message.set_rid(_map(message.rid()));
+                    message.set_current_service_bid(_map(message.current_service_bid()));
+                    rendezvous::RegisterBranchResponse response;
+                    status = _stub->RegisterBranch(&context, message, &response);
+                    if (status.ok()) {
+                        _addMapping(record.rid(), response.rid());
+                        if (record.bids_size() > 0) {
+                            _addMapping(record.bids(0), response.bid());
+                        }
+                    }
+                    break;
+                }
+                case rendezvous::TraceRecord::kRegisterBranches: {
+                    rendezvous::RegisterBranchesMessage message = record.register_branches();
+                    message.set_rid(_map(message.rid()));
+                    message.set_current_service_bid(_map(message.current_service_bid()));
+                    rendezvous::RegisterBranchesResponse response;
+                    status = _stub->RegisterBranches(&context, message, &response);
+                    if (status.ok()) {
+                        _addMapping(record.rid(), response.rid());
+                        for (int i = 0; i < std::min(record.bids_size(), response.bids_size()); i++) {
+                            _addMapping(record.bids(i), response.bids(i));
+                        }
+                    }
+                    break;
+                }
+                case rendezvous::TraceRecord::kCloseBranch: {
+                    rendezvous::CloseBranchMessage message = record.close_branch();
+                    message.set_bid(_map(message.bid()));
+                    _mapRepeated(message.mutable_visible_bids());
+                    rendezvous::Empty response;
+                    status = _stub->CloseBranch(&context, message, &response);
+                    break;
+                }
+                case rendezvous::TraceRecord::kWaitRequest: {
+                    rendezvous::WaitRequestMessage message = record.wait_request();
+                    message.set_rid(_map(message.rid()));
+                    rendezvous::WaitRequestResponse response;
+                    status = _stub->WaitRequest(&context, message, &response);
+                    prevented_inconsistency = response.prevented_inconsistency();
+                    break;
+                }
+                case rendezvous::TraceRecord::kCheckStatus: {
+                    rendezvous::CheckStatusMessage message = record.check_status();
+                    message.set_rid(_map(message.rid()));
+                    rendezvous::CheckStatusResponse response;
+                    status = _stub->CheckStatus(&context, message, &response);
+                    break;
+                }
+                case rendezvous::TraceRecord::kFetchDependencies: {
+                    rendezvous::FetchDependenciesMessage message = record.fetch_dependencies();
+                    message.set_rid(_map(message.rid()));
+                    rendezvous::FetchDependenciesResponse response;
+                    status = _stub->FetchDependencies(&context, message, &response);
+                    break;
+                }
+                default:
+                    break;
+            }
+            return status;
+        }
+};
+
+// --------
+// Workers
+// --------
+
+/**
+ * Calls are dispatched at their (scaled) arrival time and issued by a pool of workers
+ */
+class Dispatcher {
+
+    private:
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::deque<size_t> _queue;
+        bool _finished = false;
+
+    public:
+        void push(size_t index) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queue.push_back(index);
+            _cond.notify_one();
+        }
+
+        void finish() {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _finished = true;
+            _cond.notify_all();
+        }
+
+        /**
+         * @return false if all calls were dispatched
+         */
+        bool pop(size_t& index) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond.wait(lock, [this] { return !_queue.empty() || _finished; });
+            if (_queue.empty()) {
+                return false;
+            }
+            index = _queue.front();
+            _queue.pop_front();
+            return true;
+        }
+};
+
+static void runWorker(Replayer& replayer, Dispatcher& dispatcher, const std::vector<ReplayCall>& calls,
+        const Config& config, Clock::time_point start, WorkerResult& result) {
+
+    size_t index;
+    while (dispatcher.pop(index)) {
+        const ReplayCall& call = calls[index];
+        waitDependencies(call);
+
+        auto issued = Clock::now();
+        if (config.speed > 0) {
+            auto scheduled = start + std::chrono::microseconds((int64_t) (call.record.arrival_us() / config.speed));
+            result.delay_histogram.record(std::max<int64_t>(0,
+                std::chrono::duration_cast<std::chrono::microseconds>(issued - scheduled).count()));
+        }
+        bool prevented_inconsistency = false;
+        grpc::Status status = replayer.replay(call.record, prevented_inconsistency);
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - issued).count();
+        markDone(call);
+
+        result.histograms[call.record.call_case()].record(latency);
+        result.responses++;
+        if (!status.ok()) {
+            result.errors++;
+        }
+        if (status.error_code() != call.record.code()) {
+            result.code_mismatches++;
+        }
+        if (call.record.has_wait_request() && status.ok() && prevented_inconsistency != call.record.prevented_inconsistency()) {
+            result.wait_mismatches++;
+        }
+    }
+}
+
+static void writeResults(const Config& config, size_t num_calls, double duration_s, const std::vector<WorkerResult>& results) {
+    WorkerResult total;
+    for (const auto& result : results) {
+        for (const auto& it : result.histograms) {
+            total.histograms[it.first].merge(it.second);
+        }
+        total.delay_histogram.merge(result.delay_histogram);
+        total.responses += result.responses;
+        total.errors += result.errors;
+        total.code_mismatches += result.code_mismatches;
+        total.wait_mismatches += result.wait_mismatches;
+    }
+    Histogram histogram;
+    for (const auto& it : total.histograms) {
+        histogram.merge(it.second);
+    }
+
+    std::stringstream info;
+    info << "Trace: " << config.trace << "\n";
+    info << "Speed: " << (config.speed > 0 ? std::to_string(config.speed) + "x" : "max") << "\n";
+    info << "Threads: " << config.threads << "\n";
+    info << "Duration: " << duration_s << "\n";
+    info << "Requests: " << num_calls << "\n";
+    info << "Responses: " << total.responses << "\n";
+    info << "Errors: " << total.errors << "\n";
+    info << "Status mismatches (recorded vs replayed): " << total.code_mismatches << "\n";
+    info << "Wait outcome mismatches (recorded vs replayed): " << total.wait_mismatches << "\n";
+    info << "Throughput (req/s): " << (duration_s > 0 ? total.responses / duration_s : 0) << "\n";
+    info << "Latency (ms): " << histogram.mean() / 1000.0 << "\n";
+    info << "p50 (ms): " << histogram.percentile(50) / 1000.0 << "\n";
+    info << "p90 (ms): " << histogram.percentile(90) / 1000.0 << "\n";
+    info << "p99 (ms): " << histogram.percentile(99) / 1000.0 << "\n";
+    info << "max (ms): " << histogram.max() / 1000.0 << "\n";
+    if (config.speed > 0) {
+        info << "Schedule delay p50/p99 (ms): " << total.delay_histogram.percentile(50) / 1000.0
+            << ", " << total.delay_histogram.percentile(99) / 1000.0 << "\n";
+    }
+    for (const auto& it : total.histograms) {
+        // cases of the call are the field numbers of the oneof (e.g. 'register_branch')
+        info << rendezvous::TraceRecord::descriptor()->FindFieldByNumber(it.first)->name() << " (ms): " << it.second.count() << " calls, mean " << it.second.mean() / 1000.0
+            << ", p50 " << it.second.percentile(50) / 1000.0 << ", p99 " << it.second.percentile(99) / 1000.0 << "\n";
+    }
+    std::ofstream(config.output + "0.info") << info.str();
+    spdlog::info("[REPLAY] results:\n{}", info.str());
+}
+
+static void usage(char * argv[]) {
+    spdlog::error("Usage: {} --trace FILE [--addr HOST:PORT] [--speed X (0 for max)] [--threads N] [--timeout S] "
+        "[--output PREFIX]", argv[0]);
+    exit(-1);
+}
+
+static Config parseArgs(int argc, char * argv[]) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) usage(argv);
+        std::string value = argv[++i];
+        try {
+            if (arg == "--trace") config.trace = value;
+            else if (arg == "--addr") config.addr = value;
+            else if (arg == "--speed") config.speed = std::stod(value);
+            else if (arg == "--threads") config.threads = std::stoi(value);
+            else if (arg == "--timeout") config.timeout_s = std::stoi(value);
+            else if (arg == "--output") config.output = value;
+            else usage(argv);
+        }
+        catch (const std::exception& e) {
+            usage(argv);
+        }
+    }
+    if (config.trace.empty() || config.speed < 0 || config.threads < 1 || config.timeout_s < 1) {
+        usage(argv);
+    }
+    return config;
+}
+
+int main(int argc, char * argv[]) {
+    Config config = parseArgs(argc, argv);
+
+    std::unordered_map<std::string, std::unique_ptr<RequestOrder>> orders;
+    std::vector<ReplayCall> calls = loadTrace(config.trace, orders);
+    spdlog::info("[REPLAY] {} calls of {} requests", calls.size(), orders.size());
+
+    Replayer replayer(config.addr, config.timeout_s);
+    Dispatcher dispatcher;
+    std::vector<WorkerResult> results(config.threads);
+    std::vector<std::thread> workers;
+    auto start = Clock::now();
+    for (int i = 0; i < config.threads; i++) {
+        workers.emplace_back(runWorker, std::ref(replayer), std::ref(dispatcher), std::cref(calls),
+            std::cref(config), start, std::ref(results[i]));
+    }
+
+    // calls are dispatched in arrival order so that the calls they depend on are always taken by workers first
+    for (size_t i = 0; i < calls.size(); i++) {
+        if (config.speed > 0) {
+            std::this_thread::sleep_until(start + std::chrono::microseconds((int64_t) (calls[i].record.arrival_us() / config.speed)));
+        }
+        dispatcher.push(i);
+    }
+    dispatcher.finish();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double duration_s = std::chrono::duration<double>(Clock::now() - start).count();
+    writeResults(config, calls.size(), duration_s, results);
+    return 0;
+}
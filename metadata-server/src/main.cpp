@@ -18,14 +18,20 @@
 #include "spdlog/spdlog.h"
 #include "spdlog/fmt/ostr.h"
 #include <spdlog/sinks/stdout_color_sinks.h>
+#include "utils/log.h"
 #include "utils/settings.h"
+#include "metrics/http_exporter.h"
+#include "metrics/rpc_interceptor.h"
+#include "metrics/rpc_recorder.h"
 
 using json = nlohmann::json;
 
 static std::string _replica_id;
 static std::string _connections_filename;
 static std::string _replica_addr;
-static std::vector<std::string> _replicas_addrs;
+static std::string _metrics_host;
+static int _metrics_port;
+static std::vector<replicas::ReplicaClient::Replica> _replicas;
 static json _settings;
 static bool _consistency_checks;
 static bool _async_replication;
@@ -33,6 +39,7 @@ static bool _async_replication;
 std::unique_ptr<grpc::Server> server;
 std::unique_ptr<service::ClientServiceImpl> client_service;
 std::unique_ptr<service::ServerServiceImpl> server_service;
+std::unique_ptr<metrics::RpcRecorder> rpc_recorder;
 
 void sigintHandler(int sig) {
   server->Shutdown();
@@ -46,9 +53,44 @@ void shutdown() {
   server->Shutdown();
 }
 
+#ifdef LOCK_PROFILING
+// signals are handled by a dedicated thread so they must be blocked before any other thread is created
+void blockLockProfilingSignals() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGUSR1);
+  sigaddset(&signals, SIGUSR2);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+}
+
+// dump lock profile on demand with 'kill -USR1 <pid>' and reset it with 'kill -USR2 <pid>'
+void initLockProfilingDump() {
+  metrics::LockProfiler::get().addMetrics(metrics::Registry::get());
+  std::thread([]() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGUSR2);
+    while (true) {
+      int sig;
+      if (sigwait(&signals, &sig) != 0) {
+        continue;
+      }
+      if (sig == SIGUSR1) {
+        spdlog::info("[LOCK PROFILE]\n{}", metrics::LockProfiler::get().dump());
+      }
+      else {
+        metrics::LockProfiler::get().reset();
+        spdlog::info("[LOCK PROFILE] reset");
+      }
+    }
+  }).detach();
+}
+#endif
+
 void run() {
   auto rendezvous_server = std::make_shared<rendezvous::Server> (_replica_id, _settings);
-  client_service = std::make_unique<service::ClientServiceImpl>(rendezvous_server, _replicas_addrs, _consistency_checks);
+  client_service = std::make_unique<service::ClientServiceImpl>(rendezvous_server, _replicas, _consistency_checks);
   server_service = std::make_unique<service::ServerServiceImpl>(rendezvous_server, _consistency_checks);
 
   grpc::ServerBuilder builder;
@@ -57,9 +99,38 @@ void run() {
   builder.RegisterService(client_service.get());
   builder.RegisterService(server_service.get());
 
+  // record latency of all RPCs (only when metrics are exported)
+  std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> interceptor_creators;
+  if (_metrics_port != -1) {
+    interceptor_creators.push_back(std::make_unique<metrics::RpcInterceptorFactory>(metrics::Registry::get(),
+      std::vector<std::string>{ rendezvous::ClientService::service_full_name(), rendezvous_server::ServerService::service_full_name() }));
+  }
+
+  // record RPCs of clients to be replayed later (with rendezvous-replay)
+  const std::string& rpc_trace_file = _settings["rpc_trace_file"].get<std::string>();
+  if (!rpc_trace_file.empty()) {
+    rpc_recorder = std::make_unique<metrics::RpcRecorder>(rpc_trace_file, _settings["rpc_trace_queue_size"].get<int>());
+    if (rpc_recorder->isOpen()) {
+      interceptor_creators.push_back(std::make_unique<metrics::RpcRecorderInterceptorFactory>(*rpc_recorder));
+      spdlog::info("Recording RPCs to '{}'", rpc_trace_file);
+    }
+  }
+  builder.experimental().SetInterceptorCreators(std::move(interceptor_creators));
+
   server = std::unique_ptr<grpc::Server>(builder.BuildAndStart());
   rendezvous_server->initRequestsCleanup();
   rendezvous_server->initSubscribersCleanup();
+  rendezvous_server->initMetrics();
+#ifdef LOCK_PROFILING
+  initLockProfilingDump();
+#endif
+
+  std::unique_ptr<metrics::HttpExporter> metrics_exporter;
+  if (_metrics_port != -1) {
+    metrics_exporter = std::make_unique<metrics::HttpExporter>(metrics::Registry::get(), 
+      _metrics_host, _metrics_port);
+    metrics_exporter->start();
+  }
   //std::thread t(shutdown);
   //signal(SIGINT, sigintHandler);
 
@@ -92,12 +163,21 @@ void loadConfig() {
     _settings = root;
     utils::ASYNC_REPLICATION = _settings["async_replication"].get<bool>();
     utils::CONTEXT_VERSIONING = _settings["context_versioning"].get<bool>();
+    _metrics_host = _settings["metrics_host"].get<std::string>();
+    // from now on messages are written by a background thread
+    utils::initAsyncLogging(_settings["log_queue_size"].get<int>(), _settings["log_level"].get<std::string>());
   }
   catch (json::exception &e) {
     spdlog::error("Error parsing 'settings.json'");
     exit(-1);
   }
 
+  // metrics are only reachable from the local host unless overridden (e.g., containers)
+  auto metrics_host_env = std::getenv("METRICS_HOST");
+  if (metrics_host_env) {
+    _metrics_host = metrics_host_env;
+  }
+
   /* Parse connections config */
   std::ifstream connections_file("../config/connections/" + _connections_filename);
   if (!connections_file.is_open()) {
@@ -117,9 +197,26 @@ void loadConfig() {
       if (_replica_id == id) {
         spdlog::info("{} --> {} (current replica)", id, addr);
         _replica_addr = "0.0.0.0:" + std::to_string(replica.value()["port"].get<int>());
+
+        // metrics port defaults to an offset of the replica's port (-1 disables metrics)
+        int metrics_port_offset = _settings["metrics_port_offset"].get<int>();
+        if (replica.value().contains("metrics_port")) {
+          _metrics_port = replica.value()["metrics_port"].get<int>();
+        }
+        else if (metrics_port_offset != -1) {
+          _metrics_port = replica.value()["port"].get<int>() + metrics_port_offset;
+        }
+        else {
+          _metrics_port = -1;
+        }
       }
       else {
-        _replicas_addrs.push_back(addr);
+        // regions served by the replica (defaults to its own id)
+        std::vector<std::string> regions = { id };
+        if (replica.value().contains("regions")) {
+          regions = replica.value()["regions"].get<std::vector<std::string>>();
+        }
+        _replicas.push_back({ id, addr, regions });
         spdlog::info("{} --> {} ", id, addr);
       }
     }
@@ -139,7 +236,11 @@ void usage(char *argv[]) {
 }
 
 int main(int argc, char *argv[]) {
-  // levels: critical, error, warn, info, debug, trace
+#ifdef LOCK_PROFILING
+  blockLockProfilingSignals();
+#endif
+  // levels: critical, error, warn, info, debug, trace (only the ones compiled in, see LOG_LEVEL)
+  // until settings are parsed
   spdlog::set_level(spdlog::level::trace);
 
   if (argc == 3) {
@@ -3,25 +3,36 @@
 using namespace metadata;
 
 Branch::Branch(std::string service, std::string tag, std::string acsl_id, const utils::ProtoVec& vector_regions, bool replicated)
-    : _service(service), _tag(tag), _acsl_id(acsl_id), _num_opened_regions(vector_regions.size()), replicated(replicated) {
-        _regions = std::unordered_map<std::string, int>();
+    : _service(service), _tag(tag), _acsl_id(acsl_id), _compact(false), _num_opened_regions(vector_regions.size()), 
+    _opened_ts(std::chrono::system_clock::now()), replicated(replicated) {
+        _regions.reserve(vector_regions.size());
         for (const auto& region : vector_regions) {
-            _regions[region] = OPENED;
+            if (_findRegion(region) == nullptr) {
+                _regions.emplace_back(region, OPENED);
+            }
         }
     }
 
-Branch::Branch(std::string service, std::string tag, std::string acsl_id, bool replicated)
-    : _service(service), _tag(tag), _acsl_id(acsl_id), _num_opened_regions(1), replicated(replicated) {
-        _regions = std::unordered_map<std::string, int>();
+Branch::Branch(std::string service, std::string tag, std::string acsl_id, bool replicated, bool compact)
+    : _service(service), _tag(tag), _acsl_id(acsl_id), _compact(compact), _num_opened_regions(1), 
+    _opened_ts(std::chrono::system_clock::now()), replicated(replicated) {
+        _regions.emplace_back(GLOBAL_REGION, OPENED);
+    }
 
-        _regions[GLOBAL_REGION] = OPENED;
+std::pair<std::string, int> * Branch::_findRegion(const std::string& region) {
+    for (auto& region_it : _regions) {
+        if (region_it.first == region) {
+            return &region_it;
+        }
     }
+    return nullptr;
+}
 
-std::string Branch::getACSLID() {
+const std::string& Branch::getACSLID() {
     return _acsl_id;
 }
 
-std::string Branch::getTag() {
+const std::string& Branch::getTag() {
     return _tag;
 }
 
@@ -29,16 +40,51 @@ bool Branch::hasTag() {
     return !_tag.empty();
 }
 
-std::string Branch::getService() {
+const std::string& Branch::getService() {
     return _service;
 }
 
+std::vector<std::string> Branch::getRegions() {
+    std::vector<std::string> regions;
+    std::unique_lock<std::mutex> lock(_mutex_regions);
+    for (const auto& region_it : _regions) {
+        if (region_it.first != GLOBAL_REGION) {
+            regions.emplace_back(region_it.first);
+        }
+    }
+    return regions;
+}
+
+size_t Branch::getFootprint() {
+    size_t bytes = sizeof(Branch) + utils::stringBytes(_service) + utils::stringBytes(_tag) + utils::stringBytes(_acsl_id);
+    std::unique_lock<std::mutex> lock(_mutex_regions);
+    bytes += _regions.heapBytes();
+    for (const auto& region_it : _regions) {
+        bytes += utils::stringBytes(region_it.first);
+    }
+    return bytes;
+}
+
+bool Branch::isCompact() {
+    return _compact;
+}
+
+std::chrono::system_clock::time_point Branch::getOpenedTs() {
+    return _opened_ts;
+}
+
+std::chrono::system_clock::time_point Branch::getClosedTs() {
+    std::unique_lock<std::mutex> lock(_mutex_regions);
+    return _closed_ts;
+}
+
 bool Branch::isGloballyClosed(std::string region) {
     if (region.empty()) {
         return _num_opened_regions.load() == 0;
     }
     std::unique_lock<std::mutex> lock(_mutex_regions);
-    return _regions[region] == CLOSED;
+    auto region_it = _findRegion(region);
+    return region_it == nullptr || region_it->second == CLOSED;
 }
 
 int Branch::getStatus(std::string region) {
@@ -49,29 +95,39 @@ int Branch::getStatus(std::string region) {
         return OPENED;
     }
     std::unique_lock<std::mutex> lock(_mutex_regions);
-    auto region_it = _regions.find(region);
-    if (region_it == _regions.end()) {
+    auto region_it = _findRegion(region);
+    if (region_it == nullptr) {
         return UNKNOWN;
     }
-    return _regions[region];
+    return region_it->second;
 }
 
 int Branch::close(const std::string &region) {
     std::unique_lock<std::mutex> lock(_mutex_regions);
-    auto region_it = _regions.find(region);
-    if (region_it == _regions.end()) {
+    auto region_it = _findRegion(region);
+    if (region_it == nullptr) {
         return -1;
     }
-    if (_regions[region] == CLOSED) {
+    if (region_it->second == CLOSED) {
         return 0;
     }
-    _regions[region] = CLOSED;
-    _num_opened_regions.fetch_add(-1);
+    region_it->second = CLOSED;
+    if (_num_opened_regions.fetch_add(-1) == 1) {
+        _closed_ts = std::chrono::system_clock::now();
+        return 2;
+    }
     return 1;
 }
 
 void Branch::open(const std::string &region) {
     std::unique_lock<std::mutex> lock(_mutex_regions);
-    _regions[region] = OPENED;
+    auto region_it = _findRegion(region);
+    if (region_it == nullptr) {
+        _regions.emplace_back(region, OPENED);
+    }
+    else {
+        region_it->second = OPENED;
+    }
     _num_opened_regions.fetch_add(1);
+    _closed_ts = std::chrono::system_clock::time_point();
 }
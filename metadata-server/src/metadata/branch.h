@@ -2,14 +2,15 @@
 #define BRANCH_H
 
 #include <iostream>
-#include <unordered_map>
 #include <vector>
 #include "client.grpc.pb.h"
 #include "../utils/grpc_service.h"
 #include "../utils/metadata.h"
 #include "../utils/settings.h"
+#include "../utils/small_vector.h"
 #include "mutex"
 #include "atomic"
+#include <chrono>
 
 using namespace utils;
 
@@ -18,38 +19,56 @@ namespace metadata {
     class Branch {
         const std::string GLOBAL_REGION = "";
 
+        public:
+            // branches are usually registered for one or two regions (kept inline without allocations)
+            static const size_t INLINE_REGIONS = 2;
+
         private:
             const std::string _service;
             const std::string _tag;
             const std::string _acsl_id;
+            // only tracks counters (selective replication): closed at once when all its regions are closed
+            const bool _compact;
 
-            // region status with key: <region>, value: <status>
-            std::unordered_map<std::string, int> _regions;
+            // region status: <region, status> (few entries so lookups are linear)
+            utils::SmallVector<std::pair<std::string, int>, INLINE_REGIONS> _regions;
 
             std::atomic<int> _num_opened_regions;
             std::mutex _mutex_regions;
 
+            // used by wait traces (closed timestamp is only set once all regions are closed)
+            const std::chrono::system_clock::time_point _opened_ts;
+            std::chrono::system_clock::time_point _closed_ts;
+
+            /**
+             * Find a region of the branch (caller holds the regions mutex)
+             *
+             * @param region The region
+             * @return The entry of the region or nullptr if it does not exist
+             */
+            std::pair<std::string, int> * _findRegion(const std::string& region);
+
 
 
 
         public:
             std::atomic<bool> replicated;
             Branch(std::string service, std::string tag, std::string acsl_id, const utils::ProtoVec& vector_regions, bool replicated);
-            Branch(std::string service, std::string tag, std::string acsl_id, bool replicated);
+            Branch(std::string service, std::string tag, std::string acsl_id, bool replicated, bool compact = false);
 
             /**
              * Get the branch's acsl_id
              * 
              * @return acsl_id
              */
-            std::string getACSLID();
+            const std::string& getACSLID();
 
             /**
              * Get the branch's tag
              * 
              * @return bid
              */
-            std::string getTag();
+            const std::string& getTag();
 
             /**
              * Return whether a tag was assigned to this branch
@@ -63,7 +82,42 @@ namespace metadata {
              * 
              * @return service 
              */
-            std::string getService();
+            const std::string& getService();
+
+            /**
+             * Get the regions of the branch (empty for the global region)
+             * 
+             * @return regions
+             */
+            std::vector<std::string> getRegions();
+
+            /**
+             * Approximate memory used by the branch
+             * 
+             * @return bytes
+             */
+            size_t getFootprint();
+
+            /**
+             * Return whether the branch only tracks counters, without region counters (selective replication)
+             * 
+             * @return true if compact and false otherwise
+             */
+            bool isCompact();
+
+            /**
+             * Get the time when the branch was registered
+             * 
+             * @return opened timestamp
+             */
+            std::chrono::system_clock::time_point getOpenedTs();
+
+            /**
+             * Get the time when the last region of the branch was closed
+             * 
+             * @return closed timestamp (zero if the branch is still opened)
+             */
+            std::chrono::system_clock::time_point getClosedTs();
 
             /**
              * Check if branch is closed for a given region or globally
@@ -84,7 +138,8 @@ namespace metadata {
              * 
              * @param region The region context
              * 
-             * @returns -1 if region does not exist, 1 if if was successfully closed and 0 if it was already closed
+             * @returns -1 if region does not exist, 1 if if was successfully closed, 2 if it was successfully closed
+             * and it was the last opened region (branch is now globally closed) and 0 if it was already closed
              */
             int close(const std::string &region);
 
@@ -1,32 +1,114 @@
 #include "request.h"
 #include "branch.h"
+#include "../metrics/metrics.h"
+#include <algorithm>
 #include <cstddef>
 #include <mutex>
 #include <shared_mutex>
-#include <spdlog/spdlog.h>
+#include "../utils/log.h"
 
 using namespace metadata;
 
+static metrics::Gauge * const LIVE_REQUESTS = metrics::Registry::get().gauge(
+    "rendezvous_live_requests", "Number of requests in memory (including closed ones)");
+static metrics::Gauge * const LIVE_BRANCHES = metrics::Registry::get().gauge(
+    "rendezvous_live_branches", "Number of branches in memory");
+static metrics::Gauge * const LIVE_SERVICE_NODES = metrics::Registry::get().gauge(
+    "rendezvous_live_service_nodes", "Number of service nodes in memory");
+
+// parent service of branches registered without a current service
+static const std::string NO_SERVICE = "";
+// compact branches are not tracked in any region
+static const utils::ProtoVec NO_REGIONS;
+
+/**
+ * Find a counter of a service node or acsl without inserting it (counters are only inserted
+ * while tracking branches and never erased, so the pointer can be kept by readers)
+ *
+ * @param counters The counters of the service node or acsl
+ * @param key The acsl, region or tag of the counter
+ * @return Pointer to the counter or nullptr if it does not exist yet
+ */
+static const std::atomic<int> * findCounter(const Request::Counters& counters, const std::string& key) {
+    auto it = counters.find(key);
+    return it != counters.end() ? &it->second : nullptr;
+}
+
+/**
+ * Counter of a service node or acsl without inserting it
+ *
+ * @param counters The counters of the service node or acsl
+ * @param key The acsl, region or tag of the counter
+ * @return The counter or 0 if it does not exist yet
+ */
+static int getCounter(const Request::Counters& counters, const std::string& key) {
+    const std::atomic<int> * counter = findCounter(counters, key);
+    return counter != nullptr ? counter->load() : 0;
+}
+
+/**
+ * Counter of a service node or acsl, inserted if it does not exist yet
+ *
+ * @param counters The counters of the service node or acsl
+ * @param key The acsl, region or tag of the counter
+ * @param bytes Incremented by the size of the new entry if the counter is inserted
+ * @return The counter
+ */
+static std::atomic<int>& trackCounter(Request::Counters& counters, const std::string& key, size_t& bytes) {
+    auto it = counters.find(key);
+    if (it != counters.end()) return it->second;
+    auto inserted = counters.emplace(key, 0);
+    if (inserted.second) {
+        bytes += utils::entryBytes(key, sizeof(std::atomic<int>));
+    }
+    return inserted.first->second;
+}
+
+/**
+ * Opened branches of a tag in a service node, globally or in a region (without inserting counters)
+ *
+ * @param service_node The service node
+ * @param tag The tag
+ * @param region The region (empty for all regions)
+ * @return The number of opened branches
+ */
+static int getTagCounter(const Request::ServiceNode * service_node, const std::string& tag, const std::string& region) {
+    if (region.empty()) {
+        return getCounter(service_node->tag_opened_branches, tag);
+    }
+    auto tag_it = service_node->tag_opened_regions.find(tag);
+    return tag_it != service_node->tag_opened_regions.end() ? getCounter(tag_it->second, region) : 0;
+}
+
 Request::Request(std::string rid, replicas::VersionRegistry * versions_registry)
-    : _rid(rid), _next_bid_index(0), _num_opened_branches(0), _opened_global_region(0), 
-    _next_sub_rid_index(0), acsls_i(0), _versions_registry(versions_registry), _closed(false) {
+    : _rid(rid), _closed(false), _versions_registry(versions_registry),
+    _next_bid_index(0), _num_opened_branches(0), _opened_global_region(0), _opened_compact_branches(0),
+    _next_sub_rid_index(0), acsls_i(0),
+    _branches_bytes(0), _service_nodes_bytes(0), _acsls_bytes(0), _wait_logs_bytes(0),
+    _num_branches(0), _num_service_nodes(0), _num_acsls(0), _num_wait_logs(0) {
 
     _last_ts = std::chrono::system_clock::now();
     // <bid, branch>
-    _branches = std::unordered_map<std::string, metadata::Branch*>();
-    _service_nodes = std::unordered_map<std::string, ServiceNode*>();
+    _branches = utils::FlatMap<metadata::Branch*>();
     _acsls = oneapi::tbb::concurrent_hash_map<std::string, ACSL*>();
-    _wait_logs = std::set<std::string>();
-    _service_wait_logs = std::unordered_map<std::string, std::unordered_set<ServiceNode*>>();
+    _wait_logs = std::set<ACSL*, ACSLOrder>();
+    _service_wait_logs = utils::FlatMap<std::unordered_set<ServiceNode*>>();
 
     // add root node
-    _service_nodes[utils::ROOT_SERVICE_NODE_ID] = new ServiceNode{utils::ROOT_SERVICE_NODE_ID};
-    _service_nodes[utils::ROOT_SERVICE_NODE_ID]->acsl_opened_branches[utils::ROOT_ACSL_ID] = 0;
+    ServiceNode * root_node = new ServiceNode{utils::ROOT_SERVICE_NODE_ID};
+    size_t root_node_bytes = 0;
+    trackCounter(root_node->acsl_opened_branches, utils::ROOT_ACSL_ID, root_node_bytes);
+    _service_nodes.emplace(utils::ROOT_SERVICE_NODE_ID, root_node);
+    _accountServiceNode(utils::ROOT_SERVICE_NODE_ID);
+    _service_nodes_bytes.fetch_add(root_node_bytes);
+    LIVE_SERVICE_NODES->inc();
+    LIVE_REQUESTS->inc();
 
     // insert the acsl of the root
     tbb::concurrent_hash_map<std::string, ACSL*>::accessor write_accessor;
     _acsls.insert(write_accessor, utils::ROOT_ACSL_ID);
-    write_accessor->second = new ACSL{utils::ROOT_ACSL_ID, 0};
+    write_accessor->second = new ACSL{utils::ROOT_ACSL_ID, utils::encodeACSLKey(utils::ROOT_ACSL_ID), 0};
+    _accountACSL(write_accessor->second);
 }
 
 Request::~Request() {
@@ -38,10 +120,13 @@ Request::~Request() {
         for (const auto& it : _branches) {
             delete it.second;
         }
+        LIVE_BRANCHES->add(-(int64_t) _branches.size());
     }
     for (const auto& it : _service_nodes) {
         delete it.second;
     }
+    LIVE_SERVICE_NODES->add(-(int64_t) _service_nodes.size());
+    LIVE_REQUESTS->dec();
     delete _versions_registry;
 }
 
@@ -58,17 +143,58 @@ void Request::partialDelete() {
     for (const auto& it : _acsls) {
         delete it.second;
     }
+    // wait logs point to the deleted acsls
+    _wait_logs.clear();
     for (const auto& it : _branches) {
         delete it.second;
     }
+    LIVE_BRANCHES->add(-(int64_t) _branches.size());
     delete _versions_registry;
+    // prevent a double delete when the request is destroyed
+    _versions_registry = nullptr;
+
+    _branches_bytes.store(0);
+    _acsls_bytes.store(0);
+    _num_branches.store(0);
+    _num_acsls.store(0);
+}
+
+// -----------------
+// Memory Accounting
+//------------------
+
+void Request::_accountServiceNode(const std::string& service) {
+    _service_nodes_bytes.fetch_add(sizeof(ServiceNode) + utils::stringBytes(service) + utils::entryBytes(service, sizeof(ServiceNode*)));
+    _num_service_nodes.fetch_add(1);
+}
+
+void Request::_accountACSL(const ACSL * acsl) {
+    _acsls_bytes.fetch_add(sizeof(ACSL) + utils::stringBytes(acsl->acsl_id) + utils::stringBytes(acsl->key)
+        + utils::entryBytes(acsl->acsl_id, sizeof(ACSL*)));
+    _num_acsls.fetch_add(1);
+}
+
+Request::Footprint Request::getFootprint() {
+    Footprint footprint;
+    footprint.branches_bytes = _branches_bytes.load();
+    footprint.service_nodes_bytes = _service_nodes_bytes.load();
+    footprint.acsls_bytes = _acsls_bytes.load();
+    footprint.wait_logs_bytes = _wait_logs_bytes.load();
+    footprint.registry_bytes = _versions_registry != nullptr ? _versions_registry->getFootprint() : 0;
+    footprint.num_branches = _num_branches.load();
+    footprint.num_service_nodes = _num_service_nodes.load();
+    footprint.num_acsls = _num_acsls.load();
+    footprint.num_wait_logs = _num_wait_logs.load();
+    footprint.bytes = sizeof(Request) + utils::stringBytes(_rid) + footprint.branches_bytes + footprint.service_nodes_bytes
+        + footprint.acsls_bytes + footprint.wait_logs_bytes + footprint.registry_bytes;
+    return footprint;
 }
 
 // -----------
 // Identifiers
 //------------
 
-std::string Request::getRid() {
+const std::string& Request::getRid() {
     return _rid;
 }
 
@@ -82,14 +208,14 @@ std::string Request::genId() {
 
 void Request::setBranchReplicationReady(metadata::Branch * branch) {
     if (utils::ASYNC_REPLICATION) {
-        std::unique_lock<std::mutex> lock(_mutex_replicated_bid);
+        std::unique_lock<utils::Mutex> lock(_mutex_replicated_bid);
         branch->replicated.store(true);
         _cond_replicated_bid.notify_all();
     }
 }
 
-metadata::Branch * Request::_waitBranchRegistration(const std::string& bid) {
-    std::unique_lock<std::mutex> lock(_mutex_branches);
+metadata::Branch * Request::_waitBranchRegistration(std::string_view bid) {
+    std::unique_lock<utils::Mutex> lock(_mutex_branches);
     auto branch_it = _branches.find(bid);
 
     // if we are dealing with async replication we wait until branch is registered
@@ -98,7 +224,7 @@ metadata::Branch * Request::_waitBranchRegistration(const std::string& bid) {
             auto start_time = std::chrono::steady_clock::now();
             auto remaining_time = _computeRemainingTime(utils::WAIT_REPLICA_TIMEOUT_S, start_time);
             while (branch_it == _branches.end()) {
-                //spdlog::debug("waiting branch registration for bid {}", bid);
+                SPDLOG_DEBUG("waiting branch registration for bid {}", bid);
                 _cond_new_branch.wait_for(lock, std::chrono::seconds(remaining_time));
                 remaining_time = _computeRemainingTime(utils::WAIT_REPLICA_TIMEOUT_S, start_time);
                 if (remaining_time <= std::chrono::seconds(0)) {
@@ -114,14 +240,14 @@ metadata::Branch * Request::_waitBranchRegistration(const std::string& bid) {
             return branch_it->second;
         }
         else {
-            //spdlog::debug("abort waiting branch registration for bid {}", bid);
+            SPDLOG_DEBUG("abort waiting branch registration for bid {}", bid);
             return nullptr;
         }
     }
     return branch_it->second;
 }
 
-metadata::Branch * Request::_waitBranchReplicationReady(const std::string& bid) {
+metadata::Branch * Request::_waitBranchReplicationReady(std::string_view bid) {
     // wait for creation
     metadata::Branch * branch = _waitBranchRegistration(bid);
     if (branch == nullptr) {
@@ -130,7 +256,7 @@ metadata::Branch * Request::_waitBranchReplicationReady(const std::string& bid)
     
     auto start_time = std::chrono::steady_clock::now();
     auto remaining_time = _computeRemainingTime(utils::WAIT_REPLICA_TIMEOUT_S, start_time);
-    std::unique_lock<std::mutex> lock(_mutex_replicated_bid);
+    std::unique_lock<utils::Mutex> lock(_mutex_replicated_bid);
     
     // wait for actuall replication
     while (branch->replicated.load() == false) {
@@ -143,22 +269,23 @@ metadata::Branch * Request::_waitBranchReplicationReady(const std::string& bid)
     return branch;
 }
 
-bool Request::waitBranchesReplicationReady(std::vector<std::string> visible_bids) {
+bool Request::waitBranchesReplicationReady(const std::vector<std::string_view>& visible_bids) {
     auto start_time = std::chrono::steady_clock::now();
     auto remaining_time = _computeRemainingTime(utils::WAIT_REPLICA_TIMEOUT_S, start_time);
 
     for (const auto& bid: visible_bids) {
-        std::unique_lock<std::mutex> lock(_mutex_replicated_bid);
-        auto branch_it = _branches.find(bid);
+        std::unique_lock<utils::Mutex> lock(_mutex_replicated_bid);
+        // branches are looked up under their own mutex (a concurrent registration may rehash the map)
+        metadata::Branch * branch = getBranch(bid);
         
         // branches already exist
-        while (branch_it == _branches.end() || branch_it->second->replicated.load() == false) {
+        while (branch == nullptr || branch->replicated.load() == false) {
             _cond_replicated_bid.wait_for(lock, std::chrono::seconds(remaining_time));
             if (remaining_time <= std::chrono::seconds(0)) {
                 return false;
             }
             remaining_time = _computeRemainingTime(utils::WAIT_REPLICA_TIMEOUT_S, start_time);
-            branch_it = _branches.find(bid);
+            branch = getBranch(bid);
         }
     }
     return true;
@@ -208,8 +335,11 @@ std::string Request::addNextACSL(const std::string& sid, const std::string& acsl
     if (next_sub_rid != utils::ROOT_ACSL_ID) {
         // insert the next acsl and return its id
         tbb::concurrent_hash_map<std::string, ACSL*>::accessor write_accessor;
-        _acsls.insert(write_accessor, next_sub_rid);
-        write_accessor->second = new ACSL{next_sub_rid, acsls_i.fetch_add(1)};
+        // an existing acsl is kept since it may be referenced by the wait logs
+        if (_acsls.insert(write_accessor, next_sub_rid)) {
+            write_accessor->second = new ACSL{next_sub_rid, utils::encodeACSLKey(next_sub_rid), acsls_i.fetch_add(1)};
+            _accountACSL(write_accessor->second);
+        }
     }
 
     return next_sub_rid;
@@ -222,18 +352,29 @@ void Request::insertACSL(const std::string& acsl_id) {
         tbb::concurrent_hash_map<std::string, ACSL*>::accessor write_accessor;
         bool new_acsl = _acsls.insert(write_accessor, acsl_id);
         if (new_acsl) {
-            write_accessor->second = new ACSL{acsl_id};
+            write_accessor->second = new ACSL{acsl_id, utils::encodeACSLKey(acsl_id)};
+            _accountACSL(write_accessor->second);
         }
     }
 }
 
 metadata::Request::ACSL * Request::_validateACSL(const std::string& acsl_id) {
+    // acsls are looked up by every status call and registration so the common case (acsl
+    // already exists) only takes the shared lock of the entry
+    {
+        tbb::concurrent_hash_map<std::string, ACSL*>::const_accessor read_accessor;
+        if (_acsls.find(read_accessor, acsl_id)) {
+            return read_accessor->second;
+        }
+    }
+
     // insert the next acsl and return its id
     tbb::concurrent_hash_map<std::string, ACSL*>::accessor write_accessor;
     bool new_acsl = _acsls.insert(write_accessor, acsl_id);
     if (new_acsl) {
-        ACSL * acsl = new ACSL{acsl_id};
+        ACSL * acsl = new ACSL{acsl_id, utils::encodeACSLKey(acsl_id)};
         write_accessor->second = acsl;
+        _accountACSL(acsl);
         return acsl;
     }
     return write_accessor->second;
@@ -244,26 +385,28 @@ metadata::Request::ACSL * Request::_validateACSL(const std::string& acsl_id) {
 //----------------------
 
 metadata::Branch * Request::registerBranch(const std::string& acsl_id, const std::string& bid, const std::string& service,  
-    const std::string& tag, const utils::ProtoVec& regions, const std::string& current_service_bid, bool replicated) {
+    const std::string& tag, const utils::ProtoVec& regions, std::string_view current_service_bid, bool replicated,
+    bool compact) {
 
-    //spdlog::debug("> register branch for {}:{} @ acsl {}", service, tag, acsl_id);
-    std::string current_service = "";
+    SPDLOG_DEBUG("> register branch for {}:{} @ acsl {}", service, tag, acsl_id);
+    metadata::Branch * current_service_branch = nullptr;
     if (!current_service_bid.empty()) {
-        //spdlog::debug("> wait branch replication ready {}:{} @ {}", service, tag, acsl_id);
-        metadata::Branch * current_service_branch = _waitBranchReplicationReady(current_service_bid);
+        SPDLOG_DEBUG("> wait branch replication ready {}:{} @ {}", service, tag, acsl_id);
+        current_service_branch = _waitBranchReplicationReady(current_service_bid);
         if (current_service_branch == nullptr) {
             return nullptr;
         }
-        //spdlog::debug("< wait branch replication ready {}:{} @ {}", service, tag, acsl_id);
-        current_service = current_service_branch->getService();
+        SPDLOG_DEBUG("< wait branch replication ready {}:{} @ {}", service, tag, acsl_id);
     }
+    // service of a branch never changes after its registration
+    const std::string& current_service = current_service_branch != nullptr ? current_service_branch->getService() : NO_SERVICE;
 
-    std::unique_lock<std::mutex> lock(_mutex_branches);
+    std::unique_lock<utils::Mutex> lock(_mutex_branches);
     auto branch_it = _branches.find(bid);
 
     // branches already exist
     if (branch_it != _branches.end()) {
-        spdlog::error("Branch with core bid '{}' already exists", bid);
+        LOG_ERROR_RATE_LIMITED("Branch with core bid '{}' already exists", bid);
         return nullptr;
     }
     lock.unlock();
@@ -271,8 +414,14 @@ metadata::Branch * Request::registerBranch(const std::string& acsl_id, const std
     metadata::Branch * branch;
     int num = regions.size();
 
+    // compact branch only tracked by counters (closed at once when all its regions are closed)
+    if (compact) {
+        num = 1;
+        branch = new metadata::Branch(service, tag, acsl_id, replicated, true);
+    }
+
     // branch with specified regions
-    if (num > 0) {
+    else if (num > 0) {
         branch = new metadata::Branch(service, tag, acsl_id, regions, replicated);
     }
 
@@ -285,48 +434,68 @@ metadata::Branch * Request::registerBranch(const std::string& acsl_id, const std
     insertACSL(acsl_id);
 
     // error tracking branch (tag already exists!)
-    if (!trackBranch(acsl_id, service, regions, num, current_service, branch)) {
-        spdlog::error("Error tracking branch with core bid '{}'", bid);
+    if (!trackBranch(acsl_id, service, compact ? NO_REGIONS : regions, num, current_service, branch)) {
+        LOG_ERROR_RATE_LIMITED("Error tracking branch with core bid '{}'", bid);
         delete branch;
-        //spdlog::debug("< track {}:{} @ {}", service, tag, acsl_id);
+        SPDLOG_DEBUG("< track {}:{} @ {}", service, tag, acsl_id);
         return nullptr;
     }
 
+    size_t branch_bytes = branch->getFootprint() + utils::flatEntryBytes(bid, sizeof(metadata::Branch*));
     lock.lock();
     _branches[bid] = branch;
-    
-    // notify threads waiting for replication ready
+    LIVE_BRANCHES->inc();
+    _branches_bytes.fetch_add(branch_bytes);
+    _num_branches.fetch_add(1);
+    _cond_new_branch.notify_all();
+    lock.unlock();
+
+    // notify threads waiting for replication ready (they hold the replicated bid mutex while looking up branches)
     if (replicated) {
+        std::unique_lock<utils::Mutex> lock_replicated(_mutex_replicated_bid);
         _cond_replicated_bid.notify_all();
     }
-    _cond_new_branch.notify_all();
-    lock.unlock();
 
-    //spdlog::debug("< registered branch for {}:{} @ acsl {}", service, tag, acsl_id);
+    SPDLOG_DEBUG("< registered branch for {}:{} @ acsl {}", service, tag, acsl_id);
     return branch;
 }
 
-int Request::closeBranch(const std::string& bid, const std::string& region) {
-    //spdlog::debug("> close branch for {} @ {}", bid, region);
+metadata::Branch * Request::getBranch(std::string_view bid) {
+    std::unique_lock<utils::Mutex> lock(_mutex_branches);
+    auto branch_it = _branches.find(bid);
+    if (branch_it == _branches.end()) {
+        return nullptr;
+    }
+    return branch_it->second;
+}
+
+int Request::closeBranch(std::string_view bid, const std::string& region, bool * globally_closed_out) {
+    SPDLOG_DEBUG("> close branch for {} @ {}", bid, region);
 
     metadata::Branch * branch = _waitBranchRegistration(bid);
     if (branch == nullptr) {
-        spdlog::error("branch '{}' not found", bid);
+        LOG_ERROR_RATE_LIMITED("branch '{}' not found", bid);
         return -1;
     }
     int closed = branch->close(region);
-    if (closed == 1) {
+    if (closed >= 1) {
         const std::string& service = branch->getService(); 
         const std::string& acsl_id = branch->getACSLID();
-        bool globally_closed = branch->isGloballyClosed();
+        // only the close of the last opened region observes the transition
+        bool globally_closed = closed == 2;
+        closed = 1;
 
         // abort: error in acsls tbb map
-        if (!untrackBranch(acsl_id, service, region, globally_closed)) {
+        if (!untrackBranch(acsl_id, service, branch->getTag(), region, globally_closed, branch->isCompact())) {
             branch->open(region);
-            spdlog::error("branch '{}' error untracking in acsl", bid);
+            LOG_ERROR_RATE_LIMITED("branch '{}' error untracking in acsl", bid);
             return -1;
         }
 
+        if (globally_closed_out != nullptr) {
+            *globally_closed_out = globally_closed;
+        }
+
         // if this branch is globally closed than we are closer to have all the request closed
         // so we check if all branches are closed
         if (globally_closed) {
@@ -336,35 +505,51 @@ int Request::closeBranch(const std::string& bid, const std::string& region) {
         }
     }
     else {
-        spdlog::error("Could not close branch with core bid '{}'", bid);
+        LOG_ERROR_RATE_LIMITED("Could not close branch with core bid '{}'", bid);
     }
-    //spdlog::debug("< close branch for {} @ {}", bid, region);
+    SPDLOG_DEBUG("< close branch for {} @ {}", bid, region);
     return closed;
 }
 
-bool Request::untrackBranch(const std::string& acsl_id, const std::string& service, 
-    const std::string& region, bool globally_closed) {
+bool Request::untrackBranch(const std::string& acsl_id, const std::string& service, const std::string& tag,
+    const std::string& region, bool globally_closed, bool compact) {
 
     // ---------------------------
     // SERVICE NODE & DEPENDENCIES
     // ---------------------------
-    std::unique_lock<std::shared_mutex> lock_services(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock_services(_mutex_service_nodes);
 
     // sanity check
     auto it = _service_nodes.find(service);
     if (it == _service_nodes.end()) return false;
     ServiceNode * service_node = it->second;
-    
+
+    // counters are read by status calls without locks
+    _beginStatusWrite(_service_status_version);
     if (globally_closed) {
-        service_node->opened_branches--;
-        service_node->acsl_opened_branches[acsl_id]--;
+        service_node->opened_branches.fetch_add(-1);
+        service_node->acsl_opened_branches[acsl_id].fetch_add(-1);
     }
-    if (region.empty()) {
-        service_node->opened_global_region--;
+    if (compact) {
+        // compact branches are not tracked in any region
+        service_node->opened_compact_branches.fetch_add(-1);
+    }
+    else if (region.empty()) {
+        service_node->opened_global_region.fetch_add(-1);
     }
     else {
-        service_node->opened_regions[region]--;
+        service_node->opened_regions[region].fetch_add(-1);
+    }
+    // counters of the tag were created when tracking the branch
+    if (!tag.empty()) {
+        if (globally_closed) {
+            service_node->tag_opened_branches[tag].fetch_add(-1);
+        }
+        if (!compact && !region.empty()) {
+            service_node->tag_opened_regions[tag][region].fetch_add(-1);
+        }
     }
+    _endStatusWrite(_service_status_version);
 
     // notify creation of new branch
     _cond_service_nodes.notify_all();
@@ -380,31 +565,39 @@ bool Request::untrackBranch(const std::string& acsl_id, const std::string& servi
     // are observed at the same time in the wait calls, while ensuring fine-grained lock with tbb lib
     // when using a shared_lock here
 
-    std::shared_lock<std::shared_mutex> lock_acsls(_mutex_acsls);
+    std::shared_lock<utils::SharedMutex> lock_acsls(_mutex_acsls);
     ACSL * acsl = _validateACSL(acsl_id);
     if (acsl == nullptr) return false;
 
+    _beginStatusWrite(_status_version);
     if (globally_closed) {
         acsl->opened_branches.fetch_add(-1);
     }
 
-    if (region.empty()) {
+    if (compact) {
+        // compact branches are not tracked in any region
+        acsl->opened_compact_branches.fetch_add(-1);
+    }
+    else if (region.empty()) {
         acsl->opened_global_region.fetch_add(-1);
     }
     else {
-        tbb::concurrent_hash_map<std::string, int>::accessor write_accessor;
-        bool found = acsl->opened_regions.find(write_accessor, region);
+        auto region_it = acsl->opened_regions.find(region);
         // sanity check (must always be found)
-        if (found) {
-            write_accessor->second--;
+        if (region_it != acsl->opened_regions.end()) {
+            region_it->second.fetch_add(-1);
         }
     }
 
     // ------------
     // REGIONS ONLY (REMINDER: needs to be placed after tracking acsls to notify all threads)
     // ------------
-    if (!region.empty()) {
-        std::unique_lock<std::mutex> lock_regions(_mutex_regions);
+    if (compact) {
+        // compact branches are not tracked in any region
+        _opened_compact_branches.fetch_add(-1);
+    }
+    else if (!region.empty()) {
+        std::unique_lock<utils::Mutex> lock_regions(_mutex_regions);
         _opened_regions[region]--;
     }
     else {
@@ -413,6 +606,7 @@ bool Request::untrackBranch(const std::string& acsl_id, const std::string& servi
     if (globally_closed) {
         _num_opened_branches.fetch_add(-1);
     }
+    _endStatusWrite(_status_version);
     _cond_acsls.notify_all();
     return true;
 }
@@ -425,31 +619,24 @@ bool Request::trackBranch(const std::string& acsl_id, const std::string& service
     // ---------------------------
     ServiceNode * parent_node;
     ServiceNode * service_node;
-    std::unique_lock<std::shared_mutex> lock_services(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock_services(_mutex_service_nodes);
 
     auto it = _service_nodes.find(current_service);
-    // if parent does not exist we wait for it
+    // if parent does not exist we wait for it (service nodes are only looked up while holding their mutex)
     if (service != current_service && it == _service_nodes.end()) {
-        lock_services.unlock();
-
-        std::unique_lock<std::mutex> lock(_mutex_branches);
         auto start_time = std::chrono::steady_clock::now();
         auto remaining_time = _computeRemainingTime(utils::WAIT_REPLICA_TIMEOUT_S, start_time);
         while (it == _service_nodes.end()) {
-            _cond_new_branch.wait_for(lock, std::chrono::seconds(remaining_time));
+            _cond_new_service_nodes.wait_for(lock_services, std::chrono::seconds(remaining_time));
             remaining_time = _computeRemainingTime(utils::WAIT_REPLICA_TIMEOUT_S, start_time);
             if (remaining_time <= std::chrono::seconds(0)) {
-                spdlog::error("current service node '{}' not found (timed out)", current_service);
+                LOG_ERROR_RATE_LIMITED("current service node '{}' not found (timed out)", current_service);
                 return false;
             }
             it = _service_nodes.find(current_service);
         }
-        parent_node = it->second;
-        lock_services.lock();
-    }
-    else {
-        parent_node = it->second;
     }
+    parent_node = it != _service_nodes.end() ? it->second : nullptr;
     
     // sanity check
     auto service_node_it = _service_nodes.find(service);
@@ -457,62 +644,82 @@ bool Request::trackBranch(const std::string& acsl_id, const std::string& service
         std::vector<std::string> acsl_ids = std::vector<std::string>();
         acsl_ids.emplace_back(acsl_id);
         service_node = new ServiceNode{service};
-        service_node->opened_regions = std::unordered_map<std::string, int>();
-        _service_nodes[service] = service_node;
+        _service_nodes.emplace(service, service_node);
+        _accountServiceNode(service);
+        LIVE_SERVICE_NODES->inc();
     }
     else {
         service_node = service_node_it->second;
     }
 
-    // needs to be placed before lock_service_nodes to prevent deadlocks (e.g. same service nodes)
     if (service != current_service) {
-        std::unique_lock<std::shared_mutex> lock_parent_node(service_node->mutex);
+        std::unique_lock<utils::SharedMutex> lock_parent_node(parent_node->mutex);
+        size_t children_bytes = parent_node->children.heapBytes();
         parent_node->children.emplace_back(service_node);
+        children_bytes = parent_node->children.heapBytes() - children_bytes;
         lock_parent_node.unlock();
+        _service_nodes_bytes.fetch_add(children_bytes);
     }
 
-    std::unique_lock<std::shared_mutex> lock_service_node(service_node->mutex);
-    service_node->acsl_opened_branches[acsl_id] += 1;
+    // counters are read by status calls without locks
+    _beginStatusWrite(_service_status_version);
+    // entries added to the service node
+    size_t service_node_bytes = 0;
+    trackCounter(service_node->acsl_opened_branches, acsl_id, service_node_bytes).fetch_add(1);
 
     // validate tag
     if (branch->hasTag()) {
-        service_node->tagged_branches[branch->getTag()].push_back(branch);
+        const std::string& tag = branch->getTag();
+        trackCounter(service_node->tag_opened_branches, tag, service_node_bytes).fetch_add(1);
+        auto tag_regions_it = service_node->tag_opened_regions.find(tag);
+        if (tag_regions_it == service_node->tag_opened_regions.end()) {
+            tag_regions_it = service_node->tag_opened_regions.emplace(std::piecewise_construct,
+                std::forward_as_tuple(tag), std::forward_as_tuple()).first;
+            service_node_bytes += utils::entryBytes(tag, sizeof(Counters));
+        }
+        for (const auto& region: regions) {
+            trackCounter(tag_regions_it->second, region, service_node_bytes).fetch_add(1);
+        }
     }
 
-    service_node->opened_branches++;
+    service_node->opened_branches.fetch_add(1);
     for (const auto& region: regions) {
-        service_node->opened_regions[region]++;
+        trackCounter(service_node->opened_regions, region, service_node_bytes).fetch_add(1);
+    }
+    if (branch->isCompact()) {
+        service_node->opened_compact_branches.fetch_add(1);
     }
-    if (regions.empty()) {
-        service_node->opened_global_region++;
+    else if (regions.empty()) {
+        service_node->opened_global_region.fetch_add(1);
     }
+    _endStatusWrite(_service_status_version);
 
     // notify upon creation (due to async waits)
     _cond_new_service_nodes.notify_all();
-    lock_service_node.unlock();
     lock_services.unlock();
+    _service_nodes_bytes.fetch_add(service_node_bytes);
 
     // ----
     // ACSL
     // ----
-    std::shared_lock<std::shared_mutex> lock_acsls(_mutex_acsls);
+    std::shared_lock<utils::SharedMutex> lock_acsls(_mutex_acsls);
     ACSL * acsl = _validateACSL(acsl_id);
     if (acsl == nullptr) return false;
+    _beginStatusWrite(_status_version);
     acsl->opened_branches.fetch_add(1);
 
-    tbb::concurrent_hash_map<std::string, int>::accessor write_accessor;
+    size_t acsl_bytes = 0;
     for (const auto& region: regions) {
-        bool new_key = acsl->opened_regions.insert(write_accessor, region);
-        if (new_key) {
-            write_accessor->second = 1;
-        }
-        else {
-            write_accessor->second++;
-        }
+        trackCounter(acsl->opened_regions, region, acsl_bytes).fetch_add(1);
+    }
+    if (acsl_bytes != 0) {
+        _acsls_bytes.fetch_add(acsl_bytes);
     }
-    write_accessor.release();
     // if no regions are provided we also increment globally
-    if (regions.size() == 0) {
+    if (branch->isCompact()) {
+        acsl->opened_compact_branches.fetch_add(1);
+    }
+    else if (regions.size() == 0) {
         acsl->opened_global_region.fetch_add(1);
     }
 
@@ -521,21 +728,35 @@ bool Request::trackBranch(const std::string& acsl_id, const std::string& service
     // REMINDER: this MUST be placed after tracking of acsls
     // ------------
     // mantain order of these locks
-    std::unique_lock<std::mutex> lock(_mutex_branches);
-    std::unique_lock<std::mutex> lock_regions(_mutex_regions);
+    std::unique_lock<utils::Mutex> lock(_mutex_branches);
+    std::unique_lock<utils::Mutex> lock_regions(_mutex_regions);
     for (const auto& region: regions) {
         _opened_regions[region]++;
     }
-    if (regions.size() == 0) {
+    if (branch->isCompact()) {
+        _opened_compact_branches.fetch_add(1);
+    }
+    else if (regions.size() == 0) {
         _opened_global_region.fetch_add(1);
     }
     _num_opened_branches.fetch_add(1);
+    _endStatusWrite(_status_version);
     lock.unlock();
     lock_regions.unlock();
 
     return true;
 }
 
+void Request::_beginStatusWrite(StatusVersion& version) {
+    version.writes_started.fetch_add(1, std::memory_order_relaxed);
+    // counters changed afterwards are not visible before the start of the change
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void Request::_endStatusWrite(StatusVersion& version) {
+    version.writes_finished.fetch_add(1, std::memory_order_release);
+}
+
 std::chrono::seconds Request::_computeRemainingTime(int timeout, const std::chrono::steady_clock::time_point& start_time) {
     if (timeout != 0) {
         auto elapsed_time = std::chrono::steady_clock::now() - start_time;
@@ -546,17 +767,24 @@ std::chrono::seconds Request::_computeRemainingTime(int timeout, const std::chro
 }
 
 metadata::Request::ServiceNode * Request::validateServiceNode(const std::string& service) {
-    std::unique_lock<std::shared_mutex> lock(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_service_nodes);
     auto it = _service_nodes.find(service);
     if (it == _service_nodes.end()) return nullptr;
     return it->second;
 }
 
 void Request::_addToServiceWaitLogs(ServiceNode* curr_service_node, const std::string& target_service) {
-    std::unique_lock<std::shared_mutex> lock(_mutex_service_wait_logs);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_service_wait_logs);
 
     // try to insert if not yet done
-    _service_wait_logs[target_service].insert(curr_service_node);
+    auto logs_it = _service_wait_logs.try_emplace(target_service);
+    if (logs_it.second) {
+        _wait_logs_bytes.fetch_add(utils::flatEntryBytes(target_service, sizeof(std::unordered_set<ServiceNode*>)));
+    }
+    if (logs_it.first->second.insert(curr_service_node).second) {
+        _wait_logs_bytes.fetch_add(utils::CONTAINER_NODE_BYTES + sizeof(ServiceNode*));
+        _num_wait_logs.fetch_add(1);
+    }
     curr_service_node->num_current_waits++;
 
     // don't forget to notify for wait and waitRegion calls :)
@@ -564,22 +792,28 @@ void Request::_addToServiceWaitLogs(ServiceNode* curr_service_node, const std::s
 }
 
 void Request::_removeFromServiceWaitLogs(ServiceNode* curr_service_node, const std::string& target_service) {
-    std::unique_lock<std::shared_mutex> lock(_mutex_service_wait_logs);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_service_wait_logs);
 
     int n = --curr_service_node->num_current_waits;
-    if (n == 0) {
-        _service_wait_logs[target_service].erase(curr_service_node);
+    auto logs_it = _service_wait_logs.find(target_service);
+    if (n == 0 && logs_it != _service_wait_logs.end() && logs_it->second.erase(curr_service_node) == 1) {
+        _wait_logs_bytes.fetch_sub(utils::CONTAINER_NODE_BYTES + sizeof(ServiceNode*));
+        _num_wait_logs.fetch_sub(1);
     }
 }
 
 int Request::_numOpenedBranchesServiceLogs(const std::string& current_service) {
     int num = 0;
 
-    std::shared_lock<std::shared_mutex> lock_logs(_mutex_service_wait_logs);
-    std::unordered_set<ServiceNode*> service_logs = _service_wait_logs[current_service];
+    std::shared_lock<utils::SharedMutex> lock_logs(_mutex_service_wait_logs);
+    auto logs_it = _service_wait_logs.find(current_service);
+    if (logs_it == _service_wait_logs.end()) {
+        return num;
+    }
+    std::unordered_set<ServiceNode*> service_logs = logs_it->second;
     lock_logs.unlock();
 
-    std::unique_lock<std::shared_mutex> lock_services(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock_services(_mutex_service_nodes);
     for (const auto& entry: service_logs) {
         num += entry->opened_branches;
     }
@@ -592,17 +826,21 @@ std::pair<int, int> Request::_numOpenedRegionsServiceLogs(const std::string& cur
     // <global region counter, current region counter>
     std::pair<int, int> num = {0, 0};
 
-    std::unique_lock<std::shared_mutex> lock_logs(_mutex_service_wait_logs);
-    std::unordered_set<ServiceNode*> service_logs = _service_wait_logs[current_service];
+    std::unique_lock<utils::SharedMutex> lock_logs(_mutex_service_wait_logs);
+    auto logs_it = _service_wait_logs.find(current_service);
+    if (logs_it == _service_wait_logs.end()) {
+        return num;
+    }
+    std::unordered_set<ServiceNode*> service_logs = logs_it->second;
     lock_logs.unlock();
 
-    std::unique_lock<std::shared_mutex> lock_services(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock_services(_mutex_service_nodes);
     for (const auto& entry: service_logs) {
         auto it_region = entry->opened_regions.find(region);
         if (it_region != entry->opened_regions.end()) {
             num.second += it_region->second;
         }
-        num.first += entry->opened_global_region;
+        num.first += entry->opened_global_region + entry->opened_compact_branches;
     }
     lock_services.unlock();
     
@@ -613,7 +851,10 @@ void Request::_addToWaitLogs(ACSL* acsl) {
     // FRIENDLY REMINDER: caller of this function already acquires a lock on acsls mutex
 
     // try to insert if not yet done
-    _wait_logs.insert(acsl->acsl_id);
+    if (_wait_logs.insert(acsl).second) {
+        _wait_logs_bytes.fetch_add(utils::CONTAINER_NODE_BYTES + sizeof(ACSL*));
+        _num_wait_logs.fetch_add(1);
+    }
     acsl->num_current_waits++;
 
     // notify regarding new wait logs to cover an >>> EDGE CASE <<<:
@@ -626,18 +867,19 @@ void Request::_removeFromWaitLogs(ACSL* acsl) {
     // FRIENDLY REMINDER: caller of this function already acquires a lock on acsls mutex
     
     int n = --acsl->num_current_waits;
-    if (n == 0) {
-        _wait_logs.erase(acsl->acsl_id);
+    if (n == 0 && _wait_logs.erase(acsl) == 1) {
+        _wait_logs_bytes.fetch_sub(utils::CONTAINER_NODE_BYTES + sizeof(ACSL*));
+        _num_wait_logs.fetch_sub(1);
     }
 }
 
-std::vector<std::string> Request::_getGreaterACSLs(ACSL* acsl) {
-    std::shared_lock<std::shared_mutex> lock(_mutex_service_wait_logs);
-    std::vector<std::string> entries;
+std::vector<metadata::Request::ACSL*> Request::_getGreaterACSLs(ACSL* acsl) {
+    std::shared_lock<utils::SharedMutex> lock(_mutex_service_wait_logs);
+    std::vector<ACSL*> entries;
 
     // iterate in reverse order
     for (auto it = _wait_logs.rbegin(); it != _wait_logs.rend(); it++) {
-        if ((*it) > acsl->acsl_id) {
+        if ((*it)->key > acsl->key) {
             entries.emplace_back((*it));
         }
         else { 
@@ -647,51 +889,34 @@ std::vector<std::string> Request::_getGreaterACSLs(ACSL* acsl) {
     return entries;
 }
 
-int Request::_numOpenedBranchesACSLs(const std::vector<std::string>& sub_rids) {
+int Request::_numOpenedBranchesACSLs(const std::vector<ACSL*>& acsls) {
     // REMINDER: the function that calls this method already acquires lock on _mutex_acsls
 
     int num = 0;
-    tbb::concurrent_hash_map<std::string, ACSL*>::const_accessor read_accessor;
-    for (const auto& acsl_id: sub_rids) {
-        bool found = _acsls.find(read_accessor, acsl_id);
-        // sanity check
-        if (!found) continue;
-        ACSL * acsl = read_accessor->second;
+    for (ACSL * acsl : acsls) {
         num += acsl->opened_branches.load();
-
     }
-    read_accessor.release();
     return num;
 }
 
 std::pair<int, int> Request::_numOpenedRegionsACSLs(
-    const std::vector<std::string>& sub_rids, const std::string& region) {
+    const std::vector<ACSL*>& acsls, const std::string& region) {
     // REMINDER: the function that calls this method already acquires lock!
 
     // <global region counter, current region counter>
     std::pair<int, int> num = {0, 0};
-    tbb::concurrent_hash_map<std::string, ACSL*>::const_accessor read_accessor_acsl;
-    tbb::concurrent_hash_map<std::string, int>::const_accessor read_accessor_num;
-    for (const auto& acsl_id: sub_rids) {
-        bool found = _acsls.find(read_accessor_acsl, acsl_id);
-
-        // sanity check
-        if (!found) continue;
-        ACSL * acsl = read_accessor_acsl->second;
-
-        // get number of opened branches globally, in terms of regions
-        num.second += acsl->opened_global_region.load();
+    for (ACSL * acsl : acsls) {
+        // get number of opened branches globally, in terms of regions (compact branches may be in any region)
+        num.first += acsl->opened_global_region.load() + acsl->opened_compact_branches.load();
 
         // get number of opened branches for this region
-        found = acsl->opened_regions.find(read_accessor_num, region);
-        if (!found) continue;
-        num.second += read_accessor_num->second;
+        num.second += getCounter(acsl->opened_regions, region);
     }
     return num;
 }
 
 bool Request::_waitFirstBranch(const std::chrono::steady_clock::time_point& start_time, int timeout) {
-    std::unique_lock<std::mutex> lock(_mutex_branches);
+    std::unique_lock<utils::Mutex> lock(_mutex_branches);
     auto remaining_time = _computeRemainingTime(timeout, start_time);
     while (_branches.size() == 0) {
         _cond_new_branch.wait_for(lock, std::chrono::seconds(remaining_time));
@@ -702,7 +927,8 @@ bool Request::_waitFirstBranch(const std::chrono::steady_clock::time_point& star
     return true;
 }
 
-int Request::wait(const std::string& acsl_id, bool async, int timeout, const std::string& current_service) {
+int Request::wait(const std::string& acsl_id, bool async, int timeout, const std::string& current_service,
+    WaitTrace * trace) {
     int inconsistency = 0;
     auto start_time = std::chrono::steady_clock::now();
 
@@ -725,8 +951,9 @@ int Request::wait(const std::string& acsl_id, bool async, int timeout, const std
     // -----------------------------------
     //           CORE WAIT LOGIC
     // -----------------------------------
-    std::unique_lock<std::shared_mutex> lock(_mutex_acsls);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_acsls);
     _addToWaitLogs(acsl);
+    bool traced = false;
     while (true) {
         // get number of branches to ignore from highest acsls in the wait logs
         const auto& greatest_acsls = _getGreaterACSLs(acsl);
@@ -735,6 +962,15 @@ int Request::wait(const std::string& acsl_id, bool async, int timeout, const std
         int offset_services = _numOpenedBranchesServiceLogs(current_service);
         int offset = acsl->opened_branches.load() + offset_greatest_acsls + offset_services;
         if (_num_opened_branches.load() - offset != 0) {
+            // record blocking branches once per wakeup and evaluate again since the lock was released
+            if (trace != nullptr && !traced) {
+                lock.unlock();
+                _traceBlockingBranches(trace, "", "", "", acsl_id, true);
+                lock.lock();
+                traced = true;
+                continue;
+            }
+            traced = false;
             _cond_acsls.wait_for(lock, std::chrono::seconds(remaining_time));
             inconsistency = 1;
             remaining_time = _computeRemainingTime(timeout, start_time);
@@ -752,7 +988,8 @@ int Request::wait(const std::string& acsl_id, bool async, int timeout, const std
     return inconsistency;
 }
 
-int Request::waitRegion(const std::string& acsl_id, const std::string& region, bool async, int timeout, const std::string& current_service) {
+int Request::waitRegion(const std::string& acsl_id, const std::string& region, bool async, int timeout, const std::string& current_service,
+    WaitTrace * trace) {
         
     int inconsistency = 0;
     auto start_time = std::chrono::steady_clock::now();
@@ -774,8 +1011,8 @@ int Request::waitRegion(const std::string& acsl_id, const std::string& region, b
         _waitFirstBranch(start_time, timeout);
         remaining_time = _computeRemainingTime(timeout, start_time);
 
-        std::unique_lock<std::shared_mutex> lock(_mutex_acsls);
-        while (_opened_regions.count(region) == 0) {
+        std::unique_lock<utils::SharedMutex> lock(_mutex_acsls);
+        while (_opened_regions.count(region) == 0 && _opened_compact_branches.load() == 0) {
             _cond_acsls.wait_for(lock, std::chrono::seconds(remaining_time));
             inconsistency = 1;
             remaining_time = _computeRemainingTime(timeout, start_time);
@@ -785,26 +1022,27 @@ int Request::waitRegion(const std::string& acsl_id, const std::string& region, b
         }
     }
     else {
-        std::unique_lock<std::shared_mutex> lock(_mutex_acsls);
-        if (_opened_regions.count(region) == 0) {
+        std::unique_lock<utils::SharedMutex> lock(_mutex_acsls);
+        // regions of compact branches are not known so they may be in this region
+        if (_opened_regions.count(region) == 0 && _opened_compact_branches.load() == 0) {
             return 0;
         }
     }
 
-    std::unique_lock<std::shared_mutex> lock(_mutex_acsls);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_acsls);
 
     remaining_time = _computeRemainingTime(timeout, start_time);
 
     // -----------------------------------
     //           CORE WAIT LOGIC
     // -----------------------------------
-    tbb::concurrent_hash_map<std::string, int>::const_accessor read_accessor_num;
     _addToWaitLogs(acsl);
+    bool traced = false;
     while(true) {
         // get counters (region and globally, in terms of region) for current sub request
-        int num_branches_acsl_global_region = acsl->opened_global_region.load();
-        bool found = acsl->opened_regions.find(read_accessor_num, region);
-        int num_branches_acsl_region = found ? read_accessor_num->second : 0;
+        // (compact branches are waited as if they were in the global region)
+        int num_branches_acsl_global_region = acsl->opened_global_region.load() + acsl->opened_compact_branches.load();
+        int num_branches_acsl_region = getCounter(acsl->opened_regions, region);
 
         // get number of branches to ignore from preceding subrids in the wait logs
         const auto& greatest_acsls = _getGreaterACSLs(acsl);
@@ -814,9 +1052,20 @@ int Request::waitRegion(const std::string& acsl_id, const std::string& region, b
         int offset_global_region = num_branches_acsl_global_region + offset_greatest_acsls.first + offset_services.first;
         int offset_region = num_branches_acsl_region + offset_greatest_acsls.second + offset_services.second;
 
-        if (_opened_global_region.load() - offset_global_region != 0 || _opened_regions[region] - offset_region != 0) {
-
-            read_accessor_num.release();
+        int num_global_region = _opened_global_region.load() + _opened_compact_branches.load();
+        // region may not be tracked yet when only compact branches are opened
+        auto region_it = _opened_regions.find(region);
+        int num_region = region_it != _opened_regions.end() ? region_it->second.load() : 0;
+        if (num_global_region - offset_global_region != 0 || num_region - offset_region != 0) {
+
+            if (trace != nullptr && !traced) {
+                lock.unlock();
+                _traceBlockingBranches(trace, "", region, "", acsl_id, true);
+                lock.lock();
+                traced = true;
+                continue;
+            }
+            traced = false;
             _cond_acsls.wait_for(lock, std::chrono::seconds(remaining_time));
             inconsistency = 1;
             remaining_time = _computeRemainingTime(timeout, start_time);
@@ -837,7 +1086,7 @@ int Request::waitRegion(const std::string& acsl_id, const std::string& region, b
 bool Request::_doWaitAsyncServiceNodeRegistration(const std::string& service, const std::string& tag, const std::string& region,
     int timeout, const std::chrono::steady_clock::time_point& start_time, std::chrono::seconds remaining_time) {
         
-    std::unique_lock<std::shared_mutex> lock(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_service_nodes);
     while (_service_nodes.count(service) == 0) {
         _cond_new_service_nodes.wait_for(lock, remaining_time);
         remaining_time = _computeRemainingTime(timeout, start_time);
@@ -846,7 +1095,7 @@ bool Request::_doWaitAsyncServiceNodeRegistration(const std::string& service, co
         }
     }
     if (!tag.empty()) {
-        while (_service_nodes[service]->tagged_branches.count(tag) == 0) {
+        while (_service_nodes[service]->tag_opened_branches.count(tag) == 0) {
             _cond_new_service_nodes.wait_for(lock, remaining_time);
             remaining_time = _computeRemainingTime(timeout, start_time);
             if (remaining_time <= std::chrono::seconds(0)) {
@@ -855,14 +1104,12 @@ bool Request::_doWaitAsyncServiceNodeRegistration(const std::string& service, co
         }
     }
     if (!region.empty()) {
-        auto opened_regions_it = _service_nodes[service]->opened_regions;
-        auto region_it = opened_regions_it.find(region);
-        while (region_it == opened_regions_it.end()) {
+        // compact branches of the service may be in the region
+        ServiceNode * service_node = _service_nodes[service];
+        while (service_node->opened_regions.count(region) == 0 && service_node->opened_compact_branches == 0) {
             _cond_new_service_nodes.wait_for(lock, remaining_time);
             remaining_time = _computeRemainingTime(timeout, start_time);
             if (remaining_time <= std::chrono::seconds(0)) return false;
-
-            region_it = opened_regions_it.find(region);
         }
     }
     return true;
@@ -870,7 +1117,7 @@ bool Request::_doWaitAsyncServiceNodeRegistration(const std::string& service, co
 
 int Request::waitService(const std::string& acsl_id, 
     const std::string& service, const std::string& tag, bool async, int timeout, 
-    const std::string& current_service, bool wait_deps) {
+    const std::string& current_service, bool wait_deps, WaitTrace * trace) {
 
     int inconsistency = 0;
     auto start_time = std::chrono::steady_clock::now();
@@ -890,18 +1137,18 @@ int Request::waitService(const std::string& acsl_id,
     }
     // context error checking
     else {
-        std::unique_lock<std::shared_mutex> lock(_mutex_service_nodes);
+        std::unique_lock<utils::SharedMutex> lock(_mutex_service_nodes);
         // no current branch for this service
         if (_service_nodes.count(service) == 0) return -2;
         // no current branch for this service (non async) tag
-        if (!tag.empty() && _service_nodes[service]->tagged_branches.count(tag) == 0) return -2;
+        if (!tag.empty() && _service_nodes[service]->tag_opened_branches.count(tag) == 0) return -2;
     }
 
     // -----------
     // VALIDATIONS
     //------------
 
-    std::unique_lock<std::shared_mutex> lock(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_service_nodes);
     auto it = _service_nodes.find(current_service);
     if (it == _service_nodes.end()) return -3;
 
@@ -915,11 +1162,11 @@ int Request::waitService(const std::string& acsl_id,
     _addToServiceWaitLogs(current_service_node, service);
     // tag-specific
     if (!tag.empty()) {
-        inconsistency = _doWaitTag(service_node, tag, "", timeout, start_time, remaining_time);
+        inconsistency = _doWaitTag(service_node, tag, "", timeout, start_time, remaining_time, trace);
     }
     // overall service
     else {
-        inconsistency = _doWaitService(service_node, acsl_id, timeout, start_time, remaining_time);
+        inconsistency = _doWaitService(service_node, acsl_id, timeout, start_time, remaining_time, trace);
         // wait for all dependencies
         if (inconsistency != -1 && wait_deps) {
             const auto& deps = _getAllFollowingDependencies(service_node, acsl_id);
@@ -929,7 +1176,7 @@ int Request::waitService(const std::string& acsl_id,
             // iterate and wait all on all dependencies
             while (i < deps_size) {
                 auto dep = deps.at(i++);
-                inconsistency = _doWaitService(dep, acsl_id, timeout, start_time, remaining_time);
+                inconsistency = _doWaitService(dep, acsl_id, timeout, start_time, remaining_time, trace);
                 if (inconsistency == -1) {
                     break;
                 }
@@ -944,7 +1191,7 @@ int Request::waitService(const std::string& acsl_id,
 int Request::waitServiceRegion(const std::string& acsl_id, const std::string& service, 
     const std::string& region, 
     const::std::string& tag, bool async, int timeout, 
-    const std::string& current_service, bool wait_deps) {
+    const std::string& current_service, bool wait_deps, WaitTrace * trace) {
 
     int inconsistency = 0;
     auto start_time = std::chrono::steady_clock::now();
@@ -960,13 +1207,15 @@ int Request::waitServiceRegion(const std::string& acsl_id, const std::string& se
         if (!found) return -1;
     }
     else {
-        std::unique_lock<std::shared_mutex> lock(_mutex_service_nodes);
-        // context not found
-        if (_service_nodes.count(service) == 0 || _service_nodes[service]->opened_regions.count(region) == 0) {
+        std::unique_lock<utils::SharedMutex> lock(_mutex_service_nodes);
+        // context not found (unless compact branches of the service, with untracked regions, are opened)
+        auto service_it = _service_nodes.find(service);
+        if (service_it == _service_nodes.end() || (service_it->second->opened_regions.count(region) == 0
+            && service_it->second->opened_compact_branches == 0)) {
             return -2;
         }
         // tag not found
-        else if (!tag.empty() && _service_nodes[service]->tagged_branches.count(tag) == 0) {
+        else if (!tag.empty() && _service_nodes[service]->tag_opened_branches.count(tag) == 0) {
             return -4;
         }
     }
@@ -978,7 +1227,7 @@ int Request::waitServiceRegion(const std::string& acsl_id, const std::string& se
     ACSL * acsl = _validateACSL(acsl_id);
     if (acsl == nullptr) return -4;
     
-    std::unique_lock<std::shared_mutex> lock(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_service_nodes);
     auto it = _service_nodes.find(current_service);
     if (it == _service_nodes.end()) return -3;
 
@@ -994,11 +1243,11 @@ int Request::waitServiceRegion(const std::string& acsl_id, const std::string& se
 
     // tag-specific
     if (!tag.empty()) {
-        inconsistency = _doWaitTag(service_node, tag, region, timeout, start_time, remaining_time);
+        inconsistency = _doWaitTag(service_node, tag, region, timeout, start_time, remaining_time, trace);
     }
     // overall service
     else {
-        inconsistency = _doWaitServiceRegion(service_node, region, acsl_id, timeout, start_time, remaining_time);
+        inconsistency = _doWaitServiceRegion(service_node, region, acsl_id, timeout, start_time, remaining_time, trace);
         // wait for all dependencies
         if (inconsistency != -1 && wait_deps) {
             const auto& deps = _getAllFollowingDependencies(service_node, acsl_id);
@@ -1008,7 +1257,7 @@ int Request::waitServiceRegion(const std::string& acsl_id, const std::string& se
             // iterate and wait all on all dependencies
             while (i < deps_size) {
                 auto dep = deps.at(i++);
-                inconsistency = _doWaitServiceRegion(dep, region, acsl_id, timeout, start_time, remaining_time);
+                inconsistency = _doWaitServiceRegion(dep, region, acsl_id, timeout, start_time, remaining_time, trace);
                 if (inconsistency == -1) {
                     break;
                 }
@@ -1020,45 +1269,61 @@ int Request::waitServiceRegion(const std::string& acsl_id, const std::string& se
 }
 
 int Request::_doWaitTag(ServiceNode * service_node, const std::string& tag, const std::string& region, 
-    int timeout, const std::chrono::steady_clock::time_point& start_time, std::chrono::seconds remaining_time) {
+    int timeout, const std::chrono::steady_clock::time_point& start_time, std::chrono::seconds remaining_time,
+    WaitTrace * trace) {
     
-    std::unique_lock<std::shared_mutex> lock(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_service_nodes);
     int inconsistency = 0;
-
-    for (int i = 0; i < service_node->tagged_branches[tag].size(); i++) {
-        metadata::Branch * branch = service_node->tagged_branches[tag].at(i);
-
-        // this is an helper function for both wait on service and wait on service and region
-        // so the region can be empty
-        while (!branch->isGloballyClosed(region)) {
-            inconsistency = 1;
-            _cond_service_nodes.wait_for(lock, remaining_time);
-            remaining_time = _computeRemainingTime(timeout, start_time);
-            if (remaining_time <= std::chrono::seconds(0)) {
-                return -1;
-            }
+    bool traced = false;
+
+    // this is an helper function for both wait on service and wait on service and region
+    // so the region can be empty (counters are looked up again after each wait since registrations may rehash them)
+    while (getTagCounter(service_node, tag, region) > 0) {
+        if (trace != nullptr && !traced) {
+            lock.unlock();
+            _traceBlockingBranches(trace, service_node->name, region, tag, "", false);
+            lock.lock();
+            traced = true;
+            continue;
+        }
+        traced = false;
+        inconsistency = 1;
+        _cond_service_nodes.wait_for(lock, remaining_time);
+        remaining_time = _computeRemainingTime(timeout, start_time);
+        if (remaining_time <= std::chrono::seconds(0)) {
+            return -1;
         }
     }
     return inconsistency;
 }
 
 int Request::_doWaitService(ServiceNode * service_node, const std::string& acsl_id,
-    int timeout, const std::chrono::steady_clock::time_point& start_time, std::chrono::seconds remaining_time) {
+    int timeout, const std::chrono::steady_clock::time_point& start_time, std::chrono::seconds remaining_time,
+    WaitTrace * trace) {
 
-    std::unique_lock<std::shared_mutex> lock(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_service_nodes);
     int inconsistency = 0;
+    bool traced = false;
 
-    int * num_branches_ptr = &(service_node->opened_branches);
-    int * acsl_id_num_branches_ptr = &(service_node->acsl_opened_branches[acsl_id]);
+    std::atomic<int> * num_branches_ptr = &(service_node->opened_branches);
     
     // wait until branches are closed and only if there are more 
     // branches opened besides the one in the current acsl
-    while (*num_branches_ptr > 0 && *num_branches_ptr > *acsl_id_num_branches_ptr) {
+    // (counters of the maps are looked up again after each wait since registrations may create them)
+    while (*num_branches_ptr > 0 && *num_branches_ptr > getCounter(service_node->acsl_opened_branches, acsl_id)) {
+        if (trace != nullptr && !traced) {
+            lock.unlock();
+            _traceBlockingBranches(trace, service_node->name, "", "", acsl_id, true);
+            lock.lock();
+            traced = true;
+            continue;
+        }
+        traced = false;
         _cond_service_nodes.wait_for(lock, remaining_time);
         inconsistency = 1;
         remaining_time = _computeRemainingTime(timeout, start_time);
         if (remaining_time <= std::chrono::seconds(0)) {
-            spdlog::error("[{}] service node {} not found and timed out", _rid, service_node->name);
+            LOG_ERROR_RATE_LIMITED("[{}] service node {} not found and timed out", _rid, service_node->name);
             return -1;
         }
     }
@@ -1066,23 +1331,34 @@ int Request::_doWaitService(ServiceNode * service_node, const std::string& acsl_
 }
 
 int Request::_doWaitServiceRegion(ServiceNode * service_node, const std::string& region, const std::string& acsl_id,
-    int timeout, const std::chrono::steady_clock::time_point& start_time, std::chrono::seconds remaining_time) {
+    int timeout, const std::chrono::steady_clock::time_point& start_time, std::chrono::seconds remaining_time,
+    WaitTrace * trace) {
 
-    std::unique_lock<std::shared_mutex> lock(_mutex_service_nodes);
+    std::unique_lock<utils::SharedMutex> lock(_mutex_service_nodes);
 
     int inconsistency = 0;
+    bool traced = false;
 
-    int * num_branches_region_ptr = &service_node->opened_regions[region];
-    int * num_global_region_ptr = &service_node->opened_global_region;
-    int * num_branches_ptr = &service_node->opened_branches;
-    int * acsl_id_num_branches_ptr = &service_node->acsl_opened_branches[acsl_id];
+    std::atomic<int> * num_global_region_ptr = &service_node->opened_global_region;
+    std::atomic<int> * num_compact_branches_ptr = &service_node->opened_compact_branches;
+    std::atomic<int> * num_branches_ptr = &service_node->opened_branches;
 
     // WAIT FOR:
     // - current region
     // - global region that encompasses all regions
+    // - compact branches (their regions are not known here)
     // - BUT only if there are more opened branches besides the ones in the current acsl (that we must ignore!)
-    while ((*num_branches_region_ptr != 0 || *num_global_region_ptr != 0) && *num_branches_ptr > *acsl_id_num_branches_ptr) {
-
+    // (counters of the maps are looked up again after each wait since registrations may create them)
+    while ((getCounter(service_node->opened_regions, region) != 0 || *num_global_region_ptr != 0 || *num_compact_branches_ptr != 0)
+        && *num_branches_ptr > getCounter(service_node->acsl_opened_branches, acsl_id)) {
+        if (trace != nullptr && !traced) {
+            lock.unlock();
+            _traceBlockingBranches(trace, service_node->name, region, "", acsl_id, true);
+            lock.lock();
+            traced = true;
+            continue;
+        }
+        traced = false;
         _cond_service_nodes.wait_for(lock, remaining_time);
         inconsistency = 1;
         remaining_time = _computeRemainingTime(timeout, start_time);
@@ -1093,6 +1369,28 @@ int Request::_doWaitServiceRegion(ServiceNode * service_node, const std::string&
     return inconsistency;
 }
 
+void Request::_traceBlockingBranches(WaitTrace * trace, const std::string& service, const std::string& region,
+    const std::string& tag, const std::string& acsl_id, bool ignore_acsl) {
+
+    std::vector<std::pair<std::string, metadata::Branch*>> blocking;
+    std::unique_lock<utils::Mutex> lock(_mutex_branches);
+    for (const auto& [bid, branch] : _branches) {
+        if (ignore_acsl && branch->getACSLID() == acsl_id) continue;
+        if (!service.empty() && branch->getService() != service) continue;
+        if (!tag.empty() && branch->getTag() != tag) continue;
+        if (branch->isGloballyClosed()) continue;
+
+        // branches in the global region (and compact branches) also block waits on a specific region
+        if (!region.empty() && !branch->isCompact() && branch->getStatus(region) != OPENED
+            && !branch->getRegions().empty()) continue;
+
+        blocking.emplace_back(bid, branch);
+    }
+    lock.unlock();
+    std::sort(blocking.begin(), blocking.end());
+    trace->addWakeup(blocking);
+}
+
 std::vector<metadata::Request::ServiceNode*> Request::_getAllFollowingDependencies(ServiceNode * service_node, 
     const std::string& acsl_id) {
 
@@ -1101,7 +1399,7 @@ std::vector<metadata::Request::ServiceNode*> Request::_getAllFollowingDependenci
     std::unordered_set<ServiceNode*> visited {service_node};
     visited.insert(service_node);
 
-    std::shared_lock<std::shared_mutex> lock_service_node(service_node->mutex);
+    std::shared_lock<utils::SharedMutex> lock_service_node(service_node->mutex);
     // get all depends for current service
     for (const auto& child: service_node->children) {
         deps.emplace_back(child);
@@ -1111,13 +1409,13 @@ std::vector<metadata::Request::ServiceNode*> Request::_getAllFollowingDependenci
     while (i < deps.size()) {
         auto dep = deps.at(i++);
         visited.insert(dep);
-        std::shared_lock<std::shared_mutex> lock_service_node_dep(dep->mutex);
+        std::shared_lock<utils::SharedMutex> lock_service_node_dep(dep->mutex);
         // get all following dependencies for fetched service
         // - cannot be already visited
         // - cannot be in the same acsl
         for (const auto& child: dep->children) {
             if (visited.count(child) == 0) {
-                auto acsl_ids_map = child->acsl_opened_branches;
+                const auto& acsl_ids_map = child->acsl_opened_branches;
 
                 // if the service has only one acsl which is the current one we just ignore it
                 if(acsl_ids_map.size() == 1 && acsl_ids_map.count(acsl_id) == 1) {
@@ -1134,146 +1432,151 @@ utils::Status Request::checkStatus(const std::string& acsl_id) {
     ACSL * acsl = _validateACSL(acsl_id);
     if (acsl == nullptr) return utils::Status {INVALID_CONTEXT};
 
-    std::unique_lock<std::mutex> lock(_mutex_branches);
     // get number of all opened branches and ignore ones in the current acsl
-    if (_num_opened_branches.load() - acsl->opened_branches.load() != 0) {
-        //spdlog::debug("check status @ acsl {}: (OPENED <= {}-{})", acsl_id, _num_opened_branches.load(), acsl->opened_branches.load());
+    int num_opened_branches = _readStatus(_status_version, _mutex_acsls, [this, acsl]() {
+        return _num_opened_branches.load() - acsl->opened_branches.load();
+    });
+    if (num_opened_branches != 0) {
+        SPDLOG_DEBUG("check status @ acsl {}: (OPENED <= {})", acsl_id, num_opened_branches);
         return utils::Status {OPENED};
     }
-    //spdlog::debug("check status @ acsl {}: CLOSED", acsl_id);
+    SPDLOG_DEBUG("check status @ acsl {}: CLOSED", acsl_id);
     return utils::Status {CLOSED};
 }
 
 utils::Status Request::checkStatusRegion(const std::string& acsl_id, const std::string& region) {
     utils::Status res {UNKNOWN};
 
-    if (_opened_regions.count(region) == 0) return utils::Status {UNKNOWN};
+    auto region_it = _opened_regions.find(region);
+    if (region_it == _opened_regions.end()) return utils::Status {UNKNOWN};
 
     ACSL * acsl = _validateACSL(acsl_id);
     if (acsl == nullptr) return utils::Status {INVALID_CONTEXT};
 
-    tbb::concurrent_hash_map<std::string, int>::const_accessor read_accessor_num;
-    std::unique_lock<std::mutex> lock(_mutex_regions);
-
-    // get counters (region and globally) for current sub request
-    int acsl_global_region = acsl->opened_global_region.load();
-    bool found = acsl->opened_regions.find(read_accessor_num, region);
-    int acsl_region = found ? read_accessor_num->second : 0;
+    // counters are never erased so they are looked up once
+    const std::atomic<int> * acsl_region_ptr = findCounter(acsl->opened_regions, region);
+    int status = _readStatus(_status_version, _mutex_acsls, [this, acsl, &region, &region_it, &acsl_region_ptr]() {
+        // get counters (region and globally) for current sub request
+        // (the counter of the acsl may be created meanwhile by a registration)
+        if (acsl_region_ptr == nullptr) {
+            acsl_region_ptr = findCounter(acsl->opened_regions, region);
+        }
+        int acsl_region = acsl_region_ptr != nullptr ? acsl_region_ptr->load() : 0;
 
-    // by default, we are targeting a specific region
-    // but if a global region is opened then all regions are opened aswell
-    if (_opened_regions[region] - acsl_region != 0 || _opened_global_region.load() - acsl_global_region != 0) {
-        res.status = OPENED;
-    }
-    else {
-        res.status = CLOSED;
-    }
+        // by default, we are targeting a specific region
+        // but if a global region is opened then all regions are opened aswell
+        if (region_it->second.load() - acsl_region != 0
+            || _opened_global_region.load() - acsl->opened_global_region.load() != 0) {
+            return OPENED;
+        }
+        // compact branches may still be opened in this region
+        if (_opened_compact_branches.load() - acsl->opened_compact_branches.load() != 0) {
+            return UNKNOWN;
+        }
+        return CLOSED;
+    });
+    res.status = status;
 
     return res;
 }
 
 utils::Status Request::checkStatusService(const std::string& acsl_id, const std::string& service, bool detailed) {
-    utils::Status res;
-    std::shared_lock<std::shared_mutex>lock(_mutex_service_nodes);
-
-    auto it = _service_nodes.find(service);
-
     // find out if service context exists
+    // (service nodes and their counters are never erased so they are looked up once)
+    auto it = _service_nodes.find(service);
     if (it == _service_nodes.end()) {
-        res.status = UNKNOWN;
-        return res;
+        return utils::Status {UNKNOWN};
     }
-
     ServiceNode * service_node = it->second;
-    lock.unlock();
+    const std::atomic<int> * acsl_branches_ptr = findCounter(service_node->acsl_opened_branches, acsl_id);
 
-    std::shared_lock<std::shared_mutex> lock_service_node(service_node->mutex);
-    
-    // get overall status of request
-    // BUT if there are more than 0 opened branches we ignore if they belong to the same region
-    if (service_node->opened_branches == 0 
-        || service_node->opened_branches == service_node->acsl_opened_branches[acsl_id]) {
-        res.status = CLOSED;
-    } else {
-        res.status = OPENED;
-    }
-
-    // return detailed info if enabled by client
-    if (detailed) {
-        // get tagged branches within the same service
-        for (const auto& tag_it: service_node->tagged_branches) {
-            res.tagged[tag_it.first] = CLOSED;
-            // set status to OPENED if AT LEAST one branch is opened for this tag
-            for (const auto& branch_it: tag_it.second) {
-                if (branch_it->getStatus() == OPENED) {
-                    res.tagged[tag_it.first] = OPENED;
-                    break;
-                }
-            }
+    return _readStatus(_service_status_version, _mutex_service_nodes, [service_node, &acsl_id, &acsl_branches_ptr, detailed]() {
+        utils::Status res;
+        // the counter of the acsl may be created meanwhile by a registration
+        if (acsl_branches_ptr == nullptr) {
+            acsl_branches_ptr = findCounter(service_node->acsl_opened_branches, acsl_id);
         }
-        // get all regions status
-        for (const auto& region_it: service_node->opened_regions) {
-            res.regions[region_it.first] = region_it.second == 0 ? CLOSED : OPENED;
+        int acsl_branches = acsl_branches_ptr != nullptr ? acsl_branches_ptr->load() : 0;
+
+        // get overall status of request
+        // BUT if there are more than 0 opened branches we ignore if they belong to the same region
+        int opened_branches = service_node->opened_branches.load();
+        if (opened_branches == 0 || opened_branches == acsl_branches) {
+            res.status = CLOSED;
+        } else {
+            res.status = OPENED;
         }
 
-    }
-    return res;
+        // return detailed info if enabled by client
+        if (detailed) {
+            // get tagged branches within the same service
+            // (status is OPENED if AT LEAST one branch is opened for this tag)
+            for (const auto& tag_it: service_node->tag_opened_branches) {
+                res.tagged[tag_it.first] = tag_it.second.load() == 0 ? CLOSED : OPENED;
+            }
+            // get all regions status (compact branches of the service may still be opened in any of them)
+            int closed_region = service_node->opened_compact_branches.load() != 0 ? UNKNOWN : CLOSED;
+            for (const auto& region_it: service_node->opened_regions) {
+                res.regions[region_it.first] = region_it.second.load() == 0 ? closed_region : OPENED;
+            }
+        }
+        return res;
+    });
 }
 
 utils::Status Request::checkStatusServiceRegion(const std::string& acsl_id, 
     const std::string& service, const std::string& region, bool detailed) {
 
-    std::shared_lock<std::shared_mutex> lock(_mutex_service_nodes);
-    utils::Status res;
-
     // find out if service context exists
+    // (service nodes and their counters are never erased so they are looked up once)
     auto service_it = _service_nodes.find(service);
     if (service_it == _service_nodes.end()) {
-        res.status = UNKNOWN;
-        return res;
+        return utils::Status {UNKNOWN};
     }
-    lock.unlock();
-    
     ServiceNode * service_node = service_it->second;
-    std::shared_lock<std::shared_mutex> lock_service_node(service_node->mutex);
-    auto region_it = service_node->opened_regions.find(region);
-    if (region_it == service_node->opened_regions.end()) {
-        res.status = UNKNOWN;
-        return res;
-    }
-    
-    // get overall status of request
-    // get tagged branches within the same service
-    if (service_node->opened_regions[region] == 0
-        || service_node->opened_branches == service_node->acsl_opened_branches[acsl_id]) {
-            
-        res.status = CLOSED;
-    } else {
-        res.status = OPENED;
-    }
-
-    // return if client only wants basic information (status)
-    if (!detailed) {
-        return res;
-    }
+    const std::atomic<int> * region_branches_ptr = findCounter(service_node->opened_regions, region);
+    if (region_branches_ptr == nullptr) {
+        return utils::Status {UNKNOWN};
+    }
+    const std::atomic<int> * acsl_branches_ptr = findCounter(service_node->acsl_opened_branches, acsl_id);
+
+    return _readStatus(_service_status_version, _mutex_service_nodes,
+        [service_node, &region, &acsl_id, region_branches_ptr, &acsl_branches_ptr, detailed]() {
+        utils::Status res;
+        // the counter of the acsl may be created meanwhile by a registration
+        if (acsl_branches_ptr == nullptr) {
+            acsl_branches_ptr = findCounter(service_node->acsl_opened_branches, acsl_id);
+        }
+        int acsl_branches = acsl_branches_ptr != nullptr ? acsl_branches_ptr->load() : 0;
 
-    // otherwise, return detailed information
-    for (const auto& tag_it: service_node->tagged_branches) {
-        res.tagged[tag_it.first] = CLOSED;
-        // set status to OPENED if at least one branch for this tag is opened
-        for (const auto& branch_it: tag_it.second) {
-            if (branch_it->getStatus(region) == OPENED) {
-                res.tagged[tag_it.first] = OPENED;
-                break;
-            }
+        // get overall status of request
+        // get tagged branches within the same service
+        if (service_node->opened_branches.load() == acsl_branches) {
+            res.status = CLOSED;
+        } else if (region_branches_ptr->load() != 0) {
+            res.status = OPENED;
+        } else {
+            // compact branches of the service may still be opened in this region
+            res.status = service_node->opened_compact_branches.load() != 0 ? UNKNOWN : CLOSED;
         }
-    }
-    return res;
+
+        // return if client only wants basic information (status)
+        if (!detailed) {
+            return res;
+        }
+
+        // otherwise, return detailed information
+        // (status is OPENED if at least one branch for this tag is opened in the region)
+        for (const auto& tag_it: service_node->tag_opened_regions) {
+            res.tagged[tag_it.first] = getCounter(tag_it.second, region) == 0 ? CLOSED : OPENED;
+        }
+        return res;
+    });
 }
 
 utils::Dependencies Request::fetchDependencies(const std::string& acsl_id, const std::string& service) {
     utils::Dependencies result {OK};
-    std::shared_lock<std::shared_mutex> lock(_mutex_service_nodes);
+    std::shared_lock<utils::SharedMutex> lock(_mutex_service_nodes);
     ACSL * acsl = _validateACSL(acsl_id);
     if (acsl == nullptr) return utils::Dependencies {INVALID_CONTEXT};
 
@@ -1287,8 +1590,7 @@ utils::Dependencies Request::fetchDependencies(const std::string& acsl_id, const
     ServiceNode * service_node = service_node_it->second;
     const auto& deps = _getAllFollowingDependencies(service_node, acsl_id);
     for (auto & dep : deps) {
-        std::shared_lock<std::shared_mutex> lock_service_node_dep(dep->mutex);
-        if (dep->opened_branches > 0) {
+        if (dep->opened_branches.load() > 0) {
             result.deps.insert(dep->name);
         }
     }
@@ -2,10 +2,15 @@
 #define REQUEST_H
 
 #include "branch.h"
+#include "wait_trace.h"
 #include "../replicas/version_registry.h"
 #include "../utils/grpc_service.h"
+#include "../utils/flat_map.h"
 #include "../utils/metadata.h"
 #include "../utils/settings.h"
+#include "../utils/small_vector.h"
+#include "../utils/locks.h"
+#include "../utils/cache_line.h"
 #include <iostream>
 #include <map>
 #include <memory>
@@ -17,6 +22,7 @@
 #include <cstring>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <stdint.h>
 #include <iomanip>
 #include <chrono>
@@ -26,6 +32,7 @@
 #include <stack>
 
 #include "oneapi/tbb/concurrent_hash_map.h"
+#include "oneapi/tbb/concurrent_unordered_map.h"
 #include "oneapi/tbb/concurrent_vector.h"
 
 using namespace utils;
@@ -36,102 +43,190 @@ namespace metadata {
 
         // public for testing purposes
         public:
+            // services usually call a few other services (kept inline)
+            static const size_t INLINE_CHILDREN = 4;
+
+            // <acsl, region or tag, num opened branches>
+            // (counters are never erased so status calls look them up once and read them without locks)
+            typedef oneapi::tbb::concurrent_unordered_map<std::string, std::atomic<int>> Counters;
+
             /* track all branching information of a service */
             typedef struct ServiceNodeStruct {
                 std::string name;
-                std::unordered_map<std::string, int> acsl_opened_branches;
-                int opened_global_region; // FIXME: CONVERT TO ATOMIC DUE TO ThE WAIT LOGS
-                int opened_branches;
+                // counters are changed while holding the service nodes lock (for the wait calls)
+                Counters acsl_opened_branches{};
+                std::atomic<int> opened_global_region{0};
+                std::atomic<int> opened_branches{0};
+                // compact branches (selective replication) may be in any region
+                std::atomic<int> opened_compact_branches{0};
                 int num_current_waits;
-                std::unordered_map<std::string, int> opened_regions;
-                std::unordered_map<std::string, std::vector<metadata::Branch*>> tagged_branches;
-                std::vector<struct ServiceNodeStruct*> children;
+                Counters opened_regions{};
+                // opened branches of each tag (globally and per region) so that waiting on a tag
+                // does not go through its branches
+                Counters tag_opened_branches{};
+                oneapi::tbb::concurrent_unordered_map<std::string, Counters> tag_opened_regions{};
+                utils::SmallVector<struct ServiceNodeStruct*, INLINE_CHILDREN> children;
 
-                // concurrency control
-                std::shared_mutex mutex;
+                // concurrency control (children)
+                utils::SharedMutex mutex LOCK_SITE("request.service_node");
 
             } ServiceNode;
 
             typedef struct ACSLStruct {
+                // read-mostly (read by wait calls of other acsls)
                 std::string acsl_id;
-                int i;
-                // protected by acsls mutex
-                int num_current_waits;
+                // compact form of the id that orders acsls (see utils::encodeACSLKey)
+                std::string key;
+                int i = 0;
+
+                // written by wait calls (protected by acsls mutex) and registration of child acsls
+                alignas(utils::CACHE_LINE_SIZE) int num_current_waits = 0;
+                std::atomic<int> next_acsl_index{0};
 
-                std::atomic<int> next_acsl_index;
-                std::atomic<int> opened_branches;
-                std::atomic<int> opened_global_region;
-                oneapi::tbb::concurrent_hash_map<std::string, int> opened_regions;
+                // written by every registration and closure of branches of the acsl
+                alignas(utils::CACHE_LINE_SIZE) std::atomic<int> opened_branches{0};
+                std::atomic<int> opened_global_region{0};
+                std::atomic<int> opened_compact_branches{0};
+                Counters opened_regions{};
 
             } ACSL;
 
-        private:
-            std::mutex _mutex_replicated_bid;
-            std::condition_variable _cond_replicated_bid;
+            // orders acsls by their position in the tree of acsls
+            typedef struct ACSLOrderStruct {
+                bool operator()(const ACSL * acsl_1, const ACSL * acsl_2) const {
+                    return acsl_1->key < acsl_2->key;
+                }
+            } ACSLOrder;
+
+            // changes to counters read by status calls without locks (see _readStatus)
+            typedef struct StatusVersionStruct {
+                std::atomic<uint64_t> writes_started{0};
+                std::atomic<uint64_t> writes_finished{0};
+            } StatusVersion;
+
+            // approximate memory (in bytes) used by the request and the size of its structures
+            typedef struct FootprintStruct {
+                size_t bytes;
+                size_t branches_bytes;
+                size_t service_nodes_bytes;
+                size_t acsls_bytes;
+                size_t wait_logs_bytes;
+                size_t registry_bytes;
+                int num_branches;
+                int num_service_nodes;
+                int num_acsls;
+                int num_wait_logs;
+            } Footprint;
 
+        private:
+            /* --------------------------------------------- */
+            /* read-mostly (set when the request is created) */
+            /* --------------------------------------------- */
+            const std::string _rid;
+            std::chrono::time_point<std::chrono::system_clock> _last_ts;
             bool _closed;
+            replicas::VersionRegistry * _versions_registry;
+
+            /* ---------------------------------------- */
+            /* write-hot counters (each one is updated  */
+            /* by different threads in its cache line)  */
+            /* ---------------------------------------- */
+            // updated by every registration
+            alignas(utils::CACHE_LINE_SIZE) std::atomic<long> _next_bid_index;
+            // updated by every registration and closure
+            alignas(utils::CACHE_LINE_SIZE) std::atomic<int> _num_opened_branches;
+            // updated by registrations and closures of branches without regions
+            alignas(utils::CACHE_LINE_SIZE) std::atomic<int> _opened_global_region;
+            // updated by registrations and closures of compact branches (their regions are not known here)
+            std::atomic<int> _opened_compact_branches;
+            // optimistic reads of the status retried when racing with writers (see _readStatus)
+            static const int STATUS_READ_ATTEMPTS = 16;
+            // updated before and after the counters of the request and acsls read by status calls are changed
+            alignas(utils::CACHE_LINE_SIZE) StatusVersion _status_version;
+            // updated before and after the counters of service nodes read by status calls are changed
+            alignas(utils::CACHE_LINE_SIZE) StatusVersion _service_status_version;
+            // updated by new acsls
+            alignas(utils::CACHE_LINE_SIZE) std::atomic<int> _next_sub_rid_index;
+            // index for acsls
+            std::atomic<int> acsls_i;
+
             /* ----------- */
             /* acsls */
             /* ----------- */
-            // index for acsls
-            std::atomic<int> acsls_i;
             // <acsl_id, acsl_ptr>
-            oneapi::tbb::concurrent_hash_map<std::string, ACSL*> _acsls;
-            // <acsl_id>
-            std::set<std::string> _wait_logs;
-            std::unordered_map<std::string, std::unordered_set<ServiceNode*>> _service_wait_logs;
-
-            /* ------- */
-            /* helpers */
-            /* ------- */
-            const std::string _rid;
-            std::atomic<long> _next_bid_index;
-            std::atomic<int> _next_sub_rid_index;
-            std::chrono::time_point<std::chrono::system_clock> _last_ts;
-            
-            /* ------------------- */
-            /* replicas versioning */
-            /* ------------------- */
-            replicas::VersionRegistry * _versions_registry;
+            alignas(utils::CACHE_LINE_SIZE) oneapi::tbb::concurrent_hash_map<std::string, ACSL*> _acsls;
+            // acsls with ongoing wait calls
+            std::set<ACSL*, ACSLOrder> _wait_logs;
+            utils::FlatMap<std::unordered_set<ServiceNode*>> _service_wait_logs;
 
             /* -------------------- */
             /* branching management */
             /* -------------------- */
-            std::atomic<int> _num_opened_branches;
-            std::atomic<int> _opened_global_region;
             // <region, num opened branches>
-            std::unordered_map<std::string, int> _opened_regions; // FIXME: use tbb
+            // (regions are never removed so lookups do not need _mutex_regions)
+            Counters _opened_regions;
             // <bid, branch_ptr>
-            std::unordered_map<std::string, metadata::Branch*> _branches; //FIXME: use tbb
+            // (kept under _mutex_branches instead of a concurrent map: lookups wait on _cond_new_branch for branches of async replicas)
+            utils::FlatMap<metadata::Branch*> _branches;
             // <service name, service_node_ptr>
-            std::unordered_map<std::string, ServiceNode*> _service_nodes;
+            // (inserted under _mutex_service_nodes and never removed so status calls look them up without locks)
+            oneapi::tbb::concurrent_unordered_map<std::string, ServiceNode*> _service_nodes;
+
+            /* ------------------------------------ */
+            /* memory accounting (updated as the    */
+            /* request is built, without locks)     */
+            /* ------------------------------------ */
+            alignas(utils::CACHE_LINE_SIZE) std::atomic<size_t> _branches_bytes;
+            std::atomic<size_t> _service_nodes_bytes;
+            std::atomic<size_t> _acsls_bytes;
+            std::atomic<size_t> _wait_logs_bytes;
+            std::atomic<int> _num_branches;
+            std::atomic<int> _num_service_nodes;
+            std::atomic<int> _num_acsls;
+            std::atomic<int> _num_wait_logs;
 
             /* ------------------- */
             /* concurrency control */
             /* ------------------- */
+            alignas(utils::CACHE_LINE_SIZE) utils::Mutex _mutex_replicated_bid LOCK_SITE("request.replicated_bid");
+            utils::ConditionVariable _cond_replicated_bid;
             // logs
-            std::shared_mutex _mutex_service_wait_logs;
+            utils::SharedMutex _mutex_service_wait_logs LOCK_SITE("request.service_wait_logs");
             // branches
-            std::mutex _mutex_branches;
-            std::condition_variable _cond_new_branch;
+            utils::Mutex _mutex_branches LOCK_SITE("request.branches");
+            utils::ConditionVariable _cond_new_branch;
             // regions
-            std::mutex _mutex_regions;
+            utils::Mutex _mutex_regions LOCK_SITE("request.regions");
             // service nodes
-            std::shared_mutex _mutex_service_nodes;
+            utils::SharedMutex _mutex_service_nodes LOCK_SITE("request.service_nodes");
             std::condition_variable_any _cond_service_nodes;
             // service nodes -- wait with async option
             std::condition_variable_any _cond_new_service_nodes;
             // acsls
-            std::shared_mutex _mutex_acsls;
+            utils::SharedMutex _mutex_acsls LOCK_SITE("request.acsls");
             std::condition_variable_any _cond_acsls;
 
+            /**
+             * Account a new service node in the footprint of the request
+             * 
+             * @param service The name of the service node
+             */
+            void _accountServiceNode(const std::string& service);
+
+            /**
+             * Account a new acsl in the footprint of the request
+             * 
+             * @param acsl The new acsl
+             */
+            void _accountACSL(const ACSL * acsl);
+
             /**
              * Wait for the branch's registration
              * 
              * @param bid The branch identifier
              * @return pointer to the branch if found and nullptr otherwise
             */
-            metadata::Branch * _waitBranchRegistration(const std::string& bid);
+            metadata::Branch * _waitBranchRegistration(std::string_view bid);
 
             /**
              * Get all the following dependencies for the current service node
@@ -151,11 +246,12 @@ namespace metadata {
              * @param timeout Timeout set by client
              * @param start_time Start time
              * @param remaining_time Remaining timeout
+             * @param trace Optional trace of the wait call
              * @return if inconsistency was prevented or not
             */
             int _doWaitService(ServiceNode * service_node, const std::string& acsl_id,
                 int timeout, const std::chrono::steady_clock::time_point& start_time, 
-                std::chrono::seconds remaining_time);
+                std::chrono::seconds remaining_time, WaitTrace * trace);
 
             /**
              * Helper for wait logic in service and region
@@ -166,11 +262,12 @@ namespace metadata {
              * @param timeout Timeout set by client
              * @param start_time Start time
              * @param remaining_time Remaining timeout
+             * @param trace Optional trace of the wait call
              * @return if inconsistency was prevented or not
             */
             int _doWaitServiceRegion(ServiceNode * service_node, const std::string& region, const std::string& acsl_id,
                 int timeout, const std::chrono::steady_clock::time_point& start_time, 
-                std::chrono::seconds remaining_time);
+                std::chrono::seconds remaining_time, WaitTrace * trace);
 
             /**
              * Helper for wait logic in tag for service and service and region
@@ -182,11 +279,26 @@ namespace metadata {
              * @param timeout Timeout set by client
              * @param start_time Start time
              * @param remaining_time Remaining timeout
+             * @param trace Optional trace of the wait call
              * @return if inconsistency was prevented or not
             */
             int _doWaitTag(ServiceNode * service_node, const std::string& tag, const std::string& region, 
                 int timeout, const std::chrono::steady_clock::time_point& start_time, 
-                std::chrono::seconds remaining_time);
+                std::chrono::seconds remaining_time, WaitTrace * trace);
+
+            /**
+             * Record in the trace the opened branches that block a wait call in a given context
+             * REMINDER: the caller cannot hold any lock of the request (lock on branches is acquired before the others)
+             * 
+             * @param trace Trace of the wait call
+             * @param service Service context (empty for all services)
+             * @param region Region context (empty for all regions)
+             * @param tag Tag context (empty for all tags)
+             * @param acsl_id Branches of this acsl are ignored
+             * @param ignore_acsl If disabled, branches of the current acsl also block the call (e.g. tags)
+             */
+            void _traceBlockingBranches(WaitTrace * trace, const std::string& service, const std::string& region,
+                const std::string& tag, const std::string& acsl_id, bool ignore_acsl);
 
             /**
              * Helper to wait for asynchronous registration of service and its optional tag
@@ -212,6 +324,49 @@ namespace metadata {
              * @param start_time The starting time of the call
             */
             std::chrono::seconds _computeRemainingTime(int timeout, const std::chrono::steady_clock::time_point& start_time);
+
+            /**
+             * Mark the start of a change to the counters read by status calls (must be followed by _endStatusWrite)
+             * Caller must hold the lock given to the readers of these counters (see _readStatus) until the end of the change
+             * 
+             * @param version The version of the counters (request and acsls or service nodes)
+             */
+            void _beginStatusWrite(StatusVersion& version);
+
+            /**
+             * Mark the end of a change to the counters read by status calls
+             * 
+             * @param version The version of the counters (request and acsls or service nodes)
+             */
+            void _endStatusWrite(StatusVersion& version);
+
+            /**
+             * Read counters of the request without locks (seqlock): the read is retried if a change to the
+             * counters started or was ongoing meanwhile, so that all counters are observed at the same point.
+             * After STATUS_READ_ATTEMPTS the read is done while holding the given lock exclusively, since
+             * writers hold it during the whole change: acsls lock (shared) for the counters of the request and
+             * acsls and service nodes lock for the counters of service nodes
+             * 
+             * @param version The version of the counters that are read
+             * @param mutex The lock held by writers of the counters
+             * @param read Function that reads the (atomic) counters
+             * @return The result of the read
+             */
+            template <typename Read>
+            auto _readStatus(const StatusVersion& version, utils::SharedMutex& mutex, Read read) -> decltype(read()) {
+                for (int attempt = 0; attempt < STATUS_READ_ATTEMPTS; attempt++) {
+                    uint64_t finished = version.writes_finished.load(std::memory_order_acquire);
+                    uint64_t started = version.writes_started.load(std::memory_order_acquire);
+                    auto result = read();
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (started == finished && version.writes_started.load(std::memory_order_relaxed) == started) {
+                        return result;
+                    }
+                    std::this_thread::yield();
+                }
+                std::unique_lock<utils::SharedMutex> lock(mutex);
+                return read();
+            }
             
             /**
              * Validates the service node
@@ -288,31 +443,31 @@ namespace metadata {
             bool _isPrecedingAsyncZone(ACSL* subrequest_1, ACSL* subrequest_2);
 
             /**
-             * Get all preceding entires from wait logs, i.e., smaller sub_rids than the current one
+             * Get all greater entries from wait logs, i.e., acsls after the current one in the tree of acsls
              * (used to be ignored in the wait call)
              * 
-             * @param subrequest The current acsl id
-             * @return vector of all preceding sub rids
+             * @param subrequest The current acsl
+             * @return vector of all greater acsls
             */
-            std::vector<std::string> _getGreaterACSLs(ACSL* subrequest);
+            std::vector<ACSL*> _getGreaterACSLs(ACSL* subrequest);
 
             /**
-             * Get number of opened branches for all preceding acsl ids
+             * Get number of opened branches for all greater acsls
              * 
-             * @param sub_rids Vector of all preceding acsl ids identifiers
+             * @param acsls Vector of all greater acsls
              * @return number of opened branches
             */
-            int _numOpenedBranchesACSLs(const std::vector<std::string>& sub_rids);
+            int _numOpenedBranchesACSLs(const std::vector<ACSL*>& acsls);
 
             /**
-             * Get number of opened branches for all preceding acsl ids in current region and global region
+             * Get number of opened branches for all greater acsls in current region and global region
              * 
-             * @param sub_rids Vector of all preceding acsl ids identifiers
+             * @param acsls Vector of all greater acsls
              * @param region Targeted region
              * @return pair for number of opened branches with format: <global region, targeted region>
             */
             std::pair<int, int> _numOpenedRegionsACSLs(
-                const std::vector<std::string>& sub_rids, const std::string& region);
+                const std::vector<ACSL*>& acsls, const std::string& region);
 
             /**
              * Wait until the first branch is registered
@@ -351,7 +506,7 @@ namespace metadata {
              * @param visible_bid Branch identifiers to be verified to be registered
              * @return true if all bids are visible and false otherwise
              */
-            metadata::Branch * _waitBranchReplicationReady(const std::string& visible_bid);
+            metadata::Branch * _waitBranchReplicationReady(std::string_view visible_bid);
             
             /**
              * Check if bids are already visible
@@ -359,7 +514,7 @@ namespace metadata {
              * @param visible_bids Branch identifiers to be verified to be registered
              * @return true if all bids are visible and false otherwise
              */
-            bool waitBranchesReplicationReady(std::vector<std::string> visible_bids);
+            bool waitBranchesReplicationReady(const std::vector<std::string_view>& visible_bids);
 
             /**
              * Return timestamp of last modification
@@ -371,7 +526,14 @@ namespace metadata {
              * 
              * @return rid
              */
-            std::string getRid();
+            const std::string& getRid();
+
+            /**
+             * Get the approximate memory used by the request
+             * 
+             * @return footprint of the request
+             */
+            Footprint getFootprint();
 
             /**
              * Get versions registry
@@ -414,38 +576,51 @@ namespace metadata {
              * @param tag The service tag
              * @param regions The regions for each branch
              * @param current_service The parent service
+             * @param compact If enabled, only counters are tracked for the branch (regions are ignored and the branch is closed at once)
              * 
              * @param return branch if successfully registered and nullptr otherwise (if branches already exists)
              */
             metadata::Branch * registerBranch(const std::string& acsl_id, const std::string& bid, const std::string& service, 
-                const std::string& tag, const utils::ProtoVec& regions, const std::string& current_service_bid, bool replicated);
+                const std::string& tag, const utils::ProtoVec& regions, std::string_view current_service_bid, bool replicated,
+                bool compact = false);
+
+            /**
+             * Get a registered branch
+             * 
+             * @param bid The identifier of the branch
+             * @return pointer to the branch if found and nullptr otherwise
+             */
+            metadata::Branch * getBranch(std::string_view bid);
 
             /**
              * Remove a branch from the request
              * 
              * @param bid The identifier of the set of branches where the current branch was registered
              * @param region The region where the branch was registered
-
+             * @param globally_closed Optional output set to true only by the close that closed the last opened region
+             * 
              * @return one of three values:
              * - 2 if all branches are closed for the request
              * - 1 if branch was closed
              * - 0 if branch was already closed before
              * - (-1) if encountered error from either (i) wrong bid, wrong region, or error in acsls tbb map
              */
-            int closeBranch(const std::string& bid, const std::string& region);
+            int closeBranch(std::string_view bid, const std::string& region, bool * globally_closed = nullptr);
 
             /**
              * Untrack (remove) branch according to its context (service, region or none) in the corresponding maps
              *
              * @param acsl_id Current subrequest
              * @param service The service context
+             * @param tag The service tag (can be empty)
              * @param region The region context
              * @param globally_closed Indicates if all regions are closed
+             * @param compact Indicates if the branch is only tracked by counters
              * 
              * @return true if successful and false otherwise
              */
-            bool untrackBranch(const std::string& acsl_id, const std::string& service, 
-                const std::string& region, bool globally_closed);
+            bool untrackBranch(const std::string& acsl_id, const std::string& service, const std::string& tag,
+                const std::string& region, bool globally_closed, bool compact = false);
 
             /**
              * Track a set of branches (add) according to their context (service, region or none) in the corresponding maps
@@ -469,6 +644,7 @@ namespace metadata {
              * @param async Force to wait for asynchronous creation of a single branch
              * @param timeout Timeout in seconds
              * @param acsl_id Current asynchronous zone
+             * @param trace Optional trace that records the branches blocking the call
              *
              * @return Possible return values:
              * - 0 if call did not block, 
@@ -477,7 +653,8 @@ namespace metadata {
              * - (-3) current_service not found
              * - (-4) if acsl_id does not exist
              */
-            int wait(const std::string& acsl_id, bool async, int timeout, const std::string& current_service);
+            int wait(const std::string& acsl_id, bool async, int timeout, const std::string& current_service,
+                WaitTrace * trace = nullptr);
 
             /**
              * Wait until request is closed for a given context (region)
@@ -487,6 +664,7 @@ namespace metadata {
              * @param async Force to wait for asynchronous creation of a single branch
              * @param timeout Timeout in seconds
              * @param acsl_id Current asynchronous zone
+             * @param trace Optional trace that records the branches blocking the call
              *
              * @return Possible return values:
              * - 0 if call did not block, 
@@ -496,7 +674,8 @@ namespace metadata {
              * - (-3) current_service not found
              * - (-4) if acsl_id does not exist
              */
-            int waitRegion(const std::string& acsl_id, const std::string& region, bool async, int timeout, const std::string& current_service);
+            int waitRegion(const std::string& acsl_id, const std::string& region, bool async, int timeout, const std::string& current_service,
+                WaitTrace * trace = nullptr);
 
             /**
              * Wait until request is closed for a given context (service)
@@ -508,6 +687,7 @@ namespace metadata {
              * @param timeout Timeout in seconds
              * @param current_service The current service name
              * @param wait_deps If enabled, it waits for all dependencies of the service
+             * @param trace Optional trace that records the branches blocking the call
              *
              * @return Possible return values:
              * - 0 if call did not block, 
@@ -518,7 +698,7 @@ namespace metadata {
              */
             int waitService(const std::string& acsl_id, 
                 const std::string& service, const std::string& tag, bool async, 
-                int timeout, const std::string& current_service, bool wait_deps);
+                int timeout, const std::string& current_service, bool wait_deps, WaitTrace * trace = nullptr);
 
 
             /**
@@ -532,6 +712,7 @@ namespace metadata {
              * @param timeout Timeout in seconds
              * @param current_service The current service name
              * @param wait_deps If enabled, it waits for all dependencies of the service
+             * @param trace Optional trace that records the branches blocking the call
              *
              * @return Possible return values:
              * - 0 if call did not block, 
@@ -544,7 +725,7 @@ namespace metadata {
             int waitServiceRegion(const std::string& acsl_id, 
                 const std::string& service, const std::string& region, 
                 const std::string& tag, bool async, int timeout,
-                const std::string& current_service, bool wait_deps);
+                const std::string& current_service, bool wait_deps, WaitTrace * trace = nullptr);
 
             /**
              * Check status of request
@@ -566,7 +747,7 @@ namespace metadata {
              * @return Possible return values:
              * - 0 if request is OPENED 
              * - 1 if request is CLOSED
-             * - 2 if request is UNKNOWN
+             * - 2 if request is UNKNOWN (also when only compact branches, with untracked regions, are opened)
              * - (-3) if acsl_id does not exist
              */
             Status checkStatusRegion(const std::string& acsl_id, const std::string& region);
@@ -597,7 +778,7 @@ namespace metadata {
              * @return Possible return values:
              * - 0 if request is OPENED 
              * - 1 if request is CLOSED
-             * - 2 if request is UNKNOWN
+             * - 2 if request is UNKNOWN (also when only compact branches, with untracked regions, are opened)
              */
             Status checkStatusServiceRegion(const std::string& acsl_id, 
                 const std::string& service, const std::string& region, bool detailed = false);
@@ -2,35 +2,459 @@
 
 using namespace metadata;
 
-Subscriber::Subscriber(int subscribers_refresh_interval_s) 
-    : _subscribers_refresh_interval_s(subscribers_refresh_interval_s) {
-        _subscribed_branches = std::queue<SubscribedBranch>();
+Subscriber::Subscriber(int subscribers_refresh_interval_s, int capacity, ClosedBranchPredicate is_closed,
+    OverflowPolicy overflow_policy, const std::string& spill_path) 
+    : _subscribed_branches(capacity), _next_offset(0), _cursor(0), _num_shared_consumers(0),
+    _max_log_size(capacity), _is_closed(is_closed), _next_member_id(NO_MEMBER + 1),
+    _num_waiting(0),
+    _subscribers_refresh_interval_s(subscribers_refresh_interval_s),
+    _overflow_policy(overflow_policy), _num_queued(0), _num_dropped(0), _num_spilled(0),
+    _spill_path(spill_path), _spilling(false), _spill_read_pos(0), _spill_write_pos(0), _num_spill_buffered(0) {
         _last_ts = std::chrono::system_clock::now();
 }
 
-void Subscriber::push(const std::string& bid, const std::string& tag) {
-    _mutex.lock();
-    _subscribed_branches.push(SubscribedBranch{bid, tag});
-    _cond.notify_one();
-    _mutex.unlock();
+Subscriber::~Subscriber() {
+    if (_spill_file.is_open()) {
+        _spill_file.close();
+        std::remove(_spill_path.c_str());
+    }
 }
 
-metadata::Subscriber::SubscribedBranch Subscriber::pop(grpc::ServerContext * context) {
-    // refresh timestamp of last time moment
-    _last_ts = std::chrono::system_clock::now();
+bool Subscriber::parseOverflowPolicy(const std::string& name, OverflowPolicy& overflow_policy) {
+    if (name == "drop_oldest") {
+        overflow_policy = OVERFLOW_DROP_OLDEST;
+    }
+    else if (name == "spill") {
+        overflow_policy = OVERFLOW_SPILL;
+    }
+    else if (name == "reject") {
+        overflow_policy = OVERFLOW_REJECT;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+bool Subscriber::push(const std::string& bid, const std::string& tag) {
+    SubscribedBranch subscribed_branch{bid, tag, 0};
+
+    // branches go to disk while there are spilled branches so that ordering is preserved
+    bool queued = _spilling.load() && _spill(subscribed_branch);
+    while (!queued && !_subscribed_branches.tryPush(subscribed_branch)) {
+        if (_overflow_policy == OVERFLOW_DROP_OLDEST) {
+            _dropOldest();
+        }
+        else if (_overflow_policy == OVERFLOW_SPILL && _spill(subscribed_branch)) {
+            queued = true;
+        }
+        else {
+            _num_dropped.fetch_add(1);
+            return false;
+        }
+    }
+    _num_queued.fetch_add(1);
+
+    // only pay for the lock when consumers are sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_num_waiting.load() > 0) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cond.notify_all();
+    }
+    return true;
+}
+
+uint64_t Subscriber::_getLowWatermark() {
+    uint64_t low_watermark = _next_offset;
+    if (_num_shared_consumers > 0) {
+        low_watermark = std::min(low_watermark, _cursor);
+    }
+    for (const auto& group_it : _groups) {
+        for (const auto& cursor_it : group_it.second.cursors) {
+            low_watermark = std::min(low_watermark, cursor_it.second);
+        }
+    }
+    return low_watermark;
+}
+
+bool Subscriber::_spill(const SubscribedBranch& subscribed_branch) {
+    std::unique_lock<std::mutex> lock(_mutex_spill);
+    if (!_spill_file.is_open()) {
+        _spill_file.open(_spill_path, std::ios::in | std::ios::out | std::ios::trunc);
+        if (!_spill_file.is_open()) {
+            LOG_ERROR_RATE_LIMITED("could not open subscriber spill file '{}'", _spill_path);
+            return false;
+        }
+    }
+    size_t line_size = subscribed_branch.bid.size() + subscribed_branch.tag.size() + 2;
+    if (_spill_buffer.size() + line_size > SPILL_BUFFER_SIZE && !_flushSpill()) {
+        return false;
+    }
+    if (_spill_buffer.capacity() < SPILL_BUFFER_SIZE) {
+        _spill_buffer.reserve(SPILL_BUFFER_SIZE);
+    }
+    _spill_buffer.append(subscribed_branch.bid).append(1, '\t').append(subscribed_branch.tag).append(1, '\n');
+    _spill_write_pos += line_size;
+    _num_spill_buffered++;
+    _spilling.store(true);
+    _num_spilled.fetch_add(1);
+    return true;
+}
+
+bool Subscriber::_flushSpill() {
+    if (_spill_buffer.empty()) {
+        return true;
+    }
+    _spill_file.clear();
+    _spill_file.seekp(_spill_write_pos - _spill_buffer.size());
+    _spill_file.write(_spill_buffer.data(), _spill_buffer.size());
+    _spill_file.flush();
+    bool written = static_cast<bool>(_spill_file);
+    if (!written) {
+        LOG_ERROR_RATE_LIMITED("could not write {} branches to subscriber spill file '{}'", _num_spill_buffered, _spill_path);
+        _spill_write_pos -= _spill_buffer.size();
+        _num_spilled.fetch_sub(_num_spill_buffered);
+        _num_dropped.fetch_add(_num_spill_buffered);
+    }
+    _spill_buffer.clear();
+    _num_spill_buffered = 0;
+    return written;
+}
+
+size_t Subscriber::_unspill(size_t max_branches) {
+    std::unique_lock<std::mutex> lock(_mutex_spill);
+    size_t num_branches = 0;
+    std::string line;
+    // consumers read every spilled branch back from disk
+    _flushSpill();
+    _spill_file.clear();
+    _spill_file.seekg(_spill_read_pos);
+    while (num_branches < max_branches && _spill_read_pos < _spill_write_pos && std::getline(_spill_file, line)) {
+        _spill_read_pos += line.size() + 1;
+        size_t delimiter_pos = line.find('\t');
+        _log.emplace_back(SubscribedBranch{line.substr(0, delimiter_pos), line.substr(delimiter_pos + 1), _next_offset++});
+        num_branches++;
+    }
+
+    // all spilled branches were consumed so new branches go back to the ring
+    if (_spill_read_pos >= _spill_write_pos) {
+        _spill_file.close();
+        _spill_file.open(_spill_path, std::ios::in | std::ios::out | std::ios::trunc);
+        _spill_read_pos = 0;
+        _spill_write_pos = 0;
+        _spilling.store(false);
+    }
+    return num_branches;
+}
+
+void Subscriber::_dropOldest() {
+    std::unique_lock<std::mutex> lock_consumer(_mutex_consumer);
+    _refreshLog();
+    if (_subscribed_branches.size() < _subscribed_branches.capacity()) {
+        return;
+    }
+
+    // the log is full of undelivered branches: consumers at the low watermark skip the oldest one
+    uint64_t low_watermark = _getLowWatermark();
+    if (low_watermark >= _next_offset) {
+        return;
+    }
+    if (_num_shared_consumers > 0 && _cursor == low_watermark) {
+        _cursor++;
+    }
+    for (auto& group_it : _groups) {
+        for (auto& cursor_it : group_it.second.cursors) {
+            if (cursor_it.second == low_watermark) {
+                cursor_it.second++;
+            }
+        }
+    }
+    _num_dropped.fetch_add(1);
+    _refreshLog();
+}
+
+void Subscriber::_notifyConsumers() {
     std::unique_lock<std::mutex> lock(_mutex);
-    while (_subscribed_branches.size() == 0) {
+    _cond.notify_all();
+}
+
+void Subscriber::_refreshLog() {
+    uint64_t low_watermark = _getLowWatermark();
+
+    // undelivered branches are kept in the ring until there is room for them in the log
+    SubscribedBranch subscribed_branch;
+    bool drained = false;
+    while (_next_offset - low_watermark < _max_log_size && _subscribed_branches.tryPop(subscribed_branch)) {
+        subscribed_branch.offset = _next_offset++;
+        _log.emplace_back(std::move(subscribed_branch));
+        drained = true;
+    }
+    // spilled branches are newer than the ones in the ring
+    if (_spilling.load() && _subscribed_branches.size() == 0 && _next_offset - low_watermark < _max_log_size) {
+        drained = _unspill(_max_log_size - (_next_offset - low_watermark)) > 0 || drained;
+    }
+
+    // retention is bounded by closed or acked branches (only delivered ones can be removed)
+    while (!_log.empty() && _log.front().offset < low_watermark &&
+        (_acked_bids.count(_log.front().bid) != 0 || (_is_closed && _is_closed(_log.front().bid)))) {
+        _acked_bids.erase(_log.front().bid);
+        _log.pop_front();
+    }
+    // safeguard for delivered branches that are never closed
+    while (!_log.empty() && _log.front().offset < low_watermark && low_watermark - _log.front().offset > _max_log_size) {
+        LOG_ERROR_RATE_LIMITED("subscriber log full: discarding branch '{}' at offset {}", _log.front().bid, _log.front().offset);
+        _acked_bids.erase(_log.front().bid);
+        _log.pop_front();
+    }
+
+    // other group members may own the new branches
+    if (drained && !_groups.empty()) {
+        _notifyConsumers();
+    }
+}
+
+bool Subscriber::_waitBranches(grpc::ServerContext * context, std::unique_lock<std::mutex>& lock_consumer) {
+    // lock before releasing the consumer lock so that changes to the log
+    // made by other consumers in between cannot notify before we wait
+    std::unique_lock<std::mutex> lock(_mutex);
+    lock_consumer.unlock();
+
+    // announce that we are going to sleep and check again before waiting
+    // so that a producer cannot push in between without notifying us
+    _num_waiting.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_subscribed_branches.size() == 0 && !_spilling.load() && _cancelled_contexts.count(context) == 0) {
         _last_ts = std::chrono::system_clock::now();
         _cond.wait_for(lock, std::chrono::seconds(_subscribers_refresh_interval_s));
-        if (context->IsCancelled()) {
-            return SubscribedBranch{};
+    }
+    _num_waiting.fetch_add(-1);
+    bool cancelled = _cancelled_contexts.count(context) != 0;
+    lock.unlock();
+
+    lock_consumer.lock();
+    return !cancelled && !context->IsCancelled();
+}
+
+void Subscriber::ack(const std::vector<std::string>& bids) {
+    std::unique_lock<std::mutex> lock_consumer(_mutex_consumer);
+    _acked_bids.insert(bids.begin(), bids.end());
+
+    // discard acks of branches that are no longer in the log (e.g., acked twice)
+    if (_acked_bids.size() > _max_log_size) {
+        std::unordered_set<std::string> acked_bids;
+        for (const auto& subscribed_branch : _log) {
+            if (_acked_bids.count(subscribed_branch.bid) != 0) {
+                acked_bids.insert(subscribed_branch.bid);
+            }
         }
+        _acked_bids = std::move(acked_bids);
     }
-    auto subscribedBranch = _subscribed_branches.front();
-    _subscribed_branches.pop();
-    return subscribedBranch;
+}
+
+void Subscriber::cancel(grpc::ServerContext * context) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cancelled_contexts.insert(context);
+    _cond.notify_all();
+}
+
+void Subscriber::release(grpc::ServerContext * context) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _cancelled_contexts.erase(context);
+}
+
+metadata::Subscriber::SubscribedBranch Subscriber::pop(grpc::ServerContext * context) {
+    auto subscribed_branches = popBatch(context, 1);
+    if (subscribed_branches.empty()) {
+        return SubscribedBranch{};
+    }
+    return subscribed_branches.front();
+}
+
+std::vector<metadata::Subscriber::SubscribedBranch> Subscriber::popBatch(grpc::ServerContext * context, int max_batch_size,
+    uint64_t member_id) {
+
+    std::vector<SubscribedBranch> subscribed_branches;
+
+    // refresh timestamp of last time moment
+    _last_ts = std::chrono::system_clock::now();
+    std::unique_lock<std::mutex> lock_consumer(_mutex_consumer);
+    // consumers that pop without seeking first are counted once and never released
+    if (member_id == NO_MEMBER && _num_shared_consumers == 0) {
+        _num_shared_consumers = 1;
+    }
+
+    while (true) {
+        _refreshLog();
+
+        // consumer without group: deliver branches starting at the shared cursor
+        if (member_id == NO_MEMBER) {
+            if (!_log.empty() && _cursor < _next_offset) {
+                size_t idx = _cursor > _log.front().offset ? _cursor - _log.front().offset : 0;
+                while (idx < _log.size() && (int) subscribed_branches.size() < max_batch_size) {
+                    subscribed_branches.emplace_back(_log[idx++]);
+                }
+                if (!subscribed_branches.empty()) {
+                    _cursor = subscribed_branches.back().offset + 1;
+                    return subscribed_branches;
+                }
+            }
+        }
+        // group member: only deliver branches of its own partition
+        else {
+            auto member_it = _members.find(member_id);
+            if (member_it == _members.end()) {
+                return subscribed_branches;
+            }
+            ConsumerGroup& group = _groups[member_it->second];
+            size_t partition = std::find(group.members.begin(), group.members.end(), member_id) - group.members.begin();
+            uint64_t& cursor = group.cursors[member_id];
+
+            size_t idx = (!_log.empty() && cursor > _log.front().offset) ? cursor - _log.front().offset : 0;
+            while (idx < _log.size() && (int) subscribed_branches.size() < max_batch_size) {
+                const auto& subscribed_branch = _log[idx++];
+                // partition by the rid of the composed bid (<bid>:<rid>) without copying it
+                std::string_view bid = subscribed_branch.bid;
+                size_t delimiter_pos = bid.find(utils::FULL_ID_DELIMITER);
+                std::string_view rid = delimiter_pos == std::string_view::npos ? bid : bid.substr(delimiter_pos + 1);
+                if (std::hash<std::string_view>{}(rid) % group.members.size() == partition) {
+                    subscribed_branches.emplace_back(subscribed_branch);
+                }
+            }
+            cursor = idx < _log.size() ? _log[idx].offset : _next_offset;
+            if (!subscribed_branches.empty()) {
+                return subscribed_branches;
+            }
+        }
+
+        if (!_waitBranches(context, lock_consumer)) {
+            return subscribed_branches;
+        }
+    }
+}
+
+uint64_t Subscriber::seek(uint64_t offset) {
+    std::unique_lock<std::mutex> lock_consumer(_mutex_consumer);
+    _num_shared_consumers++;
+    _refreshLog();
+    // cannot resume after the last branch
+    _cursor = std::min(offset, _next_offset);
+    return _cursor;
+}
+
+void Subscriber::releaseCursor() {
+    std::unique_lock<std::mutex> lock_consumer(_mutex_consumer);
+    if (_num_shared_consumers == 0) {
+        return;
+    }
+    _num_shared_consumers--;
+    // branches retained only for the cursor can be removed once the last consumer is gone
+    _refreshLog();
+}
+
+void Subscriber::_rebalance(ConsumerGroup& group, uint64_t offset) {
+    // branches that were not yet scanned by some member are delivered again to their new owners
+    for (auto& cursor_it : group.cursors) {
+        cursor_it.second = offset;
+    }
+}
+
+uint64_t Subscriber::joinGroup(const std::string& group_id, uint64_t offset) {
+    std::unique_lock<std::mutex> lock_consumer(_mutex_consumer);
+    _refreshLog();
+    uint64_t member_id = _next_member_id++;
+
+    auto group_it = _groups.find(group_id);
+    // new group starts at the offset provided by the member
+    if (group_it == _groups.end()) {
+        offset = std::min(offset, _next_offset);
+    }
+    // existing group restarts at the offset of its slowest member
+    else {
+        offset = _next_offset;
+        for (const auto& cursor_it : group_it->second.cursors) {
+            offset = std::min(offset, cursor_it.second);
+        }
+    }
+
+    ConsumerGroup& group = _groups[group_id];
+    group.members.emplace_back(member_id);
+    group.cursors[member_id] = offset;
+    _members[member_id] = group_id;
+    _rebalance(group, offset);
+    SPDLOG_INFO("member #{} joined consumer group '{}' with #{} members (offset={})", member_id, group_id, group.members.size(), offset);
+
+    lock_consumer.unlock();
+    _notifyConsumers();
+    return member_id;
+}
+
+void Subscriber::leaveGroup(uint64_t member_id) {
+    std::unique_lock<std::mutex> lock_consumer(_mutex_consumer);
+    auto member_it = _members.find(member_id);
+    if (member_it == _members.end()) {
+        return;
+    }
+    const std::string group_id = member_it->second;
+    _members.erase(member_it);
+
+    ConsumerGroup& group = _groups[group_id];
+    uint64_t offset = _next_offset;
+    for (const auto& cursor_it : group.cursors) {
+        offset = std::min(offset, cursor_it.second);
+    }
+    group.cursors.erase(member_id);
+    group.members.erase(std::find(group.members.begin(), group.members.end(), member_id));
+
+    if (group.members.empty()) {
+        _groups.erase(group_id);
+    }
+    else {
+        _rebalance(group, offset);
+    }
+    SPDLOG_INFO("member #{} left consumer group '{}'", member_id, group_id);
+
+    lock_consumer.unlock();
+    _notifyConsumers();
+}
+
+int Subscriber::getGroupSize(const std::string& group_id) {
+    std::unique_lock<std::mutex> lock_consumer(_mutex_consumer);
+    auto group_it = _groups.find(group_id);
+    if (group_it == _groups.end()) {
+        return 0;
+    }
+    return group_it->second.members.size();
+}
+
+uint64_t Subscriber::getCursor(uint64_t member_id) {
+    std::unique_lock<std::mutex> lock_consumer(_mutex_consumer);
+    if (member_id == NO_MEMBER) {
+        return _cursor;
+    }
+    auto member_it = _members.find(member_id);
+    if (member_it == _members.end()) {
+        return 0;
+    }
+    return _groups[member_it->second].cursors[member_id];
+}
+
+size_t Subscriber::getLogSize() {
+    std::unique_lock<std::mutex> lock_consumer(_mutex_consumer);
+    return _log.size();
+}
+
+bool Subscriber::isFull() {
+    return _spilling.load() || _subscribed_branches.size() >= _subscribed_branches.capacity();
+}
+
+metadata::Subscriber::OverflowPolicy Subscriber::getOverflowPolicy() {
+    return _overflow_policy;
+}
+
+metadata::Subscriber::QueueStats Subscriber::getQueueStats() {
+    return QueueStats{_num_queued.load(), _num_dropped.load(), _num_spilled.load(), _subscribed_branches.size()};
 }
 
 std::chrono::time_point<std::chrono::system_clock> Subscriber::getLastTs() {
     return _last_ts;
-}
\ No newline at end of file
+}
@@ -1,46 +1,223 @@
 #ifndef SUBSCRIBER_H
 #define SUBSCRIBER_H
 
+#include <unordered_map>
 #include <unordered_set>
 #include <mutex>
 #include <shared_mutex>
 #include <condition_variable>
 #include <chrono>
-#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <string_view>
+#include <vector>
 #include "branch.h"
 #include "../utils/grpc_service.h"
 #include "../utils/metadata.h"
+#include "../utils/mpsc_ring.h"
 #include "../utils/settings.h"
 #include <chrono>
+#include "../utils/log.h"
 #include "spdlog/fmt/ostr.h"
 
 namespace metadata {
 
     class Subscriber {
 
-        typedef struct SubscribedBranchStruct {
-            std::string bid;
-            std::string tag;
-        } SubscribedBranch;
+        public:
+            typedef struct SubscribedBranchStruct {
+                std::string bid;
+                std::string tag;
+                // position of the branch in the subscriber's log
+                uint64_t offset;
+            } SubscribedBranch;
+
+            // tells whether a branch no longer needs to be delivered (closed in the subscriber's region)
+            typedef std::function<bool(const std::string& bid)> ClosedBranchPredicate;
+
+            // consumers that do not belong to a group share the same cursor
+            static const uint64_t NO_MEMBER = 0;
+
+            // size of the buffered writes to the on-disk log (spill overflow policy)
+            static const size_t SPILL_BUFFER_SIZE = 64 * 1024;
+
+            // what happens to new branches when the queue is full
+            enum OverflowPolicy {
+                // skip the oldest branch not yet delivered to the slowest consumer
+                OVERFLOW_DROP_OLDEST,
+                // append new branches to an on-disk log until consumers catch up
+                OVERFLOW_SPILL,
+                // new branches are not queued (and monitored registrations are rejected)
+                OVERFLOW_REJECT
+            };
+
+            typedef struct QueueStatsStruct {
+                // number of branches added to the queue
+                uint64_t queued;
+                // number of branches lost due to overflows
+                uint64_t dropped;
+                // number of branches written to the on-disk log
+                uint64_t spilled;
+                // number of branches currently waiting in the in-memory queue
+                uint64_t depth;
+            } QueueStats;
 
         private:
-            std::queue<SubscribedBranch> _subscribed_branches;
+            typedef struct ConsumerGroupStruct {
+                // members in join order: the i-th member owns the bids whose rid hash (modulo size) is i
+                std::vector<uint64_t> members;
+                // <member id, offset of the next branch to be scanned>
+                std::unordered_map<uint64_t, uint64_t> cursors;
+            } ConsumerGroup;
+
+            // producers (publishers) push without locking while there is room, consumers drain the ring in batches
+            // a full ring makes producers take the consumer lock (drop_oldest) or the spill lock (spill)
+            utils::MPSCRing<SubscribedBranch> _subscribed_branches;
+            // protects the log, cursors and consumer groups
+            std::mutex _mutex_consumer;
+
+            // append-only log of drained branches, used to replay branches after reconnects
+            // retention: branches are removed from the front once they are closed
+            std::deque<SubscribedBranch> _log;
+            uint64_t _next_offset;
+            // offset of the next branch to be delivered to consumers without group
+            uint64_t _cursor;
+            // consumers without group that are still connected (the cursor only bounds retention while there are any)
+            int _num_shared_consumers;
+            const size_t _max_log_size;
+            ClosedBranchPredicate _is_closed;
+            // branches acked by consumers whose status is not known by the predicate (e.g., owned by other replicas)
+            std::unordered_set<std::string> _acked_bids;
+
+            // <group id, group>
+            std::unordered_map<std::string, ConsumerGroup> _groups;
+            // <member id, group id>
+            std::unordered_map<uint64_t, std::string> _members;
+            uint64_t _next_member_id;
+
+            // consumers are only woken up by producers when they are waiting for new branches
+            std::atomic<int> _num_waiting;
             std::mutex _mutex;
             std::condition_variable _cond;
             std::chrono::time_point<std::chrono::system_clock> _last_ts;
+            // connections being closed whose consumers must stop waiting (protected by _mutex)
+            std::unordered_set<grpc::ServerContext *> _cancelled_contexts;
 
             const int _subscribers_refresh_interval_s;
 
+            // overflow handling
+            const OverflowPolicy _overflow_policy;
+            std::atomic<uint64_t> _num_queued;
+            std::atomic<uint64_t> _num_dropped;
+            std::atomic<uint64_t> _num_spilled;
+
+            // on-disk log with one branch per line (<bid>\t<tag>)
+            // while it is not empty, new branches are also spilled to preserve ordering
+            const std::string _spill_path;
+            std::mutex _mutex_spill;
+            std::fstream _spill_file;
+            std::atomic<bool> _spilling;
+            size_t _spill_read_pos;
+            // end of the on-disk log, including the branches still buffered in memory
+            size_t _spill_write_pos;
+            // branches are written to disk in batches, once the buffer is full or consumers read them back
+            std::string _spill_buffer;
+            uint64_t _num_spill_buffered;
+
+            /**
+             * Append branch to the on-disk log (buffered)
+             * 
+             * @param subscribed_branch The branch
+             * @return true if branch was spilled and false otherwise
+             */
+            bool _spill(const SubscribedBranch& subscribed_branch);
+
+            /**
+             * Write the buffered branches to the on-disk log with a single seek and flush
+             * Buffered branches are counted as dropped if they cannot be written
+             * Caller must hold the spill lock
+             * 
+             * @return true if all buffered branches were written and false otherwise
+             */
+            bool _flushSpill();
+
+            /**
+             * Move branches from the on-disk log to the subscriber's log (truncates the file once it is consumed)
+             * Caller must hold the consumer lock
+             * 
+             * @param max_branches The maximum number of branches to be moved
+             * @return The number of moved branches
+             */
+            size_t _unspill(size_t max_branches);
+
+            /**
+             * Discard the oldest branch that was not delivered to the slowest consumer to make room for new branches
+             * Called by producers when the ring is full: takes the consumer lock and drains the ring into the log,
+             * so these producers wait for consumers that are scanning the log (and for each other) until there is room
+             */
+            void _dropOldest();
+
+            /**
+             * Move branches in the ring to the log and remove closed (or acked) branches from the front of the log
+             * Caller must hold the consumer lock
+             */
+            void _refreshLog();
+
+            /**
+             * Return the offset of the slowest consumer
+             * Caller must hold the consumer lock
+             */
+            uint64_t _getLowWatermark();
+
+            /**
+             * Wake up all waiting consumers so that they scan the log again
+             */
+            void _notifyConsumers();
+
+            /**
+             * Wait for new branches without holding the consumer lock
+             * 
+             * @param context The grpc context for the current connection
+             * @param lock_consumer The consumer lock held by the caller
+             * @return false if the context (or the subscription of the connection) was cancelled and true otherwise
+             */
+            bool _waitBranches(grpc::ServerContext * context, std::unique_lock<std::mutex>& lock_consumer);
+
+            /**
+             * Every member of the group restarts at the same offset after members join or leave
+             * 
+             * @param group The consumer group
+             * @param offset The offset where all members restart
+             */
+            void _rebalance(ConsumerGroup& group, uint64_t offset);
+
         public:
-            Subscriber(int subscribers_refresh_interval_s);
+            Subscriber(int subscribers_refresh_interval_s, int capacity, ClosedBranchPredicate is_closed = nullptr,
+                OverflowPolicy overflow_policy = OVERFLOW_DROP_OLDEST, const std::string& spill_path = "");
+
+            ~Subscriber();
+
+            /**
+             * Parse the name of an overflow policy (drop_oldest, spill or reject)
+             * 
+             * @param name The name of the policy
+             * @param overflow_policy Set to the parsed policy
+             * @return true if name is valid and false otherwise
+             */
+            static bool parseOverflowPolicy(const std::string& name, OverflowPolicy& overflow_policy);
 
             /**
              * Add branch to queue
              * 
              * @param branch The branch's bid
              * @param tag
+             * @return true if branch was added and false if the queue is full and the branch was dropped
              */
-            void push(const std::string& bid, const std::string& tag);
+            bool push(const std::string& bid, const std::string& tag);
 
             /**
              * Remove the branch from the queue. Blocks until a branch is available
@@ -49,6 +226,100 @@ namespace metadata {
              */
             SubscribedBranch pop(grpc::ServerContext * context);
 
+            /**
+             * Remove up to max_batch_size branches from the queue. Blocks until at least one branch is available
+             * @param context The grpc context for the current connection
+             * @param max_batch_size The maximum number of branches to be removed
+             * @param member_id The member of a consumer group (branches are partitioned among members)
+             * @return The removed branches (empty if context was cancelled)
+             */
+            std::vector<SubscribedBranch> popBatch(grpc::ServerContext * context, int max_batch_size, 
+                uint64_t member_id = NO_MEMBER);
+
+            /**
+             * Mark branches as acked by a consumer so that they can be removed from the log once delivered,
+             * even if the predicate does not report them as closed
+             * 
+             * @param bids The composed bids of the acked branches
+             */
+            void ack(const std::vector<std::string>& bids);
+
+            /**
+             * Stop delivering branches to the consumer of a connection that is being closed
+             * Wakes the consumer up if it is waiting for branches instead of letting it sleep until the refresh interval
+             * Must be followed by release(context) once the consumer returned
+             * 
+             * @param context The grpc context for the connection
+             */
+            void cancel(grpc::ServerContext * context);
+
+            /**
+             * Forget a connection previously cancelled
+             * 
+             * @param context The grpc context for the connection
+             */
+            void release(grpc::ServerContext * context);
+
+            /**
+             * Move the cursor to replay all retained branches starting at the given offset
+             * Registers a new consumer without group, which must call releaseCursor() once it is done
+             * 
+             * @param offset The offset of the next branch to be delivered (0 replays all retained branches)
+             * @return The offset where delivery is going to resume
+             */
+            uint64_t seek(uint64_t offset);
+
+            /**
+             * Remove a consumer without group registered by seek(offset)
+             * Once all of them are gone, the cursor no longer prevents delivered branches from being removed from the log
+             */
+            void releaseCursor();
+
+            /**
+             * Add a new member to a consumer group, which triggers a rebalance of the group
+             * 
+             * @param group_id The identifier of the group
+             * @param offset The offset where delivery starts if the group is new
+             * @return The identifier of the new member
+             */
+            uint64_t joinGroup(const std::string& group_id, uint64_t offset);
+
+            /**
+             * Remove a member from its consumer group, which triggers a rebalance of the group
+             * 
+             * @param member_id The identifier of the member
+             */
+            void leaveGroup(uint64_t member_id);
+
+            /**
+             * Return the number of members of a consumer group
+             */
+            int getGroupSize(const std::string& group_id);
+
+            /**
+             * Return the offset of the next branch to be delivered
+             * 
+             * @param member_id The member of a consumer group (or the shared cursor by default)
+             */
+            uint64_t getCursor(uint64_t member_id = NO_MEMBER);
+
+            /**
+             * Return the number of branches retained for replay
+             */
+            size_t getLogSize();
+
+            /**
+             * Check if the in-memory queue cannot take more branches
+             */
+            bool isFull();
+
+            OverflowPolicy getOverflowPolicy();
+
+            /**
+             * Return the counters of queued, dropped and spilled branches and the current queue depth
+             */
+            QueueStats getQueueStats();
+
             /**
              * Return timestamp of last active moment
              */
@@ -0,0 +1,187 @@
+#include "wait_trace.h"
+#include "spdlog/fmt/fmt.h"
+#include <random>
+
+using namespace metadata;
+using json = nlohmann::json;
+
+/**
+ * Generate a random id in hex with the size required by OTLP (16 bytes for traces and 8 for spans)
+ *
+ * @param num_bytes The size of the id
+ */
+static std::string genOtlpId(int num_bytes) {
+    thread_local std::mt19937_64 generator(std::random_device{}());
+    std::string id;
+    for (int i = 0; i < num_bytes; i += 8) {
+        id += fmt::format("{:016x}", generator());
+    }
+    return id.substr(0, num_bytes * 2);
+}
+
+static std::string unixNanos(std::chrono::system_clock::time_point ts) {
+    return std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(ts.time_since_epoch()).count());
+}
+
+static json stringAttribute(const std::string& key, const std::string& value) {
+    return {{"key", key}, {"value", {{"stringValue", value}}}};
+}
+
+static json intAttribute(const std::string& key, int value) {
+    // OTLP/JSON encodes 64-bit integers as strings
+    return {{"key", key}, {"value", {{"intValue", std::to_string(value)}}}};
+}
+
+static json arrayAttribute(const std::string& key, const std::vector<std::string>& values) {
+    json array = json::array();
+    for (const auto& value : values) {
+        array.push_back({{"stringValue", value}});
+    }
+    return {{"key", key}, {"value", {{"arrayValue", {{"values", array}}}}}};
+}
+
+WaitTrace::WaitTrace(const std::string& rid, const std::string& acsl_id)
+    : _rid(rid), _acsl_id(acsl_id), _start_ts(std::chrono::system_clock::now()),
+    _start_steady_ts(std::chrono::steady_clock::now()), _duration_ms(0), _result(0) {
+}
+
+double WaitTrace::_relativeMs(std::chrono::system_clock::time_point ts, std::chrono::system_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(ts - start).count();
+}
+
+void WaitTrace::setContext(const std::string& service, const std::string& region, const std::string& tag) {
+    _context = fmt::format("service={} region={} tag={}", service, region, tag);
+}
+
+void WaitTrace::addWakeup(const std::vector<std::pair<std::string, metadata::Branch*>>& blocking) {
+    Wakeup wakeup {std::chrono::system_clock::now(), _context, {}};
+    for (const auto& [bid, branch] : blocking) {
+        wakeup.blocking_bids.emplace_back(bid);
+        auto it = _branches.find(bid);
+        if (it == _branches.end()) {
+            _branches[bid] = BranchInfo {bid, branch->getService(), branch->getTag(), branch->getACSLID(),
+                branch->getRegions(), branch->getOpenedTs(), {}, 1};
+            _pending[bid] = branch;
+        }
+        else {
+            it->second.num_wakeups++;
+        }
+    }
+    _wakeups.emplace_back(std::move(wakeup));
+}
+
+void WaitTrace::finish(int result) {
+    _result = result;
+    _end_ts = std::chrono::system_clock::now();
+    _duration_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start_steady_ts).count();
+    for (const auto& [bid, branch] : _pending) {
+        _branches[bid].closed_ts = branch->getClosedTs();
+    }
+    _pending.clear();
+}
+
+int WaitTrace::getResult() {
+    return _result;
+}
+
+double WaitTrace::getDurationMs() {
+    return _duration_ms;
+}
+
+const std::vector<WaitTrace::Wakeup>& WaitTrace::getWakeups() {
+    return _wakeups;
+}
+
+const std::map<std::string, WaitTrace::BranchInfo>& WaitTrace::getBranches() {
+    return _branches;
+}
+
+void WaitTrace::toProto(rendezvous::WaitTraceSummary * summary) {
+    summary->set_duration_ms(_duration_ms);
+    summary->set_num_wakeups(_wakeups.size());
+    for (const auto& [bid, info] : _branches) {
+        rendezvous::BlockingBranch * branch = summary->add_blocking_branches();
+        branch->set_bid(bid);
+        branch->set_service(info.service);
+        branch->set_tag(info.tag);
+        branch->set_acsl(info.acsl_id);
+        for (const auto& region : info.regions) {
+            branch->add_regions(region);
+        }
+        branch->set_num_wakeups(info.num_wakeups);
+        branch->set_opened_ms(_relativeMs(info.opened_ts, _start_ts));
+        bool closed = info.closed_ts != std::chrono::system_clock::time_point();
+        branch->set_closed_ms(closed ? _relativeMs(info.closed_ts, _start_ts) : -1);
+    }
+}
+
+json WaitTrace::toOtlpJson(const std::string& sid) {
+    const std::string& trace_id = genOtlpId(16);
+    const std::string& root_span_id = genOtlpId(8);
+
+    // root span: wait call
+    json events = json::array();
+    for (const auto& wakeup : _wakeups) {
+        events.push_back({
+            {"timeUnixNano", unixNanos(wakeup.ts)},
+            {"name", "wakeup"},
+            {"attributes", {
+                stringAttribute("rendezvous.context", wakeup.context),
+                arrayAttribute("rendezvous.blocking_bids", wakeup.blocking_bids)}}
+        });
+    }
+    // OTLP status codes: 1 (OK) and 2 (ERROR)
+    json root_span = {
+        {"traceId", trace_id},
+        {"spanId", root_span_id},
+        {"name", "WaitRequest"},
+        // SPAN_KIND_SERVER
+        {"kind", 2},
+        {"startTimeUnixNano", unixNanos(_start_ts)},
+        {"endTimeUnixNano", unixNanos(_end_ts)},
+        {"attributes", {
+            stringAttribute("rendezvous.rid", _rid),
+            stringAttribute("rendezvous.acsl", _acsl_id),
+            intAttribute("rendezvous.result", _result),
+            intAttribute("rendezvous.num_wakeups", _wakeups.size())}},
+        {"events", events},
+        {"status", {{"code", _result >= 0 ? 1 : 2}}}
+    };
+
+    json spans = json::array();
+    spans.push_back(root_span);
+
+    // child spans: blocking branches (still opened branches end with the wait call)
+    for (const auto& [bid, info] : _branches) {
+        bool closed = info.closed_ts != std::chrono::system_clock::time_point();
+        spans.push_back({
+            {"traceId", trace_id},
+            {"spanId", genOtlpId(8)},
+            {"parentSpanId", root_span_id},
+            {"name", "Branch " + info.service},
+            // SPAN_KIND_INTERNAL
+            {"kind", 1},
+            {"startTimeUnixNano", unixNanos(info.opened_ts)},
+            {"endTimeUnixNano", unixNanos(closed ? info.closed_ts : _end_ts)},
+            {"attributes", {
+                stringAttribute("rendezvous.bid", bid),
+                stringAttribute("rendezvous.service", info.service),
+                stringAttribute("rendezvous.tag", info.tag),
+                stringAttribute("rendezvous.acsl", info.acsl_id),
+                arrayAttribute("rendezvous.regions", info.regions),
+                intAttribute("rendezvous.num_wakeups", info.num_wakeups),
+                {{"key", "rendezvous.closed"}, {"value", {{"boolValue", closed}}}}}}
+        });
+    }
+
+    json resource = {{"attributes", {
+        stringAttribute("service.name", "rendezvous"),
+        stringAttribute("service.instance.id", sid)}}};
+    json scope_spans = {
+        {"scope", {{"name", "rendezvous.wait"}}},
+        {"spans", spans}};
+    json resource_spans = {
+        {"resource", resource},
+        {"scopeSpans", json::array({scope_spans})}};
+    return {{"resourceSpans", json::array({resource_spans})}};
+}
@@ -0,0 +1,111 @@
+#ifndef WAIT_TRACE_H
+#define WAIT_TRACE_H
+
+#include "branch.h"
+#include "client.grpc.pb.h"
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace metadata {
+
+    /**
+     * Explains why a wait call blocked: records the branches blocking the call at each wakeup
+     * Each trace is owned by a single wait call so it is not thread-safe
+     */
+    class WaitTrace {
+
+        public:
+            typedef struct BranchInfoStruct {
+                std::string bid;
+                std::string service;
+                std::string tag;
+                std::string acsl_id;
+                std::vector<std::string> regions;
+                std::chrono::system_clock::time_point opened_ts;
+                // zero if the branch was still opened when the wait call returned
+                std::chrono::system_clock::time_point closed_ts;
+                // number of wakeups where the branch was blocking the call
+                int num_wakeups;
+            } BranchInfo;
+
+            typedef struct WakeupStruct {
+                std::chrono::system_clock::time_point ts;
+                // context (service, region and tag) being waited at the time of the wakeup
+                std::string context;
+                std::vector<std::string> blocking_bids;
+            } Wakeup;
+
+        private:
+            const std::string _rid;
+            const std::string _acsl_id;
+            const std::chrono::system_clock::time_point _start_ts;
+            const std::chrono::steady_clock::time_point _start_steady_ts;
+            std::chrono::system_clock::time_point _end_ts;
+            double _duration_ms;
+            int _result;
+            std::string _context;
+
+            std::vector<Wakeup> _wakeups;
+            // <bid, info> of all branches that blocked the call at least once
+            std::map<std::string, BranchInfo> _branches;
+            // <bid, branch> of blocking branches whose closed timestamp is only read when the call returns
+            std::map<std::string, metadata::Branch*> _pending;
+
+            static double _relativeMs(std::chrono::system_clock::time_point ts, std::chrono::system_clock::time_point start);
+
+        public:
+            WaitTrace(const std::string& rid, const std::string& acsl_id);
+
+            /**
+             * Set the context being waited (a single wait call can wait on multiple services)
+             *
+             * @param service The service context (can be empty)
+             * @param region The region context (can be empty)
+             * @param tag The tag of the service (can be empty)
+             */
+            void setContext(const std::string& service, const std::string& region, const std::string& tag);
+
+            /**
+             * Record the branches blocking the call
+             *
+             * @param blocking Pairs of <bid, branch> that are still opened
+             */
+            void addWakeup(const std::vector<std::pair<std::string, metadata::Branch*>>& blocking);
+
+            /**
+             * Stop the trace and read the closed timestamps of the blocking branches
+             * REMINDER: must be called while the request (and its branches) still exists
+             *
+             * @param result The result of the wait call
+             */
+            void finish(int result);
+
+            int getResult();
+            double getDurationMs();
+            const std::vector<Wakeup>& getWakeups();
+            const std::map<std::string, BranchInfo>& getBranches();
+
+            /**
+             * Fill the summary returned to clients
+             *
+             * @param summary The summary in the wait response
+             */
+            void toProto(rendezvous::WaitTraceSummary * summary);
+
+            /**
+             * Export the trace as an OTLP/JSON request (OpenTelemetry trace format):
+             * the wait call is the root span and each blocking branch is a child span
+             *
+             * @param sid The id of the replica (exported as service.instance.id)
+             * @return json with a single resourceSpans entry
+             */
+            nlohmann::json toOtlpJson(const std::string& sid);
+    };
+
+}
+
+#endif
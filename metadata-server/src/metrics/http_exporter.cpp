@@ -0,0 +1,135 @@
+#include "http_exporter.h"
+#include "spdlog/spdlog.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+using namespace metrics;
+
+HttpExporter::HttpExporter(Registry& registry, const std::string& host, int port)
+    : _registry(registry), _host(host), _port(port), _socket(-1), _running(false) {
+}
+
+HttpExporter::~HttpExporter() {
+    stop();
+}
+
+int HttpExporter::start() {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(_port);
+    if (inet_pton(AF_INET, _host.c_str(), &addr.sin_addr) != 1) {
+        spdlog::error("[METRICS] invalid address '{}'", _host);
+        return -1;
+    }
+
+    _socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (_socket == -1) {
+        spdlog::error("[METRICS] could not create socket: {}", strerror(errno));
+        return -1;
+    }
+    int reuse = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(_socket, (sockaddr *) &addr, sizeof(addr)) == -1 || listen(_socket, SOMAXCONN) == -1) {
+        spdlog::error("[METRICS] could not listen on {}:{}: {}", _host, _port, strerror(errno));
+        close(_socket);
+        _socket = -1;
+        return -1;
+    }
+
+    _running = true;
+    _thread = std::thread(&HttpExporter::_serve, this);
+    spdlog::info("Metrics exposed on http://{}:{}/metrics", _host, _port);
+    return 0;
+}
+
+void HttpExporter::stop() {
+    if (!_running.exchange(false)) {
+        return;
+    }
+    _thread.join();
+    close(_socket);
+    _socket = -1;
+}
+
+void HttpExporter::_serve() {
+    pollfd fd{_socket, POLLIN, 0};
+    while (_running) {
+        // wake up periodically to check if exporter was stopped
+        int ready = poll(&fd, 1, POLL_INTERVAL_MS);
+        if (ready <= 0) {
+            continue;
+        }
+        int connection = accept(_socket, nullptr, nullptr);
+        if (connection == -1) {
+            continue;
+        }
+        _handleConnection(connection);
+        close(connection);
+    }
+}
+
+static void sendAll(int connection, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(connection, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        sent += n;
+    }
+}
+
+void HttpExporter::_handleConnection(int connection) {
+    // prevent slow clients from blocking the exporter
+    timeval timeout{1, 0};
+    setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // only the request line and headers are read (requests have no body)
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_SIZE) {
+        ssize_t n = recv(connection, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            break;
+        }
+        request.append(buffer, n);
+    }
+
+    // FORMAT: <method> <path> <version>
+    std::string method, path;
+    size_t method_end = request.find(' ');
+    if (method_end != std::string::npos) {
+        method = request.substr(0, method_end);
+        size_t path_end = request.find(' ', method_end + 1);
+        if (path_end != std::string::npos) {
+            path = request.substr(method_end + 1, path_end - method_end - 1);
+        }
+    }
+
+    std::string status, content_type, body;
+    if (method != "GET") {
+        status = "405 Method Not Allowed";
+        content_type = "text/plain";
+        body = "method not allowed\n";
+    }
+    else if (path == "/metrics" || path.rfind("/metrics?", 0) == 0) {
+        status = "200 OK";
+        content_type = "text/plain; version=0.0.4; charset=utf-8";
+        body = _registry.serialize();
+    }
+    else {
+        status = "404 Not Found";
+        content_type = "text/plain";
+        body = "not found\n";
+    }
+
+    sendAll(connection, "HTTP/1.1 " + status + "\r\n"
+        "Content-Type: " + content_type + "\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "Connection: close\r\n\r\n" + body);
+}
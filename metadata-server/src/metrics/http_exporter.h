@@ -0,0 +1,49 @@
+#ifndef METRICS_HTTP_EXPORTER_H
+#define METRICS_HTTP_EXPORTER_H
+
+#include "metrics.h"
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace metrics {
+
+    /**
+     * Minimal HTTP server that exposes the metrics of a registry (GET /metrics) to Prometheus
+     * Scrapes are served sequentially by a single thread
+     */
+    class HttpExporter {
+
+        private:
+            static const int POLL_INTERVAL_MS = 200;
+            static const size_t MAX_REQUEST_SIZE = 8192;
+
+            Registry& _registry;
+            const std::string _host;
+            const int _port;
+            int _socket;
+            std::atomic<bool> _running;
+            std::thread _thread;
+
+            void _serve();
+            void _handleConnection(int connection);
+
+        public:
+            HttpExporter(Registry& registry, const std::string& host, int port);
+            ~HttpExporter();
+
+            /**
+             * Start listening for scrapes in the background
+             *
+             * @return 0 if exporter started and -1 otherwise
+             */
+            int start();
+
+            /**
+             * Stop listening for scrapes
+             */
+            void stop();
+    };
+}
+
+#endif
@@ -0,0 +1,115 @@
+#include "lock_profiler.h"
+#include "spdlog/fmt/fmt.h"
+#include <algorithm>
+
+using namespace metrics;
+
+// ---------
+// Lock Site
+//----------
+
+LockSite::LockSite(const std::string& name)
+    : _name(name), _acquisitions(0), _contentions(0), _wait_ns(0), _max_wait_ns(0), _hold_ns(0), _max_hold_ns(0) {
+}
+
+void LockSite::_updateMax(std::atomic<uint64_t>& max, uint64_t value) {
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed));
+}
+
+void LockSite::recordAcquisition() {
+    _acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void LockSite::recordContention(uint64_t wait_ns) {
+    _contentions.fetch_add(1, std::memory_order_relaxed);
+    _wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+    _updateMax(_max_wait_ns, wait_ns);
+}
+
+void LockSite::recordHold(uint64_t hold_ns) {
+    _hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
+    _updateMax(_max_hold_ns, hold_ns);
+}
+
+LockSite::Stats LockSite::getStats() const {
+    return Stats{_name, _acquisitions.load(), _contentions.load(), _wait_ns.load(), _max_wait_ns.load(),
+        _hold_ns.load(), _max_hold_ns.load()};
+}
+
+void LockSite::reset() {
+    _acquisitions = 0;
+    _contentions = 0;
+    _wait_ns = 0;
+    _max_wait_ns = 0;
+    _hold_ns = 0;
+    _max_hold_ns = 0;
+}
+
+// -------------
+// Lock Profiler
+//--------------
+
+LockProfiler& LockProfiler::get() {
+    static LockProfiler profiler;
+    return profiler;
+}
+
+LockSite * LockProfiler::getSite(const std::string& name) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto& site = _sites[name];
+    if (site == nullptr) {
+        site = std::make_unique<LockSite>(name);
+    }
+    return site.get();
+}
+
+std::vector<LockSite::Stats> LockProfiler::getStats() {
+    std::vector<LockSite::Stats> stats;
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (const auto& it : _sites) {
+        stats.emplace_back(it.second->getStats());
+    }
+    lock.unlock();
+    std::sort(stats.begin(), stats.end(), [](const LockSite::Stats& a, const LockSite::Stats& b) {
+        return a.wait_ns > b.wait_ns;
+    });
+    return stats;
+}
+
+void LockProfiler::reset() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (auto& it : _sites) {
+        it.second->reset();
+    }
+}
+
+std::string LockProfiler::dump() {
+    std::string out = fmt::format("{:<32} {:>12} {:>12} {:>8} {:>12} {:>12} {:>12} {:>12}\n",
+        "site", "acquisitions", "contentions", "cont(%)", "wait(ms)", "max wait(us)", "hold(ms)", "max hold(us)");
+    for (const auto& stats : getStats()) {
+        double contention = stats.acquisitions == 0 ? 0 : 100.0 * stats.contentions / stats.acquisitions;
+        out += fmt::format("{:<32} {:>12} {:>12} {:>8.2f} {:>12.3f} {:>12.1f} {:>12.3f} {:>12.1f}\n",
+            stats.name, stats.acquisitions, stats.contentions, contention,
+            stats.wait_ns / 1e6, stats.max_wait_ns / 1e3, stats.hold_ns / 1e6, stats.max_hold_ns / 1e3);
+    }
+    return out;
+}
+
+void LockProfiler::addMetrics(Registry& registry) {
+    auto collect = [this](const std::function<double(const LockSite::Stats&)>& value) {
+        std::vector<Registry::Sample> samples;
+        for (const auto& stats : getStats()) {
+            samples.push_back({{{"site", stats.name}}, value(stats)});
+        }
+        return samples;
+    };
+    registry.addCollector("rendezvous_lock_acquisitions_total", "Number of acquisitions of each lock site", "counter",
+        [collect]() { return collect([](const LockSite::Stats& stats) { return stats.acquisitions; }); });
+    registry.addCollector("rendezvous_lock_contentions_total", "Number of acquisitions that found the lock taken", "counter",
+        [collect]() { return collect([](const LockSite::Stats& stats) { return stats.contentions; }); });
+    registry.addCollector("rendezvous_lock_wait_seconds_total", "Time spent waiting to acquire each lock site", "counter",
+        [collect]() { return collect([](const LockSite::Stats& stats) { return stats.wait_ns / 1e9; }); });
+    registry.addCollector("rendezvous_lock_hold_seconds_total", "Time each lock site was held", "counter",
+        [collect]() { return collect([](const LockSite::Stats& stats) { return stats.hold_ns / 1e9; }); });
+}
@@ -0,0 +1,186 @@
+#ifndef METRICS_LOCK_PROFILER_H
+#define METRICS_LOCK_PROFILER_H
+
+#include "metrics.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace metrics {
+
+    /**
+     * Counters shared by all locks with the same name (e.g. the branches mutex of every request)
+     */
+    class LockSite {
+
+        public:
+            typedef struct StatsStruct {
+                std::string name;
+                uint64_t acquisitions;
+                // acquisitions that found the lock already taken
+                uint64_t contentions;
+                uint64_t wait_ns;
+                uint64_t max_wait_ns;
+                uint64_t hold_ns;
+                uint64_t max_hold_ns;
+            } Stats;
+
+        private:
+            const std::string _name;
+            std::atomic<uint64_t> _acquisitions;
+            std::atomic<uint64_t> _contentions;
+            std::atomic<uint64_t> _wait_ns;
+            std::atomic<uint64_t> _max_wait_ns;
+            std::atomic<uint64_t> _hold_ns;
+            std::atomic<uint64_t> _max_hold_ns;
+
+            static void _updateMax(std::atomic<uint64_t>& max, uint64_t value);
+
+        public:
+            LockSite(const std::string& name);
+
+            void recordAcquisition();
+            void recordContention(uint64_t wait_ns);
+            void recordHold(uint64_t hold_ns);
+            Stats getStats() const;
+            void reset();
+    };
+
+    /**
+     * Registry of lock sites of the process
+     */
+    class LockProfiler {
+
+        private:
+            std::mutex _mutex;
+            // <name, site>: sites are never deleted so locks keep pointers to them
+            std::unordered_map<std::string, std::unique_ptr<LockSite>> _sites;
+
+        public:
+            static LockProfiler& get();
+
+            /**
+             * Get (or create) lock site with the given name
+             */
+            LockSite * getSite(const std::string& name);
+
+            /**
+             * Return stats of all sites sorted by total wait time (highest first)
+             */
+            std::vector<LockSite::Stats> getStats();
+
+            /**
+             * Reset counters of all sites (e.g. after warmup)
+             */
+            void reset();
+
+            /**
+             * Format stats of all sites as a table
+             *
+             * @return The table with one line per site
+             */
+            std::string dump();
+
+            /**
+             * Expose stats of all sites as metrics
+             *
+             * @param registry The registry where metrics are exposed
+             */
+            void addMetrics(Registry& registry);
+    };
+
+    /**
+     * Mutex that records acquisition wait time, hold time and contention in a lock site
+     * It can wrap exclusive (std::mutex) and shared (std::shared_mutex) mutexes
+     */
+    template<typename M>
+    class ProfiledMutex {
+
+        private:
+            M _mutex;
+            LockSite * _site;
+            // only the exclusive owner writes it
+            std::chrono::steady_clock::time_point _acquired_ts;
+
+            static uint64_t _elapsedNs(std::chrono::steady_clock::time_point start) {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+
+            // shared owners are tracked per thread since the lock can be held by many threads at once
+            static std::vector<std::pair<const void*, std::chrono::steady_clock::time_point>>& _sharedAcquisitions() {
+                thread_local std::vector<std::pair<const void*, std::chrono::steady_clock::time_point>> acquisitions;
+                return acquisitions;
+            }
+
+        public:
+            explicit ProfiledMutex(const char * name) : _site(LockProfiler::get().getSite(name)) {
+            }
+
+            ProfiledMutex(const ProfiledMutex&) = delete;
+            ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+            void lock() {
+                if (!_mutex.try_lock()) {
+                    auto start_ts = std::chrono::steady_clock::now();
+                    _mutex.lock();
+                    _site->recordContention(_elapsedNs(start_ts));
+                }
+                _site->recordAcquisition();
+                _acquired_ts = std::chrono::steady_clock::now();
+            }
+
+            bool try_lock() {
+                if (!_mutex.try_lock()) {
+                    return false;
+                }
+                _site->recordAcquisition();
+                _acquired_ts = std::chrono::steady_clock::now();
+                return true;
+            }
+
+            void unlock() {
+                uint64_t hold_ns = _elapsedNs(_acquired_ts);
+                _mutex.unlock();
+                _site->recordHold(hold_ns);
+            }
+
+            void lock_shared() {
+                if (!_mutex.try_lock_shared()) {
+                    auto start_ts = std::chrono::steady_clock::now();
+                    _mutex.lock_shared();
+                    _site->recordContention(_elapsedNs(start_ts));
+                }
+                _site->recordAcquisition();
+                _sharedAcquisitions().emplace_back(this, std::chrono::steady_clock::now());
+            }
+
+            bool try_lock_shared() {
+                if (!_mutex.try_lock_shared()) {
+                    return false;
+                }
+                _site->recordAcquisition();
+                _sharedAcquisitions().emplace_back(this, std::chrono::steady_clock::now());
+                return true;
+            }
+
+            void unlock_shared() {
+                auto& acquisitions = _sharedAcquisitions();
+                for (auto it = acquisitions.rbegin(); it != acquisitions.rend(); ++it) {
+                    if (it->first == this) {
+                        _site->recordHold(_elapsedNs(it->second));
+                        acquisitions.erase(std::next(it).base());
+                        break;
+                    }
+                }
+                _mutex.unlock_shared();
+            }
+    };
+}
+
+#endif
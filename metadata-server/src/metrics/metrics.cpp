@@ -0,0 +1,289 @@
+#include "metrics.h"
+#include "spdlog/fmt/fmt.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace metrics;
+
+int metrics::shardIndex() {
+    static std::atomic<int> next_shard(0);
+    thread_local int shard = next_shard.fetch_add(1, std::memory_order_relaxed) % NUM_SHARDS;
+    return shard;
+}
+
+double metrics::elapsedSeconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// -------
+// Metrics
+//--------
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& shard : _shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+int64_t Gauge::value() const {
+    int64_t total = 0;
+    for (const auto& shard : _shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+Histogram::Histogram(const std::vector<double>& bounds) : _bounds(bounds) {
+    for (auto& shard : _shards) {
+        // last bucket is +Inf
+        shard.buckets = std::make_unique<std::atomic<uint64_t>[]>(_bounds.size() + 1);
+        for (size_t i = 0; i <= _bounds.size(); i++) {
+            shard.buckets[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void Histogram::observe(double value) {
+    // first bucket whose upper bound is not lower than the value
+    size_t index = std::lower_bound(_bounds.begin(), _bounds.end(), value) - _bounds.begin();
+    Shard& shard = _shards[shardIndex()];
+    shard.buckets[index].fetch_add(1, std::memory_order_relaxed);
+    shard.sum_ns.fetch_add((uint64_t) std::llround(std::max(value, 0.0) * 1e9), std::memory_order_relaxed);
+}
+
+const std::vector<double>& Histogram::getBounds() const {
+    return _bounds;
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot snapshot{std::vector<uint64_t>(_bounds.size() + 1, 0), 0, 0};
+    uint64_t sum_ns = 0;
+    for (const auto& shard : _shards) {
+        for (size_t i = 0; i <= _bounds.size(); i++) {
+            snapshot.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+        }
+        sum_ns += shard.sum_ns.load(std::memory_order_relaxed);
+    }
+    // buckets are exposed as cumulative counts and the total count must match the +Inf bucket
+    for (size_t i = 1; i <= _bounds.size(); i++) {
+        snapshot.buckets[i] += snapshot.buckets[i - 1];
+    }
+    snapshot.count = snapshot.buckets.back();
+    snapshot.sum = sum_ns / 1e9;
+    return snapshot;
+}
+
+ScopedTimer::ScopedTimer(Histogram * histogram)
+    : _histogram(histogram), _start(std::chrono::steady_clock::now()) {
+}
+
+ScopedTimer::~ScopedTimer() {
+    if (_histogram != nullptr) {
+        _histogram->observe(elapsed());
+    }
+}
+
+double ScopedTimer::elapsed() const {
+    return elapsedSeconds(_start);
+}
+
+// --------
+// Registry
+//---------
+
+Registry::Registry() : _next_collector_id(0) {
+}
+
+Registry& Registry::get() {
+    static Registry registry;
+    return registry;
+}
+
+Registry::Family * Registry::_getFamily(const std::string& name, const std::string& help, const std::string& type) {
+    auto it = _families.find(name);
+    if (it == _families.end()) {
+        it = _families.emplace(name, Family{help, type, {}, {}, {}}).first;
+    }
+    else if (it->second.type != type) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+Counter * Registry::counter(const std::string& name, const std::string& help, const Labels& labels) {
+    const std::string& key = _serializeLabels(labels);
+    std::shared_lock<std::shared_mutex> read_lock(_mutex);
+    auto family_it = _families.find(name);
+    if (family_it != _families.end()) {
+        auto it = family_it->second.counters.find(key);
+        if (it != family_it->second.counters.end()) {
+            return it->second.get();
+        }
+    }
+    read_lock.unlock();
+
+    std::unique_lock<std::shared_mutex> write_lock(_mutex);
+    Family * family = _getFamily(name, help, "counter");
+    if (family == nullptr) {
+        return nullptr;
+    }
+    auto& metric = family->counters[key];
+    if (metric == nullptr) {
+        metric = std::make_unique<Counter>();
+    }
+    return metric.get();
+}
+
+Gauge * Registry::gauge(const std::string& name, const std::string& help, const Labels& labels) {
+    const std::string& key = _serializeLabels(labels);
+    std::shared_lock<std::shared_mutex> read_lock(_mutex);
+    auto family_it = _families.find(name);
+    if (family_it != _families.end()) {
+        auto it = family_it->second.gauges.find(key);
+        if (it != family_it->second.gauges.end()) {
+            return it->second.get();
+        }
+    }
+    read_lock.unlock();
+
+    std::unique_lock<std::shared_mutex> write_lock(_mutex);
+    Family * family = _getFamily(name, help, "gauge");
+    if (family == nullptr) {
+        return nullptr;
+    }
+    auto& metric = family->gauges[key];
+    if (metric == nullptr) {
+        metric = std::make_unique<Gauge>();
+    }
+    return metric.get();
+}
+
+Histogram * Registry::histogram(const std::string& name, const std::string& help, const Labels& labels,
+    const std::vector<double>& bounds) {
+
+    const std::string& key = _serializeLabels(labels);
+    std::shared_lock<std::shared_mutex> read_lock(_mutex);
+    auto family_it = _families.find(name);
+    if (family_it != _families.end()) {
+        auto it = family_it->second.histograms.find(key);
+        if (it != family_it->second.histograms.end()) {
+            return it->second.get();
+        }
+    }
+    read_lock.unlock();
+
+    std::unique_lock<std::shared_mutex> write_lock(_mutex);
+    Family * family = _getFamily(name, help, "histogram");
+    if (family == nullptr) {
+        return nullptr;
+    }
+    auto& metric = family->histograms[key];
+    if (metric == nullptr) {
+        metric = std::make_unique<Histogram>(bounds);
+    }
+    return metric.get();
+}
+
+int Registry::addCollector(const std::string& name, const std::string& help, const std::string& type, Collector collector) {
+    std::unique_lock<std::mutex> lock(_mutex_collectors);
+    int id = _next_collector_id++;
+    _collectors[id] = CollectorEntry{name, help, type, collector};
+    return id;
+}
+
+void Registry::removeCollector(int id) {
+    std::unique_lock<std::mutex> lock(_mutex_collectors);
+    _collectors.erase(id);
+}
+
+// -------------
+// Serialization
+//--------------
+
+std::string Registry::_escape(const std::string& value) {
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\') escaped += "\\\\";
+        else if (c == '"') escaped += "\\\"";
+        else if (c == '\n') escaped += "\\n";
+        else escaped += c;
+    }
+    return escaped;
+}
+
+// FORMAT: name_1="value_1",...,name_n="value_n"
+std::string Registry::_serializeLabels(const Labels& labels) {
+    std::string serialized;
+    for (const auto& label : labels) {
+        if (!serialized.empty()) {
+            serialized += ',';
+        }
+        serialized += label.first + "=\"" + _escape(label.second) + '"';
+    }
+    return serialized;
+}
+
+std::string Registry::_formatValue(double value) {
+    if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    return fmt::format("{}", value);
+}
+
+static void appendSample(std::string& out, const std::string& name, const std::string& labels, const std::string& value) {
+    out += name;
+    if (!labels.empty()) {
+        out += '{' + labels + '}';
+    }
+    out += ' ' + value + '\n';
+}
+
+std::string Registry::serialize() {
+    std::string out;
+    std::shared_lock<std::shared_mutex> read_lock(_mutex);
+
+    for (const auto& family_it : _families) {
+        const std::string& name = family_it.first;
+        const Family& family = family_it.second;
+        out += "# HELP " + name + ' ' + family.help + '\n';
+        out += "# TYPE " + name + ' ' + family.type + '\n';
+
+        for (const auto& it : family.counters) {
+            appendSample(out, name, it.first, std::to_string(it.second->value()));
+        }
+        for (const auto& it : family.gauges) {
+            appendSample(out, name, it.first, std::to_string(it.second->value()));
+        }
+        for (const auto& it : family.histograms) {
+            const std::vector<double>& bounds = it.second->getBounds();
+            Histogram::Snapshot snapshot = it.second->snapshot();
+            const std::string& separator = it.first.empty() ? "" : ",";
+            for (size_t i = 0; i <= bounds.size(); i++) {
+                const std::string& le = i < bounds.size() ? _formatValue(bounds[i]) : "+Inf";
+                appendSample(out, name + "_bucket", it.first + separator + "le=\"" + le + '"',
+                    std::to_string(snapshot.buckets[i]));
+            }
+            appendSample(out, name + "_sum", it.first, _formatValue(snapshot.sum));
+            appendSample(out, name + "_count", it.first, std::to_string(snapshot.count));
+        }
+    }
+    read_lock.unlock();
+
+    // collectors may acquire locks of their own so they must not block the creation of metrics
+    std::unique_lock<std::mutex> lock(_mutex_collectors);
+    for (const auto& it : _collectors) {
+        const CollectorEntry& entry = it.second;
+        out += "# HELP " + entry.name + ' ' + entry.help + '\n';
+        out += "# TYPE " + entry.name + ' ' + entry.type + '\n';
+        for (const auto& sample : entry.collector()) {
+            appendSample(out, entry.name, _serializeLabels(sample.labels), _formatValue(sample.value));
+        }
+    }
+    return out;
+}
@@ -0,0 +1,239 @@
+#ifndef METRICS_METRICS_H
+#define METRICS_METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../utils/cache_line.h"
+
+namespace metrics {
+
+    // <label name, label value>
+    typedef std::vector<std::pair<std::string, std::string>> Labels;
+
+    // values are spread among shards to prevent threads from contending for the same cache line
+    static const int NUM_SHARDS = 16;
+
+    /**
+     * Return the shard assigned to the current thread (threads are assigned in a round-robin fashion)
+     */
+    int shardIndex();
+
+    /**
+     * Return the seconds elapsed since a given instant (used for observing durations)
+     */
+    double elapsedSeconds(std::chrono::steady_clock::time_point start);
+
+    /**
+     * Monotonic counter updated without locks
+     */
+    class Counter {
+
+        private:
+            struct alignas(utils::CACHE_LINE_SIZE) Shard {
+                std::atomic<uint64_t> value{0};
+            };
+            Shard _shards[NUM_SHARDS];
+
+        public:
+            void inc(uint64_t value = 1) {
+                _shards[shardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+            }
+
+            uint64_t value() const;
+    };
+
+    /**
+     * Value that goes up and down (e.g. number of live objects) updated without locks
+     */
+    class Gauge {
+
+        private:
+            struct alignas(utils::CACHE_LINE_SIZE) Shard {
+                std::atomic<int64_t> value{0};
+            };
+            Shard _shards[NUM_SHARDS];
+
+        public:
+            void add(int64_t value) {
+                _shards[shardIndex()].value.fetch_add(value, std::memory_order_relaxed);
+            }
+
+            void inc() {
+                add(1);
+            }
+
+            void dec() {
+                add(-1);
+            }
+
+            int64_t value() const;
+    };
+
+    /**
+     * Distribution of durations (in seconds) over fixed buckets updated without locks
+     */
+    class Histogram {
+
+        public:
+            typedef struct SnapshotStruct {
+                // cumulative counts for each upper bound (the last one is +Inf)
+                std::vector<uint64_t> buckets;
+                uint64_t count;
+                double sum;
+            } Snapshot;
+
+        private:
+            struct alignas(utils::CACHE_LINE_SIZE) Shard {
+                std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+                // sum is kept in nanoseconds since there is no atomic addition for doubles
+                std::atomic<uint64_t> sum_ns{0};
+            };
+
+            const std::vector<double> _bounds;
+            Shard _shards[NUM_SHARDS];
+
+        public:
+            Histogram(const std::vector<double>& bounds);
+
+            /**
+             * Record a new observation
+             *
+             * @param value The observed duration in seconds
+             */
+            void observe(double value);
+
+            const std::vector<double>& getBounds() const;
+            Snapshot snapshot() const;
+    };
+
+    /**
+     * Record the lifetime of the timer in a histogram
+     */
+    class ScopedTimer {
+
+        private:
+            Histogram * _histogram;
+            const std::chrono::steady_clock::time_point _start;
+
+        public:
+            explicit ScopedTimer(Histogram * histogram);
+            ~ScopedTimer();
+
+            // seconds elapsed since the timer was created
+            double elapsed() const;
+    };
+
+    // from 50us to 30s
+    static const std::vector<double> DEFAULT_DURATION_BOUNDS = {
+        0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30
+    };
+
+    /**
+     * Holds all metrics of the process and serializes them in the Prometheus text format
+     */
+    class Registry {
+
+        public:
+            // Helper structure for values computed when metrics are collected
+            typedef struct SampleStruct {
+                Labels labels;
+                double value;
+            } Sample;
+
+            typedef std::function<std::vector<Sample>()> Collector;
+
+        private:
+            typedef struct FamilyStruct {
+                std::string help;
+                std::string type;
+                // <serialized labels, metric>
+                std::map<std::string, std::unique_ptr<Counter>> counters;
+                std::map<std::string, std::unique_ptr<Gauge>> gauges;
+                std::map<std::string, std::unique_ptr<Histogram>> histograms;
+            } Family;
+
+            typedef struct CollectorEntryStruct {
+                std::string name;
+                std::string help;
+                std::string type;
+                Collector collector;
+            } CollectorEntry;
+
+            // sorted by name for a stable output
+            std::map<std::string, Family> _families;
+            std::shared_mutex _mutex;
+            std::map<int, CollectorEntry> _collectors;
+            std::mutex _mutex_collectors;
+            int _next_collector_id;
+
+            /**
+             * Find or create family of metrics
+             * Caller must hold the write lock
+             *
+             * @return nullptr if family already exists with another type
+             */
+            Family * _getFamily(const std::string& name, const std::string& help, const std::string& type);
+
+            static std::string _serializeLabels(const Labels& labels);
+            static std::string _escape(const std::string& value);
+            static std::string _formatValue(double value);
+
+        public:
+            Registry();
+
+            /**
+             * Return registry shared by the whole process
+             */
+            static Registry& get();
+
+            /**
+             * Get (or create) metric of a family for the given labels
+             * Metrics are never deleted so the returned pointers can be cached
+             *
+             * @param name The name of the family
+             * @param help The description of the family
+             * @param labels The labels that identify the metric in the family
+             * @return The metric or nullptr if family already exists with another type
+             */
+            Counter * counter(const std::string& name, const std::string& help, const Labels& labels = {});
+            Gauge * gauge(const std::string& name, const std::string& help, const Labels& labels = {});
+            Histogram * histogram(const std::string& name, const std::string& help, const Labels& labels = {},
+                const std::vector<double>& bounds = DEFAULT_DURATION_BOUNDS);
+
+            /**
+             * Register a function that computes samples of a family (of gauges or counters) when metrics are collected
+             *
+             * @param name The name of the family
+             * @param help The description of the family
+             * @param type Either "gauge" or "counter"
+             * @param collector Function returning the current samples (must not create metrics)
+             * @return The identifier of the collector (used for removing it)
+             */
+            int addCollector(const std::string& name, const std::string& help, const std::string& type, Collector collector);
+
+            /**
+             * Remove collector previously added
+             *
+             * @param id The identifier of the collector
+             */
+            void removeCollector(int id);
+
+            /**
+             * Serialize all metrics in the Prometheus text exposition format
+             *
+             * @return The text exposition
+             */
+            std::string serialize();
+    };
+}
+
+#endif
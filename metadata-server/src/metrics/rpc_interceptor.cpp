@@ -0,0 +1,85 @@
+#include "rpc_interceptor.h"
+
+using namespace metrics;
+
+static const char * CODE_NAMES[NUM_STATUS_CODES] = {
+    "OK", "CANCELLED", "UNKNOWN", "INVALID_ARGUMENT", "DEADLINE_EXCEEDED", "NOT_FOUND", "ALREADY_EXISTS",
+    "PERMISSION_DENIED", "RESOURCE_EXHAUSTED", "FAILED_PRECONDITION", "ABORTED", "OUT_OF_RANGE",
+    "UNIMPLEMENTED", "INTERNAL", "UNAVAILABLE", "DATA_LOSS", "UNAUTHENTICATED"
+};
+
+RpcInterceptor::RpcInterceptor(Registry& registry, MethodMetrics * metrics)
+    : _registry(registry), _metrics(metrics), _start(std::chrono::steady_clock::now()) {
+}
+
+void RpcInterceptor::Intercept(grpc::experimental::InterceptorBatchMethods * methods) {
+    if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_STATUS)) {
+        _metrics->latency->observe(elapsedSeconds(_start));
+
+        int code = methods->GetSendStatus().error_code();
+        if (code < 0 || code >= NUM_STATUS_CODES) {
+            code = grpc::StatusCode::UNKNOWN;
+        }
+        // concurrent first uses get the same counter from the registry
+        Counter * handled = _metrics->handled[code].load(std::memory_order_acquire);
+        if (handled == nullptr) {
+            handled = _registry.counter("rendezvous_rpc_handled_total", "Number of served RPCs by status code",
+                {{"service", _metrics->service}, {"method", _metrics->method}, {"code", CODE_NAMES[code]}});
+            _metrics->handled[code].store(handled, std::memory_order_release);
+        }
+        handled->inc();
+    }
+    methods->Proceed();
+}
+
+RpcInterceptorFactory::RpcInterceptorFactory(Registry& registry, const std::vector<std::string>& services)
+    : _registry(registry) {
+
+    const google::protobuf::DescriptorPool * pool = google::protobuf::DescriptorPool::generated_pool();
+    for (const auto& service : services) {
+        const google::protobuf::ServiceDescriptor * descriptor = pool->FindServiceByName(service);
+        if (descriptor == nullptr) {
+            continue;
+        }
+        for (int i = 0; i < descriptor->method_count(); i++) {
+            auto metrics = _buildMethodMetrics("/" + service + "/" + descriptor->method(i)->name());
+            std::string_view full_method = metrics->full_method;
+            _methods.emplace(full_method, std::move(metrics));
+        }
+    }
+}
+
+std::unique_ptr<MethodMetrics> RpcInterceptorFactory::_buildMethodMetrics(const std::string& full_method) {
+    auto metrics = std::make_unique<MethodMetrics>();
+    metrics->full_method = full_method;
+
+    // FORMAT: /<package>.<service>/<method>
+    size_t delimiter = full_method.rfind('/');
+    if (delimiter != std::string::npos && delimiter > 0) {
+        metrics->service = full_method.substr(1, delimiter - 1);
+        metrics->method = full_method.substr(delimiter + 1);
+    }
+    else {
+        metrics->method = full_method;
+    }
+    metrics->latency = _registry.histogram("rendezvous_rpc_duration_seconds", "Latency of served RPCs",
+        {{"service", metrics->service}, {"method", metrics->method}});
+    for (auto& handled : metrics->handled) {
+        handled.store(nullptr);
+    }
+    return metrics;
+}
+
+grpc::experimental::Interceptor * RpcInterceptorFactory::CreateServerInterceptor(grpc::experimental::ServerRpcInfo * info) {
+    auto it = _methods.find(info->method());
+    if (it != _methods.end()) {
+        return new RpcInterceptor(_registry, it->second.get());
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex_other_methods);
+    auto& metrics = _other_methods[info->method()];
+    if (metrics == nullptr) {
+        metrics = _buildMethodMetrics(info->method());
+    }
+    return new RpcInterceptor(_registry, metrics.get());
+}
@@ -0,0 +1,84 @@
+#ifndef METRICS_RPC_INTERCEPTOR_H
+#define METRICS_RPC_INTERCEPTOR_H
+
+#include "metrics.h"
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/support/server_interceptor.h>
+#include <google/protobuf/descriptor.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace metrics {
+
+    // number of grpc status codes (OK to UNAUTHENTICATED)
+    static const int NUM_STATUS_CODES = 17;
+
+    /**
+     * Metrics of a served method, looked up in the registry once and shared by all its RPCs
+     */
+    typedef struct MethodMetricsStruct {
+        // FORMAT: /<package>.<service>/<method>
+        std::string full_method;
+        std::string service;
+        std::string method;
+        Histogram * latency;
+        // registered on first use so that only status codes that were returned are exported
+        std::atomic<Counter *> handled[NUM_STATUS_CODES];
+    } MethodMetrics;
+
+    /**
+     * Records the latency and status code of every RPC served by the gRPC server
+     * (streaming RPCs are measured until the stream is closed)
+     */
+    class RpcInterceptor : public grpc::experimental::Interceptor {
+
+        private:
+            Registry& _registry;
+            MethodMetrics * _metrics;
+            const std::chrono::steady_clock::time_point _start;
+
+        public:
+            RpcInterceptor(Registry& registry, MethodMetrics * metrics);
+
+            void Intercept(grpc::experimental::InterceptorBatchMethods * methods) override;
+    };
+
+    class RpcInterceptorFactory : public grpc::experimental::ServerInterceptorFactoryInterface {
+
+        private:
+            Registry& _registry;
+
+            // <full method, metrics> for all methods of the served services (read-only after construction)
+            std::unordered_map<std::string_view, std::unique_ptr<MethodMetrics>> _methods;
+
+            // methods that are not part of the served services (e.g. unimplemented ones)
+            std::mutex _mutex_other_methods;
+            std::unordered_map<std::string, std::unique_ptr<MethodMetrics>> _other_methods;
+
+            /**
+             * Look up the metrics of a method in the registry
+             *
+             * @param full_method The method (FORMAT: /<package>.<service>/<method>)
+             * @return The metrics of the method
+             */
+            std::unique_ptr<MethodMetrics> _buildMethodMetrics(const std::string& full_method);
+
+        public:
+            /**
+             * Look up the metrics of all methods of the served services so that RPCs do not access the registry
+             *
+             * @param registry
+             * @param services Full names of the served services (e.g. rendezvous.ClientService)
+             */
+            RpcInterceptorFactory(Registry& registry, const std::vector<std::string>& services);
+
+            grpc::experimental::Interceptor * CreateServerInterceptor(grpc::experimental::ServerRpcInfo * info) override;
+    };
+}
+
+#endif
@@ -0,0 +1,205 @@
+#include "rpc_recorder.h"
+#include <google/protobuf/util/delimited_message_util.h>
+#include "spdlog/spdlog.h"
+
+using namespace metrics;
+
+static const std::string CLIENT_SERVICE_PREFIX = "/rendezvous.ClientService/";
+
+// time the writer sleeps when there are no records to be written
+static const std::chrono::milliseconds WRITER_IDLE_INTERVAL(5);
+
+// -------------
+// RPC Recorder
+//--------------
+
+RpcRecorder::RpcRecorder(const std::string& filename, size_t queue_size)
+    : _file(filename, std::ios::out | std::ios::binary | std::ios::trunc),
+    _start(std::chrono::steady_clock::now()), _queue(queue_size), _running(true) {
+
+    Registry& registry = Registry::get();
+    _recorded = registry.counter("rendezvous_rpc_trace_records_total", "Number of RPCs written to the trace file",
+        {{"outcome", "recorded"}});
+    _dropped = registry.counter("rendezvous_rpc_trace_records_total", "Number of RPCs written to the trace file",
+        {{"outcome", "dropped"}});
+
+    if (!_file.is_open()) {
+        spdlog::error("[RPC TRACE] could not open '{}'", filename);
+        _running = false;
+        return;
+    }
+    _file.write(RPC_TRACE_MAGIC.data(), RPC_TRACE_MAGIC.size());
+    _writer = std::thread(&RpcRecorder::_write, this);
+}
+
+RpcRecorder::~RpcRecorder() {
+    _running = false;
+    if (_writer.joinable()) {
+        _writer.join();
+    }
+}
+
+bool RpcRecorder::isOpen() {
+    return _file.is_open();
+}
+
+int64_t RpcRecorder::elapsedUs(std::chrono::steady_clock::time_point ts) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(ts - _start).count();
+}
+
+bool RpcRecorder::record(std::unique_ptr<rendezvous::TraceRecord> record) {
+    if (!_running || !_queue.tryPush(std::move(record))) {
+        _dropped->inc();
+        return false;
+    }
+    return true;
+}
+
+void RpcRecorder::_write() {
+    std::unique_ptr<rendezvous::TraceRecord> record;
+    while (true) {
+        if (_queue.tryPop(record)) {
+            google::protobuf::util::SerializeDelimitedToOstream(*record, &_file);
+            _recorded->inc();
+            continue;
+        }
+        // only stop after the queue is drained
+        if (!_running) {
+            break;
+        }
+        // records are flushed when the server is idle so that a killed server loses as few as possible
+        _file.flush();
+        std::this_thread::sleep_for(WRITER_IDLE_INTERVAL);
+    }
+    _file.flush();
+}
+
+// -------------------------
+// RPC Recorder Interceptor
+//--------------------------
+
+RpcRecorderInterceptor::RpcRecorderInterceptor(RpcRecorder& recorder, const std::string& method)
+    : _recorder(recorder), _start(std::chrono::steady_clock::now()), _method(method),
+    _record(std::make_unique<rendezvous::TraceRecord>()) {
+    _record->set_arrival_us(_recorder.elapsedUs(_start));
+}
+
+void RpcRecorderInterceptor::_copyRequest(const void * message) {
+    if (_method == "RegisterRequest") {
+        _record->mutable_register_request()->CopyFrom(*static_cast<const rendezvous::RegisterRequestMessage*>(message));
+    }
+    else if (_method == "RegisterBranch") {
+        _record->mutable_register_branch()->CopyFrom(*static_cast<const rendezvous::RegisterBranchMessage*>(message));
+    }
+    else if (_method == "RegisterBranches") {
+        _record->mutable_register_branches()->CopyFrom(*static_cast<const rendezvous::RegisterBranchesMessage*>(message));
+    }
+    else if (_method == "CloseBranch") {
+        _record->mutable_close_branch()->CopyFrom(*static_cast<const rendezvous::CloseBranchMessage*>(message));
+    }
+    else if (_method == "WaitRequest") {
+        _record->mutable_wait_request()->CopyFrom(*static_cast<const rendezvous::WaitRequestMessage*>(message));
+    }
+    else if (_method == "CheckStatus") {
+        _record->mutable_check_status()->CopyFrom(*static_cast<const rendezvous::CheckStatusMessage*>(message));
+    }
+    else if (_method == "FetchDependencies") {
+        _record->mutable_fetch_dependencies()->CopyFrom(*static_cast<const rendezvous::FetchDependenciesMessage*>(message));
+    }
+}
+
+void RpcRecorderInterceptor::_copyResponse(const void * message) {
+    if (_method == "RegisterRequest") {
+        _record->set_rid(static_cast<const rendezvous::RegisterRequestResponse*>(message)->rid());
+    }
+    else if (_method == "RegisterBranch") {
+        const auto * response = static_cast<const rendezvous::RegisterBranchResponse*>(message);
+        _record->set_rid(response->rid());
+        _record->add_bids(response->bid());
+    }
+    else if (_method == "RegisterBranches") {
+        const auto * response = static_cast<const rendezvous::RegisterBranchesResponse*>(message);
+        _record->set_rid(response->rid());
+        _record->mutable_bids()->CopyFrom(response->bids());
+    }
+    else if (_method == "WaitRequest") {
+        const auto * response = static_cast<const rendezvous::WaitRequestResponse*>(message);
+        _record->set_prevented_inconsistency(response->prevented_inconsistency());
+        _record->set_timed_out(response->timed_out());
+    }
+}
+
+void RpcRecorderInterceptor::Intercept(grpc::experimental::InterceptorBatchMethods * methods) {
+    // hook points of the same batch are handled in the order of the call
+    if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::POST_RECV_MESSAGE)) {
+        const void * message = methods->GetRecvMessage();
+        if (message != nullptr) {
+            _copyRequest(message);
+        }
+    }
+    if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_MESSAGE)) {
+        const void * message = methods->GetSendMessage();
+        if (message != nullptr) {
+            _copyResponse(message);
+        }
+    }
+    if (methods->QueryInterceptionHookPoint(grpc::experimental::InterceptionHookPoints::PRE_SEND_STATUS) && _record != nullptr) {
+        _record->set_code(methods->GetSendStatus().error_code());
+        _record->set_duration_us(_recorder.elapsedUs(std::chrono::steady_clock::now()) - _record->arrival_us());
+        _recorder.record(std::move(_record));
+    }
+    methods->Proceed();
+}
+
+RpcRecorderInterceptorFactory::RpcRecorderInterceptorFactory(RpcRecorder& recorder) : _recorder(recorder) {
+}
+
+grpc::experimental::Interceptor * RpcRecorderInterceptorFactory::CreateServerInterceptor(grpc::experimental::ServerRpcInfo * info) {
+    // FORMAT: /<package>.<service>/<method>
+    std::string full_method = info->method();
+    if (full_method.rfind(CLIENT_SERVICE_PREFIX, 0) != 0) {
+        return nullptr;
+    }
+    std::string method = full_method.substr(CLIENT_SERVICE_PREFIX.size());
+    if (method == "Subscribe" || method == "Monitor" || method == "Stats") {
+        return nullptr;
+    }
+    return new RpcRecorderInterceptor(_recorder, method);
+}
+
+// -----------------
+// RPC Trace Reader
+//------------------
+
+RpcTraceReader::RpcTraceReader(const std::string& filename)
+    : _file(filename, std::ios::in | std::ios::binary), _valid(false) {
+
+    if (!_file.is_open()) {
+        return;
+    }
+    std::string magic(RPC_TRACE_MAGIC.size(), '\0');
+    _file.read(&magic[0], magic.size());
+    if (!_file || magic != RPC_TRACE_MAGIC) {
+        return;
+    }
+    _input = std::make_unique<google::protobuf::io::IstreamInputStream>(&_file);
+    _valid = true;
+}
+
+bool RpcTraceReader::isValid() {
+    return _valid;
+}
+
+bool RpcTraceReader::next(rendezvous::TraceRecord& record) {
+    if (!_valid) {
+        return false;
+    }
+    record.Clear();
+    bool clean_eof = false;
+    if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(&record, _input.get(), &clean_eof)) {
+        // a truncated last record (e.g. server killed while writing) ends the trace
+        _valid = false;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,134 @@
+#ifndef METRICS_RPC_RECORDER_H
+#define METRICS_RPC_RECORDER_H
+
+#include "metrics.h"
+#include "../utils/mpsc_ring.h"
+#include "client.pb.h"
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/support/server_interceptor.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace metrics {
+
+    // first bytes of every trace file (followed by length-delimited TraceRecord messages)
+    const std::string RPC_TRACE_MAGIC = "RVTRACE1";
+
+    /**
+     * Writes the RPCs of clients to a binary trace file
+     * RPC threads only push records to a lock-free queue that is drained by a background thread
+     * (records are dropped when the queue is full so that RPCs are never blocked)
+     */
+    class RpcRecorder {
+
+        private:
+            std::ofstream _file;
+            const std::chrono::steady_clock::time_point _start;
+            utils::MPSCRing<std::unique_ptr<rendezvous::TraceRecord>> _queue;
+            std::atomic<bool> _running;
+            std::thread _writer;
+            Counter * _recorded;
+            Counter * _dropped;
+
+            void _write();
+
+        public:
+            /**
+             * Open (truncate) the trace file and start the background writer
+             *
+             * @param filename Path of the trace file
+             * @param queue_size Maximum number of records waiting to be written
+             */
+            RpcRecorder(const std::string& filename, size_t queue_size);
+
+            /**
+             * Write the remaining records and close the trace file
+             */
+            ~RpcRecorder();
+
+            bool isOpen();
+
+            /**
+             * @param ts Arrival of an RPC
+             * @return Microseconds between the start of the recording and the arrival of the RPC
+             */
+            int64_t elapsedUs(std::chrono::steady_clock::time_point ts);
+
+            /**
+             * Add record to the queue of the background writer (safe to be called by multiple threads)
+             *
+             * @param record The record of a completed RPC
+             * @return false if the record was dropped
+             */
+            bool record(std::unique_ptr<rendezvous::TraceRecord> record);
+    };
+
+    /**
+     * Copies the request, the generated identifiers and the outcome of each unary RPC of clients
+     * to a trace record (subscriptions, monitoring and admin RPCs are not recorded)
+     */
+    class RpcRecorderInterceptor : public grpc::experimental::Interceptor {
+
+        private:
+            RpcRecorder& _recorder;
+            const std::chrono::steady_clock::time_point _start;
+            const std::string _method;
+            std::unique_ptr<rendezvous::TraceRecord> _record;
+
+            void _copyRequest(const void * message);
+            void _copyResponse(const void * message);
+
+        public:
+            RpcRecorderInterceptor(RpcRecorder& recorder, const std::string& method);
+
+            void Intercept(grpc::experimental::InterceptorBatchMethods * methods) override;
+    };
+
+    class RpcRecorderInterceptorFactory : public grpc::experimental::ServerInterceptorFactoryInterface {
+
+        private:
+            RpcRecorder& _recorder;
+
+        public:
+            RpcRecorderInterceptorFactory(RpcRecorder& recorder);
+
+            /**
+             * @return Interceptor for recorded RPCs and nullptr for the remaining ones
+             */
+            grpc::experimental::Interceptor * CreateServerInterceptor(grpc::experimental::ServerRpcInfo * info) override;
+    };
+
+    /**
+     * Reads the records of a trace file written by RpcRecorder (in completion order of the RPCs)
+     */
+    class RpcTraceReader {
+
+        private:
+            std::ifstream _file;
+            std::unique_ptr<google::protobuf::io::IstreamInputStream> _input;
+            bool _valid;
+
+        public:
+            RpcTraceReader(const std::string& filename);
+
+            /**
+             * @return true if the file was opened and starts with the trace header
+             */
+            bool isValid();
+
+            /**
+             * Read next record
+             *
+             * @param record The record to be filled
+             * @return false if there are no more (complete) records
+             */
+            bool next(rendezvous::TraceRecord& record);
+    };
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include "partition_client.h"
+
+using namespace replicas;
+
+PartitionClient::PartitionClient(const std::string& sid, std::vector<ReplicaClient::Replica> replicas,
+    int num_virtual_nodes) : _sid(sid) {
+
+    for (int i = 0; i < num_virtual_nodes; i++) {
+        _ring[_hash(_sid + "#" + std::to_string(i))] = _sid;
+    }
+
+    // by default, replicas does not contain the address of the current replica
+    for (const auto& replica : replicas) {
+        for (int i = 0; i < num_virtual_nodes; i++) {
+            _ring[_hash(replica.sid + "#" + std::to_string(i))] = replica.sid;
+        }
+        auto channel = grpc::CreateChannel(replica.addr, grpc::InsecureChannelCredentials());
+        _stubs[replica.sid] = rendezvous::ClientService::NewStub(channel);
+    }
+}
+
+uint64_t PartitionClient::_hash(std::string_view key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char c : key) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    // final mixing step (murmur3) since similar keys barely change the high bits
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+const std::string& PartitionClient::getOwner(std::string_view rid) {
+    // first replica clockwise from the hash of the request
+    auto it = _ring.lower_bound(_hash(rid));
+    if (it == _ring.end()) {
+        it = _ring.begin();
+    }
+    return it->second;
+}
+
+bool PartitionClient::isOwner(std::string_view rid) {
+    return getOwner(rid) == _sid;
+}
@@ -0,0 +1,114 @@
+#ifndef PARTITION_CLIENT_H
+#define PARTITION_CLIENT_H
+
+#include "client.grpc.pb.h"
+#include "replica_client.h"
+#include "../utils/grpc_service.h"
+#include <grpcpp/grpcpp.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../utils/log.h"
+
+namespace replicas {
+
+    class PartitionClient {
+
+        private:
+            // number of points of each replica in the hash ring
+            static const int DEFAULT_VIRTUAL_NODES = 128;
+
+            const std::string _sid;
+
+            // consistent hash ring: <hash, sid>
+            std::map<uint64_t, std::string> _ring;
+
+            // client stubs for remaining replicas: <sid, stub>
+            std::unordered_map<std::string, std::unique_ptr<rendezvous::ClientService::Stub>> _stubs;
+
+            /**
+             * Stable 64-bit hash (FNV-1a with murmur3 finalizer) so that all replicas agree on the ring
+             *
+             * @param key The key to be hashed
+             * @return The hash value
+             */
+            static uint64_t _hash(std::string_view key);
+
+        public:
+            /**
+             * Build hash ring with the current and remaining replicas
+             *
+             * @param sid The identifier of the current replica
+             * @param replicas Remaining replicas (current replica is not part of the vector)
+             * @param num_virtual_nodes Number of points of each replica in the ring
+             */
+            PartitionClient(const std::string& sid, std::vector<ReplicaClient::Replica> replicas,
+                int num_virtual_nodes = DEFAULT_VIRTUAL_NODES);
+
+            /**
+             * Get the replica that owns a request
+             *
+             * @param rid The identifier of the (root) request
+             * @return The identifier of the owner replica
+             */
+            const std::string& getOwner(std::string_view rid);
+
+            /**
+             * Check if the current replica owns a request
+             *
+             * @param rid The identifier of the (root) request
+             * @return true if request is owned by the current replica and false otherwise
+             */
+            bool isOwner(std::string_view rid);
+
+            /**
+             * Forward a client call to the replica that owns the request
+             *
+             * @param rid The identifier of the (root) request
+             * @param server_context The context of the call being forwarded (to propagate the deadline)
+             * @param method The client stub method to be invoked in the owner replica
+             * @param request The original request
+             * @param response The response to be filled by the owner replica
+             * @return The status returned by the owner replica
+             */
+            template <typename RequestType, typename ResponseType>
+            grpc::Status forward(std::string_view rid, grpc::ServerContext * server_context,
+                grpc::Status (rendezvous::ClientService::Stub::*method)(grpc::ClientContext *, const RequestType&, ResponseType *),
+                const RequestType& request, ResponseType * response) {
+
+                return forwardToOwner(getOwner(rid), server_context, method, request, response);
+            }
+
+            /**
+             * Forward a client call to an owner replica (e.g., a batch of calls for requests of the same owner)
+             *
+             * @param owner The identifier of the owner replica (see getOwner)
+             * @param server_context The context of the call being forwarded (to propagate the deadline)
+             * @param method The client stub method to be invoked in the owner replica
+             * @param request The original request
+             * @param response The response to be filled by the owner replica
+             * @return The status returned by the owner replica
+             */
+            template <typename RequestType, typename ResponseType>
+            grpc::Status forwardToOwner(const std::string& owner, grpc::ServerContext * server_context,
+                grpc::Status (rendezvous::ClientService::Stub::*method)(grpc::ClientContext *, const RequestType&, ResponseType *),
+                const RequestType& request, ResponseType * response) {
+
+                auto stub_it = _stubs.find(owner);
+                if (stub_it == _stubs.end()) {
+                    LOG_CRITICAL_RATE_LIMITED("[PARTITION CLIENT] owner '{}' not found", owner);
+                    return grpc::Status(grpc::StatusCode::INTERNAL, utils::ERR_MSG_OWNER_NOT_FOUND);
+                }
+
+                grpc::ClientContext context;
+                context.set_deadline(server_context->deadline());
+                return (stub_it->second.get()->*method)(&context, request, response);
+            }
+    };
+}
+
+#endif
@@ -1,52 +1,77 @@
 #include "replica_client.h"
+#include <algorithm>
 
 using namespace replicas;
 
-ReplicaClient::ReplicaClient(std::vector<std::string> addrs) {
+ReplicaClient::ReplicaClient(std::vector<Replica> replicas, bool selective_replication)
+    : _replicas(replicas), _selective_replication(selective_replication), _num_pending_wait_logs(0) {
 
-    // by default, addrs does not contain the address of the current replica
-    for (const auto& addr : addrs) {
-      auto channel = grpc::CreateChannel(addr, grpc::InsecureChannelCredentials());
+    // by default, replicas does not contain the address of the current replica
+    for (const auto& replica : _replicas) {
+      auto channel = grpc::CreateChannel(replica.addr, grpc::InsecureChannelCredentials());
       auto stub = rendezvous_server::ServerService::NewStub(channel);
       _servers.push_back(std::move(stub));
+      _replication_lag.push_back(metrics::Registry::get().histogram("rendezvous_replication_lag_seconds", 
+        "Time until replicated requests and branches are acknowledged by each peer", {{"peer", replica.sid}}));
     }
 }
 
-void ReplicaClient::waitCompletionQueue(const std::string& request, AsyncRequestHelper& req_helper) {
+int ReplicaClient::getNumPendingWaitLogs() {
+    return _num_pending_wait_logs.load();
+}
+
+bool ReplicaClient::isSelectiveReplication() {
+    return _selective_replication;
+}
+
+bool ReplicaClient::isFullReplica(const Replica& replica, const BranchScope& scope) {
+    // branches in the global region are visible in every region
+    if (!_selective_replication || scope.regions.empty()) {
+        return true;
+    }
+    if (replica.sid == scope.origin || scope.subscribers.count(replica.sid) != 0) {
+        return true;
+    }
+    for (const auto& region : scope.regions) {
+        if (std::find(replica.regions.begin(), replica.regions.end(), region) != replica.regions.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ReplicaClient::waitCompletionQueue(const std::string& request, AsyncRequestHelper& req_helper, bool track_lag) {
     for(int i = 0; i < req_helper.nrpcs; i++) {
         void * tagPtr;
         bool ok = false;
 
         req_helper.queue.Next(&tagPtr, &ok);
+        // each rpc is tagged with its (1-based) index
         const size_t tag = size_t(tagPtr);
         const grpc::Status & status = *(req_helper.statuses[tag-1].get());
 
         if (!status.ok()) {
-            spdlog::critical("[REPLICA CLIENT - {}] RPC #{} ERROR: {}", request.c_str(), tag, status.error_message().c_str());
+            LOG_CRITICAL_RATE_LIMITED("[REPLICA CLIENT - {}] RPC #{} ERROR: {}", request.c_str(), tag, status.error_message().c_str());
+        }
+        else if (track_lag) {
+            _replication_lag[req_helper.replicas[tag-1]]->observe(metrics::elapsedSeconds(req_helper.start_ts));
         }
     }
 }
 
 void ReplicaClient::_doRegisterRequest(const std::string& rid) {
     AsyncRequestHelper req_helper;
-    for (const auto& server : _servers) {
+    for (size_t i = 0; i < _servers.size(); i++) {
         grpc::ClientContext * context = new grpc::ClientContext();
-        req_helper.contexts.emplace_back(context);
-
         grpc::Status * status = new grpc::Status();
-        req_helper.statuses.emplace_back(status);
-
         rendezvous_server::Empty * response = new rendezvous_server::Empty();
-        req_helper.responses.emplace_back(response);
-
         rendezvous_server::RegisterRequestMessage request;
         request.set_rid(rid);
         
-        req_helper.rpcs.emplace_back(server->AsyncRegisterRequest(context, request, &req_helper.queue));
-        req_helper.rpcs[req_helper.nrpcs]->Finish(response, status, (void*)1);
-        req_helper.nrpcs++;
+        req_helper.rpcs.emplace_back(_servers[i]->AsyncRegisterRequest(context, request, &req_helper.queue));
+        saveAsyncCall(req_helper, i, context, status, response);
     }
-    waitCompletionQueue("RR", req_helper);
+    waitCompletionQueue("RR", req_helper, true);
 }
 
 void ReplicaClient::registerRequest(const std::string& rid) {
@@ -60,101 +85,285 @@ void ReplicaClient::registerRequest(const std::string& rid) {
     }
 }
 
-void ReplicaClient::saveAsyncCall(AsyncRequestHelper &req_helper, grpc::ClientContext * context, grpc::Status * status, rendezvous_server::Empty * response) {
+void ReplicaClient::saveAsyncCall(AsyncRequestHelper &req_helper, size_t replica_index, grpc::ClientContext * context, 
+    grpc::Status * status, rendezvous_server::Empty * response) {
+
     req_helper.contexts.emplace_back(context);
     req_helper.statuses.emplace_back(status);
     req_helper.responses.emplace_back(response);
-    req_helper.rpcs[req_helper.nrpcs]->Finish(response, status, (void*)1);
+    req_helper.replicas.emplace_back(replica_index);
+    req_helper.rpcs[req_helper.nrpcs]->Finish(response, status, (void*)(size_t)(req_helper.nrpcs + 1));
     req_helper.nrpcs++;
 }
 
-void ReplicaClient::_doRegisterBranch(const std::string& rid, const std::string& acsl, const std::string& core_bid,
-    const std::string& service, const std::string& tag, 
-    const google::protobuf::RepeatedPtrField<std::string>& regions, bool monitor,
-    const rendezvous_server::RequestContext& ctx_replica) {
-
+void ReplicaClient::_doRegisterBranch(const OutboundRegisterBranch& messages, const BranchScope& scope) {
         AsyncRequestHelper req_helper;
-        for (const auto& server : _servers) {
+        for (size_t i = 0; i < _servers.size(); i++) {
+            const auto& server = _servers[i];
             grpc::ClientContext * context = new grpc::ClientContext();
             grpc::Status * status = new grpc::Status();
             rendezvous_server::Empty * response = new rendezvous_server::Empty();
-            rendezvous_server::RegisterBranchMessage request;
-
-            request.set_rid(rid);
-            request.set_acsl(acsl);
-            request.set_core_bid(core_bid);
-            request.set_service(service);
-            request.set_tag(tag);
-            request.set_monitor(monitor);
-            request.mutable_regions()->CopyFrom(regions);
 
-            // async replication requires context propagation
-            if (utils::ASYNC_REPLICATION) {
-                request.mutable_context()->CopyFrom(ctx_replica);
-            }
+            // replicas outside the branch's scope only track its counters
+            const auto& request = isFullReplica(_replicas[i], scope) ? *messages.full : *messages.compact;
 
             req_helper.rpcs.emplace_back(server->AsyncRegisterBranch(context, request, &req_helper.queue));
-            saveAsyncCall(req_helper, context, status, response);
+            saveAsyncCall(req_helper, i, context, status, response);
         }
-        waitCompletionQueue("RB", req_helper);
+        waitCompletionQueue("RB", req_helper, true);
     }
 
 void ReplicaClient::registerBranch(const std::string& rid, const std::string& acsl, const std::string& core_bid,
     const std::string& service, const std::string& tag, 
     const google::protobuf::RepeatedPtrField<std::string>& regions, bool monitor,
-    const rendezvous_server::RequestContext& ctx_replica) {
+    const rendezvous_server::RequestContext& ctx_replica, const BranchScope& scope) {
+
+        // messages are built once and shared by all replicas
+        auto messages = std::make_shared<OutboundRegisterBranch>();
+        auto build = [&](rendezvous_server::RegisterBranchMessage * message) {
+            message->set_rid(rid);
+            message->set_acsl(acsl);
+            message->set_core_bid(core_bid);
+            message->set_service(service);
+            message->set_tag(tag);
+
+            // async replication requires context propagation
+            if (utils::ASYNC_REPLICATION) {
+                *message->mutable_context() = ctx_replica;
+            }
+        };
+        messages->full = google::protobuf::Arena::CreateMessage<rendezvous_server::RegisterBranchMessage>(&messages->arena);
+        build(messages->full);
+        *messages->full->mutable_regions() = regions;
+        messages->full->set_monitor(monitor);
+
+        // replicas that only track counters do not need the regions (branch is closed at once)
+        if (_selective_replication) {
+            messages->compact = google::protobuf::Arena::CreateMessage<rendezvous_server::RegisterBranchMessage>(&messages->arena);
+            build(messages->compact);
+            messages->compact->set_compact(true);
+        }
 
         if (utils::ASYNC_REPLICATION) {
-        std::thread([this, rid, acsl, core_bid, service, tag, regions, monitor, ctx_replica]() {
-            _doRegisterBranch(rid, acsl, core_bid, service, tag, regions, monitor, ctx_replica);
-        }).detach();
+            std::thread([this, messages, scope]() {
+                _doRegisterBranch(*messages, scope);
+            }).detach();
         }
         else {
-            _doRegisterBranch(rid, acsl, core_bid, service, tag, regions, monitor, ctx_replica);
+            _doRegisterBranch(*messages, scope);
         }
 }
 
-void ReplicaClient::_doCloseBranch(const std::string& rid, const std::string& core_bid, const std::string& region, 
-    const rendezvous_server::RequestContext& ctx_replica) {
-
+void ReplicaClient::_doCloseBranch(const OutboundCloseBranch& messages, const BranchScope& scope, bool compact) {
         AsyncRequestHelper req_helper;
-        for (const auto& server : _servers) {
+        for (size_t i = 0; i < _servers.size(); i++) {
+            // closes of regions are only sent to replicas that track the full metadata of the branch
+            if (isFullReplica(_replicas[i], scope) == compact) {
+                continue;
+            }
             grpc::ClientContext * context = new grpc::ClientContext();
-            req_helper.contexts.emplace_back(context);
-
             grpc::Status * status = new grpc::Status();
-            req_helper.statuses.emplace_back(status);
+            rendezvous_server::Empty * response = new rendezvous_server::Empty();
+
+            req_helper.rpcs.emplace_back(_servers[i]->AsyncCloseBranch(context, *messages.message, &req_helper.queue));
+            saveAsyncCall(req_helper, i, context, status, response);
+        }
+        waitCompletionQueue(compact ? "CCB" : "CB", req_helper, true);
+    }
+
+void ReplicaClient::closeBranch(std::string_view rid, std::string_view core_bid, const std::string& region, 
+const rendezvous_server::RequestContext& ctx_replica, const BranchScope& scope) {
+
+    // message is built once and shared by all replicas
+    auto messages = std::make_shared<OutboundCloseBranch>();
+    messages->message = google::protobuf::Arena::CreateMessage<rendezvous_server::CloseBranchMessage>(&messages->arena);
+    messages->message->set_rid(rid.data(), rid.size());
+    messages->message->set_core_bid(core_bid.data(), core_bid.size());
+    messages->message->set_region(region);
+
+    // async replication requires context propagation
+    if (utils::ASYNC_REPLICATION) {
+        *messages->message->mutable_context() = ctx_replica;
+    }
+
+    if (utils::ASYNC_REPLICATION) {
+        std::thread([this, messages, scope]() {
+            _doCloseBranch(*messages, scope, false);
+        }).detach();
+    }
+    else {
+        _doCloseBranch(*messages, scope, false);
+    }
+}
+
+void ReplicaClient::closeCompactBranch(std::string_view rid, std::string_view core_bid, const std::vector<std::string>& regions, 
+const rendezvous_server::RequestContext& ctx_replica) {
+
+    // replicas outside the regions of the branch registered it compact (even if they have subscribers now)
+    BranchScope scope{regions, {}, {}};
+    bool any_compact = false;
+    for (const auto& replica : _replicas) {
+        any_compact = any_compact || !isFullReplica(replica, scope);
+    }
+    if (!any_compact) {
+        return;
+    }
+
+    auto messages = std::make_shared<OutboundCloseBranch>();
+    messages->message = google::protobuf::Arena::CreateMessage<rendezvous_server::CloseBranchMessage>(&messages->arena);
+    messages->message->set_rid(rid.data(), rid.size());
+    messages->message->set_core_bid(core_bid.data(), core_bid.size());
+    messages->message->set_compact(true);
+
+    // async replication requires context propagation
+    if (utils::ASYNC_REPLICATION) {
+        *messages->message->mutable_context() = ctx_replica;
+    }
+
+    if (utils::ASYNC_REPLICATION) {
+        std::thread([this, messages, scope]() {
+            _doCloseBranch(*messages, scope, true);
+        }).detach();
+    }
+    else {
+        _doCloseBranch(*messages, scope, true);
+    }
+}
 
+void ReplicaClient::_doCloseBranches(const OutboundCloseBranches& messages) {
+        AsyncRequestHelper req_helper;
+        for (size_t i = 0; i < _servers.size(); i++) {
+            if (messages.messages[i] == nullptr) {
+                continue;
+            }
+            grpc::ClientContext * context = new grpc::ClientContext();
+            grpc::Status * status = new grpc::Status();
             rendezvous_server::Empty * response = new rendezvous_server::Empty();
-            req_helper.responses.emplace_back(response);
 
-            rendezvous_server::CloseBranchMessage request;
-            request.set_rid(rid);
-            request.set_core_bid(core_bid);
-            request.set_region(region);
+            req_helper.rpcs.emplace_back(_servers[i]->AsyncCloseBranches(context, *messages.messages[i], &req_helper.queue));
+            saveAsyncCall(req_helper, i, context, status, response);
+        }
+        waitCompletionQueue("CBs", req_helper, true);
+    }
 
-            // async replication requires context propagation
+void ReplicaClient::closeBranches(const std::vector<ClosedBranch>& branches) {
+    auto messages = std::make_shared<OutboundCloseBranches>();
+    messages->messages.resize(_servers.size(), nullptr);
+
+    for (size_t i = 0; i < _servers.size(); i++) {
+        for (const auto& branch : branches) {
+            // closes of regions are only sent to replicas that track the full metadata of the branch
+            if (!isFullReplica(_replicas[i], branch.scope)) {
+                continue;
+            }
+            if (messages->messages[i] == nullptr) {
+                messages->messages[i] = google::protobuf::Arena::CreateMessage<rendezvous_server::CloseBranchesMessage>(&messages->arena);
+            }
+            auto * message = messages->messages[i]->add_branches();
+            message->set_rid(branch.root_rid);
+            message->set_core_bid(branch.core_bid);
+            message->set_region(branch.region);
             if (utils::ASYNC_REPLICATION) {
-                request.mutable_context()->CopyFrom(ctx_replica);
+                *message->mutable_context() = branch.ctx_replica;
             }
+        }
+    }
+
+    if (utils::ASYNC_REPLICATION) {
+        std::thread([this, messages]() {
+            _doCloseBranches(*messages);
+        }).detach();
+    }
+    else {
+        _doCloseBranches(*messages);
+    }
+}
+
+void ReplicaClient::_doAddSubscriber(const std::string& sid, const std::string& service, uint64_t version) {
+    AsyncRequestHelper req_helper;
+    for (size_t i = 0; i < _servers.size(); i++) {
+        grpc::ClientContext * context = new grpc::ClientContext();
+        grpc::Status * status = new grpc::Status();
+        rendezvous_server::Empty * response = new rendezvous_server::Empty();
+        rendezvous_server::AddSubscriberMessage request;
+        request.set_sid(sid);
+        request.set_service(service);
+        request.set_version(version);
+
+        req_helper.rpcs.emplace_back(_servers[i]->AsyncAddSubscriber(context, request, &req_helper.queue));
+        saveAsyncCall(req_helper, i, context, status, response);
+    }
+    waitCompletionQueue("AS", req_helper);
+}
+
+void ReplicaClient::addSubscriber(const std::string& sid, const std::string& service, uint64_t version) {
+    std::thread([this, sid, service, version]() {
+        _doAddSubscriber(sid, service, version);
+    }).detach();
+}
+
+void ReplicaClient::_doRemoveSubscriber(const std::string& sid, const std::string& service, uint64_t version) {
+    AsyncRequestHelper req_helper;
+    for (size_t i = 0; i < _servers.size(); i++) {
+        grpc::ClientContext * context = new grpc::ClientContext();
+        grpc::Status * status = new grpc::Status();
+        rendezvous_server::Empty * response = new rendezvous_server::Empty();
+        rendezvous_server::RemoveSubscriberMessage request;
+        request.set_sid(sid);
+        request.set_service(service);
+        request.set_version(version);
+
+        req_helper.rpcs.emplace_back(_servers[i]->AsyncRemoveSubscriber(context, request, &req_helper.queue));
+        saveAsyncCall(req_helper, i, context, status, response);
+    }
+    waitCompletionQueue("RS", req_helper);
+}
+
+void ReplicaClient::removeSubscriber(const std::string& sid, const std::string& service, uint64_t version) {
+    std::thread([this, sid, service, version]() {
+        _doRemoveSubscriber(sid, service, version);
+    }).detach();
+}
+
+void ReplicaClient::_doPublishBranch(const OutboundPublishBranch& messages, 
+    const std::unordered_set<std::string>& sids) {
 
-            req_helper.rpcs.emplace_back(server->AsyncCloseBranch(context, request, &req_helper.queue));
-            req_helper.rpcs[req_helper.nrpcs]->Finish(response, status, (void*)1);
-            req_helper.nrpcs++;
+    AsyncRequestHelper req_helper;
+    for (size_t i = 0; i < _servers.size(); i++) {
+        if (sids.count(_replicas[i].sid) == 0) {
+            continue;
         }
-        waitCompletionQueue("CB", req_helper);
+        grpc::ClientContext * context = new grpc::ClientContext();
+        grpc::Status * status = new grpc::Status();
+        rendezvous_server::Empty * response = new rendezvous_server::Empty();
+
+        req_helper.rpcs.emplace_back(_servers[i]->AsyncPublishBranch(context, *messages.message, &req_helper.queue));
+        saveAsyncCall(req_helper, i, context, status, response);
     }
+    waitCompletionQueue("PB", req_helper);
+}
 
-void ReplicaClient::closeBranch(const std::string& rid, const std::string& core_bid, const std::string& region, 
-const rendezvous_server::RequestContext& ctx_replica) {
+void ReplicaClient::publishBranch(const std::unordered_set<std::string>& sids, const std::string& service, 
+    const std::string& tag, const std::string& bid, const google::protobuf::RepeatedPtrField<std::string>& regions) {
+
+    if (sids.empty()) {
+        return;
+    }
+    // message is built once and shared by all replicas with subscribers
+    auto messages = std::make_shared<OutboundPublishBranch>();
+    messages->message = google::protobuf::Arena::CreateMessage<rendezvous_server::PublishBranchMessage>(&messages->arena);
+    messages->message->set_bid(bid);
+    messages->message->set_service(service);
+    messages->message->set_tag(tag);
+    *messages->message->mutable_regions() = regions;
 
     if (utils::ASYNC_REPLICATION) {
-        std::thread([this, rid, core_bid, region, ctx_replica]() {
-            _doCloseBranch(rid, core_bid, region, ctx_replica);
+        std::thread([this, messages, sids]() {
+            _doPublishBranch(*messages, sids);
         }).detach();
     }
     else {
-        _doCloseBranch(rid, core_bid, region, ctx_replica);
+        _doPublishBranch(*messages, sids);
     }
 }
 
@@ -162,25 +371,19 @@ replicas::ReplicaClient::AsyncRequestHelper * ReplicaClient::addWaitLog(const st
     const std::string& acsl, const std::string& target_service) {
 
     AsyncRequestHelper * req_helper = new AsyncRequestHelper{};
+    _num_pending_wait_logs.fetch_add(1);
 
-    for (const auto& server : _servers) {
+    for (size_t i = 0; i < _servers.size(); i++) {
         grpc::ClientContext * context = new grpc::ClientContext();
-        req_helper->contexts.emplace_back(context);
-
         grpc::Status * status = new grpc::Status();
-        req_helper->statuses.emplace_back(status);
-
         rendezvous_server::Empty * response = new rendezvous_server::Empty();
-        req_helper->responses.emplace_back(response);
-
         rendezvous_server::AddWaitLogMessage request;
         request.set_rid(rid);
         request.set_acsl(acsl);
         request.set_target_service(target_service);
 
-        req_helper->rpcs.emplace_back(server->AsyncAddWaitLog(context, request, &req_helper->queue));
-        req_helper->rpcs[req_helper->nrpcs]->Finish(response, status, (void*)1);
-        req_helper->nrpcs++;
+        req_helper->rpcs.emplace_back(_servers[i]->AsyncAddWaitLog(context, request, &req_helper->queue));
+        saveAsyncCall(*req_helper, i, context, status, response);
     }
 
     return req_helper;
@@ -193,26 +396,21 @@ void ReplicaClient::removeWaitLog(const std::string& rid, const std::string& acs
     std::thread([this, rid, acsl, target_service, add_wait_log_async_request_helper]() {
         // wait for previous requests for adding to wait log
         waitCompletionQueue("AWL", *add_wait_log_async_request_helper);
+        delete add_wait_log_async_request_helper;
+        _num_pending_wait_logs.fetch_sub(1);
 
         AsyncRequestHelper req_helper;
-        for (const auto& server : _servers) {
+        for (size_t i = 0; i < _servers.size(); i++) {
             grpc::ClientContext * context = new grpc::ClientContext();
-            req_helper.contexts.emplace_back(context);
-
             grpc::Status * status = new grpc::Status();
-            req_helper.statuses.emplace_back(status);
-
             rendezvous_server::Empty * response = new rendezvous_server::Empty();
-            req_helper.responses.emplace_back(response);
-
             rendezvous_server::RemoveWaitLogMessage request;
             request.set_rid(rid);
             request.set_acsl(acsl);
             request.set_target_service(target_service);
 
-            req_helper.rpcs.emplace_back(server->AsyncRemoveWaitLog(context, request, &req_helper.queue));
-            req_helper.rpcs[req_helper.nrpcs]->Finish(response, status, (void*)1);
-            req_helper.nrpcs++;
+            req_helper.rpcs.emplace_back(_servers[i]->AsyncRemoveWaitLog(context, request, &req_helper.queue));
+            saveAsyncCall(req_helper, i, context, status, response);
         }
         waitCompletionQueue("RWL", req_helper);
     }).detach();
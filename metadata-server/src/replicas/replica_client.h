@@ -6,10 +6,16 @@
 #include "../utils/grpc_service.h"
 #include "../utils/metadata.h"
 #include "../utils/settings.h"
+#include "../metrics/metrics.h"
 #include <grpcpp/grpcpp.h>
+#include <google/protobuf/arena.h>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <atomic>
 #include <thread>
-#include "spdlog/spdlog.h"
+#include <unordered_set>
+#include "../utils/log.h"
 #include "spdlog/fmt/ostr.h"
 
 namespace replicas {
@@ -25,35 +31,97 @@ namespace replicas {
                 std::vector<std::unique_ptr<grpc::ClientContext>> contexts;
                 std::vector<std::unique_ptr<rendezvous_server::Empty>> responses;
                 std::vector<std::unique_ptr<grpc::ClientAsyncResponseReader<rendezvous_server::Empty>>> rpcs;
+                // index of the target replica of each rpc
+                std::vector<size_t> replicas;
+                std::chrono::steady_clock::time_point start_ts = std::chrono::steady_clock::now();
                 std::mutex mutex;
             } AsyncRequestHelper;
 
+            // Helper structure for replicas connections
+            typedef struct ReplicaStruct {
+                std::string sid;
+                std::string addr;
+                std::vector<std::string> regions;
+            } Replica;
+
+            // Helper structure for selective replication of a branch
+            typedef struct BranchScopeStruct {
+                std::vector<std::string> regions;
+                // remote replicas with subscribers for the branch's service
+                std::unordered_set<std::string> subscribers;
+                // replica that registered the branch (always tracks its full metadata)
+                std::string origin;
+            } BranchScope;
+
+            // Replication messages of a branch, built once (in a single arena) and shared by all replicas
+            template <typename T>
+            struct OutboundMessagesStruct {
+                google::protobuf::Arena arena;
+                // sent to replicas that track the full metadata of the branch
+                T * full;
+                // sent to replicas that only track counters (nullptr without selective replication)
+                T * compact;
+            };
+            typedef OutboundMessagesStruct<rendezvous_server::RegisterBranchMessage> OutboundRegisterBranch;
+
+            // Close of a branch, built once (in a single arena) and shared by all replicas
+            typedef struct OutboundCloseBranchStruct {
+                google::protobuf::Arena arena;
+                rendezvous_server::CloseBranchMessage * message;
+            } OutboundCloseBranch;
+
+            // Branch closed by the current replica, replicated along with other closes in a single call
+            typedef struct ClosedBranchStruct {
+                std::string root_rid;
+                std::string core_bid;
+                std::string region;
+                rendezvous_server::RequestContext ctx_replica;
+                BranchScope scope;
+            } ClosedBranch;
+
+            // Batch of closes for each replica (nullptr if the replica has nothing to close), built in a single arena
+            typedef struct OutboundCloseBranchesStruct {
+                google::protobuf::Arena arena;
+                std::vector<rendezvous_server::CloseBranchesMessage*> messages;
+            } OutboundCloseBranches;
+
+            // Branch published to the replicas with subscribers, built once (in a single arena) and shared by all of them
+            typedef struct OutboundPublishBranchStruct {
+                google::protobuf::Arena arena;
+                rendezvous_server::PublishBranchMessage * message;
+            } OutboundPublishBranch;
+
         private:
             std::vector<std::shared_ptr<rendezvous_server::ServerService::Stub>> _servers;
-            void saveAsyncCall(AsyncRequestHelper &req_helper, grpc::ClientContext * context, grpc::Status * status, rendezvous_server::Empty * response);
+            std::vector<Replica> _replicas;
+            const bool _selective_replication;
+            // time until each replica acknowledges replicated requests and branches
+            std::vector<metrics::Histogram*> _replication_lag;
+            // wait logs added but not yet removed from all replicas (each one holds an async request helper)
+            std::atomic<int> _num_pending_wait_logs;
+            void saveAsyncCall(AsyncRequestHelper &req_helper, size_t replica_index, grpc::ClientContext * context, 
+                grpc::Status * status, rendezvous_server::Empty * response);
 
             /* Helpers */
             void _doRegisterRequest(const std::string& rid);
-            void _doRegisterBranch(const std::string& root_rid, const std::string& acsl, const std::string& core_bid, 
-                const std::string& service, const std::string& tag, 
-                const google::protobuf::RepeatedPtrField<std::string>& regions, bool monitor,
-                const rendezvous_server::RequestContext& ctx_replica);
-            void _doCloseBranch(const std::string& root_rid, const std::string& core_bid, const std::string& region, 
-                const rendezvous_server::RequestContext& ctx_replica);
-            
+            void _doRegisterBranch(const OutboundRegisterBranch& messages, const BranchScope& scope);
+            void _doCloseBranch(const OutboundCloseBranch& messages, const BranchScope& scope, bool compact);
+            void _doCloseBranches(const OutboundCloseBranches& messages);
+            void _doAddSubscriber(const std::string& sid, const std::string& service, uint64_t version);
+            void _doRemoveSubscriber(const std::string& sid, const std::string& service, uint64_t version);
+            void _doPublishBranch(const OutboundPublishBranch& messages, const std::unordered_set<std::string>& sids);
 
         public:
-            ReplicaClient(std::vector<std::string> addrs);
+            ReplicaClient(std::vector<Replica> replicas, bool selective_replication = false);
 
             /**
              * Wait for completion queue of async requests
              * 
              * @param request The type of request that is being handled
-             * @param cq The completion queue
-             * @param statuses Vector of status for each request
-             * @param rpcs Number of RPCs performed
+             * @param rh The helper with the completion queue and the status of each request
+             * @param track_lag Record the replication lag of each replica
              */
-            void waitCompletionQueue(const std::string& request, AsyncRequestHelper& rh);
+            void waitCompletionQueue(const std::string& request, AsyncRequestHelper& rh, bool track_lag = false);
 
             /**
              * Send register request call to all replicas
@@ -71,23 +139,94 @@ namespace replicas {
              * @param regions The regions where the branches were registered
              * @param monitor If enabled, we publish the branch for datastore monitor subscribers
              * @param ctx_replica Context targeted ot the replica
+             * @param scope Regions and subscribers of the branch (only used with selective replication)
              */
             void registerBranch(const std::string& root_rid, const std::string& acsl, const std::string& core_bid, 
                 const std::string& service, const std::string& tag, 
                 const google::protobuf::RepeatedPtrField<std::string>& regions, bool monitor,
-                const rendezvous_server::RequestContext& ctx_replica);
+                const rendezvous_server::RequestContext& ctx_replica, const BranchScope& scope = BranchScope{});
 
             /**
-             * Send close branch call to all replicas
+             * Send close branch call to all replicas that track the full metadata of the branch
              * 
              * @param root_rid The identifier of the root request
              * @param core_bid bid The identifier of the set of branches generated when the branch was registered (without rid)
              * @param region The region where the branch was registered
              * @param ctx_replica Context targeted ot the replica
+             * @param scope Regions and subscribers of the branch (only used with selective replication)
              */
-            void closeBranch(const std::string& root_rid, const std::string& core_bid, const std::string& region, 
+            void closeBranch(std::string_view root_rid, std::string_view core_bid, const std::string& region, 
+                const rendezvous_server::RequestContext& ctx_replica, const BranchScope& scope = BranchScope{});
+
+            /**
+             * Close a branch at once in the replicas outside its regions, which only track its counters
+             * Sent by the replica that registered the branch once it is closed in all its regions (selective replication)
+             * 
+             * @param root_rid The identifier of the root request
+             * @param core_bid bid The identifier of the set of branches generated when the branch was registered (without rid)
+             * @param regions The regions of the branch
+             * @param ctx_replica Context targeted ot the replica
+             */
+            void closeCompactBranch(std::string_view root_rid, std::string_view core_bid, const std::vector<std::string>& regions, 
                 const rendezvous_server::RequestContext& ctx_replica);
 
+            /**
+             * Send a single close branches call to each replica with the closes of the branches it fully tracks
+             * 
+             * @param branches The branches closed by the current replica
+             */
+            void closeBranches(const std::vector<ClosedBranch>& branches);
+
+            /**
+             * Announce to all replicas that the current replica has subscribers for a service
+             * 
+             * @param sid The identifier of the current replica
+             * @param service The subscribed service
+             * @param version Orders announcements of the service (replicas ignore older ones)
+             */
+            void addSubscriber(const std::string& sid, const std::string& service, uint64_t version);
+
+            /**
+             * Announce to all replicas that the current replica no longer has subscribers for a service
+             * 
+             * @param sid The identifier of the current replica
+             * @param service The unsubscribed service
+             * @param version Orders announcements of the service (replicas ignore older ones)
+             */
+            void removeSubscriber(const std::string& sid, const std::string& service, uint64_t version);
+
+            /**
+             * Send a monitored branch to the replicas with subscribers for its service (partitioned mode)
+             * 
+             * @param sids The remote replicas with subscribers for the service
+             * @param service The service of the branch
+             * @param tag The tag of the branch
+             * @param bid The composed identifier of the branch
+             * @param regions The regions of the branch
+             */
+            void publishBranch(const std::unordered_set<std::string>& sids, const std::string& service, 
+                const std::string& tag, const std::string& bid, const google::protobuf::RepeatedPtrField<std::string>& regions);
+
+            /**
+             * Check if a replica must receive the full metadata of a branch, i.e., if the replica
+             * registered it, is responsible for one of its regions or has subscribers for its service
+             * 
+             * @param replica The remote replica
+             * @param scope The regions and subscribers of the branch
+             * @return true if the branch is fully replicated and false if only counters are replicated
+             */
+            bool isFullReplica(const Replica& replica, const BranchScope& scope);
+
+            /**
+             * Return whether branches are only fully replicated to replicas of their regions
+             */
+            bool isSelectiveReplication();
+
+            /**
+             * Return number of wait logs whose replication was not completed yet
+             */
+            int getNumPendingWaitLogs();
+
             /**
              * Add wait call to log entry (asynchronous broadcast)
              * 
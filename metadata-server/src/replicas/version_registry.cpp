@@ -42,4 +42,13 @@ void VersionRegistry::waitRemoteVersion(const std::string& sid, int version) {
     while (version > _versions[sid]) {
         _cond_versions.wait_for(lock, std::chrono::seconds(_wait_replica_timeout_s));
     }
-}
\ No newline at end of file
+}
+
+size_t VersionRegistry::getFootprint() {
+    std::unique_lock<std::mutex> lock(_mutex_versions);
+    size_t bytes = sizeof(VersionRegistry) + _versions.slotBytes();
+    for (const auto& version_it : _versions) {
+        bytes += utils::stringBytes(version_it.first);
+    }
+    return bytes;
+}
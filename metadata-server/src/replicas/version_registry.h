@@ -4,11 +4,11 @@
 #include <mutex>
 #include <vector>
 #include <string>
-#include <unordered_map>
 #include <map>
 #include <condition_variable>
 #include "client.grpc.pb.h"
 #include <grpcpp/grpcpp.h>
+#include "../utils/flat_map.h"
 #include "../utils/grpc_service.h"
 #include "../utils/metadata.h"
 #include "../utils/settings.h"
@@ -24,7 +24,7 @@ namespace replicas {
             const int _wait_replica_timeout_s;
 
             // hash map: <server id, version>
-            std::unordered_map<std::string, int> _versions;
+            utils::FlatMap<int> _versions;
 
             // concurrency control
             std::mutex _mutex_versions;
@@ -79,6 +79,13 @@ namespace replicas {
              * 
              */
             void waitRemoteVersion(const std::string& sid, int version);
+
+            /**
+             * Approximate memory used by the registry
+             * 
+             * @return bytes
+             */
+            size_t getFootprint();
         };
     
 }
@@ -1,21 +1,79 @@
 #include "server.h"
 #include "utils/metadata.h"
 #include "utils/settings.h"
+#include <filesystem>
+#include <fstream>
 
 using namespace rendezvous;
 
+static metrics::Histogram * const GC_REQUESTS_PAUSE = metrics::Registry::get().histogram(
+  "rendezvous_gc_pause_seconds", "Time the garbage collectors hold the lock of their structures", {{"collector", "requests"}});
+static metrics::Histogram * const GC_CLOSED_REQUESTS_PAUSE = metrics::Registry::get().histogram(
+  "rendezvous_gc_pause_seconds", "Time the garbage collectors hold the lock of their structures", {{"collector", "closed_requests"}});
+static metrics::Histogram * const GC_SUBSCRIBERS_PAUSE = metrics::Registry::get().histogram(
+  "rendezvous_gc_pause_seconds", "Time the garbage collectors hold the lock of their structures", {{"collector", "subscribers"}});
+
+/**
+ * Histogram of the duration of wait calls according to their outcome
+ * 
+ * @param result The result of the wait call
+ */
+static metrics::Histogram * waitDurationHistogram(int result) {
+  static const std::string help = "Duration of wait calls by outcome";
+  static metrics::Histogram * const non_blocking = metrics::Registry::get().histogram(
+    "rendezvous_wait_duration_seconds", help, {{"outcome", "non_blocking"}});
+  static metrics::Histogram * const prevented = metrics::Registry::get().histogram(
+    "rendezvous_wait_duration_seconds", help, {{"outcome", "prevented"}});
+  static metrics::Histogram * const timed_out = metrics::Registry::get().histogram(
+    "rendezvous_wait_duration_seconds", help, {{"outcome", "timed_out"}});
+  static metrics::Histogram * const error = metrics::Registry::get().histogram(
+    "rendezvous_wait_duration_seconds", help, {{"outcome", "error"}});
+
+  switch (result) {
+    case 0: return non_blocking;
+    case 1: return prevented;
+    case -1: return timed_out;
+    default: return error;
+  }
+}
+
 Server::Server(std::string sid, json settings)
-    : _next_rid(0), _sid(sid), 
-    _cleanup_requests_interval_m(settings["cleanup_requests_interval_m"].get<int>()),
+    : _cleanup_requests_interval_m(settings["cleanup_requests_interval_m"].get<int>()),
     _cleanup_requests_validity_m(settings["cleanup_requests_validity_m"].get<int>()),
     _cleanup_subscribers_interval_m(settings["cleanup_subscribers_interval_m"].get<int>()),
     _cleanup_subscribers_validity_m(settings["cleanup_subscribers_validity_m"].get<int>()),
     _subscribers_refresh_interval_s(settings["subscribers_refresh_interval_s"].get<int>()),
-    _wait_replica_timeout_s(settings["wait_replica_timeout_s"].get<int>()) {
+    _subscribers_queue_capacity(settings["subscribers_queue_capacity"].get<int>()),
+    _subscribers_overflow_policy(_parseOverflowPolicy(settings["subscribers_overflow_policy"].get<std::string>())),
+    _subscribers_spill_dir(settings["subscribers_spill_dir"].get<std::string>()),
+    _wait_replica_timeout_s(settings["wait_replica_timeout_s"].get<int>()),
+    _selective_replication(settings["selective_replication"].get<bool>()),
+    _partitioned_mode(settings["partitioned_mode"].get<bool>()),
+    _wait_traces_file(settings["wait_traces_file"].get<std::string>()),
+    _sid(sid), _next_rid(0),
+    _next_subscriber_id(0),
+    // versions keep increasing across restarts so that replicas do not ignore announcements of a restarted replica
+    _subscribed_service_version(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count()) {
 
     utils::SIZE_SIDS = sid.size();
 
+    if (_subscribers_overflow_policy == metadata::Subscriber::OVERFLOW_SPILL) {
+      std::error_code error;
+      std::filesystem::create_directories(_subscribers_spill_dir, error);
+      if (error) {
+        spdlog::error("could not create subscribers spill directory '{}': {}", _subscribers_spill_dir, error.message());
+      }
+    }
+
     utils::WAIT_REPLICA_TIMEOUT_S = _wait_replica_timeout_s;
+
+    if (!_wait_traces_file.empty()) {
+      _wait_traces_stream.open(_wait_traces_file, std::ios::app);
+      if (!_wait_traces_stream.is_open()) {
+        spdlog::error("could not open wait traces file '{}'", _wait_traces_file);
+      }
+    }
     
     spdlog::info("----------------------- SETTINGS ---------------------\n");
     spdlog::info("> SIDs' size: {} chars", utils::SIZE_SIDS);
@@ -25,45 +83,59 @@ Server::Server(std::string sid, json settings)
     spdlog::info("\t >> Subscribers interval: {}", _cleanup_subscribers_interval_m);
     spdlog::info("\t >> Subscribers validity: {}", _cleanup_subscribers_validity_m);
     spdlog::info("> Subscribers max wait time: {} seconds", _subscribers_refresh_interval_s);
+    spdlog::info("> Subscribers queue capacity: {} branches", _subscribers_queue_capacity);
+    spdlog::info("> Subscribers overflow policy: {}", settings["subscribers_overflow_policy"].get<std::string>());
     spdlog::info("> Wait replica timeout: {} seconds", _wait_replica_timeout_s);
+    spdlog::info("> Selective replication: {}", _selective_replication);
+    spdlog::info("> Partitioned mode: {}", _partitioned_mode);
+    spdlog::info("> Wait traces file: {}", _wait_traces_file.empty() ? "disabled" : _wait_traces_file);
     spdlog::info("\n------------------------------------------------------");
     
-    _requests = std::unordered_map<std::string, metadata::Request*>();
-    _closed_requests = std::unordered_map<std::string, metadata::Request*>();
-    _subscribers = std::unordered_map<std::string, std::unordered_map<std::string, metadata::Subscriber*>>();
+    _requests = utils::FlatMap<metadata::Request*>();
+    _closed_requests = utils::FlatMap<metadata::Request*>();
+    _subscribers = std::unordered_map<std::string, Subscription>();
 }
 
 // for running GTest suit
 Server::Server(std::string sid)
-    : _next_rid(0), _sid(sid), 
-    _cleanup_requests_interval_m(30),
+    : _cleanup_requests_interval_m(30),
     _cleanup_requests_validity_m(30),
     _cleanup_subscribers_interval_m(30),
     _cleanup_subscribers_validity_m(30),
     _subscribers_refresh_interval_s(60),
-    _wait_replica_timeout_s(0) {
+    _subscribers_queue_capacity(1024),
+    _subscribers_overflow_policy(metadata::Subscriber::OVERFLOW_DROP_OLDEST),
+    _subscribers_spill_dir("/tmp/rendezvous"),
+    _wait_replica_timeout_s(0),
+    _selective_replication(false),
+    _partitioned_mode(false),
+    _wait_traces_file(""),
+    _sid(sid), _next_rid(0),
+    _next_subscriber_id(0),
+    // versions keep increasing across restarts so that replicas do not ignore announcements of a restarted replica
+    _subscribed_service_version(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count()) {
     
     utils::SIZE_SIDS = sid.size();
     utils::WAIT_REPLICA_TIMEOUT_S = 0;
     utils::ASYNC_REPLICATION = false;
     utils::CONSISTENCY_CHECKS = true;
     utils::CONSISTENCY_CHECKS = false;
-    _requests = std::unordered_map<std::string, metadata::Request*>();
-    _subscribers = std::unordered_map<std::string, std::unordered_map<std::string, metadata::Subscriber*>>();
-    spdlog::set_level(spdlog::level::trace);
+    _requests = utils::FlatMap<metadata::Request*>();
+    _subscribers = std::unordered_map<std::string, Subscription>();
 }
 
 
 Server::~Server() {
+  for (int collector : _metrics_collectors) {
+    metrics::Registry::get().removeCollector(collector);
+  }
   for (auto pair = _requests.begin(); pair != _requests.end(); pair++) {
     metadata::Request * request = pair->second;
     delete request;
   }
-  for (auto regions_it = _subscribers.begin(); regions_it != _subscribers.end(); regions_it++) {
-    for (auto subscribers_it = regions_it->second.begin(); subscribers_it != regions_it->second.end(); subscribers_it++) {
-      metadata::Subscriber * subscriber = subscribers_it->second;
-      delete subscriber;
-    }
+  for (auto subscribers_it = _subscribers.begin(); subscribers_it != _subscribers.end(); subscribers_it++) {
+    delete subscribers_it->second.subscriber;
   }
 }
 
@@ -71,41 +143,236 @@ Server::~Server() {
 // Publish-Subscribe
 //------------------
 
-metadata::Subscriber * Server::getSubscriber(const std::string& service, const std::string& region) {
-  std::shared_lock<std::shared_mutex> read_lock(_mutex_subscribers);
-  auto it_regions = _subscribers.find(service);
+metadata::Subscriber * Server::getSubscriber(const std::string& service, const std::string& region, 
+  std::vector<std::string> tags) {
 
-  // found subscriber in the region
-  if (it_regions != _subscribers.end()) {
-    auto it_subscriber = it_regions->second.find(region);
-    if (it_subscriber != it_regions->second.end()) {
-      return it_subscriber->second;
-    }
+  std::sort(tags.begin(), tags.end());
+  tags.erase(std::unique(tags.begin(), tags.end()), tags.end());
+
+  // FORMAT: <service>\0<region>\0<tag_1>\0...\0<tag_n>
+  std::string key = service + '\0' + region;
+  for (const auto& tag : tags) {
+    key += '\0' + tag;
+  }
+
+  std::shared_lock<utils::SharedMutex> read_lock(_mutex_subscribers);
+  auto it = _subscribers.find(key);
+  if (it != _subscribers.end()) {
+    return it->second.subscriber;
   }
 
   // manually upgrade lock
   read_lock.unlock();
-  std::shared_lock<std::shared_mutex> write_lock(_mutex_subscribers);
+  std::unique_lock<utils::SharedMutex> write_lock(_mutex_subscribers);
+
+  // sanity check for race conditions between unlocking read lock and locking write lock
+  it = _subscribers.find(key);
+  if (it != _subscribers.end()) {
+    return it->second.subscriber;
+  }
 
   // register new subscriber
-  metadata::Subscriber * subscriber = new metadata::Subscriber(_subscribers_refresh_interval_s);
-  _subscribers[service][region] = subscriber;
+  bool first_of_service = _subscribers_index.find(service) == _subscribers_index.end();
+  const std::string& spill_path = _subscribers_spill_dir + "/subscriber_" + _sid + "_" + std::to_string(_next_subscriber_id++) + ".log";
+  metadata::Subscriber * subscriber = new metadata::Subscriber(_subscribers_refresh_interval_s, _subscribers_queue_capacity,
+    [this, region](const std::string& bid) { return isBranchClosed(bid, region); }, _subscribers_overflow_policy, spill_path);
+  _subscribers[key] = Subscription{service, region, tags, subscriber};
+
+  // index subscriber by each tag of interest (or by empty tag if subscriber receives all tags)
+  auto& tags_index = _subscribers_index[service][region];
+  if (tags.empty()) {
+    tags_index[""].emplace_back(subscriber);
+  }
+  for (const auto& tag : tags) {
+    tags_index[tag].emplace_back(subscriber);
+  }
+  if (first_of_service && _subscribed_service_listener) {
+    _subscribed_service_listener(service, true, ++_subscribed_service_version);
+  }
   return subscriber;
 }
 
-void Server::publishBranches(const std::string& service, const std::string& tag, const std::string& bid) {
-  metadata::Subscriber * subscriber;
-  
-  std::shared_lock<std::shared_mutex> read_lock(_mutex_subscribers);
-  auto it_regions = _subscribers.find(service);
-
-  // found subscriber in certain regions
-  if (it_regions != _subscribers.end()) {
-    for (const auto& subscriber : it_regions->second) {
-      ////spdlog::debug("publishing branch '{}' for service '{}' in region '{}'", bid.c_str(), service.c_str(), it_regions->first);
-      subscriber.second->push(bid, tag);
+void Server::_unindexSubscriber(const Subscription& subscription) {
+  auto& regions_index = _subscribers_index[subscription.service];
+  auto& tags_index = regions_index[subscription.region];
+  std::vector<std::string> tags = subscription.tags;
+  if (tags.empty()) {
+    tags.emplace_back("");
+  }
+  for (const auto& tag : tags) {
+    auto& subscribers = tags_index[tag];
+    subscribers.erase(std::remove(subscribers.begin(), subscribers.end(), subscription.subscriber), subscribers.end());
+    if (subscribers.empty()) {
+      tags_index.erase(tag);
+    }
+  }
+  if (tags_index.empty()) {
+    regions_index.erase(subscription.region);
+  }
+  if (regions_index.empty()) {
+    _subscribers_index.erase(subscription.service);
+  }
+}
+
+void Server::_forEachSubscriber(const std::string& service, const std::string& tag, const utils::ProtoVec& regions,
+  const std::function<void(const std::string&, metadata::Subscriber*)>& fn) {
+
+  auto regions_it = _subscribers_index.find(service);
+  if (regions_it == _subscribers_index.end()) {
+    return;
+  }
+
+  auto forEach = [&tag, &fn](const std::string& region, 
+    std::unordered_map<std::string, std::vector<metadata::Subscriber*>>& tags_index) {
+
+    // subscribers of the branch's tag and subscribers of all tags
+    for (const auto& subscribed_tag : { std::string(), tag }) {
+      auto tags_it = tags_index.find(subscribed_tag);
+      if (tags_it == tags_index.end()) {
+        continue;
+      }
+      for (const auto& subscriber : tags_it->second) {
+        fn(region, subscriber);
+      }
+      if (tag.empty()) {
+        break;
+      }
+    }
+  };
+
+  // global branches are visible in all regions
+  if (regions.empty()) {
+    for (auto& tags_index : regions_it->second) {
+      forEach(tags_index.first, tags_index.second);
+    }
+    return;
+  }
+
+  // otherwise, only subscribers of the branch's regions and subscribers of all regions
+  auto all_regions_it = regions_it->second.find("");
+  if (all_regions_it != regions_it->second.end()) {
+    forEach(all_regions_it->first, all_regions_it->second);
+  }
+  for (const auto& region : regions) {
+    if (region.empty()) {
+      continue;
+    }
+    auto tags_index_it = regions_it->second.find(region);
+    if (tags_index_it != regions_it->second.end()) {
+      forEach(tags_index_it->first, tags_index_it->second);
+    }
+  }
+}
+
+void Server::publishBranches(const std::string& service, const std::string& tag, const std::string& bid, 
+  const utils::ProtoVec& regions) {
+
+  std::shared_lock<utils::SharedMutex> read_lock(_mutex_subscribers);
+  _forEachSubscriber(service, tag, regions, [&service, &tag, &bid](const std::string& region, metadata::Subscriber * subscriber) {
+    if (!subscriber->push(bid, tag)) {
+      LOG_ERROR_RATE_LIMITED("subscriber queue full for service '{}' in region '{}': dropped branch '{}'", service, region, bid);
+    }
+  });
+}
+
+bool Server::canPublishBranches(const std::string& service, const std::string& tag, const utils::ProtoVec& regions) {
+  if (_subscribers_overflow_policy != metadata::Subscriber::OVERFLOW_REJECT) {
+    return true;
+  }
+  bool can_publish = true;
+  std::shared_lock<utils::SharedMutex> read_lock(_mutex_subscribers);
+  _forEachSubscriber(service, tag, regions, [&can_publish](const std::string&, metadata::Subscriber * subscriber) {
+    can_publish = can_publish && !subscriber->isFull();
+  });
+  return can_publish;
+}
+
+bool Server::isBranchClosed(const std::string& composed_bid, const std::string& region) {
+  auto ids = parseFullId(composed_bid);
+  metadata::Request * request = getRequest(ids.second);
+  if (request == nullptr) {
+    // partitioned mode: requests owned by other replicas are unknown here, so their
+    // branches are kept until they are closed through this replica (or the owner is this replica)
+    if (_partitioned_mode) {
+      return _is_request_owner && _is_request_owner(ids.second);
+    }
+    return true;
+  }
+  if (request->isClosed()) {
+    return true;
+  }
+  metadata::Branch * branch = request->getBranch(ids.first);
+  if (branch == nullptr) {
+    return true;
+  }
+  int status = branch->getStatus(region);
+  // branch was not registered for the region so we rely on its global status
+  if (status == UNKNOWN) {
+    status = branch->getStatus();
+  }
+  return status == CLOSED;
+}
+
+void Server::ackBranch(const std::string& composed_bid, const std::string& region) {
+  const std::vector<std::string> bids = { composed_bid };
+  std::shared_lock<utils::SharedMutex> read_lock(_mutex_subscribers);
+  for (const auto& subscription_it : _subscribers) {
+    const Subscription& subscription = subscription_it.second;
+    // global branches are published to subscribers of every region
+    if (region.empty() || subscription.region.empty() || subscription.region == region) {
+      subscription.subscriber->ack(bids);
+    }
+  }
+}
+
+void Server::setRequestOwnership(std::function<bool(std::string_view)> is_request_owner) {
+  _is_request_owner = std::move(is_request_owner);
+}
+
+void Server::setClosedBranchListener(std::function<void(metadata::Request *, std::string_view)> listener) {
+  _closed_branch_listener = std::move(listener);
+}
+
+void Server::setSubscribedServiceListener(std::function<void(const std::string&, bool, uint64_t)> listener) {
+  std::unique_lock<utils::SharedMutex> write_lock(_mutex_subscribers);
+  _subscribed_service_listener = std::move(listener);
+}
+
+bool Server::addRemoteSubscriber(const std::string& sid, const std::string& service, uint64_t version) {
+  std::unique_lock<utils::SharedMutex> write_lock(_mutex_remote_subscribers);
+  uint64_t& last_version = _remote_subscribers_versions[service][sid];
+  if (version < last_version) {
+    return false;
+  }
+  last_version = version;
+  _remote_subscribers[service].insert(sid);
+  return true;
+}
+
+bool Server::removeRemoteSubscriber(const std::string& sid, const std::string& service, uint64_t version) {
+  std::unique_lock<utils::SharedMutex> write_lock(_mutex_remote_subscribers);
+  uint64_t& last_version = _remote_subscribers_versions[service][sid];
+  if (version < last_version) {
+    return false;
+  }
+  last_version = version;
+  auto it = _remote_subscribers.find(service);
+  if (it != _remote_subscribers.end()) {
+    it->second.erase(sid);
+    if (it->second.empty()) {
+      _remote_subscribers.erase(it);
     }
   }
+  return true;
+}
+
+std::unordered_set<std::string> Server::getRemoteSubscribers(const std::string& service) {
+  std::shared_lock<utils::SharedMutex> read_lock(_mutex_remote_subscribers);
+  auto it = _remote_subscribers.find(service);
+  if (it == _remote_subscribers.end()) {
+    return std::unordered_set<std::string>();
+  }
+  return it->second;
 }
 
 // ------------------
@@ -120,21 +387,22 @@ void Server::initSubscribersCleanup() {
     while (true) {
       std::this_thread::sleep_for(std::chrono::minutes(_cleanup_subscribers_interval_m));
       auto now = std::chrono::system_clock::now();
-      std::unique_lock<std::shared_mutex> write_lock(_mutex_subscribers);
-      spdlog::info("[GC SUBSCRIBERS] initializing garbage collector...");
-
-      for (auto subscribers_it = _subscribers.begin(); subscribers_it != _subscribers.cend(); /* no increment */) {
-        for (auto regions_it = subscribers_it->second.cbegin(); regions_it != subscribers_it->second.cend(); /* no increment */) {
-          if (now - regions_it->second->getLastTs() > std::chrono::minutes(_cleanup_subscribers_validity_m)) {
-            delete regions_it->second;
-            subscribers_it->second.erase(regions_it++);
+      std::unique_lock<utils::SharedMutex> write_lock(_mutex_subscribers);
+      SPDLOG_INFO("[GC SUBSCRIBERS] initializing garbage collector...");
+      metrics::ScopedTimer pause_timer(GC_SUBSCRIBERS_PAUSE);
+
+      for (auto subscribers_it = _subscribers.begin(); subscribers_it != _subscribers.end(); /* no increment */) {
+        auto stats = subscribers_it->second.subscriber->getQueueStats();
+        SPDLOG_INFO("[GC SUBSCRIBERS] service '{}' in region '{}': {} queued, {} dropped, {} spilled branches", 
+          subscribers_it->second.service, subscribers_it->second.region, stats.queued, stats.dropped, stats.spilled);
+        if (now - subscribers_it->second.subscriber->getLastTs() > std::chrono::minutes(_cleanup_subscribers_validity_m)) {
+          const std::string& service = subscribers_it->second.service;
+          _unindexSubscriber(subscribers_it->second);
+          // last subscriber of the service expired
+          if (_subscribers_index.find(service) == _subscribers_index.end() && _subscribed_service_listener) {
+            _subscribed_service_listener(service, false, ++_subscribed_service_version);
           }
-          else {
-            ++regions_it;
-          }
-        }
-        // current subscriber (id) is not associated with any region so we delete the id from the main subscriber map
-        if (subscribers_it->second.empty()) {
+          delete subscribers_it->second.subscriber;
           _subscribers.erase(subscribers_it++);
         }
         else {
@@ -155,9 +423,10 @@ void Server::initRequestsCleanup() {
       std::this_thread::sleep_for(std::chrono::minutes(_cleanup_requests_interval_m));
 
       // cleanup current requests
-      std::unique_lock<std::shared_mutex> write_lock_requests(_mutex_requests);
+      std::unique_lock<utils::SharedMutex> write_lock_requests(_mutex_requests);
+      auto pause_start_ts = std::chrono::steady_clock::now();
       std::size_t initial_size = _requests.size();
-      spdlog::info("[GC REQUESTS] initializing garbage collector for {} requests...", initial_size);
+      SPDLOG_INFO("[GC REQUESTS] initializing garbage collector for {} requests...", initial_size);
       auto now = std::chrono::system_clock::now();
       for (auto it = _requests.cbegin(); it != _requests.cend(); /* no increment */) {
         if (now - it->second->getLastTs() > std::chrono::minutes(_cleanup_requests_validity_m)) {
@@ -169,14 +438,16 @@ void Server::initRequestsCleanup() {
         }
       }
       write_lock_requests.unlock();
-      spdlog::info("[GC REQUESTS] done! collected {} requests", initial_size - _requests.size());
+      GC_REQUESTS_PAUSE->observe(metrics::elapsedSeconds(pause_start_ts));
+      SPDLOG_INFO("[GC REQUESTS] done! collected {} requests", initial_size - _requests.size());
 
       // cleanup closed requests
-      std::unique_lock<std::shared_mutex> write_lock_closed_requests(_mutex_closed_requests);
+      std::unique_lock<utils::SharedMutex> write_lock_closed_requests(_mutex_closed_requests);
+      pause_start_ts = std::chrono::steady_clock::now();
       initial_size = _closed_requests.size();
-      spdlog::info("[GC CLOSED REQUESTS] initializing garbage collector for {} requests...", initial_size);
+      SPDLOG_INFO("[GC CLOSED REQUESTS] initializing garbage collector for {} requests...", initial_size);
       now = std::chrono::system_clock::now();
-      spdlog::info("[GC REQUESTS] initializing garbage collector for {} requests...", initial_size);
+      SPDLOG_INFO("[GC REQUESTS] initializing garbage collector for {} requests...", initial_size);
 
       for (auto it = _closed_requests.cbegin(); it != _closed_requests.cend(); /* no increment */) {
         if (now - it->second->getLastTs() > std::chrono::minutes(_cleanup_requests_validity_m)) {
@@ -188,34 +459,176 @@ void Server::initRequestsCleanup() {
         }
       }
       write_lock_closed_requests.unlock();
-      spdlog::info("[GC CLOSED REQUESTS] done! collected {} requests", initial_size - _closed_requests.size());
+      GC_CLOSED_REQUESTS_PAUSE->observe(metrics::elapsedSeconds(pause_start_ts));
+      SPDLOG_INFO("[GC CLOSED REQUESTS] done! collected {} requests", initial_size - _closed_requests.size());
     }
     
   }).detach();
 }
 
+// -------
+// Metrics
+//--------
+
+void Server::initMetrics() {
+  metrics::Registry& registry = metrics::Registry::get();
+
+  _metrics_collectors.emplace_back(registry.addCollector("rendezvous_requests", 
+    "Number of requests tracked by the server", "gauge", [this]() {
+
+    std::shared_lock<utils::SharedMutex> read_lock_requests(_mutex_requests);
+    double num_opened = _requests.size();
+    read_lock_requests.unlock();
+    std::shared_lock<utils::SharedMutex> read_lock_closed_requests(_mutex_closed_requests);
+    double num_closed = _closed_requests.size();
+    read_lock_closed_requests.unlock();
+    return std::vector<metrics::Registry::Sample>{
+      {{{"state", "opened"}}, num_opened}, 
+      {{{"state", "closed"}}, num_closed}};
+  }));
+
+  // samples of each subscriber are identified by their subscription
+  auto collectSubscribers = [this](const std::function<double(const metadata::Subscriber::QueueStats&)>& value) {
+    std::vector<metrics::Registry::Sample> samples;
+    std::shared_lock<utils::SharedMutex> read_lock(_mutex_subscribers);
+    for (const auto& it : _subscribers) {
+      std::string tags;
+      for (const auto& tag : it.second.tags) {
+        tags += tags.empty() ? tag : "," + tag;
+      }
+      samples.push_back({
+        {{"service", it.second.service}, {"region", it.second.region}, {"tags", tags}}, 
+        value(it.second.subscriber->getQueueStats())});
+    }
+    return samples;
+  };
+  _metrics_collectors.emplace_back(registry.addCollector("rendezvous_subscriber_queue_depth", 
+    "Number of branches waiting in the queue of each subscriber", "gauge", [collectSubscribers]() {
+    return collectSubscribers([](const metadata::Subscriber::QueueStats& stats) { return stats.depth; });
+  }));
+  _metrics_collectors.emplace_back(registry.addCollector("rendezvous_subscriber_dropped_total", 
+    "Number of branches lost due to overflows of each subscriber", "counter", [collectSubscribers]() {
+    return collectSubscribers([](const metadata::Subscriber::QueueStats& stats) { return stats.dropped; });
+  }));
+  _metrics_collectors.emplace_back(registry.addCollector("rendezvous_subscriber_spilled_total", 
+    "Number of branches written to disk due to overflows of each subscriber", "counter", [collectSubscribers]() {
+    return collectSubscribers([](const metadata::Subscriber::QueueStats& stats) { return stats.spilled; });
+  }));
+}
+
+// -----
+// Stats
+//------
+
+/**
+ * Bucket of a request in the histograms of the stats: the smallest power of two not lower than the value
+ * 
+ * @param value Number of entries of the request (e.g. branches)
+ */
+static int statsBucket(int value) {
+  int bound = 1;
+  while (bound < value) {
+    bound <<= 1;
+  }
+  return value <= 0 ? 0 : bound;
+}
+
+static void addFootprint(metadata::Request::Footprint& total, const metadata::Request::Footprint& footprint) {
+  total.bytes += footprint.bytes;
+  total.branches_bytes += footprint.branches_bytes;
+  total.service_nodes_bytes += footprint.service_nodes_bytes;
+  total.acsls_bytes += footprint.acsls_bytes;
+  total.wait_logs_bytes += footprint.wait_logs_bytes;
+  total.registry_bytes += footprint.registry_bytes;
+  total.num_branches += footprint.num_branches;
+  total.num_service_nodes += footprint.num_service_nodes;
+  total.num_acsls += footprint.num_acsls;
+  total.num_wait_logs += footprint.num_wait_logs;
+}
+
+Server::Stats Server::getStats(size_t top_k) {
+  Stats stats{};
+  auto larger = [](const RequestStats& a, const RequestStats& b) { return a.footprint.bytes > b.footprint.bytes; };
+  // min-heap with the largest requests found so far
+  std::vector<RequestStats> top;
+
+  std::shared_lock<utils::SharedMutex> read_lock_requests(_mutex_requests);
+  stats.num_requests = _requests.size();
+  for (const auto& it : _requests) {
+    const auto& footprint = it.second->getFootprint();
+    addFootprint(stats.total, footprint);
+    stats.branches_per_request[statsBucket(footprint.num_branches)]++;
+    stats.acsls_per_request[statsBucket(footprint.num_acsls)]++;
+
+    if (top_k == 0) {
+      continue;
+    }
+    if (top.size() < top_k) {
+      top.push_back({it.first, footprint});
+      std::push_heap(top.begin(), top.end(), larger);
+    }
+    else if (footprint.bytes > top.front().footprint.bytes) {
+      std::pop_heap(top.begin(), top.end(), larger);
+      top.back() = {it.first, footprint};
+      std::push_heap(top.begin(), top.end(), larger);
+    }
+  }
+  read_lock_requests.unlock();
+
+  std::shared_lock<utils::SharedMutex> read_lock_closed_requests(_mutex_closed_requests);
+  stats.num_closed_requests = _closed_requests.size();
+  for (const auto& it : _closed_requests) {
+    addFootprint(stats.total, it.second->getFootprint());
+  }
+  read_lock_closed_requests.unlock();
+
+  std::sort_heap(top.begin(), top.end(), larger);
+  stats.top_requests = std::move(top);
+  return stats;
+}
+
 // -----------
 // Identifiers
 //------------
 
-std::string Server::getSid() {
+const std::string& Server::getSid() {
   return _sid;
 }
 
+bool Server::isSelectiveReplication() {
+  return _selective_replication;
+}
+
+bool Server::isPartitionedMode() {
+  return _partitioned_mode;
+}
+
 std::string Server::genRid() {
   return "rv_" + _sid + '_' + std::to_string(_next_rid.fetch_add(1));
 }
 
 std::string Server::genBid(metadata::Request * request) {
-  return "rv_" + _sid + "_" + request->genId();
+  const std::string& id = request->genId();
+  std::string bid;
+  bid.reserve(4 + _sid.size() + id.size());
+  bid.append("rv_").append(_sid).append(1, '_').append(id);
+  return bid;
 }
 
-std::pair<std::string, std::string> Server::parseFullId(const std::string& full_id) {
+std::string_view Server::parseBranchSid(std::string_view bid) {
+  // FORMAT: rv_<sid>_<id> (all replicas have sids of the same size)
+  if (bid.size() <= 4 + _sid.size() || bid.compare(0, 3, "rv_") != 0 || bid[3 + _sid.size()] != '_') {
+    return std::string_view();
+  }
+  return bid.substr(3, _sid.size());
+}
+
+std::pair<std::string_view, std::string_view> Server::parseFullId(std::string_view full_id) {
   size_t delimiter_pos = full_id.find(utils::FULL_ID_DELIMITER);
-  std::string primary_id, secondary_id;
+  std::string_view primary_id, secondary_id;
 
   // FORMAT: <primary_id>:<secondary_id>
-  if (delimiter_pos != std::string::npos) {
+  if (delimiter_pos != std::string_view::npos) {
     primary_id = full_id.substr(0, delimiter_pos);
     secondary_id = full_id.substr(delimiter_pos+1);
   }
@@ -229,23 +642,41 @@ std::pair<std::string, std::string> Server::parseFullId(const std::string& full_
   return std::make_pair(primary_id, secondary_id);
 }
 
-std::string Server::composeFullId(const std::string& primary_id, const std::string& secondary_id) {
+std::string Server::composeFullId(std::string_view primary_id, std::string_view secondary_id) {
+  std::string full_id;
+  composeFullId(primary_id, secondary_id, full_id);
+  return full_id;
+}
+
+void Server::composeFullId(std::string_view primary_id, std::string_view secondary_id, std::string& full_id) {
   if (secondary_id.empty()) {
-    return primary_id;
+    full_id.assign(primary_id);
+    return;
   }
-  return primary_id + utils::FULL_ID_DELIMITER + secondary_id;
+  full_id.clear();
+  full_id.reserve(primary_id.size() + 1 + secondary_id.size());
+  full_id.append(primary_id).append(1, utils::FULL_ID_DELIMITER).append(secondary_id);
 }
 
 // -----------
 // Helpers
 //------------
 
+metadata::Subscriber::OverflowPolicy Server::_parseOverflowPolicy(const std::string& name) {
+  metadata::Subscriber::OverflowPolicy overflow_policy;
+  if (!metadata::Subscriber::parseOverflowPolicy(name, overflow_policy)) {
+    spdlog::critical("invalid subscribers overflow policy '{}': using 'drop_oldest'", name);
+    return metadata::Subscriber::OVERFLOW_DROP_OLDEST;
+  }
+  return overflow_policy;
+}
+
 std::string Server::addNextACSL(metadata::Request * request, const std::string& acsl_id, bool gen_id) {
   return request->addNextACSL(_sid, acsl_id, gen_id);
 }
 
-metadata::Request * Server::getRequest(const std::string& rid) {
-  std::shared_lock<std::shared_mutex> lock(_mutex_requests); 
+metadata::Request * Server::getRequest(std::string_view rid) {
+  std::shared_lock<utils::SharedMutex> lock(_mutex_requests); 
   auto pair = _requests.find(rid);
   // return request if it was found
   if (pair != _requests.end()) {
@@ -253,7 +684,7 @@ metadata::Request * Server::getRequest(const std::string& rid) {
   }
 
   // check if request is closed already
-  std::shared_lock<std::shared_mutex> read_lock_closed_requests(_mutex_closed_requests);
+  std::shared_lock<utils::SharedMutex> read_lock_closed_requests(_mutex_closed_requests);
   auto it = _closed_requests.find(rid);
   // found closed request
   if (it != _closed_requests.end()) {
@@ -264,8 +695,8 @@ metadata::Request * Server::getRequest(const std::string& rid) {
   return nullptr;
 }
 
-metadata::Request * Server::getOrRegisterRequest(std::string rid) {
-  std::shared_lock<std::shared_mutex> read_lock(_mutex_requests); 
+metadata::Request * Server::getOrRegisterRequest(std::string_view rid) {
+  std::shared_lock<utils::SharedMutex> read_lock(_mutex_requests); 
 
   // rid is not empty so we try to get the request
   if (!rid.empty()) {
@@ -278,12 +709,10 @@ metadata::Request * Server::getOrRegisterRequest(std::string rid) {
   read_lock.unlock();
 
   // generate new rid
-  if (rid.empty()) {
-    rid = genRid();
-  }
+  const std::string& new_rid = rid.empty() ? genRid() : std::string(rid);
 
   // check if request is closed already
-  /* std::shared_lock<std::shared_mutex> read_lock_closed_requests(_mutex_closed_requests);
+  /* std::shared_lock<utils::SharedMutex> read_lock_closed_requests(_mutex_closed_requests);
   auto it = _closed_requests.find(rid);
   // found closed request
   if (it != _closed_requests.end()) {
@@ -292,15 +721,15 @@ metadata::Request * Server::getOrRegisterRequest(std::string rid) {
   read_lock_closed_requests.unlock(); */
 
   // otherwise, register request for the first time
-  std::unique_lock<std::shared_mutex> write_lock(_mutex_requests);
+  std::unique_lock<utils::SharedMutex> write_lock(_mutex_requests);
   // sanity check for race conditions between unlocking read lock and locking write lock
-  auto it = _requests.find(rid);
+  auto it = _requests.find(new_rid);
   if (it != _requests.end()) {
     return it->second;
   }
   replicas::VersionRegistry * versionsRegistry = new replicas::VersionRegistry(_wait_replica_timeout_s);
-  metadata::Request * request = new metadata::Request(rid, versionsRegistry);
-  _requests.insert({rid, request});
+  metadata::Request * request = new metadata::Request(new_rid, versionsRegistry);
+  _requests.insert({new_rid, request});
   return request;
 }
 
@@ -321,35 +750,45 @@ std::string Server::registerBranchGTest(metadata::Request * request,
 
 metadata::Branch * Server::registerBranch(metadata::Request * request, 
   const std::string& acsl_id, const std::string& service, 
-  const utils::ProtoVec& regions, const std::string& tag, const std::string& current_service_bid, 
-  const std::string& bid, bool monitor, bool replicated) {
+  const utils::ProtoVec& regions, const std::string& tag, std::string_view current_service_bid, 
+  const std::string& bid, bool monitor, bool replicated, bool compact) {
 
-  metadata::Branch * branch = request->registerBranch(acsl_id, bid, service, tag, regions, current_service_bid, replicated);
+  metadata::Branch * branch = request->registerBranch(acsl_id, bid, service, tag, regions, current_service_bid, replicated, compact);
   // unexpected error
   if (!branch) {
     return branch;
   }
 
-  const std::string& composed_bid = composeFullId(bid, request->getRid());
   if (monitor) {
-    publishBranches(service, tag, composed_bid);
+    publishBranches(service, tag, composeFullId(bid, request->getRid()), regions);
   }
   return branch;
 }
 
-int Server::closeBranch(metadata::Request * request, const std::string& bid, const std::string& region) {
-  int closed = request->closeBranch(bid, region);
+int Server::closeBranch(metadata::Request * request, std::string_view bid, const std::string& region,
+  bool * globally_closed) {
+  bool closed_all_regions = false;
+  int closed = request->closeBranch(bid, region, &closed_all_regions);
+  if (globally_closed != nullptr) {
+    *globally_closed = closed_all_regions;
+  }
+
+  // only the replica that registered the branch closes it in the replicas that track its counters
+  // (every full replica eventually observes the last close, possibly replicated from another replica)
+  if (closed_all_regions && _closed_branch_listener && parseBranchSid(bid) == _sid) {
+    _closed_branch_listener(request, bid);
+  }
 
   // if all branches are closed we move the request to the closed structure
   //FIXME
   /* if (closed == 2) {
-    std::unique_lock<std::shared_mutex> write_lock_requests(_mutex_requests);
+    std::unique_lock<utils::SharedMutex> write_lock_requests(_mutex_requests);
     const std::string& rid = request->getRid();
     _requests.erase(rid);
     write_lock_requests.unlock();
 
     // sanity check
-    std::unique_lock<std::shared_mutex> write_lock_closed_requests(_mutex_closed_requests);
+    std::unique_lock<utils::SharedMutex> write_lock_closed_requests(_mutex_closed_requests);
     if (_closed_requests.count(rid) != 0) {
       delete _closed_requests[rid];
     }
@@ -367,29 +806,49 @@ int Server::closeBranch(metadata::Request * request, const std::string& bid, con
 
 int Server::wait(metadata::Request * request, const std::string& acsl_id, 
   const std::string& service, const::std::string& region, 
-  std::string tag, bool async, int timeout, std::string current_service, bool wait_deps) {
+  std::string tag, bool async, int timeout, std::string current_service, bool wait_deps,
+  metadata::WaitTrace * trace) {
 
   int result;
   metadata::Subscriber * subscriber;
   const std::string& rid = request->getRid();
+  auto start_ts = std::chrono::steady_clock::now();
+
+  if (trace != nullptr) {
+    trace->setContext(service, region, tag);
+  }
 
   if (!service.empty() && !region.empty())
-    result = request->waitServiceRegion(acsl_id, service, region, tag, async, timeout, current_service, wait_deps);
+    result = request->waitServiceRegion(acsl_id, service, region, tag, async, timeout, current_service, wait_deps, trace);
   else if (!service.empty())
-    result = request->waitService(acsl_id, service, tag, async, timeout, current_service, wait_deps);
+    result = request->waitService(acsl_id, service, tag, async, timeout, current_service, wait_deps, trace);
   else if (!region.empty())
-    result = request->waitRegion(acsl_id, region, async, timeout, current_service);
+    result = request->waitRegion(acsl_id, region, async, timeout, current_service, trace);
   else
-    result = request->wait(acsl_id, async, timeout, current_service);
+    result = request->wait(acsl_id, async, timeout, current_service, trace);
 
   // TODO: REMOVE THIS FOR FINAL RELEASE!
-  //spdlog::debug("PREVENTED INCONSISTENCY? RESULT = {}", result);
+  SPDLOG_DEBUG("PREVENTED INCONSISTENCY? RESULT = {}", result);
   if (result == 1) {
     _prevented_inconsistencies.fetch_add(1);
   }
+  waitDurationHistogram(result)->observe(metrics::elapsedSeconds(start_ts));
   return result;
 }
 
+void Server::exportWaitTrace(metadata::WaitTrace * trace) {
+  if (!_wait_traces_stream.is_open()) return;
+
+  // FORMAT: one OTLP/JSON request per line (as in the file exporter of the OpenTelemetry collector)
+  const std::string& line = trace->toOtlpJson(_sid).dump() + "\n";
+  std::unique_lock<std::mutex> lock(_mutex_wait_traces);
+  _wait_traces_stream << line;
+  if (!_wait_traces_stream) {
+    LOG_ERROR_RATE_LIMITED("could not write to wait traces file '{}'", _wait_traces_file);
+    _wait_traces_stream.clear();
+  }
+}
+
 utils::Status Server::checkStatus(metadata::Request * request, const std::string& acsl_id, 
   const std::string& service, const std::string& region, bool detailed) {
 
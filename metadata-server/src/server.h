@@ -6,8 +6,12 @@
 #include "metadata/subscriber.h"
 #include "replicas/version_registry.h"
 #include "replicas/replica_client.h"
+#include "utils/flat_map.h"
 #include "utils/grpc_service.h"
 #include "utils/metadata.h"
+#include "utils/locks.h"
+#include "metrics/metrics.h"
+#include <algorithm>
 #include <atomic>
 #include <vector>
 #include <mutex>
@@ -15,14 +19,18 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 #include <fstream>
 #include <chrono>
 #include <iomanip>
 #include <sstream>
+#include <map>
 #include <set>
-#include "spdlog/spdlog.h"
+#include <unordered_set>
+#include <functional>
+#include "utils/log.h"
 #include "spdlog/fmt/ostr.h"
 #include <nlohmann/json.hpp>
 
@@ -44,22 +52,110 @@ namespace rendezvous {
             const int _cleanup_subscribers_interval_m;
             const int _cleanup_subscribers_validity_m;
             const int _subscribers_refresh_interval_s;
+            const int _subscribers_queue_capacity;
+            const metadata::Subscriber::OverflowPolicy _subscribers_overflow_policy;
+            const std::string _subscribers_spill_dir;
             const int _wait_replica_timeout_s;
+            const bool _selective_replication;
+            const bool _partitioned_mode;
+            // partitioned mode: tells whether a request is owned by the current replica (set before serving requests)
+            std::function<bool(std::string_view)> _is_request_owner;
+            // selective replication: called once a branch registered by the current replica is closed in all its regions (set before serving requests)
+            std::function<void(metadata::Request *, std::string_view)> _closed_branch_listener;
+            // OTLP/JSON file where traced wait calls are exported (empty if disabled)
+            const std::string _wait_traces_file;
+            // opened once for the server's lifetime (buffered, flushed when the server is destroyed)
+            std::ofstream _wait_traces_stream;
+            std::mutex _mutex_wait_traces;
 
             const std::string _sid;
             std::atomic<long> _next_rid;
             
             // <rid, request_ptr>
-            std::shared_mutex _mutex_requests;
-            std::shared_mutex _mutex_closed_requests;
-            std::unordered_map<std::string, metadata::Request*> _requests;
-            std::unordered_map<std::string, metadata::Request*> _closed_requests;
+            utils::SharedMutex _mutex_requests LOCK_SITE("server.requests");
+            utils::SharedMutex _mutex_closed_requests LOCK_SITE("server.closed_requests");
+            utils::FlatMap<metadata::Request*> _requests;
+            utils::FlatMap<metadata::Request*> _closed_requests;
 
-            // <service w/ tag, <region, subscriber_ptr>>
-            std::unordered_map<std::string, std::unordered_map<std::string, metadata::Subscriber*>> _subscribers;
-            std::shared_mutex _mutex_subscribers;
+            // Helper structure for subscriptions
+            typedef struct SubscriptionStruct {
+                std::string service;
+                std::string region;
+                // sorted and without duplicates
+                std::vector<std::string> tags;
+                metadata::Subscriber * subscriber;
+            } Subscription;
+
+            // <subscription key (service, region, tags), subscription>
+            std::unordered_map<std::string, Subscription> _subscribers;
+            // <service, <region, <tag, subscriber_ptrs>>>: empty region or tag matches every region or tag
+            std::unordered_map<std::string, std::unordered_map<std::string, 
+                std::unordered_map<std::string, std::vector<metadata::Subscriber*>>>> _subscribers_index;
+            utils::SharedMutex _mutex_subscribers LOCK_SITE("server.subscribers");
+            // used to name the spill file of each subscriber (protected by the subscribers write lock)
+            long _next_subscriber_id;
+            // called when a service gets its first subscriber or loses its last one (under the subscribers write lock)
+            std::function<void(const std::string&, bool, uint64_t)> _subscribed_service_listener;
+            // orders the changes reported to the listener (protected by the subscribers write lock)
+            uint64_t _subscribed_service_version;
+
+            // collectors of metrics computed from the server's structures (removed when server is destroyed)
+            std::vector<int> _metrics_collectors;
+
+            // <service, remote replicas (sids) with subscribers>
+            std::unordered_map<std::string, std::unordered_set<std::string>> _remote_subscribers;
+            // <service, <remote replica (sid), version of its last announcement>>: announcements may arrive out of order
+            std::unordered_map<std::string, std::unordered_map<std::string, uint64_t>> _remote_subscribers_versions;
+            utils::SharedMutex _mutex_remote_subscribers LOCK_SITE("server.remote_subscribers");
+
+            /**
+             * Remove subscriber from the subscribers index
+             * Caller must hold the subscribers write lock
+             * 
+             * @param subscription The subscription of the subscriber
+             */
+            void _unindexSubscriber(const Subscription& subscription);
+
+            /**
+             * Apply a function to every subscriber interested in a branch
+             * Caller must hold the subscribers read lock
+             * 
+             * @param service
+             * @param tag
+             * @param regions Regions of the branch (empty if branch is global)
+             * @param fn Called with the region of the subscription and the subscriber
+             */
+            void _forEachSubscriber(const std::string& service, const std::string& tag, const utils::ProtoVec& regions,
+                const std::function<void(const std::string&, metadata::Subscriber*)>& fn);
+
+            /**
+             * Parse overflow policy from settings (defaults to drop oldest)
+             * 
+             * @param name The name of the policy
+             * @return The overflow policy
+             */
+            static metadata::Subscriber::OverflowPolicy _parseOverflowPolicy(const std::string& name);
 
         public:
+            // Helper structure for the footprint of a single request
+            typedef struct RequestStatsStruct {
+                std::string rid;
+                metadata::Request::Footprint footprint;
+            } RequestStats;
+
+            // Helper structure for memory stats of all requests
+            typedef struct StatsStruct {
+                int num_requests;
+                int num_closed_requests;
+                // sum of all requests
+                metadata::Request::Footprint total;
+                // largest live requests first
+                std::vector<RequestStats> top_requests;
+                // <upper bound (power of two), number of live requests>
+                std::map<int, int> branches_per_request;
+                std::map<int, int> acsls_per_request;
+            } Stats;
+
             Server(std::string sid, json settings);
             Server(std::string sid);
             ~Server();
@@ -67,13 +163,15 @@ namespace rendezvous {
             std::atomic<int> _prevented_inconsistencies = 0;
 
             /**
-             * Get subscriber associated with the service and region
+             * Get subscriber associated with the service, region and tags
              * 
              * @param service
-             * @param region
+             * @param region Region of the subscriber (empty to receive branches of all regions)
+             * @param tags Tags of interest (empty to receive branches of all tags)
              * @return metadata::Subscriber* 
              */
-            metadata::Subscriber * getSubscriber(const std::string& service, const std::string& region);
+            metadata::Subscriber * getSubscriber(const std::string& service, const std::string& region, 
+                std::vector<std::string> tags = {});
 
             /**
              * Publish branches for interested subscribers
@@ -81,8 +179,92 @@ namespace rendezvous {
              * @param service
              * @param tag
              * @param bid 
+             * @param regions Regions of the branch (empty if branch is global)
+             */
+            void publishBranches(const std::string& service, const std::string& tag, const std::string& bid, 
+                const utils::ProtoVec& regions);
+
+            /**
+             * Check if a monitored branch can be published without overflowing subscribers that reject new branches
+             * 
+             * @param service
+             * @param tag
+             * @param regions Regions of the branch (empty if branch is global)
+             * @return false if the branch should be rejected and true otherwise
+             */
+            bool canPublishBranches(const std::string& service, const std::string& tag, const utils::ProtoVec& regions);
+
+            /**
+             * Check if a published branch no longer needs to be delivered to the subscribers of a region
+             * 
+             * @param composed_bid The full identifier of the branch
+             * @param region The region of the subscriber
+             * @return true if branch is closed in the region (or no longer exists) and false otherwise
+             * (unknown branches of requests owned by other replicas are never reported as closed)
+             */
+            bool isBranchClosed(const std::string& composed_bid, const std::string& region);
+
+            /**
+             * Mark a branch as acked in the subscribers that may have received it, so that it can be removed 
+             * from their logs (used for branches of requests owned by other replicas that were closed through this replica)
+             * 
+             * @param composed_bid The full identifier of the branch
+             * @param region The closed region (empty for the global region)
+             */
+            void ackBranch(const std::string& composed_bid, const std::string& region);
+
+            /**
+             * Set the function that tells whether a request is owned by the current replica (partitioned mode)
+             * Must be set before serving requests
+             * 
+             * @param is_request_owner
+             */
+            void setRequestOwnership(std::function<bool(std::string_view rid)> is_request_owner);
+
+            /**
+             * Set the function called once a branch registered by the current replica is closed in all its regions,
+             * so that replicas that only track its counters are closed at once (selective replication)
+             * Must be set before serving requests
+             * 
+             * @param listener
+             */
+            void setClosedBranchListener(std::function<void(metadata::Request * request, std::string_view bid)> listener);
+
+            /**
+             * Set the function called when a service gets its first local subscriber (subscribed is true) 
+             * or when its last local subscriber expires (subscribed is false), along with an increasing version
+             * 
+             * @param listener
              */
-            void publishBranches(const std::string& service, const std::string& tag, const std::string& bid);
+            void setSubscribedServiceListener(std::function<void(const std::string& service, bool subscribed, uint64_t version)> listener);
+
+            /**
+             * Register a remote replica that has subscribers for the service
+             * 
+             * @param sid The remote replica id
+             * @param service
+             * @param version Version of the announcement (ignored if an announcement with a higher version was seen)
+             * @return true if the remote subscriber was registered and false if the announcement is outdated
+             */
+            bool addRemoteSubscriber(const std::string& sid, const std::string& service, uint64_t version = 0);
+
+            /**
+             * Unregister a remote replica that no longer has subscribers for the service
+             * 
+             * @param sid The remote replica id
+             * @param service
+             * @param version Version of the announcement (ignored if an announcement with a higher version was seen)
+             * @return true if the remote subscriber was unregistered and false if the announcement is outdated
+             */
+            bool removeRemoteSubscriber(const std::string& sid, const std::string& service, uint64_t version);
+
+            /**
+             * Get all remote replicas that have subscribers for the service
+             * 
+             * @param service
+             * @return set of remote replicas ids
+             */
+            std::unordered_set<std::string> getRemoteSubscribers(const std::string& service);
 
             /**
              * Process that periodically cleans old and disconnected subscribers
@@ -96,12 +278,40 @@ namespace rendezvous {
              */
             void initRequestsCleanup();
 
+            /**
+             * Expose metrics computed from the server's structures (live requests and subscribers' queues)
+             * 
+             */
+            void initMetrics();
+
+            /**
+             * Compute memory stats of all requests (only the requests maps are locked)
+             * 
+             * @param top_k Number of largest live requests to return
+             * @return The stats of the server
+             */
+            Stats getStats(size_t top_k);
+
             /**
              * Return server identifier
              * 
              * @return The server identifier 
              */
-            std::string getSid();
+            const std::string& getSid();
+
+            /**
+             * Return whether branches are only fully replicated to replicas of their regions
+             * 
+             * @return true if selective replication is enabled and false otherwise
+             */
+            bool isSelectiveReplication();
+
+            /**
+             * Return whether requests are partitioned among replicas (each request is owned by a single replica)
+             * 
+             * @return true if partitioned mode is enabled and false otherwise
+             */
+            bool isPartitionedMode();
 
             /**
              * Generate an identifier for a new request
@@ -118,15 +328,23 @@ namespace rendezvous {
              */
             std::string genBid(metadata::Request * request);
 
+            /**
+             * Parse the replica that registered a branch from its core identifier
+             * 
+             * @param bid The core identifier of the branch
+             * @return The sid of the replica (empty if the identifier was not generated by a replica)
+             */
+            std::string_view parseBranchSid(std::string_view bid);
+
             /**
              * Helper for parsing full id
              * - (GENERIC)      full_rid       ->   <rid, acsl_id>
              * - (CLOSE BRANCH) composed_rid   ->   <full_rid, bid>
              * 
              * @param full_id The full id to be parsed 
-             * @return rid and bid
+             * @return rid and bid (views of full_id, which must outlive them)
              */
-            std::pair<std::string, std::string> parseFullId(const std::string& full_id);
+            std::pair<std::string_view, std::string_view> parseFullId(std::string_view full_id);
 
             /**
              * Helper for composing full id
@@ -137,7 +355,16 @@ namespace rendezvous {
              * @param secondary_id The second identifier
              * @return new composed id in the format <primary_id:secondary_id>
              */
-            std::string composeFullId(const std::string& primary_id, const std::string& secondary_id);
+            std::string composeFullId(std::string_view primary_id, std::string_view secondary_id);
+
+            /**
+             * Helper for composing full id into an existing string (e.g. field of a response) to reuse its buffer
+             * 
+             * @param primary_id The first identifier
+             * @param secondary_id The second identifier
+             * @param full_id Set to the composed id in the format <primary_id:secondary_id>
+             */
+            void composeFullId(std::string_view primary_id, std::string_view secondary_id, std::string& full_id);
 
             /**
              * Register a new sub request originating from an async branch within the current subrequest
@@ -161,7 +388,7 @@ namespace rendezvous {
              * @param rid Request identifier
              * @return Request if found, otherwise return nullptr
              */
-            metadata::Request * getRequest(const std::string& rid);
+            metadata::Request * getRequest(std::string_view rid);
 
             /**
              * Tr
@@ -177,7 +404,7 @@ namespace rendezvous {
              * @param rid Request identifier
              * @return Request if successfully registered, otherwise return nullptr
              */
-            metadata::Request * getOrRegisterRequest(std::string rid);
+            metadata::Request * getOrRegisterRequest(std::string_view rid);
 
             // helper for GTest: it calls registerBranch method
             std::string registerBranchGTest(metadata::Request * request, 
@@ -194,13 +421,14 @@ namespace rendezvous {
              * @param current_service_bid The parent service in the dependency graph
              * @param monitor Monitor branch by publishing identifier to subscribers
              * @param bid The set of branches identifier: empty if request is from client
+             * @param compact Only track counters of the branch (replicated from selective replication)
              * @return 
              * - The new identifier (core_bid) of the set of branches 
              * - Or empty if an error ocurred (branches already exist with bid)
              */
             metadata::Branch * registerBranch(metadata::Request * request, const std::string& acsl_id, const std::string& service, 
-                const utils::ProtoVec& regions, const std::string& tag, const std::string& current_service, 
-                const std::string& bid, bool monitor, bool replicated = false);
+                const utils::ProtoVec& regions, const std::string& tag, std::string_view current_service_bid, 
+                const std::string& bid, bool monitor, bool replicated = false, bool compact = false);
 
             /**
              * Close a branch according to its identifier
@@ -209,12 +437,14 @@ namespace rendezvous {
              * @param bid The identifier of the set of branches where the current branch was registered
              * @param region Region where branch was registered
              * @param service Service where branch was registered
+             * @param globally_closed Optional output set to true only by the close that closed the last opened region
              * @return one of three values:
              * - 1 if branch was closed
              * - 0 if branch was already closed before
              * - (-1) if encountered error from either (i) wrong bid, wrong region, or error in sub_requests tbb map
              */
-            int closeBranch(metadata::Request * request, const std::string& bid, const std::string& region);
+            int closeBranch(metadata::Request * request, std::string_view bid, const std::string& region,
+                bool * globally_closed = nullptr);
 
             /**
              * Wait until request is closed for a given context (none, service, region or service and region)
@@ -228,6 +458,7 @@ namespace rendezvous {
              * @param timeout Timeout in seconds
              * @param current_service Current service doing the wait call
              * @param wait_deps If enabled, it waits for all dependencies of the service
+             * @param trace Optional trace that records the branches blocking the call
              * @return Possible return values:
              * - 0 if call did not block, 
              * - 1 if inconsistency was prevented
@@ -238,7 +469,15 @@ namespace rendezvous {
              */
             int wait(metadata::Request * request, const std::string& acsl_id, const std::string& service, 
                 const::std::string& region, std::string tag = "", 
-                bool async = false, int timeout = 0, std::string current_service = "", bool wait_deps = false);
+                bool async = false, int timeout = 0, std::string current_service = "", bool wait_deps = false,
+                metadata::WaitTrace * trace = nullptr);
+
+            /**
+             * Append a finished trace of a wait call to the traces file (if enabled in the settings)
+             * 
+             * @param trace The finished trace
+             */
+            void exportWaitTrace(metadata::WaitTrace * trace);
             
             /**
              * Check status of the request for a given context (none, service, region or service and region)
@@ -2,19 +2,65 @@
 
 using namespace service;
 
+// number of largest requests returned by the stats call when not provided
+static const int DEFAULT_STATS_TOP_K = 10;
+
 ClientServiceImpl::ClientServiceImpl(
   std::shared_ptr<rendezvous::Server> server, 
-  std::vector<std::string> addrs, bool consistency_checks)
-  : _server(server), _num_wait_calls(0), _replica_client(addrs),
-  _num_replicas(addrs.size()+1) /* current replica is not part of the address vector */ ,
+  std::vector<replicas::ReplicaClient::Replica> replicas, bool consistency_checks)
+  : _server(server), _num_wait_calls(0),
+  // partitioned mode: requests are not replicated since they are owned by a single replica
+  // (replica client only routes monitored branches to the replicas with subscribers)
+  _replica_client(replicas, server->isSelectiveReplication()),
+  _partition_client(server->isPartitionedMode() ? std::make_shared<replicas::PartitionClient>(server->getSid(), replicas) : nullptr),
+  _partitioned_mode(server->isPartitionedMode()),
+  _announce_subscribers(!replicas.empty() && (server->isSelectiveReplication() || server->isPartitionedMode())),
+  _num_replicas(server->isPartitionedMode() ? 1 : replicas.size()+1) /* current replica is not part of the replicas vector */ ,
   _consistency_checks(consistency_checks)
   
   {
 
   _pending_service_branches = std::unordered_map<std::string, PendingServiceBranch*>();
+
+  // subscribers keep branches of requests owned by other replicas until they are acked
+  if (_partitioned_mode) {
+    _server->setRequestOwnership([partition_client = _partition_client](std::string_view rid) {
+      return partition_client->isOwner(rid);
+    });
+  }
+
+  // replicas outside the subscribed regions (or owners of requests in partitioned mode) must keep sending
+  // branches to this replica while it has subscribers for the service (announced once per service and retracted when they expire)
+  if (_announce_subscribers) {
+    _server->setSubscribedServiceListener([this](const std::string& service, bool subscribed, uint64_t version) {
+      if (subscribed) {
+        _replica_client.addSubscriber(_server->getSid(), service, version);
+      }
+      else {
+        _replica_client.removeSubscriber(_server->getSid(), service, version);
+      }
+    });
+  }
+
+  // replicas outside the regions of a branch only track its counters and are closed at once
+  // by the replica that registered the branch (when it observes the close of its last region)
+  if (_num_replicas > 1 && _server->isSelectiveReplication()) {
+    _server->setClosedBranchListener([this](metadata::Request * rv_request, std::string_view bid) {
+      _closeCompactBranch(rv_request, bid);
+    });
+  }
 }
 
-metadata::Request * ClientServiceImpl::_getRequest(const std::string& rid) {
+ClientServiceImpl::~ClientServiceImpl() {
+  if (_announce_subscribers) {
+    _server->setSubscribedServiceListener(nullptr);
+  }
+  if (_num_replicas > 1 && _server->isSelectiveReplication()) {
+    _server->setClosedBranchListener(nullptr);
+  }
+}
+
+metadata::Request * ClientServiceImpl::_getRequest(std::string_view rid) {
   metadata::Request * request;
   // one metadata server
   if (_num_replicas == 1) {
@@ -27,29 +73,236 @@ metadata::Request * ClientServiceImpl::_getRequest(const std::string& rid) {
   return request;
 }
 
-grpc::Status ClientServiceImpl::Subscribe(grpc::ServerContext * context,
-  const rendezvous::SubscribeMessage * request,
-  grpc::ServerWriter<rendezvous::SubscribeResponse> * writer) {
+metadata::Subscriber * ClientServiceImpl::_initSubscriber(const rendezvous::SubscribeMessage& request, uint64_t& member_id) {
+  SPDLOG_INFO("> [SUB] loading subscriber for service '{}' and region '{}'", request.service(), request.region());
+  std::vector<std::string> tags(request.tags().begin(), request.tags().end());
+  metadata::Subscriber * subscriber = _server->getSubscriber(request.service(), request.region(), tags);
 
-  //if (!_consistency_checks) return grpc::Status::OK;
-  spdlog::info("> [SUB] loading subscriber for service '{}' and region '{}'", request->service(), request->region());
-  metadata::Subscriber * subscriber = _server->getSubscriber(request->service(), request->region());
-  rendezvous::SubscribeResponse response;
+  // consumer group: branches are partitioned among all members of the group
+  member_id = metadata::Subscriber::NO_MEMBER;
+  if (!request.group().empty()) {
+    member_id = subscriber->joinGroup(request.group(), request.offset());
+  }
+  // resume from the last offset seen by the subscriber (replays branches that were not closed yet)
+  else {
+    uint64_t offset = subscriber->seek(request.offset());
+    SPDLOG_INFO("> [SUB] resuming subscriber for service '{}' and region '{}' at offset {}", request.service(), request.region(), offset);
+  }
+
+  return subscriber;
+}
+
+void ClientServiceImpl::_streamBranches(grpc::ServerContext * context, metadata::Subscriber * subscriber, 
+  uint64_t member_id, int batch_size, const std::function<bool(const rendezvous::SubscribeResponse&)>& write) {
 
+  rendezvous::SubscribeResponse response;
   while (!context->IsCancelled()) {
-    auto subscribedBranch = subscriber->pop(context);
-    if (!subscribedBranch.bid.empty()) {
+    auto subscribedBranches = subscriber->popBatch(context, std::max(batch_size, 1), member_id);
+    // only returns without branches when the connection was cancelled
+    if (subscribedBranches.empty()) {
+      break;
+    }
+
+    // send all available branches (up to batch size) in a single response
+    if (batch_size > 1) {
+      response.clear_bids();
+      response.clear_tags();
+      for (auto& subscribedBranch : subscribedBranches) {
+        response.add_bids(std::move(subscribedBranch.bid));
+        response.add_tags(std::move(subscribedBranch.tag));
+      }
+      response.set_next_offset(subscribedBranches.back().offset + 1);
+    }
+    else {
+      const auto& subscribedBranch = subscribedBranches.front();
       response.set_bid(subscribedBranch.bid);
       response.set_tag(subscribedBranch.tag);
-      //spdlog::debug("< [SUB] sending bid -->  '{}' for tag '{}'", subscribedBranch.bid, subscribedBranch.tag);
-      writer->Write(response);
+      response.set_next_offset(subscribedBranch.offset + 1);
+      SPDLOG_DEBUG("< [SUB] sending bid -->  '{}' for tag '{}'", subscribedBranch.bid, subscribedBranch.tag);
+    }
+
+    // stream is broken
+    if (!write(response)) {
+      break;
     }
   }
 
-  spdlog::info("< [SUB] context CANCELLED for service '{}' and region '{}'", request->service(), request->region());
+  if (member_id != metadata::Subscriber::NO_MEMBER) {
+    subscriber->leaveGroup(member_id);
+  }
+  // consumer registered by seek when the subscriber was loaded
+  else {
+    subscriber->releaseCursor();
+  }
+}
+
+grpc::Status ClientServiceImpl::Subscribe(grpc::ServerContext * context,
+  const rendezvous::SubscribeMessage * request,
+  grpc::ServerWriter<rendezvous::SubscribeResponse> * writer) {
+
+  //if (!_consistency_checks) return grpc::Status::OK;
+  uint64_t member_id;
+  metadata::Subscriber * subscriber = _initSubscriber(*request, member_id);
+
+  _streamBranches(context, subscriber, member_id, request->batch_size(), 
+    [writer](const rendezvous::SubscribeResponse& response) { return writer->Write(response); });
+
+  SPDLOG_INFO("< [SUB] context CANCELLED for service '{}' and region '{}'", request->service(), request->region());
+  return grpc::Status::OK;
+}
+
+grpc::Status ClientServiceImpl::Monitor(grpc::ServerContext * context,
+  grpc::ServerReaderWriter<rendezvous::SubscribeResponse, rendezvous::MonitorMessage> * stream) {
+
+  // first message carries the subscription
+  rendezvous::MonitorMessage message;
+  if (!stream->Read(&message) || !message.has_subscribe()) {
+    LOG_ERROR_RATE_LIMITED("< [MON] Error: subscription not provided");
+    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_MONITOR_NO_SUBSCRIPTION);
+  }
+  const rendezvous::SubscribeMessage subscription = message.subscribe();
+  uint64_t member_id;
+  metadata::Subscriber * subscriber = _initSubscriber(subscription, member_id);
+
+  // bids are streamed to the monitor while its acks are being applied
+  std::thread writer([this, context, stream, subscriber, member_id, &subscription]() {
+    _streamBranches(context, subscriber, member_id, subscription.batch_size(), 
+      [stream](const rendezvous::SubscribeResponse& response) { return stream->Write(response); });
+  });
+
+  // each message closes a batch of branches that are now visible in the datastore
+  while (stream->Read(&message)) {
+    _closeAcks(context, subscriber, message.acks());
+  }
+
+  // monitor stopped sending acks so we also stop streaming bids
+  // (writer is woken up since it may be waiting for new branches)
+  subscriber->cancel(context);
+  writer.join();
+  subscriber->release(context);
+
+  SPDLOG_INFO("< [MON] monitor finished for service '{}' and region '{}'", subscription.service(), subscription.region());
   return grpc::Status::OK;
 }
 
+void ClientServiceImpl::_getCloseReplication(metadata::Request * rv_request, rendezvous_server::RequestContext& ctx_replica) {
+  if (utils::ASYNC_REPLICATION) {
+    const std::string& sid = _server->getSid();
+    int version = rv_request->getVersionsRegistry()->getLocalVersion(sid);
+    ctx_replica.set_sid(sid);
+    ctx_replica.set_version(version);
+  }
+}
+
+replicas::ReplicaClient::BranchScope ClientServiceImpl::_getCloseScope(metadata::Request * rv_request, std::string_view bid) {
+  replicas::ReplicaClient::BranchScope scope{};
+  if (_server->isSelectiveReplication()) {
+    metadata::Branch * branch = rv_request->getBranch(bid);
+    if (branch != nullptr) {
+      scope = _getBranchScope(branch->getService(), branch->getRegions());
+      scope.origin = _server->parseBranchSid(bid);
+    }
+  }
+  return scope;
+}
+
+void ClientServiceImpl::_closeCompactBranch(metadata::Request * rv_request, std::string_view bid) {
+  metadata::Branch * branch = rv_request->getBranch(bid);
+  if (branch == nullptr) {
+    return;
+  }
+  rendezvous_server::RequestContext ctx_replica;
+  _getCloseReplication(rv_request, ctx_replica);
+  SPDLOG_DEBUG("> [SENDING REPL CCB: {}:{}] sid: {}, version {}", rv_request->getRid(), bid, ctx_replica.sid(), ctx_replica.version());
+  _replica_client.closeCompactBranch(rv_request->getRid(), bid, branch->getRegions(), ctx_replica);
+}
+
+std::vector<std::string> ClientServiceImpl::_closeOwnedAcks(const std::vector<const rendezvous::BranchAck *>& acks) {
+  std::vector<std::string> closed_bids;
+  std::vector<replicas::ReplicaClient::ClosedBranch> closed_branches;
+  for (const rendezvous::BranchAck * ack : acks) {
+    const std::string& region = ack->region();
+    auto ids = _server->parseFullId(ack->bid());
+    std::string_view bid = ids.first;
+    std::string_view root_rid = ids.second;
+    if (bid.empty() || root_rid.empty()) {
+      LOG_ERROR_RATE_LIMITED("< [MON] Error parsing composed bid '{}'", ack->bid());
+      continue;
+    }
+
+    metadata::Request * rv_request = _getRequest(root_rid);
+    if (rv_request == nullptr) {
+      LOG_ERROR_RATE_LIMITED("< [MON: {}] Error: invalid request", root_rid);
+      continue;
+    }
+    if (rv_request->isClosed()) {
+      closed_bids.emplace_back(ack->bid());
+      continue;
+    }
+
+    int res = _server->closeBranch(rv_request, bid, region);
+    if (res == 0) {
+      LOG_ERROR_RATE_LIMITED("< [MON: {}] Error: branch not found for composed bid: {}", root_rid, ack->bid());
+      continue;
+    } else if (res == -1) {
+      LOG_ERROR_RATE_LIMITED("< [MON: {}] Error: region '{}' or branch not found after timeout for composed_bid '{}'", root_rid, region, ack->bid());
+      continue;
+    }
+    closed_bids.emplace_back(ack->bid());
+
+    if (_num_replicas > 1) {
+      auto& closed_branch = closed_branches.emplace_back();
+      closed_branch.root_rid = root_rid;
+      closed_branch.core_bid = bid;
+      closed_branch.region = region;
+      _getCloseReplication(rv_request, closed_branch.ctx_replica);
+      closed_branch.scope = _getCloseScope(rv_request, bid);
+    }
+  }
+
+  // all closes of the acks are replicated in a single call to each replica
+  if (!closed_branches.empty()) {
+    SPDLOG_DEBUG("> [SENDING REPL CBs] #{} closed branches", closed_branches.size());
+    _replica_client.closeBranches(closed_branches);
+  }
+  return closed_bids;
+}
+
+void ClientServiceImpl::_closeAcks(grpc::ServerContext * context, metadata::Subscriber * subscriber,
+  const google::protobuf::RepeatedPtrField<rendezvous::BranchAck>& acks) {
+
+  std::vector<const rendezvous::BranchAck *> owned_acks;
+  // partitioned mode: acks of requests owned by other replicas are grouped by their owner
+  std::unordered_map<std::string, rendezvous::CloseBranchesMessage> forwarded_acks;
+  for (const auto& ack : acks) {
+    std::string_view root_rid = _server->parseFullId(ack.bid()).second;
+    if (_partitioned_mode && !root_rid.empty() && !_partition_client->isOwner(root_rid)) {
+      *forwarded_acks[_partition_client->getOwner(root_rid)].add_acks() = ack;
+    }
+    else {
+      owned_acks.emplace_back(&ack);
+    }
+  }
+  _closeOwnedAcks(owned_acks);
+
+  // a single forwarded call to each owner
+  std::vector<std::string> forwarded_bids;
+  for (const auto& [owner, close_request] : forwarded_acks) {
+    rendezvous::CloseBranchesResponse close_response;
+    grpc::Status status = _partition_client->forwardToOwner(owner, context, &rendezvous::ClientService::Stub::CloseBranches, close_request, &close_response);
+    if (!status.ok()) {
+      LOG_ERROR_RATE_LIMITED("< [MON] Error: forwarded close of #{} acks to owner '{}' failed: {}", close_request.acks_size(), owner, status.error_message());
+      continue;
+    }
+    forwarded_bids.insert(forwarded_bids.end(), close_response.bids().begin(), close_response.bids().end());
+  }
+
+  // closed branches of requests owned by other replicas can now be removed from the subscriber's log
+  if (!forwarded_bids.empty()) {
+    subscriber->ack(forwarded_bids);
+  }
+}
+
 grpc::Status ClientServiceImpl::RegisterRequest(grpc::ServerContext* context, 
   const rendezvous::RegisterRequestMessage* request, 
   rendezvous::RegisterRequestResponse* response) {
@@ -57,7 +310,19 @@ grpc::Status ClientServiceImpl::RegisterRequest(grpc::ServerContext* context,
   //if (!_consistency_checks) return grpc::Status::OK;
   std::string rid = request->rid();
   metadata::Request * rv_request;
-  //spdlog::trace("> [RR] register request '{}'", rid.c_str());
+  SPDLOG_TRACE("> [RR] register request '{}'", rid.c_str());
+
+  // partitioned mode: identifier is generated here but request is registered in its owner replica
+  if (_partitioned_mode) {
+    if (rid.empty()) {
+      rid = _server->genRid();
+    }
+    if (!_partition_client->isOwner(rid)) {
+      rendezvous::RegisterRequestMessage forwarded_request(*request);
+      forwarded_request.set_rid(rid);
+      return _partition_client->forward(rid, context, &rendezvous::ClientService::Stub::RegisterRequest, forwarded_request, response);
+    }
+  }
   rv_request = _server->getOrRegisterRequest(rid);
   response->set_rid(rv_request->getRid());
   
@@ -73,7 +338,7 @@ grpc::Status ClientServiceImpl::RegisterBranch(grpc::ServerContext* context,
   rendezvous::RegisterBranchResponse* response) {
 
   //if (!_consistency_checks) return grpc::Status::OK;
-  std::string rid = request->rid();
+  const std::string& rid = request->rid();
   const std::string& bid = request->bid();
   const std::string& service = request->service();
   const std::string& tag = request->tag();
@@ -82,48 +347,59 @@ grpc::Status ClientServiceImpl::RegisterBranch(grpc::ServerContext* context,
   int num = request->regions().size();
   const auto& regions = request->regions();
   // TO BE PARSED!
-  std::string current_service_bid = request->current_service_bid();
+  std::string_view current_service_bid = request->current_service_bid();
+
+  // partitioned mode: request is handled by its owner replica
+  if (_partitioned_mode && !_partition_client->isOwner(rid)) {
+    // owner publishes the branch to the replicas with subscribers
+    return _partition_client->forward(rid, context, &rendezvous::ClientService::Stub::RegisterBranch, *request, response);
+  }
 
   if (bid.empty()) {
-    //spdlog::trace("> [RB: {}] register #{} branches on service '{}:{}' @ acsl {} (monitor={})", rid, num, service, tag, acsl_id, monitor);
+    SPDLOG_TRACE("> [RB: {}] register #{} branches on service '{}:{}' @ acsl {} (monitor={})", rid, num, service, tag, acsl_id, monitor);
   }
   else {
-    //spdlog::trace("> [RB: {}] register #{} branches with bid '{}' on service '{}:{}' @ acsl {} (monitor={})", rid, num, bid, service, tag, acsl_id, monitor);
+    SPDLOG_TRACE("> [RB: {}] register #{} branches with bid '{}' on service '{}:{}' @ acsl {} (monitor={})", rid, num, bid, service, tag, acsl_id, monitor);
   }
   
   if (service.empty()) {
-    spdlog::error("< [RB: {}] Error: service empty", rid);
+    LOG_ERROR_RATE_LIMITED("< [RB: {}] Error: service empty", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_SERVICE_EMPTY);
   }
 
   metadata::Request * rv_request = _getRequest(rid);
   if (rv_request == nullptr) {
-    spdlog::error("< [RB: {}] Error: invalid rid", rid);
+    LOG_ERROR_RATE_LIMITED("< [RB: {}] Error: invalid rid", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REQUEST);
   }
 
-  std::string core_bid = "";
-
-  if (bid.empty()) {
-    core_bid = _server->genBid(rv_request);
-  } else {
-    core_bid = _server->parseFullId(bid).first;
-  }
+  const std::string& core_bid = bid.empty() ? _server->genBid(rv_request) : std::string(_server->parseFullId(bid).first);
 
   if (!current_service_bid.empty()) {
     current_service_bid = _server->parseFullId(current_service_bid).first;
   }
 
+  // subscribers that reject new branches on overflow are not able to monitor this branch
+  if (monitor && !_server->canPublishBranches(service, tag, regions)) {
+    LOG_ERROR_RATE_LIMITED("< [RB: {}] Error: subscribers queue full for service '{}'", rid, service);
+    return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, utils::ERR_MSG_SUBSCRIBERS_QUEUE_FULL);
+  }
+
   auto branch = _server->registerBranch(rv_request, acsl_id, service, regions, tag, current_service_bid, core_bid, monitor);
 
   // could not create branch (tag already exists)
   if (!branch) {
-    spdlog::error("< [RB: {}] Error: could not register branch for core bid {}", rid, core_bid);
+    LOG_ERROR_RATE_LIMITED("< [RB: {}] Error: could not register branch for core bid {}", rid, core_bid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_REGISTERING_BRANCH);
   }
 
   response->set_rid(rid);
-  response->set_bid(_server->composeFullId(core_bid, rid));
+  _server->composeFullId(core_bid, rid, *response->mutable_bid());
+
+  // partitioned mode: subscribers of other replicas are only notified by the owner
+  if (_partitioned_mode && monitor) {
+    _replica_client.publishBranch(_server->getRemoteSubscribers(service), service, tag, response->bid(), regions);
+  }
 
   // replicate client request to remaining replicas
   if (_num_replicas > 1) {
@@ -135,12 +411,13 @@ grpc::Status ClientServiceImpl::RegisterBranch(grpc::ServerContext* context,
       ctx_replica.set_sid(sid);
       ctx_replica.set_version(new_version);
     }
-    //spdlog::debug("> [SENDING REPL RB: {}:{}:{}] sid: {}, version {}", rid, service, tag, ctx_replica.sid(), ctx_replica.version());
-    _replica_client.registerBranch(rid, acsl_id, core_bid, service, tag, regions, monitor, ctx_replica);
+    SPDLOG_DEBUG("> [SENDING REPL RB: {}:{}:{}] sid: {}, version {}", rid, service, tag, ctx_replica.sid(), ctx_replica.version());
+    auto scope = _getBranchScope(service, regions);
+    _replica_client.registerBranch(rid, acsl_id, core_bid, service, tag, regions, monitor, ctx_replica, scope);
 
   }
 
-  //spdlog::trace("< [RB: {}] registered branch with bid {} on service '{}:{}' @ acsl {} and #{} regions (monitor={})", rid, core_bid, service, tag, acsl_id, num, monitor);
+  SPDLOG_TRACE("< [RB: {}] registered branch with bid {} on service '{}:{}' @ acsl {} and #{} regions (monitor={})", rid, core_bid, service, tag, acsl_id, num, monitor);
   return grpc::Status::OK;
 }
 
@@ -151,28 +428,48 @@ grpc::Status ClientServiceImpl::RegisterBranches(grpc::ServerContext* context,
   //if (!_consistency_checks) return grpc::Status::OK;
   const std::string& rid = request->rid();
   const std::string& current_service_bid = request->current_service_bid();
-  auto branches = request->branches();
+  const auto& branches = request->branches();
 
-  //spdlog::trace("> [RBs: {}] register #{} service branches for request '{}')", rid, branches.size());
+  // partitioned mode: request is handled by its owner replica
+  if (_partitioned_mode && !_partition_client->isOwner(rid)) {
+    // owner publishes the branches to the replicas with subscribers
+    return _partition_client->forward(rid, context, &rendezvous::ClientService::Stub::RegisterBranches, *request, response);
+  }
+
+  SPDLOG_TRACE("> [RBs: {}] register #{} service branches", rid, branches.size());
 
   metadata::Request * rv_request = _getRequest(rid);
   if (rv_request == nullptr) {
-    spdlog::error("< [RBs] Error: invalid request '{}'", rid);
+    LOG_ERROR_RATE_LIMITED("< [RBs] Error: invalid request '{}'", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REQUEST);
   }
 
+  // subscribers that reject new branches on overflow are not able to monitor these branches
+  for (const auto& branch: branches) {
+    if (branch.monitor() && !_server->canPublishBranches(branch.service(), branch.tag(), branch.regions())) {
+      LOG_ERROR_RATE_LIMITED("< [RBs: {}] Error: subscribers queue full for service '{}'", rid, branch.service());
+      return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, utils::ERR_MSG_SUBSCRIBERS_QUEUE_FULL);
+    }
+  }
+
   for (const auto& branch: branches) {
     const std::string& core_bid = _server->genBid(rv_request);
     auto new_branch = _server->registerBranch(rv_request, branch.acsl(), branch.service(), branch.regions(), branch.tag(), current_service_bid, core_bid, branch.monitor());
 
     // could not create branch (tag already exists)
     if (!new_branch) {
-      spdlog::error("< [RBs] Error: could not register branch for core bid {}", core_bid);
+      LOG_ERROR_RATE_LIMITED("< [RBs] Error: could not register branch for core bid {}", core_bid);
       return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_REGISTERING_BRANCH);
     }
 
     response->set_rid(rid);
-    response->add_bids(_server->composeFullId(core_bid, rid));
+    _server->composeFullId(core_bid, rid, *response->add_bids());
+
+    // partitioned mode: subscribers of other replicas are only notified by the owner
+    if (_partitioned_mode && branch.monitor()) {
+      _replica_client.publishBranch(_server->getRemoteSubscribers(branch.service()), branch.service(), branch.tag(), 
+        response->bids(response->bids_size() - 1), branch.regions());
+    }
 
     // replicate client request to remaining replicas
     if (_num_replicas > 1) {
@@ -184,7 +481,8 @@ grpc::Status ClientServiceImpl::RegisterBranches(grpc::ServerContext* context,
         ctx_replica.set_sid(sid);
         ctx_replica.set_version(new_version);
       }
-      _replica_client.registerBranch(rid, branch.acsl(), core_bid, branch.service(), branch.tag(), branch.regions(), branch.monitor(), ctx_replica);
+      auto scope = _getBranchScope(branch.service(), branch.regions());
+      _replica_client.registerBranch(rid, branch.acsl(), core_bid, branch.service(), branch.tag(), branch.regions(), branch.monitor(), ctx_replica, scope);
     }
   }
 
@@ -218,18 +516,28 @@ grpc::Status ClientServiceImpl::CloseBranch(grpc::ServerContext* context,
 
   // parse composed id into <bid, root_rid>
   auto ids = _server->parseFullId(composed_bid);
-  const std::string& bid = ids.first;
-  const std::string& root_rid = ids.second;
+  std::string_view bid = ids.first;
+  std::string_view root_rid = ids.second;
   if (bid.empty() || root_rid.empty()) {
-    spdlog::error("< [CB] Error parsing composed bid '{}'", composed_bid);
+    LOG_ERROR_RATE_LIMITED("< [CB] Error parsing composed bid '{}'", composed_bid);
     return grpc::Status(grpc::StatusCode::INTERNAL, utils::ERR_PARSING_BID);
   }
 
-  //spdlog::trace("> [CB: {}] closing branch with bid '{}' on region '{}'", root_rid, bid, region);
+  SPDLOG_TRACE("> [CB: {}] closing branch with bid '{}' on region '{}'", root_rid, bid, region);
+
+  // partitioned mode: request is handled by its owner replica
+  if (_partitioned_mode && !_partition_client->isOwner(root_rid)) {
+    grpc::Status status = _partition_client->forward(root_rid, context, &rendezvous::ClientService::Stub::CloseBranch, *request, response);
+    // closed branch of a request owned by another replica can now be removed from the subscribers' logs
+    if (status.ok()) {
+      _server->ackBranch(composed_bid, region);
+    }
+    return status;
+  }
 
   metadata::Request * rv_request = _getRequest(root_rid);
   if (rv_request == nullptr) {
-    spdlog::error("< [CB: {}] Error: invalid request", root_rid);
+    LOG_ERROR_RATE_LIMITED("< [CB: {}] Error: invalid request", root_rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REQUEST);
   }
   if (rv_request->isClosed()) {
@@ -239,39 +547,59 @@ grpc::Status ClientServiceImpl::CloseBranch(grpc::ServerContext* context,
   // clients wants to ensure that all provided bids (previously registered) are closed
   // this happens in case of previous async register branch calls in the same service
   if (utils::ASYNC_REPLICATION && visible_bids.size() != 0) {
-    std::vector<std::string> visible_bids_vec = std::vector<std::string>();
+    std::vector<std::string_view> visible_bids_vec;
+    visible_bids_vec.reserve(visible_bids.size());
     for (const auto& visible_bid: visible_bids) {
       visible_bids_vec.emplace_back(_server->parseFullId(visible_bid).first);
     }
     bool are_visible = rv_request->waitBranchesReplicationReady(visible_bids_vec);
     if (!are_visible) {
-      spdlog::error("< [CB] Timedout waiting for #{} bids to be visible when closing branch: {}", visible_bids.size(), composed_bid);
+      LOG_ERROR_RATE_LIMITED("< [CB] Timedout waiting for #{} bids to be visible when closing branch: {}", visible_bids.size(), composed_bid);
       return grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, utils::ERR_MSG_VISIBLE_BIDS_TIMEOUT);
     }
   }
 
   int res = _server->closeBranch(rv_request, bid, region);
   if (res == 0) {
-    spdlog::error("< [CB: {}] Error: branch not found for composed bid: {}", root_rid, composed_bid);
+    LOG_ERROR_RATE_LIMITED("< [CB: {}] Error: branch not found for composed bid: {}", root_rid, composed_bid);
     return grpc::Status(grpc::StatusCode::NOT_FOUND, utils::ERR_MSG_BRANCH_NOT_FOUND);
   } else if (res == -1) {
-    spdlog::error("< [CB: {}] Error: region '{}' or branch not found after timeout for composed_bid '{}'", root_rid, region, composed_bid);
+    LOG_ERROR_RATE_LIMITED("< [CB: {}] Error: region '{}' or branch not found after timeout for composed_bid '{}'", root_rid, region, composed_bid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REGION);
   }
 
   // replicate client request to remaining replicas
   if (_num_replicas > 1) {
     rendezvous_server::RequestContext ctx_replica;
-    if (utils::ASYNC_REPLICATION) {
-      const std::string& sid = _server->getSid();
-      int version = rv_request->getVersionsRegistry()->getLocalVersion(sid);
-      ctx_replica.set_sid(sid);
-      ctx_replica.set_version(version);
+    _getCloseReplication(rv_request, ctx_replica);
+    SPDLOG_DEBUG("> [SENDING REPL CB: {}:{}] sid: {}, version {}", root_rid, bid, ctx_replica.sid(), ctx_replica.version());
+    _replica_client.closeBranch(root_rid, bid, region, ctx_replica, _getCloseScope(rv_request, bid));
+  }
+  SPDLOG_TRACE("< [CB: {}] closed branch with bid '{}' on region '{}'", root_rid, bid, region);
+  return grpc::Status::OK;
+}
+
+grpc::Status ClientServiceImpl::CloseBranches(grpc::ServerContext* context, 
+  const rendezvous::CloseBranchesMessage* request, 
+  rendezvous::CloseBranchesResponse* response) {
+
+  SPDLOG_TRACE("> [CBs] closing #{} acked branches", request->acks_size());
+  std::vector<const rendezvous::BranchAck *> acks;
+  acks.reserve(request->acks_size());
+  for (const auto& ack : request->acks()) {
+    // acks are forwarded at most once (by the replica of the monitor to the owner of their requests)
+    std::string_view root_rid = _server->parseFullId(ack.bid()).second;
+    if (_partitioned_mode && !root_rid.empty() && !_partition_client->isOwner(root_rid)) {
+      LOG_ERROR_RATE_LIMITED("< [CBs: {}] Error: request of composed bid '{}' is not owned by this replica", root_rid, ack.bid());
+      continue;
     }
-    //spdlog::debug("> [SENDING REPL CB: {}:{}] sid: {}, version {}", root_rid, bid, ctx_replica.sid(), ctx_replica.version());
-    _replica_client.closeBranch(root_rid, bid, region, ctx_replica);
+    acks.emplace_back(&ack);
   }
-  //spdlog::trace("< [CB: {}] closed branch with bid '{}' on region '{}'", root_rid, bid, region);
+
+  for (auto& closed_bid : _closeOwnedAcks(acks)) {
+    response->add_bids(std::move(closed_bid));
+  }
+  SPDLOG_TRACE("< [CBs] closed #{} acked branches", response->bids_size());
   return grpc::Status::OK;
 }
 
@@ -291,24 +619,29 @@ grpc::Status ClientServiceImpl::WaitRequest(grpc::ServerContext* context,
   //bool async = request->async();
   int timeout = request->timeout();
 
-  //spdlog::trace("> [WR: {}] wait call targeting service '{}' and region '{}' @ acsl {}", rid, service, region, acsl_id);
+  SPDLOG_TRACE("> [WR: {}] wait call targeting service '{}' and region '{}' @ acsl {}", rid, service, region, acsl_id);
+
+  // partitioned mode: request is handled by its owner replica
+  if (_partitioned_mode && !_partition_client->isOwner(rid)) {
+    return _partition_client->forward(rid, context, &rendezvous::ClientService::Stub::WaitRequest, *request, response);
+  }
 
   // validate parameters
   if (timeout < 0) {
-    spdlog::error("< [WR: {}] Error: invalid timeout ({})", rid, timeout);
+    LOG_ERROR_RATE_LIMITED("< [WR: {}] Error: invalid timeout ({})", rid, timeout);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_TIMEOUT);
   } if (!service.empty() && services.size() > 0) {
-    spdlog::error("< [WR: {}] Error: cannot provide 'service' and 'services' parameters simultaneously", rid);
+    LOG_ERROR_RATE_LIMITED("< [WR: {}] Error: cannot provide 'service' and 'services' parameters simultaneously", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_SERVICES_EXCLUSIVE);
   } if (!tag.empty() && service.empty()) {
-    spdlog::error("< [WR: {}] Error: service not specified for tag '{}'", rid, tag);
+    LOG_ERROR_RATE_LIMITED("< [WR: {}] Error: service not specified for tag '{}'", rid, tag);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_TAG_USAGE);
   }
 
   // check if request exists
   metadata::Request * rv_request = _getRequest(rid);
   if (rv_request == nullptr) {
-    spdlog::error("< [WR: {}] Error: invalid request", rid);
+    LOG_ERROR_RATE_LIMITED("< [WR: {}] Error: invalid request", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REQUEST);
   }
   if (rv_request->isClosed()) {
@@ -316,11 +649,16 @@ grpc::Status ClientServiceImpl::WaitRequest(grpc::ServerContext* context,
   }
 
   int result;
-  replicas::ReplicaClient::AsyncRequestHelper * async_request_helper = _replica_client.addWaitLog(rid, acsl_id, service);
+  replicas::ReplicaClient::AsyncRequestHelper * async_request_helper = nullptr;
+  if (_num_replicas > 1) {
+    async_request_helper = _replica_client.addWaitLog(rid, acsl_id, service);
+  }
+  // only allocated when the client asks for it
+  std::unique_ptr<metadata::WaitTrace> trace = request->trace() ? std::make_unique<metadata::WaitTrace>(rid, acsl_id) : nullptr;
 
   // perform wait on a single service
   if (services.size() == 0) {
-    result = _server->wait(rv_request, acsl_id, service, region, tag, utils::ASYNC_REPLICATION, timeout, current_service, wait_deps);
+    result = _server->wait(rv_request, acsl_id, service, region, tag, utils::ASYNC_REPLICATION, timeout, current_service, wait_deps, trace.get());
     if (result == 1) {
       response->set_prevented_inconsistency(true);
     }
@@ -328,29 +666,37 @@ grpc::Status ClientServiceImpl::WaitRequest(grpc::ServerContext* context,
   // otherwise, perform wait on multiple provided services
   else {
     for (const auto& service: services) {
-      result = _server->wait(rv_request, acsl_id, service, region, tag, utils::ASYNC_REPLICATION, timeout, current_service, wait_deps);
+      result = _server->wait(rv_request, acsl_id, service, region, tag, utils::ASYNC_REPLICATION, timeout, current_service, wait_deps, trace.get());
       if (result < 0) {
         break;
       }
     }
   }
 
-  _replica_client.removeWaitLog(rid, acsl_id, service, async_request_helper);
+  if (async_request_helper != nullptr) {
+    _replica_client.removeWaitLog(rid, acsl_id, service, async_request_helper);
+  }
+
+  if (trace != nullptr) {
+    trace->finish(result);
+    trace->toProto(response->mutable_trace());
+    _server->exportWaitTrace(trace.get());
+  }
 
   // parse errors
   if (result == -1) {
     response->set_timed_out(true);
   } else if (result == -2) {
-    spdlog::error("< [WR: {}] Error: invalid context (service/region)", rid);
+    LOG_ERROR_RATE_LIMITED("< [WR: {}] Error: invalid context (service/region)", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_SERVICE_REGION);
   } else if (result == -3) {
-    spdlog::error("< [WR: {}] Error: current service branch needs to be registered before any wait call", rid);
+    LOG_ERROR_RATE_LIMITED("< [WR: {}] Error: current service branch needs to be registered before any wait call", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_WAIT_CALL_NO_CURRENT_SERVICE);
   } else if (result == -4) {
-    spdlog::error("< [WR: {}] Error: invalid tag", rid);
+    LOG_ERROR_RATE_LIMITED("< [WR: {}] Error: invalid tag", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_TAG);
   }
-  //spdlog::trace("< [WR: {}] returning call targeting service '{}' and region '{}' (r={})", rid, service, region, result);
+  SPDLOG_TRACE("< [WR: {}] returning call targeting service '{}' and region '{}' (r={})", rid, service, region, result);
   return grpc::Status::OK;
 }
 
@@ -365,12 +711,17 @@ grpc::Status ClientServiceImpl::CheckStatus(grpc::ServerContext* context,
   const std::string& acsl_id = request->acsl().empty() ? utils::ROOT_ACSL_ID : request->acsl();
   bool detailed = request->detailed();
 
-  //spdlog::trace("> [CS] query for request '{}' on service '{}' and region '{}' @ acsl {} (detailed={})", rid, service, region, acsl, detailed);
+  SPDLOG_TRACE("> [CS] query for request '{}' on service '{}' and region '{}' @ acsl {} (detailed={})", rid, service, region, acsl_id, detailed);
+
+  // partitioned mode: request is handled by its owner replica
+  if (_partitioned_mode && !_partition_client->isOwner(rid)) {
+    return _partition_client->forward(rid, context, &rendezvous::ClientService::Stub::CheckStatus, *request, response);
+  }
 
   // check if request exists
   metadata::Request * rv_request = _getRequest(rid);
   if (rv_request == nullptr) {
-    spdlog::error("< [CS] Error: invalid request for composed rid '{}'", rid);
+    LOG_ERROR_RATE_LIMITED("< [CS] Error: invalid request for composed rid '{}'", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REQUEST);
   }
   if (rv_request->isClosed()) {
@@ -412,12 +763,17 @@ grpc::Status ClientServiceImpl::FetchDependencies(grpc::ServerContext* context,
   const std::string& service = request->service();
   const std::string& acsl_id = request->acsl().empty() ? utils::ROOT_ACSL_ID : request->acsl();
 
-  //spdlog::trace("> [FD] query for request '{}' on service '{}'", rid, service);
+  SPDLOG_TRACE("> [FD] query for request '{}' on service '{}'", rid, service);
+
+  // partitioned mode: request is handled by its owner replica
+  if (_partitioned_mode && !_partition_client->isOwner(rid)) {
+    return _partition_client->forward(rid, context, &rendezvous::ClientService::Stub::FetchDependencies, *request, response);
+  }
   
   // check if request exists
   metadata::Request * rv_request = _getRequest(rid);
   if (rv_request == nullptr) {
-    spdlog::error("< [FD] Error: invalid request '{}'", rid);
+    LOG_ERROR_RATE_LIMITED("< [FD] Error: invalid request '{}'", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REQUEST);
   }
   if (rv_request->isClosed()) {
@@ -427,7 +783,7 @@ grpc::Status ClientServiceImpl::FetchDependencies(grpc::ServerContext* context,
   const auto& result = _server->fetchDependencies(rv_request, service, acsl_id);
 
   if (result.res == INVALID_SERVICE) {
-    spdlog::error("< [FD] Error: invalid service", rid);
+    LOG_ERROR_RATE_LIMITED("< [FD] Error: invalid service '{}' for request '{}'", service, rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_SERVICE);
   }
 
@@ -443,3 +799,61 @@ grpc::Status ClientServiceImpl::FetchDependencies(grpc::ServerContext* context,
 
   return grpc::Status::OK;
 }
+
+/**
+ * Fill the footprint of a request (or the sum of all requests) in a stats response
+ * 
+ * @param rid The identifier of the request (empty for sums)
+ * @param footprint The footprint
+ * @param proto The footprint in the response
+ */
+static void footprintToProto(const std::string& rid, const metadata::Request::Footprint& footprint, 
+  rendezvous::RequestFootprint * proto) {
+
+  proto->set_rid(rid);
+  proto->set_bytes(footprint.bytes);
+  proto->set_branches_bytes(footprint.branches_bytes);
+  proto->set_service_nodes_bytes(footprint.service_nodes_bytes);
+  proto->set_acsls_bytes(footprint.acsls_bytes);
+  proto->set_wait_logs_bytes(footprint.wait_logs_bytes);
+  proto->set_registry_bytes(footprint.registry_bytes);
+  proto->set_num_branches(footprint.num_branches);
+  proto->set_num_service_nodes(footprint.num_service_nodes);
+  proto->set_num_acsls(footprint.num_acsls);
+  proto->set_num_wait_logs(footprint.num_wait_logs);
+}
+
+grpc::Status ClientServiceImpl::Stats(grpc::ServerContext*, 
+  const rendezvous::StatsMessage* request, 
+  rendezvous::StatsResponse* response) {
+
+  int top_k = request->top_k();
+  if (top_k < 0) {
+    LOG_ERROR_RATE_LIMITED("< [STATS] Error: invalid top k ({})", top_k);
+    return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_TOP_K);
+  }
+  if (top_k == 0) {
+    top_k = DEFAULT_STATS_TOP_K;
+  }
+  SPDLOG_TRACE("> [STATS] top {} requests", top_k);
+
+  const auto& stats = _server->getStats(top_k);
+  response->set_num_requests(stats.num_requests);
+  response->set_num_closed_requests(stats.num_closed_requests);
+  footprintToProto("", stats.total, response->mutable_total());
+  for (const auto& request_stats : stats.top_requests) {
+    footprintToProto(request_stats.rid, request_stats.footprint, response->add_top_requests());
+  }
+  for (const auto& [le, count] : stats.branches_per_request) {
+    rendezvous::StatsBucket * bucket = response->add_branches_per_request();
+    bucket->set_le(le);
+    bucket->set_count(count);
+  }
+  for (const auto& [le, count] : stats.acsls_per_request) {
+    rendezvous::StatsBucket * bucket = response->add_acsls_per_request();
+    bucket->set_le(le);
+    bucket->set_count(count);
+  }
+  response->set_pending_wait_logs(_replica_client.getNumPendingWaitLogs());
+  return grpc::Status::OK;
+}
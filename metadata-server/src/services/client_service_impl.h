@@ -6,6 +6,7 @@
 #include "../metadata/subscriber.h"
 #include "../server.h"
 #include "../replicas/replica_client.h"
+#include "../replicas/partition_client.h"
 #include "../utils/grpc_service.h"
 #include "../utils/metadata.h"
 #include "../utils/settings.h"
@@ -17,7 +18,9 @@
 #include <memory>
 #include <string>
 #include <chrono>
-#include "spdlog/spdlog.h"
+#include <functional>
+#include <thread>
+#include "../utils/log.h"
 #include "spdlog/fmt/ostr.h"
 #include <unordered_map>
 
@@ -28,6 +31,11 @@ namespace service {
         private:
             std::shared_ptr<rendezvous::Server> _server;
             replicas::ReplicaClient _replica_client;
+            // only built in partitioned mode (shared with the server to check the ownership of requests)
+            std::shared_ptr<replicas::PartitionClient> _partition_client;
+            const bool _partitioned_mode;
+            // subscribed services are announced to the remaining replicas (selective replication or partitioned mode)
+            const bool _announce_subscribers;
             
             // debugging purposes
             std::atomic<int> _num_wait_calls;
@@ -53,15 +61,110 @@ namespace service {
             *
             * @param rid The request identifier
             */
-            metadata::Request * _getRequest(const std::string& rid);
+            metadata::Request * _getRequest(std::string_view rid);
+
+            /**
+            * Load the subscriber for a subscription, joining its consumer group or moving its cursor
+            *
+            * @param request The subscription
+            * @param member_id Set to the member of the consumer group (or NO_MEMBER if no group was provided)
+            * @return The subscriber
+            */
+            metadata::Subscriber * _initSubscriber(const rendezvous::SubscribeMessage& request, uint64_t& member_id);
+
+            /**
+            * Stream subscribed branches until the context is cancelled or the stream is broken
+            *
+            * @param context The grpc context of the stream
+            * @param subscriber The subscriber
+            * @param member_id The member of the consumer group (or NO_MEMBER)
+            * @param batch_size Maximum number of branches per response (single branch if lower than 2)
+            * @param write Writes a response to the stream and returns false if the stream is broken
+            */
+            void _streamBranches(grpc::ServerContext * context, metadata::Subscriber * subscriber, uint64_t member_id, 
+                int batch_size, const std::function<bool(const rendezvous::SubscribeResponse&)>& write);
+
+            /**
+            * Build the replication context for the close of a branch
+            *
+            * @param rv_request The request of the branch
+            * @param ctx_replica Filled with the context sent to replicas (only with async replication)
+            */
+            void _getCloseReplication(metadata::Request * rv_request, rendezvous_server::RequestContext& ctx_replica);
+
+            /**
+            * Build the replication scope for the close of a branch, so that closes of its regions are only
+            * sent to the replicas that track its full metadata (selective replication)
+            *
+            * @param rv_request The request of the branch
+            * @param bid The core identifier of the branch
+            * @return The scope of the branch (empty if selective replication is disabled)
+            */
+            replicas::ReplicaClient::BranchScope _getCloseScope(metadata::Request * rv_request, std::string_view bid);
+
+            /**
+            * Close a branch at once in the replicas that only track its counters, once it was closed
+            * in all its regions (called on the replica that registered the branch)
+            *
+            * @param rv_request The request of the branch
+            * @param bid The core identifier of the branch
+            */
+            void _closeCompactBranch(metadata::Request * rv_request, std::string_view bid);
+
+            /**
+            * Close acknowledged branches of requests handled by this replica, replicating all closes in a single call
+            * Errors are logged and do not prevent closing the remaining branches
+            *
+            * @param acks The acknowledged branches (composed bid and region)
+            * @return The composed bids of the closed branches
+            */
+            std::vector<std::string> _closeOwnedAcks(const std::vector<const rendezvous::BranchAck *>& acks);
+
+            /**
+            * Close the branches acknowledged by a monitor, replicating all closes in a single call
+            * Errors are logged and do not prevent closing the remaining branches
+            *
+            * Acks of requests owned by other replicas (partitioned mode) are forwarded in a single call to each owner,
+            * and the closed ones are also acked in the subscriber
+            *
+            * @param context The grpc context of the monitor stream
+            * @param subscriber The subscriber of the monitor
+            * @param acks The acknowledged branches (composed bid and region)
+            */
+            void _closeAcks(grpc::ServerContext * context, metadata::Subscriber * subscriber,
+                const google::protobuf::RepeatedPtrField<rendezvous::BranchAck>& acks);
+
+            /**
+            * Build the replication scope of a branch when it is registered, used to decide which replicas
+            * receive full metadata and which ones only track counters (selective replication)
+            *
+            * @param service The service of the branch
+            * @param regions The regions of the branch (only copied with selective replication)
+            * @return The scope of the branch (empty if selective replication is disabled)
+            */
+            template <typename Regions>
+            replicas::ReplicaClient::BranchScope _getBranchScope(const std::string& service, 
+                const Regions& regions) {
+
+                replicas::ReplicaClient::BranchScope scope{};
+                if (_server->isSelectiveReplication()) {
+                    scope.regions.assign(regions.begin(), regions.end());
+                    scope.subscribers = _server->getRemoteSubscribers(service);
+                }
+                return scope;
+            }
 
         public:
-            ClientServiceImpl(std::shared_ptr<rendezvous::Server> server, std::vector<std::string> addrs, bool consistency_checks);
+            ClientServiceImpl(std::shared_ptr<rendezvous::Server> server, std::vector<replicas::ReplicaClient::Replica> replicas, bool consistency_checks);
+            ~ClientServiceImpl();
 
             grpc::Status Subscribe(grpc::ServerContext * context,
                 const rendezvous::SubscribeMessage * request,
                 grpc::ServerWriter<rendezvous::SubscribeResponse> * writer) override;
 
+            grpc::Status Monitor(grpc::ServerContext * context,
+                grpc::ServerReaderWriter<rendezvous::SubscribeResponse, rendezvous::MonitorMessage> * stream) override;
+
             grpc::Status RegisterRequest(grpc::ServerContext * context, 
                 const rendezvous::RegisterRequestMessage * request, 
                 rendezvous::RegisterRequestResponse * response) override;
@@ -78,6 +181,10 @@ namespace service {
                 const rendezvous::CloseBranchMessage * request, 
                 rendezvous::Empty * response) override;
 
+            grpc::Status CloseBranches(grpc::ServerContext * context, 
+                const rendezvous::CloseBranchesMessage * request, 
+                rendezvous::CloseBranchesResponse * response) override;
+
             grpc::Status WaitRequest(grpc::ServerContext * context, 
                 const rendezvous::WaitRequestMessage * request, 
                 rendezvous::WaitRequestResponse * response) override;
@@ -89,6 +196,10 @@ namespace service {
             grpc::Status FetchDependencies(grpc::ServerContext * context, 
                 const rendezvous::FetchDependenciesMessage * request, 
                 rendezvous::FetchDependenciesResponse * response) override;
+
+            grpc::Status Stats(grpc::ServerContext * context, 
+                const rendezvous::StatsMessage * request, 
+                rendezvous::StatsResponse * response) override;
         
     };
 }
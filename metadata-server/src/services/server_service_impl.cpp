@@ -9,10 +9,10 @@ ServerServiceImpl::ServerServiceImpl(std::shared_ptr<rendezvous::Server> server,
 
 grpc::Status ServerServiceImpl::RegisterRequest(grpc::ServerContext* context, const rendezvous_server::RegisterRequestMessage* request, rendezvous_server::Empty* response) {
   //if (!_consistency_checks) return grpc::Status::OK;
-  //spdlog::trace("> [REPLICATED RR] register request '{}'", request->rid());
+  SPDLOG_TRACE("> [REPLICATED RR] register request '{}'", request->rid());
 
   metadata::Request * rv_request;
-  std::string rid = request->rid();
+  const std::string& rid = request->rid();
   _server->getOrRegisterRequest(rid);
   return grpc::Status::OK;
 }
@@ -30,33 +30,34 @@ grpc::Status ServerServiceImpl::RegisterBranch(grpc::ServerContext* context,
   const std::string& core_bid = request->core_bid();
   const auto& regions = request->regions();
   bool monitor = request->monitor();
+  bool compact = request->compact();
   int num = request->regions().size();
 
-  //spdlog::trace("> [REPLICATED RB: {}] register #{} branches on service '{}' (monitor={}) for ids {}:{} @ acsl {}", rid, num, service, monitor, core_bid, rid, acsl_id);
+  SPDLOG_TRACE("> [REPLICATED RB: {}] register #{} branches on service '{}' (monitor={}) for ids {}:{} @ acsl {}", rid, num, service, monitor, core_bid, rid, acsl_id);
 
   metadata::Request * rv_request = _server->getOrRegisterRequest(rid);
   if (rv_request == nullptr) {
-    spdlog::critical("< [REPLICATED RB: {}] Error: invalid request for ids {}:{} @ acsl {}", rid, core_bid, rid, acsl_id);
+    LOG_CRITICAL_RATE_LIMITED("< [REPLICATED RB: {}] Error: invalid request for ids {}:{} @ acsl {}", rid, core_bid, rid, acsl_id);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REQUEST);
   }
   
   if (utils::ASYNC_REPLICATION) {
-    auto replica_ctx = request->context();
+    const auto& replica_ctx = request->context();
     auto version_registry = rv_request->getVersionsRegistry();
 
-    //spdlog::debug("> [RECEIVED REPL RB: {}:{}:{}] sid: {}, version {}", rid, service, tag, replica_ctx.sid(), replica_ctx.version());
+    SPDLOG_DEBUG("> [RECEIVED REPL RB: {}:{}:{}] sid: {}, version {}", rid, service, tag, replica_ctx.sid(), replica_ctx.version());
     version_registry->waitRemoteVersion(replica_ctx.sid(), replica_ctx.version()-1);
 
-    _server->registerBranch(rv_request, acsl_id, service, regions, tag, request->context().current_service(), core_bid, monitor);
+    _server->registerBranch(rv_request, acsl_id, service, regions, tag, request->context().current_service(), core_bid, monitor, false, compact);
 
     version_registry->updateRemoteVersion(replica_ctx.sid(), replica_ctx.version());
-    //spdlog::debug("> [APPLIED REPL RB: {}:{}:{}] sid: {}, version {}", rid, service, tag, replica_ctx.sid(), replica_ctx.version());
+    SPDLOG_DEBUG("> [APPLIED REPL RB: {}:{}:{}] sid: {}, version {}", rid, service, tag, replica_ctx.sid(), replica_ctx.version());
   }
   else {
-    _server->registerBranch(rv_request, acsl_id, service, regions, tag, request->context().current_service(), core_bid, monitor, true);
+    _server->registerBranch(rv_request, acsl_id, service, regions, tag, request->context().current_service(), core_bid, monitor, true, compact);
   }
 
-  //spdlog::trace("< [REPLICATED RB: {}] registered #{} branches on service '{}' (monitor={}) for ids {}:{} @ acsl {}", rid, num, service, monitor, core_bid, rid, acsl_id);
+  SPDLOG_TRACE("< [REPLICATED RB: {}] registered #{} branches on service '{}' (monitor={}) for ids {}:{} @ acsl {}", rid, num, service, monitor, core_bid, rid, acsl_id);
 
   return grpc::Status::OK;
 }
@@ -66,36 +67,114 @@ grpc::Status ServerServiceImpl::CloseBranch(grpc::ServerContext* context,
   rendezvous_server::Empty* response) {
 
   //if (!_consistency_checks) return grpc::Status::OK;
+  return _closeBranch(*request);
+}
 
-  const std::string& rid = request->rid();
-  const std::string& core_bid = request->core_bid();
-  const std::string& region = request->region();
+grpc::Status ServerServiceImpl::CloseBranches(grpc::ServerContext*, 
+  const rendezvous_server::CloseBranchesMessage* request, 
+  rendezvous_server::Empty*) {
+
+  // an error in one of the branches does not prevent closing the remaining ones
+  grpc::Status status = grpc::Status::OK;
+  for (const auto& branch : request->branches()) {
+    grpc::Status branch_status = _closeBranch(branch);
+    if (!branch_status.ok() && status.ok()) {
+      status = branch_status;
+    }
+  }
+  return status;
+}
+
+grpc::Status ServerServiceImpl::_closeBranch(const rendezvous_server::CloseBranchMessage& request) {
+  const std::string& rid = request.rid();
+  const std::string& core_bid = request.core_bid();
+  const std::string& region = request.region();
   
-  //spdlog::trace("> [REPLICATED CB: {}] closing branch on region '{}' for ids {}:{}", rid, region, core_bid, rid);
+  SPDLOG_TRACE("> [REPLICATED CB: {}] closing branch on region '{}' for ids {}:{}", rid, region, core_bid, rid);
 
   metadata::Request * rv_request = _server->getOrRegisterRequest(rid);
   if (rv_request == nullptr) {
-    spdlog::critical("< [REPLICATED CB: {}] Error: invalid request for ids {}:{}", rid, core_bid, rid);
+    LOG_CRITICAL_RATE_LIMITED("< [REPLICATED CB: {}] Error: invalid request for ids {}:{}", rid, core_bid, rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REQUEST);
   }
 
   if (utils::ASYNC_REPLICATION) {
     replicas::VersionRegistry * version_registry;
-    auto replica_ctx = request->context();
+    const auto& replica_ctx = request.context();
     rv_request->getVersionsRegistry()->waitRemoteVersion(replica_ctx.sid(), replica_ctx.version());
   }
 
-  // always force close branch when dealing with replicated requests
-  int res = _server->closeBranch(rv_request, core_bid, region);
+  int res;
+  // selective replication: aggregate close sent by the replica that registered the branch
+  if (request.compact()) {
+    res = _closeCompactBranch(rv_request, core_bid);
+  }
+  else {
+    // compact branches ignore region closes (replica got subscribers for the service after the branch was registered)
+    if (_server->isSelectiveReplication()) {
+      metadata::Branch * branch = rv_request->getBranch(core_bid);
+      if (branch != nullptr && branch->isCompact()) {
+        SPDLOG_TRACE("< [REPLICATED CB: {}] ignored close on region '{}' of compact branch for ids {}:{}", rid, region, core_bid, rid);
+        return grpc::Status::OK;
+      }
+    }
+    // always force close branch when dealing with replicated requests
+    res = _server->closeBranch(rv_request, core_bid, region);
+  }
 
   if (res == 0) {
-    spdlog::critical("< [REPLICATED CB: {}] Error: branch not found for ids {}:{}", rid, core_bid, rid);
+    LOG_CRITICAL_RATE_LIMITED("< [REPLICATED CB: {}] Error: branch not found for ids {}:{}", rid, core_bid, rid);
     return grpc::Status(grpc::StatusCode::NOT_FOUND, utils::ERR_MSG_BRANCH_NOT_FOUND);
   } else if (res == -1) {
-    spdlog::critical("< [REPLICATED CB: {}] Error: region '{}' not found for branch for ids {}:{}", rid, region, core_bid, rid);
+    LOG_CRITICAL_RATE_LIMITED("< [REPLICATED CB: {}] Error: region '{}' not found for branch for ids {}:{}", rid, region, core_bid, rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REGION);
   }
-  //spdlog::trace("< [REPLICATED CB: {}] closed branch on region '{}' for ids {}:{}", rid, region, core_bid, rid);
+  SPDLOG_TRACE("< [REPLICATED CB: {}] closed branch on region '{}' for ids {}:{}", rid, region, core_bid, rid);
+  return grpc::Status::OK;
+}
+
+int ServerServiceImpl::_closeCompactBranch(metadata::Request * rv_request, const std::string& core_bid) {
+  metadata::Branch * branch = rv_request->getBranch(core_bid);
+  if (branch == nullptr) {
+    return 0;
+  }
+  // only counters are tracked (in the global region of the branch)
+  if (branch->isCompact()) {
+    return _server->closeBranch(rv_request, core_bid, "");
+  }
+  // replica got the full branch while it had subscribers for its service: close the regions it did not see closed
+  for (const auto& region : branch->getRegions()) {
+    if (branch->getStatus(region) == utils::OPENED && _server->closeBranch(rv_request, core_bid, region) == -1) {
+      return -1;
+    }
+  }
+  return 1;
+}
+
+grpc::Status ServerServiceImpl::AddSubscriber(grpc::ServerContext*, 
+  const rendezvous_server::AddSubscriberMessage* request, 
+  rendezvous_server::Empty*) {
+
+  SPDLOG_INFO("> [BROADCASTED SUB] replica '{}' subscribed service '{}'", request->sid(), request->service());
+  _server->addRemoteSubscriber(request->sid(), request->service(), request->version());
+  return grpc::Status::OK;
+}
+
+grpc::Status ServerServiceImpl::RemoveSubscriber(grpc::ServerContext*, 
+  const rendezvous_server::RemoveSubscriberMessage* request, 
+  rendezvous_server::Empty*) {
+
+  SPDLOG_INFO("> [BROADCASTED UNSUB] replica '{}' unsubscribed service '{}'", request->sid(), request->service());
+  _server->removeRemoteSubscriber(request->sid(), request->service(), request->version());
+  return grpc::Status::OK;
+}
+
+grpc::Status ServerServiceImpl::PublishBranch(grpc::ServerContext*, 
+  const rendezvous_server::PublishBranchMessage* request, 
+  rendezvous_server::Empty*) {
+
+  SPDLOG_TRACE("> [PUBLISHED BRANCH] branch '{}' on service '{}:{}'", request->bid(), request->service(), request->tag());
+  _server->publishBranches(request->service(), request->tag(), request->bid(), request->regions());
   return grpc::Status::OK;
 }
 
@@ -109,17 +188,17 @@ grpc::Status ServerServiceImpl::AddWaitLog(grpc::ServerContext* context,
   const std::string& acsl_id = request->acsl();
   const std::string& target_service = request->target_service();
   
-  //spdlog::trace("> [BROADCASTED ADD WAIT] adding wait call for root rid '{}' on async zone '{}' to logs", rid, acsl_id);
+  SPDLOG_TRACE("> [BROADCASTED ADD WAIT] adding wait call for root rid '{}' on async zone '{}' to logs", rid, acsl_id);
 
   metadata::Request * rv_request = _server->getOrRegisterRequest(rid);
   if (rv_request == nullptr) {
-    spdlog::critical("< [BROADCASTED ADD WAIT] Error: invalid root rid {}", rid);
+    LOG_CRITICAL_RATE_LIMITED("< [BROADCASTED ADD WAIT] Error: invalid root rid {}", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REQUEST);
   }
 
   metadata::Request::ACSL * acsl = rv_request->_validateACSL(acsl_id);
   if (acsl == nullptr) {
-    spdlog::critical("< [BROADCASTED ADD WAIT] Error: invalid async zone {}", acsl_id);
+    LOG_CRITICAL_RATE_LIMITED("< [BROADCASTED ADD WAIT] Error: invalid async zone {}", acsl_id);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_ACSL);
   }
 
@@ -147,17 +226,17 @@ grpc::Status ServerServiceImpl::RemoveWaitLog(grpc::ServerContext* context,
   const std::string& current_service = request->context().current_service();
   const std::string& target_service = request->target_service();
   
-  //spdlog::trace("> [BROADCASTED REMOVE WAIT] remove wait call for root rid '{}' on async zone '{}' to logs", rid, acsl_id);
+  SPDLOG_TRACE("> [BROADCASTED REMOVE WAIT] remove wait call for root rid '{}' on async zone '{}' to logs", rid, acsl_id);
 
   metadata::Request * rv_request = _server->getOrRegisterRequest(rid);
   if (rv_request == nullptr) {
-    spdlog::critical("< [BROADCASTED REMOVE WAIT] Error: invalid root rid {}", rid);
+    LOG_CRITICAL_RATE_LIMITED("< [BROADCASTED REMOVE WAIT] Error: invalid root rid {}", rid);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_REQUEST);
   }
 
   metadata::Request::ACSL * acsl = rv_request->_validateACSL(acsl_id);
   if (acsl == nullptr) {
-    spdlog::critical("< [BROADCASTED REMOVE WAIT] Error: invalid async zone {}", acsl_id);
+    LOG_CRITICAL_RATE_LIMITED("< [BROADCASTED REMOVE WAIT] Error: invalid async zone {}", acsl_id);
     return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, utils::ERR_MSG_INVALID_ACSL);
   }
 
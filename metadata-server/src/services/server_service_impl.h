@@ -12,7 +12,7 @@
 #include <iostream>
 #include <memory>
 #include <string>
-#include "spdlog/spdlog.h"
+#include "../utils/log.h"
 #include "spdlog/fmt/ostr.h"
 
 namespace service {
@@ -23,6 +23,23 @@ namespace service {
             std::shared_ptr<rendezvous::Server> _server;
             bool _consistency_checks;
 
+            /**
+             * Close a replicated branch
+             * 
+             * @param request The replicated close
+             * @return The status of the close
+             */
+            grpc::Status _closeBranch(const rendezvous_server::CloseBranchMessage& request);
+
+            /**
+             * Close a branch at once, after it was closed in all its regions (selective replication)
+             * 
+             * @param rv_request The request of the branch
+             * @param core_bid The identifier of the branch (without rid)
+             * @return Same as the close of a branch in the server
+             */
+            int _closeCompactBranch(metadata::Request * rv_request, const std::string& core_bid);
+
         public:
             ServerServiceImpl(std::shared_ptr<rendezvous::Server> server, bool consistency_checks);
 
@@ -39,6 +56,22 @@ namespace service {
                 const rendezvous_server::CloseBranchMessage * request, 
                 rendezvous_server::Empty * response) override;
 
+            grpc::Status CloseBranches(grpc::ServerContext * context, 
+                const rendezvous_server::CloseBranchesMessage * request, 
+                rendezvous_server::Empty * response) override;
+
+            grpc::Status AddSubscriber(grpc::ServerContext * context, 
+                const rendezvous_server::AddSubscriberMessage * request, 
+                rendezvous_server::Empty * response) override;
+
+            grpc::Status RemoveSubscriber(grpc::ServerContext * context, 
+                const rendezvous_server::RemoveSubscriberMessage * request, 
+                rendezvous_server::Empty * response) override;
+
+            grpc::Status PublishBranch(grpc::ServerContext * context, 
+                const rendezvous_server::PublishBranchMessage * request, 
+                rendezvous_server::Empty * response) override;
+
             grpc::Status AddWaitLog(grpc::ServerContext * context, 
                 const rendezvous_server::AddWaitLogMessage * request, 
                 rendezvous_server::Empty * response) override;
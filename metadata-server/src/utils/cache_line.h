@@ -0,0 +1,12 @@
+#ifndef UTILS_CACHE_LINE_H
+#define UTILS_CACHE_LINE_H
+
+#include <cstddef>
+
+namespace utils {
+
+    // data written by different threads is kept in different cache lines (avoids false sharing)
+    inline constexpr size_t CACHE_LINE_SIZE = 64;
+}
+
+#endif
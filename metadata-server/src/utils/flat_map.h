@@ -0,0 +1,371 @@
+#ifndef UTILS_FLAT_MAP_H
+#define UTILS_FLAT_MAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+
+namespace utils {
+
+    /**
+     * Open-addressing hash map with string keys (linear probing over an array of control bytes).
+     * Entries are stored inline in a single array instead of one heap node per entry and lookups
+     * accept a std::string_view so that callers do not build temporary strings.
+     *
+     * Each control byte is either EMPTY, DELETED (tombstone) or the 7 low bits of the hash of the
+     * key in that slot, so most mismatches are discarded without comparing keys.
+     * Erasing never moves other entries (iterators and references stay valid) but inserting
+     * may rehash and invalidate all of them, just like std::unordered_map
+     */
+    template <typename V>
+    class FlatMap {
+
+        public:
+            typedef std::string key_type;
+            typedef V mapped_type;
+            typedef std::pair<const std::string, V> value_type;
+
+        private:
+            static constexpr int8_t EMPTY = -128;
+            static constexpr int8_t DELETED = -2;
+            // most maps of the metadata only hold a few entries (e.g. regions of a branch)
+            static constexpr size_t MIN_CAPACITY = 2;
+            static constexpr size_t NOT_FOUND = SIZE_MAX;
+
+            // slots are allocated lazily so that empty maps do not take heap memory
+            int8_t * _ctrl;
+            value_type * _slots;
+            size_t _capacity;
+            size_t _size;
+            size_t _tombstones;
+
+            static size_t _hash(std::string_view key) {
+                return std::hash<std::string_view>()(key);
+            }
+
+            static int8_t _fragment(size_t hash) {
+                return (int8_t) (hash & 0x7F);
+            }
+
+            // keep at least 1/8 of the slots (and at least one) empty so that probing always ends
+            static size_t _maxLoad(size_t capacity) {
+                return capacity < 8 ? capacity - 1 : capacity - capacity / 8;
+            }
+
+            size_t _find(std::string_view key) const {
+                if (_size == 0) {
+                    return NOT_FOUND;
+                }
+                size_t hash = _hash(key);
+                int8_t fragment = _fragment(hash);
+                size_t mask = _capacity - 1;
+                for (size_t i = (hash >> 7) & mask; ; i = (i + 1) & mask) {
+                    if (_ctrl[i] == EMPTY) {
+                        return NOT_FOUND;
+                    }
+                    if (_ctrl[i] == fragment && _slots[i].first == key) {
+                        return i;
+                    }
+                }
+            }
+
+            // first free slot for a key that is known not to be in the map
+            size_t _findFree(size_t hash) const {
+                size_t mask = _capacity - 1;
+                size_t i = (hash >> 7) & mask;
+                while (_ctrl[i] >= 0) {
+                    i = (i + 1) & mask;
+                }
+                return i;
+            }
+
+            void _rehash(size_t capacity) {
+                int8_t * old_ctrl = _ctrl;
+                value_type * old_slots = _slots;
+                size_t old_capacity = _capacity;
+
+                _ctrl = new int8_t[capacity];
+                std::fill(_ctrl, _ctrl + capacity, EMPTY);
+                _slots = std::allocator<value_type>().allocate(capacity);
+                _capacity = capacity;
+                _tombstones = 0;
+
+                for (size_t i = 0; i < old_capacity; i++) {
+                    if (old_ctrl[i] >= 0) {
+                        size_t hash = _hash(old_slots[i].first);
+                        size_t j = _findFree(hash);
+                        new (&_slots[j]) value_type(std::move(old_slots[i]));
+                        _ctrl[j] = _fragment(hash);
+                        old_slots[i].~value_type();
+                    }
+                }
+                if (old_ctrl != nullptr) {
+                    delete[] old_ctrl;
+                    std::allocator<value_type>().deallocate(old_slots, old_capacity);
+                }
+            }
+
+            void _growFor(size_t n) {
+                if (_capacity != 0 && n + _tombstones <= _maxLoad(_capacity)) {
+                    return;
+                }
+                size_t capacity = MIN_CAPACITY;
+                while (_maxLoad(capacity) < n) {
+                    capacity <<= 1;
+                }
+                // only tombstones are cleaned up when the entries still fit
+                _rehash(capacity > _capacity ? capacity : _capacity);
+            }
+
+            template <typename K, typename... Args>
+            std::pair<size_t, bool> _emplace(K&& key, Args&&... args) {
+                size_t i = _find(key);
+                if (i != NOT_FOUND) {
+                    return {i, false};
+                }
+                _growFor(_size + 1);
+                size_t hash = _hash(key);
+                i = _findFree(hash);
+                if (_ctrl[i] == DELETED) {
+                    _tombstones--;
+                }
+                new (&_slots[i]) value_type(std::piecewise_construct,
+                    std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+                _ctrl[i] = _fragment(hash);
+                _size++;
+                return {i, true};
+            }
+
+            void _destroy() {
+                if (_ctrl == nullptr) {
+                    return;
+                }
+                for (size_t i = 0; i < _capacity; i++) {
+                    if (_ctrl[i] >= 0) {
+                        _slots[i].~value_type();
+                    }
+                }
+                delete[] _ctrl;
+                std::allocator<value_type>().deallocate(_slots, _capacity);
+                _ctrl = nullptr;
+                _slots = nullptr;
+                _capacity = 0;
+                _size = 0;
+                _tombstones = 0;
+            }
+
+            template <typename M, typename T>
+            class Iterator {
+
+                friend class FlatMap;
+
+                private:
+                    M * _map;
+                    size_t _index;
+
+                    void _skip() {
+                        while (_index < _map->_capacity && _map->_ctrl[_index] < 0) {
+                            _index++;
+                        }
+                    }
+
+                public:
+                    typedef std::forward_iterator_tag iterator_category;
+                    typedef T value_type;
+                    typedef std::ptrdiff_t difference_type;
+                    typedef T * pointer;
+                    typedef T & reference;
+
+                    Iterator() : _map(nullptr), _index(0) {}
+                    Iterator(M * map, size_t index) : _map(map), _index(index) {
+                        _skip();
+                    }
+
+                    // iterator converts to const_iterator
+                    template <typename OM, typename OT>
+                    Iterator(const Iterator<OM, OT>& other) : _map(other._map), _index(other._index) {}
+
+                    reference operator*() const { return _map->_slots[_index]; }
+                    pointer operator->() const { return &_map->_slots[_index]; }
+
+                    Iterator& operator++() {
+                        _index++;
+                        _skip();
+                        return *this;
+                    }
+
+                    Iterator operator++(int) {
+                        Iterator previous = *this;
+                        ++(*this);
+                        return previous;
+                    }
+
+                    bool operator==(const Iterator& other) const { return _index == other._index; }
+                    bool operator!=(const Iterator& other) const { return _index != other._index; }
+
+                    template <typename OM, typename OT> friend class Iterator;
+            };
+
+        public:
+            typedef Iterator<FlatMap, value_type> iterator;
+            typedef Iterator<const FlatMap, const value_type> const_iterator;
+
+            FlatMap() : _ctrl(nullptr), _slots(nullptr), _capacity(0), _size(0), _tombstones(0) {}
+
+            FlatMap(const FlatMap& other) : FlatMap() {
+                reserve(other._size);
+                for (const auto& entry : other) {
+                    _emplace(entry.first, entry.second);
+                }
+            }
+
+            FlatMap(FlatMap&& other) noexcept
+                : _ctrl(other._ctrl), _slots(other._slots), _capacity(other._capacity),
+                _size(other._size), _tombstones(other._tombstones) {
+                other._ctrl = nullptr;
+                other._slots = nullptr;
+                other._capacity = 0;
+                other._size = 0;
+                other._tombstones = 0;
+            }
+
+            FlatMap& operator=(FlatMap other) noexcept {
+                std::swap(_ctrl, other._ctrl);
+                std::swap(_slots, other._slots);
+                std::swap(_capacity, other._capacity);
+                std::swap(_size, other._size);
+                std::swap(_tombstones, other._tombstones);
+                return *this;
+            }
+
+            ~FlatMap() {
+                _destroy();
+            }
+
+            iterator begin() { return iterator(this, 0); }
+            iterator end() { return iterator(this, _capacity); }
+            const_iterator begin() const { return const_iterator(this, 0); }
+            const_iterator end() const { return const_iterator(this, _capacity); }
+            const_iterator cbegin() const { return begin(); }
+            const_iterator cend() const { return end(); }
+
+            size_t size() const { return _size; }
+            bool empty() const { return _size == 0; }
+
+            /**
+             * @return Number of slots (used for memory accounting)
+             */
+            size_t bucket_count() const { return _capacity; }
+
+            /**
+             * Bytes allocated in the heap by the slots of the map (excluding the heap bytes of keys and values)
+             *
+             * @return The heap bytes
+             */
+            size_t slotBytes() const { return _capacity * (sizeof(value_type) + sizeof(int8_t)); }
+
+            void reserve(size_t n) {
+                if (n > 0) {
+                    _growFor(n);
+                }
+            }
+
+            void clear() {
+                _destroy();
+            }
+
+            iterator find(std::string_view key) {
+                size_t i = _find(key);
+                return i == NOT_FOUND ? end() : iterator(this, i);
+            }
+
+            const_iterator find(std::string_view key) const {
+                size_t i = _find(key);
+                return i == NOT_FOUND ? end() : const_iterator(this, i);
+            }
+
+            size_t count(std::string_view key) const {
+                return _find(key) != NOT_FOUND ? 1 : 0;
+            }
+
+            V& at(std::string_view key) {
+                size_t i = _find(key);
+                if (i == NOT_FOUND) {
+                    throw std::out_of_range("utils::FlatMap::at");
+                }
+                return _slots[i].second;
+            }
+
+            V& operator[](std::string_view key) {
+                // slots may be reallocated by the insertion
+                size_t i = _emplace(key).first;
+                return _slots[i].second;
+            }
+
+            template <typename... Args>
+            std::pair<iterator, bool> emplace(const std::string& key, Args&&... args) {
+                auto result = _emplace(key, std::forward<Args>(args)...);
+                return {iterator(this, result.first), result.second};
+            }
+
+            template <typename... Args>
+            std::pair<iterator, bool> emplace(std::string&& key, Args&&... args) {
+                auto result = _emplace(std::move(key), std::forward<Args>(args)...);
+                return {iterator(this, result.first), result.second};
+            }
+
+            template <typename... Args>
+            std::pair<iterator, bool> try_emplace(std::string_view key, Args&&... args) {
+                auto result = _emplace(key, std::forward<Args>(args)...);
+                return {iterator(this, result.first), result.second};
+            }
+
+            std::pair<iterator, bool> insert(const value_type& entry) {
+                return emplace(entry.first, entry.second);
+            }
+
+            /**
+             * Remove entry (other iterators remain valid)
+             *
+             * @param it Iterator of the entry
+             * @return Iterator of the next entry
+             */
+            iterator erase(const_iterator it) {
+                size_t i = it._index;
+                _slots[i].~value_type();
+                // a slot followed by an empty slot ends every probe sequence through it
+                if (_ctrl[(i + 1) & (_capacity - 1)] == EMPTY) {
+                    _ctrl[i] = EMPTY;
+                }
+                else {
+                    _ctrl[i] = DELETED;
+                    _tombstones++;
+                }
+                _size--;
+                return iterator(this, i + 1);
+            }
+
+            iterator erase(iterator it) {
+                return erase(const_iterator(it));
+            }
+
+            size_t erase(std::string_view key) {
+                size_t i = _find(key);
+                if (i == NOT_FOUND) {
+                    return 0;
+                }
+                erase(const_iterator(this, i));
+                return 1;
+            }
+    };
+}
+
+#endif
@@ -37,6 +37,8 @@ namespace utils {
     const std::string ERR_MSG_INVALID_SERVICES_EXCLUSIVE = "Cannot provide either 'service' or 'services' simultaneously";
     const std::string ERR_MSG_INVALID_SERVICE = "Invalid service";
     const std::string ERR_MSG_VISIBLE_BIDS_TIMEOUT = "Timedout while waiting for bids to be visible";
+    const std::string ERR_MSG_MONITOR_NO_SUBSCRIPTION = "First monitor message must provide the subscription";
+    const std::string ERR_MSG_INVALID_TOP_K = "Invalid top k. Value cannot be negative";
     
     /* common gRPC custom error messages */
     const std::string ERR_MSG_INVALID_REQUEST = "Invalid request identifier";
@@ -46,6 +48,8 @@ namespace utils {
     const std::string ERR_MSG_BRANCH_ALREADY_EXISTS = "A branch was already registered with the provided identifier";
     const std::string ERR_PARSING_RID = "Unexpected error parsing rid";
     const std::string ERR_PARSING_BID = "Unexpected error parsing bid";
+    const std::string ERR_MSG_OWNER_NOT_FOUND = "Replica owning the request was not found";
+    const std::string ERR_MSG_SUBSCRIBERS_QUEUE_FULL = "Subscribers of the branch cannot take more branches";
 }
 
 #endif
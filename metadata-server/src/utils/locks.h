@@ -0,0 +1,39 @@
+#ifndef UTILS_LOCKS_H
+#define UTILS_LOCKS_H
+
+#include <condition_variable>
+#include <mutex>
+#include <shared_mutex>
+
+/* ---------------------------------------------------------------------- */
+/* locks of the metadata structures                                       */
+/* built with -DLOCK_PROFILING=ON, each lock records wait and hold times  */
+/* in the lock site given by its name (see metrics/lock_profiler.h)       */
+/* ---------------------------------------------------------------------- */
+
+#ifdef LOCK_PROFILING
+
+#include "../metrics/lock_profiler.h"
+
+namespace utils {
+    typedef metrics::ProfiledMutex<std::mutex> Mutex;
+    typedef metrics::ProfiledMutex<std::shared_mutex> SharedMutex;
+    // condition variables of std::condition_variable only work with std::mutex
+    typedef std::condition_variable_any ConditionVariable;
+}
+
+#define LOCK_SITE(name) {name}
+
+#else
+
+namespace utils {
+    typedef std::mutex Mutex;
+    typedef std::shared_mutex SharedMutex;
+    typedef std::condition_variable ConditionVariable;
+}
+
+#define LOCK_SITE(name)
+
+#endif
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef UTILS_LOG_H
+#define UTILS_LOG_H
+
+#include "spdlog/spdlog.h"
+#include "spdlog/async.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/* ---------------------------------------------------------------------- */
+/* logging of the metadata server                                         */
+/* - SPDLOG_<LEVEL> macros below SPDLOG_ACTIVE_LEVEL (set with            */
+/*   -DLOG_LEVEL=<level>) are removed at compile time with their args     */
+/* - messages are written by a background thread (see initAsyncLogging)   */
+/* - errors on request paths are rate limited per call site               */
+/* ---------------------------------------------------------------------- */
+
+namespace utils {
+
+    // at most one message per call site in this interval (the others are counted and reported with the next one)
+    static constexpr std::chrono::milliseconds LOG_RATE_LIMIT_INTERVAL(1000);
+
+    /**
+     * Rate limiter of a single call site: checked before the message is formatted
+     */
+    class LogRateLimiter {
+
+        private:
+            std::atomic<int64_t> _last_ns;
+            std::atomic<uint64_t> _suppressed;
+
+        public:
+            LogRateLimiter() : _last_ns(INT64_MIN), _suppressed(0) {
+            }
+
+            /**
+             * Check whether a message can be logged
+             *
+             * @param suppressed Set with the number of messages suppressed since the last logged one
+             * @return true if the message can be logged and false otherwise
+             */
+            bool allow(uint64_t& suppressed) {
+                int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+                int64_t last = _last_ns.load(std::memory_order_relaxed);
+                int64_t interval = std::chrono::duration_cast<std::chrono::nanoseconds>(LOG_RATE_LIMIT_INTERVAL).count();
+                // only one of the threads racing for the same interval logs the message
+                if ((last != INT64_MIN && now - last < interval) || !_last_ns.compare_exchange_strong(last, now)) {
+                    _suppressed.fetch_add(1, std::memory_order_relaxed);
+                    return false;
+                }
+                suppressed = _suppressed.exchange(0, std::memory_order_relaxed);
+                return true;
+            }
+    };
+
+    /**
+     * Replace the default logger with one that writes to stdout in a background thread
+     * RPC threads never block: when the queue is full the oldest messages are dropped
+     *
+     * @param queue_size Number of messages in the queue of the background thread
+     * @param level Runtime level (e.g. "info"), which cannot be lower than the compiled one
+     */
+    inline void initAsyncLogging(size_t queue_size, const std::string& level) {
+        spdlog::init_thread_pool(queue_size, 1);
+        auto logger = spdlog::stdout_color_mt<spdlog::async_factory_nonblock>("rendezvous");
+        spdlog::set_default_logger(logger);
+        spdlog::set_level(spdlog::level::from_str(level));
+    }
+}
+
+// the number of suppressed messages is formatted in its own prefix so that it never
+// binds to a placeholder of the message (or gets dropped with its extra arguments)
+#define LOG_RATE_LIMITED_IMPL(LOG_MACRO, fmt_str, ...) \
+    do { \
+        static utils::LogRateLimiter _log_rate_limiter; \
+        uint64_t _log_suppressed; \
+        if (_log_rate_limiter.allow(_log_suppressed)) { \
+            if (_log_suppressed == 0) LOG_MACRO(fmt_str, ##__VA_ARGS__); \
+            else LOG_MACRO("[suppressed {} similar messages] " fmt_str, _log_suppressed, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_WARN
+#define LOG_WARN_RATE_LIMITED(fmt_str, ...) LOG_RATE_LIMITED_IMPL(SPDLOG_WARN, fmt_str, ##__VA_ARGS__)
+#else
+#define LOG_WARN_RATE_LIMITED(fmt_str, ...) (void) 0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_ERROR
+#define LOG_ERROR_RATE_LIMITED(fmt_str, ...) LOG_RATE_LIMITED_IMPL(SPDLOG_ERROR, fmt_str, ##__VA_ARGS__)
+#else
+#define LOG_ERROR_RATE_LIMITED(fmt_str, ...) (void) 0
+#endif
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_CRITICAL
+#define LOG_CRITICAL_RATE_LIMITED(fmt_str, ...) LOG_RATE_LIMITED_IMPL(SPDLOG_CRITICAL, fmt_str, ##__VA_ARGS__)
+#else
+#define LOG_CRITICAL_RATE_LIMITED(fmt_str, ...) (void) 0
+#endif
+
+#endif
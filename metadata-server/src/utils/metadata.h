@@ -1,6 +1,9 @@
 #ifndef UTILS_METADATA_H
 #define UTILS_METADATA_H
 
+#include "settings.h"
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <map>
 #include <set>
@@ -36,6 +39,111 @@ namespace utils {
     const int OK = 0;
     const int INVALID_SERVICE = -2;
     const int INVALID_CONTEXT = -3;
+
+    /* ------------------------------ */
+    /* helpers for memory accounting  */
+    /* (approximate footprint)        */
+    /* ------------------------------ */
+    // overhead of each entry of node-based containers (next pointer, cached hash and bucket slot)
+    const size_t CONTAINER_NODE_BYTES = 3 * sizeof(void*);
+
+    /**
+     * Bytes allocated in the heap by a string (short strings are stored inline)
+     *
+     * @param value The string
+     * @return The heap bytes
+     */
+    inline size_t stringBytes(const std::string& value) {
+        static const size_t inline_capacity = std::string().capacity();
+        return value.capacity() > inline_capacity ? value.capacity() + 1 : 0;
+    }
+
+    /**
+     * Bytes of a new entry with a string key in a node-based container
+     *
+     * @param key The key of the entry
+     * @param value_size The size of the value of the entry
+     * @return The entry bytes
+     */
+    inline size_t entryBytes(const std::string& key, size_t value_size) {
+        return CONTAINER_NODE_BYTES + sizeof(std::string) + stringBytes(key) + value_size;
+    }
+
+    /**
+     * Bytes of a new entry with a string key in a flat map (slot with its control byte)
+     * Spare slots of the map are not accounted
+     *
+     * @param key The key of the entry
+     * @param value_size The size of the value of the entry
+     * @return The entry bytes
+     */
+    inline size_t flatEntryBytes(const std::string& key, size_t value_size) {
+        return 1 + sizeof(std::string) + stringBytes(key) + value_size;
+    }
+
+    /* ---------------------------- */
+    /* helpers for acsl identifiers */
+    /* ---------------------------- */
+    // first byte of indexes that do not fit in a single byte (followed by their big-endian bytes)
+    const unsigned char ACSL_KEY_MULTIBYTE_INDEX = 0xF0;
+
+    /**
+     * Encode an acsl id (e.g. 'root:eu0:eu12') in a compact key ordered by the position of the acsl in the
+     * tree of acsls: parents precede their children and siblings are ordered by their numeric index
+     * ('eu2' precedes 'eu10'). Keys are compared as plain bytes and the key of an acsl is a prefix of the
+     * keys of all its descendants
+     *
+     * FORMAT of each component: <prefix (e.g. sid)> 0x00 <index + 1 (0 if none)>
+     * where values above 0xEF take 0xF0 + (n - 1) followed by their n big-endian bytes
+     *
+     * @param acsl_id The acsl id
+     * @return The key of the acsl (empty for the root)
+     */
+    inline std::string encodeACSLKey(const std::string& acsl_id) {
+        std::string key;
+        key.reserve(acsl_id.size() + 2);
+        size_t start = 0;
+        while (start < acsl_id.size()) {
+            size_t end = acsl_id.find(FULL_ID_DELIMITER, start);
+            if (end == std::string::npos) {
+                end = acsl_id.size();
+            }
+            // index is given by the trailing digits of the component
+            size_t digits = end;
+            while (digits > start && end - digits < 18 && acsl_id[digits - 1] >= '0' && acsl_id[digits - 1] <= '9') {
+                digits--;
+            }
+            // leading zeros are kept in the prefix so that different ids never share a key
+            while (digits + 1 < end && acsl_id[digits] == '0') {
+                digits++;
+            }
+            key.append(acsl_id, start, digits - start);
+            key.push_back('\0');
+
+            uint64_t value = 0;
+            if (digits < end) {
+                for (size_t i = digits; i < end; i++) {
+                    value = value * 10 + (acsl_id[i] - '0');
+                }
+                value++;
+            }
+            if (value < ACSL_KEY_MULTIBYTE_INDEX) {
+                key.push_back((char) value);
+            }
+            else {
+                int n = 0;
+                for (uint64_t rest = value; rest > 0; rest >>= 8) {
+                    n++;
+                }
+                key.push_back((char) (ACSL_KEY_MULTIBYTE_INDEX + n - 1));
+                for (int i = n - 1; i >= 0; i--) {
+                    key.push_back((char) ((value >> (8 * i)) & 0xFF));
+                }
+            }
+            start = end + 1;
+        }
+        return key;
+    }
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef UTILS_MPSC_RING_H
+#define UTILS_MPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "cache_line.h"
+
+namespace utils {
+
+    /**
+     * Bounded lock-free ring buffer for multiple producers and a single consumer.
+     * Each cell holds a sequence number that tells producers and the consumer
+     * whether the cell is free or filled for the current lap of the ring
+     */
+    template <typename T>
+    class MPSCRing {
+
+        private:
+            typedef struct CellStruct {
+                std::atomic<size_t> sequence;
+                T data;
+            } Cell;
+
+            const size_t _capacity;
+            const size_t _mask;
+            std::unique_ptr<Cell[]> _buffer;
+
+            // producers and consumer positions are kept in different cache lines
+            alignas(CACHE_LINE_SIZE) std::atomic<size_t> _enqueue_pos;
+            alignas(CACHE_LINE_SIZE) std::atomic<size_t> _dequeue_pos;
+
+            static size_t _roundCapacity(size_t capacity) {
+                size_t rounded = 2;
+                while (rounded < capacity) {
+                    rounded <<= 1;
+                }
+                return rounded;
+            }
+
+        public:
+            /**
+             * @param capacity Maximum number of elements (rounded up to a power of two)
+             */
+            explicit MPSCRing(size_t capacity)
+                : _capacity(_roundCapacity(capacity)), _mask(_capacity - 1),
+                _buffer(new Cell[_capacity]), _enqueue_pos(0), _dequeue_pos(0) {
+
+                for (size_t i = 0; i < _capacity; i++) {
+                    _buffer[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            MPSCRing(const MPSCRing&) = delete;
+            MPSCRing& operator=(const MPSCRing&) = delete;
+
+            /**
+             * Add element to the ring (safe to be called by multiple threads)
+             *
+             * @param value The element to be added
+             * @return true if element was added and false if the ring is full
+             */
+            bool tryPush(T value) {
+                Cell * cell;
+                size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+                while (true) {
+                    cell = &_buffer[pos & _mask];
+                    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                    intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+                    // cell is free for the current lap
+                    if (diff == 0) {
+                        if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            break;
+                        }
+                    }
+                    // cell was not consumed yet
+                    else if (diff < 0) {
+                        return false;
+                    }
+                    // another producer took the cell
+                    else {
+                        pos = _enqueue_pos.load(std::memory_order_relaxed);
+                    }
+                }
+                cell->data = std::move(value);
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            /**
+             * Remove element from the ring (only one thread can consume at a time)
+             *
+             * @param value The removed element
+             * @return true if an element was removed and false if the ring is empty
+             */
+            bool tryPop(T& value) {
+                size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+                Cell * cell = &_buffer[pos & _mask];
+                size_t sequence = cell->sequence.load(std::memory_order_acquire);
+                if ((intptr_t) sequence - (intptr_t) (pos + 1) < 0) {
+                    return false;
+                }
+                value = std::move(cell->data);
+                cell->sequence.store(pos + _capacity, std::memory_order_release);
+                _dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+                return true;
+            }
+
+            /**
+             * Approximate number of elements in the ring
+             */
+            size_t size() {
+                size_t enqueue_pos = _enqueue_pos.load(std::memory_order_acquire);
+                size_t dequeue_pos = _dequeue_pos.load(std::memory_order_relaxed);
+                return enqueue_pos > dequeue_pos ? enqueue_pos - dequeue_pos : 0;
+            }
+
+            size_t capacity() {
+                return _capacity;
+            }
+    };
+}
+
+#endif
@@ -7,26 +7,28 @@
 
 namespace utils {
 
+    // REMINDER: globals are inline so that all translation units (and all servers of the process) share them
+
     /* ------------------------ */
     /* parsing/formating of IDs */
     /*     (subrids, bids)      */
     /* ------------------------ */
-    static int SIZE_SIDS = 1;
-    static const char FULL_ID_DELIMITER = ':';
-    static std::string ROOT_ACSL_ID = "";
-    static std::string ROOT_SERVICE_NODE_ID = "";
+    inline int SIZE_SIDS = 1;
+    inline const char FULL_ID_DELIMITER = ':';
+    inline std::string ROOT_ACSL_ID = "";
+    inline std::string ROOT_SERVICE_NODE_ID = "";
 
     /* -------------------------------- */
     /* parsed values from settings.json */
     /* -------------------------------- */
-    static bool ASYNC_REPLICATION;
-    static bool CONTEXT_VERSIONING;
-    static int WAIT_REPLICA_TIMEOUT_S;
+    inline bool ASYNC_REPLICATION;
+    inline bool CONTEXT_VERSIONING;
+    inline int WAIT_REPLICA_TIMEOUT_S;
     
     /* --------------------------- */
     /* parsed values from env vars */
     /* --------------------------- */
-    static bool CONSISTENCY_CHECKS;
+    inline bool CONSISTENCY_CHECKS;
 }
 
 #endif
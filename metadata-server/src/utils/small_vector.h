@@ -0,0 +1,214 @@
+#ifndef UTILS_SMALL_VECTOR_H
+#define UTILS_SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace utils {
+
+    /**
+     * Vector that keeps up to N elements inline (inside the object) and only allocates heap memory
+     * when it grows beyond them. Used for the small lists of the metadata (e.g. regions of a branch)
+     * that almost always hold one to four elements
+     *
+     * Like std::vector, growing invalidates iterators, pointers and references to the elements
+     */
+    template <typename T, size_t N>
+    class SmallVector {
+
+        static_assert(N > 0, "inline capacity must be positive");
+
+        public:
+            typedef T value_type;
+            typedef T * iterator;
+            typedef const T * const_iterator;
+
+        private:
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type _inline[N];
+            T * _data;
+            size_t _size;
+            size_t _capacity;
+
+            bool _isInline() const {
+                return _data == reinterpret_cast<const T*>(_inline);
+            }
+
+            void _grow(size_t capacity) {
+                T * data = std::allocator<T>().allocate(capacity);
+                for (size_t i = 0; i < _size; i++) {
+                    new (&data[i]) T(std::move(_data[i]));
+                    _data[i].~T();
+                }
+                if (!_isInline()) {
+                    std::allocator<T>().deallocate(_data, _capacity);
+                }
+                _data = data;
+                _capacity = capacity;
+            }
+
+            void _release() {
+                clear();
+                if (!_isInline()) {
+                    std::allocator<T>().deallocate(_data, _capacity);
+                    _data = reinterpret_cast<T*>(_inline);
+                    _capacity = N;
+                }
+            }
+
+            // moves the elements of other to this (empty) vector
+            void _take(SmallVector&& other) {
+                if (!other._isInline()) {
+                    // heap buffer is taken over
+                    _data = other._data;
+                    _size = other._size;
+                    _capacity = other._capacity;
+                    other._data = reinterpret_cast<T*>(other._inline);
+                    other._size = 0;
+                    other._capacity = N;
+                    return;
+                }
+                for (auto& value : other) {
+                    new (&_data[_size++]) T(std::move(value));
+                }
+                other.clear();
+            }
+
+        public:
+            SmallVector() : _data(reinterpret_cast<T*>(_inline)), _size(0), _capacity(N) {}
+
+            SmallVector(std::initializer_list<T> values) : SmallVector() {
+                reserve(values.size());
+                for (const auto& value : values) {
+                    push_back(value);
+                }
+            }
+
+            SmallVector(const SmallVector& other) : SmallVector() {
+                reserve(other._size);
+                for (const auto& value : other) {
+                    push_back(value);
+                }
+            }
+
+            SmallVector(SmallVector&& other) noexcept : SmallVector() {
+                _take(std::move(other));
+            }
+
+            SmallVector& operator=(const SmallVector& other) {
+                if (this != &other) {
+                    clear();
+                    reserve(other._size);
+                    for (const auto& value : other) {
+                        push_back(value);
+                    }
+                }
+                return *this;
+            }
+
+            SmallVector& operator=(SmallVector&& other) noexcept {
+                if (this != &other) {
+                    _release();
+                    _take(std::move(other));
+                }
+                return *this;
+            }
+
+            ~SmallVector() {
+                _release();
+            }
+
+            iterator begin() { return _data; }
+            iterator end() { return _data + _size; }
+            const_iterator begin() const { return _data; }
+            const_iterator end() const { return _data + _size; }
+
+            size_t size() const { return _size; }
+            bool empty() const { return _size == 0; }
+            size_t capacity() const { return _capacity; }
+
+            /**
+             * @return Bytes allocated in the heap (0 while the elements fit inline)
+             */
+            size_t heapBytes() const { return _isInline() ? 0 : _capacity * sizeof(T); }
+
+            T& operator[](size_t i) { return _data[i]; }
+            const T& operator[](size_t i) const { return _data[i]; }
+
+            T& at(size_t i) {
+                if (i >= _size) {
+                    throw std::out_of_range("utils::SmallVector::at");
+                }
+                return _data[i];
+            }
+
+            const T& at(size_t i) const {
+                if (i >= _size) {
+                    throw std::out_of_range("utils::SmallVector::at");
+                }
+                return _data[i];
+            }
+
+            T& back() { return _data[_size - 1]; }
+            const T& back() const { return _data[_size - 1]; }
+
+            void reserve(size_t capacity) {
+                if (capacity > _capacity) {
+                    _grow(capacity);
+                }
+            }
+
+            template <typename... Args>
+            T& emplace_back(Args&&... args) {
+                if (_size == _capacity) {
+                    // arguments may refer to elements of this vector
+                    T value(std::forward<Args>(args)...);
+                    _grow(_capacity * 2);
+                    new (&_data[_size]) T(std::move(value));
+                }
+                else {
+                    new (&_data[_size]) T(std::forward<Args>(args)...);
+                }
+                return _data[_size++];
+            }
+
+            void push_back(const T& value) {
+                emplace_back(value);
+            }
+
+            void push_back(T&& value) {
+                emplace_back(std::move(value));
+            }
+
+            void pop_back() {
+                _data[--_size].~T();
+            }
+
+            /**
+             * Remove element keeping the order of the remaining ones
+             *
+             * @param it Iterator of the element
+             * @return Iterator of the next element
+             */
+            iterator erase(const_iterator it) {
+                iterator pos = _data + (it - _data);
+                std::move(pos + 1, end(), pos);
+                pop_back();
+                return pos;
+            }
+
+            void clear() {
+                for (size_t i = 0; i < _size; i++) {
+                    _data[i].~T();
+                }
+                _size = 0;
+            }
+    };
+}
+
+#endif
@@ -47,6 +47,44 @@ TEST(ACSLsTest, RidParsing) {
   ASSERT_EQ(parsed_id.second, "");
 }
 
+TEST(ACSLsTest, RidParsingWithoutCopies) { 
+  rendezvous::Server server(SID);
+
+  // parsed ids are views of the full id
+  std::string full_id = "1st:2nd";
+  auto parsed_id = server.parseFullId(full_id);
+  ASSERT_EQ(full_id.data(), parsed_id.first.data());
+  ASSERT_EQ(full_id.data() + 4, parsed_id.second.data());
+
+  // only the first separator splits the id
+  parsed_id = server.parseFullId("1st:2nd:3rd");
+  ASSERT_EQ("1st", parsed_id.first);
+  ASSERT_EQ("2nd:3rd", parsed_id.second);
+
+  // trailing separator
+  parsed_id = server.parseFullId("1st:2nd:");
+  ASSERT_EQ("1st", parsed_id.first);
+  ASSERT_EQ("2nd:", parsed_id.second);
+
+  // no separator and empty id
+  parsed_id = server.parseFullId("");
+  ASSERT_EQ("", parsed_id.first);
+  ASSERT_EQ(utils::ROOT_ACSL_ID, parsed_id.second);
+
+  // round trip
+  for (const std::string& id : {"1st:2nd", "rv_eu_1:rv_eu_0", ":2nd", "1st:2nd:3rd"}) {
+    parsed_id = server.parseFullId(id);
+    ASSERT_EQ(id, server.composeFullId(parsed_id.first, parsed_id.second));
+  }
+
+  // composing into a reused buffer replaces its content
+  std::string buffer = "previous:id";
+  server.composeFullId("1st", "2nd", buffer);
+  ASSERT_EQ("1st:2nd", buffer);
+  server.composeFullId("1st", "", buffer);
+  ASSERT_EQ("1st", buffer);
+}
+
 TEST(ACSLsTest, RegisterWrongBranchId) { 
   rendezvous::Server server(SID);
   int closed;
@@ -483,3 +483,152 @@ TEST(ConcurrencyTest, WaitServiceTagForceAsync) {
     }
   }
 }
+
+TEST(ConcurrencyTest, CheckStatusWhileRegistering) {
+  rendezvous::Server server(SID);
+  std::vector<std::thread> threads;
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+  request->insertACSL(DUMMY_ACSL);
+
+  utils::ProtoVec regions;
+  regions.Add("EU");
+  std::string bid_0 = server.registerBranchGTest(request, ROOT_SUB_RID, "service", regions, "", "");
+  ASSERT_EQ(getBid(0), bid_0);
+
+  // status is read without locks while branches are registered and closed
+  std::atomic<bool> done(false);
+  for (int i = 0; i < 2; i++) {
+    threads.emplace_back([&server, request, &regions, i] {
+      for (int j = 0; j < 1000; j++) {
+        std::string bid = server.registerBranchGTest(request, ROOT_SUB_RID, "service_" + std::to_string(i), regions, "", "");
+        ASSERT_EQ(1, server.closeBranch(request, bid, "EU"));
+      }
+    });
+  }
+  threads.emplace_back([&server, request, &done] {
+    while (!done.load()) {
+      ASSERT_EQ(OPENED, server.checkStatus(request, DUMMY_ACSL, "", "").status);
+      ASSERT_EQ(OPENED, server.checkStatus(request, DUMMY_ACSL, "", "EU").status);
+    }
+  });
+
+  threads[0].join();
+  threads[1].join();
+  done.store(true);
+  threads[2].join();
+
+  ASSERT_EQ(1, server.closeBranch(request, bid_0, "EU"));
+  ASSERT_EQ(CLOSED, server.checkStatus(request, DUMMY_ACSL, "", "").status);
+  ASSERT_EQ(CLOSED, server.checkStatus(request, DUMMY_ACSL, "", "EU").status);
+}
+
+TEST(ConcurrencyTest, GloballyClosedTransitionOnce) {
+  rendezvous::Server server(SID);
+  std::vector<std::thread> threads;
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+
+  std::vector<std::string> region_names = {"EU", "US", "AP", "SA"};
+  utils::ProtoVec regions;
+  for (const auto& region: region_names) {
+    regions.Add(region.c_str());
+  }
+  std::string bid_0 = server.registerBranchGTest(request, ROOT_SUB_RID, "service", regions, "", "");
+  ASSERT_EQ(getBid(0), bid_0);
+
+  // only the close of the last opened region observes the branch being globally closed
+  std::atomic<int> num_globally_closed(0);
+  for (const auto& region: region_names) {
+    threads.emplace_back([&server, request, &bid_0, &region, &num_globally_closed] {
+      bool globally_closed = false;
+      ASSERT_EQ(1, server.closeBranch(request, bid_0, region, &globally_closed));
+      if (globally_closed) num_globally_closed++;
+    });
+  }
+  for (auto& thread: threads) {
+    thread.join();
+  }
+  ASSERT_EQ(1, num_globally_closed.load());
+
+  bool globally_closed = false;
+  ASSERT_EQ(0, server.closeBranch(request, bid_0, "EU", &globally_closed));
+  ASSERT_FALSE(globally_closed);
+  ASSERT_EQ(CLOSED, server.checkStatus(request, ROOT_SUB_RID, "", "").status);
+}
+
+TEST(ConcurrencyTest, CheckServiceStatusWhileClosingTags) {
+  rendezvous::Server server(SID);
+  std::vector<std::thread> threads;
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+  request->insertACSL(DUMMY_ACSL);
+
+  utils::ProtoVec regions;
+  regions.Add("EU");
+  std::string bid_0 = server.registerBranchGTest(request, ROOT_SUB_RID, "service", regions, "tag", "");
+  ASSERT_EQ(getBid(0), bid_0);
+
+  // tag counters of the service node are updated while status calls read them
+  std::atomic<bool> done(false);
+  for (int i = 0; i < 2; i++) {
+    threads.emplace_back([&server, request, &regions, i] {
+      for (int j = 0; j < 500; j++) {
+        const std::string& tag = "tag_" + std::to_string(i) + "_" + std::to_string(j);
+        std::string bid = server.registerBranchGTest(request, ROOT_SUB_RID, "service", regions, tag, "");
+        ASSERT_EQ(1, server.closeBranch(request, bid, "EU"));
+      }
+    });
+  }
+  threads.emplace_back([&server, request, &done] {
+    while (!done.load()) {
+      ASSERT_EQ(OPENED, server.checkStatus(request, DUMMY_ACSL, "service", "", true).status);
+      ASSERT_EQ(OPENED, server.checkStatus(request, DUMMY_ACSL, "service", "EU", true).status);
+    }
+  });
+
+  threads[0].join();
+  threads[1].join();
+  done.store(true);
+  threads[2].join();
+
+  ASSERT_EQ(1, server.closeBranch(request, bid_0, "EU"));
+  ASSERT_EQ(CLOSED, server.checkStatus(request, DUMMY_ACSL, "service", "").status);
+  ASSERT_EQ(CLOSED, server.checkStatus(request, DUMMY_ACSL, "service", "EU").status);
+}
+
+TEST(ConcurrencyTest, CheckServiceStatusWhileRegisteringInACSL) {
+  rendezvous::Server server(SID);
+  std::vector<std::thread> threads;
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+  request->insertACSL(DUMMY_ACSL);
+
+  utils::ProtoVec regions;
+  regions.Add("EU");
+  std::string bid_0 = server.registerBranchGTest(request, ROOT_SUB_RID, "service", regions, "", "");
+  ASSERT_EQ(getBid(0), bid_0);
+
+  // counters of the service node and of the acsl (ignored by the status call) are read without locks
+  // while branches of the same acsl are registered and closed, so both must be observed at the same point
+  std::atomic<bool> done(false);
+  for (int i = 0; i < 2; i++) {
+    threads.emplace_back([&server, request, &regions] {
+      for (int j = 0; j < 1000; j++) {
+        std::string bid = server.registerBranchGTest(request, DUMMY_ACSL, "service", regions, "", "");
+        ASSERT_EQ(1, server.closeBranch(request, bid, "EU"));
+      }
+    });
+  }
+  threads.emplace_back([&server, request, &done] {
+    while (!done.load()) {
+      ASSERT_EQ(OPENED, server.checkStatus(request, DUMMY_ACSL, "service", "").status);
+      ASSERT_EQ(OPENED, server.checkStatus(request, DUMMY_ACSL, "service", "EU").status);
+    }
+  });
+
+  threads[0].join();
+  threads[1].join();
+  done.store(true);
+  threads[2].join();
+
+  ASSERT_EQ(1, server.closeBranch(request, bid_0, "EU"));
+  ASSERT_EQ(CLOSED, server.checkStatus(request, DUMMY_ACSL, "service", "").status);
+  ASSERT_EQ(CLOSED, server.checkStatus(request, DUMMY_ACSL, "service", "EU").status);
+}
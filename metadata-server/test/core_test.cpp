@@ -363,6 +363,63 @@ TEST(CoreTest, CheckRequest_ContextNotFound) {
   ASSERT_EQ(UNKNOWN, res.status);
 }
 
+TEST(CoreTest, CheckRequest_CompactBranch) { 
+  rendezvous::Server server(SID); 
+  utils::Status res;
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+
+  utils::ProtoVec regions_r;
+  regions_r.Add("r");
+
+  std::string bid_0 = server.genBid(request);
+  auto branch_0 = server.registerBranch(request, ROOT_SUB_RID, "s1", regions_r, EMPTY_TAG, "", bid_0, false);
+  ASSERT_TRUE(branch_0 != nullptr);
+
+  // compact branch (selective replication) is only tracked by counters
+  utils::ProtoVec no_regions;
+  std::string bid_1 = server.genBid(request);
+  auto branch_1 = server.registerBranch(request, ROOT_SUB_RID, "s2", no_regions, EMPTY_TAG, "", bid_1, false, true, true);
+  ASSERT_TRUE(branch_1 != nullptr);
+  ASSERT_TRUE(branch_1->isCompact());
+
+  request->insertACSL(DUMMY_ACSL);
+
+  res = server.checkStatus(request, DUMMY_ACSL, "", "r");
+  ASSERT_EQ(OPENED, res.status);
+  res = server.checkStatus(request, DUMMY_ACSL, "s2", "");
+  ASSERT_EQ(OPENED, res.status);
+
+  // regions of the compact branch are not known so it may still be opened in region 'r'
+  int found = server.closeBranch(request, bid_0, "r");
+  ASSERT_EQ(1, found);
+  res = server.checkStatus(request, DUMMY_ACSL, "", "r");
+  ASSERT_EQ(UNKNOWN, res.status);
+  res = server.checkStatus(request, DUMMY_ACSL, "s1", "r");
+  ASSERT_EQ(CLOSED, res.status);
+  res = server.checkStatus(request, DUMMY_ACSL, "s2", "r");
+  ASSERT_EQ(UNKNOWN, res.status);
+  res = server.checkStatus(request, DUMMY_ACSL, "", "");
+  ASSERT_EQ(OPENED, res.status);
+  ASSERT_EQ(-1, server.wait(request, DUMMY_ACSL, "", "r", "", false, 1));
+
+  // compact branch is closed at once (without regions) when all its regions are closed
+  found = server.closeBranch(request, bid_1, "r");
+  ASSERT_EQ(-1, found);
+  res = server.checkStatus(request, DUMMY_ACSL, "s2", "");
+  ASSERT_EQ(OPENED, res.status);
+  found = server.closeBranch(request, bid_1, "");
+  ASSERT_EQ(1, found);
+  found = server.closeBranch(request, bid_1, "");
+  ASSERT_EQ(0, found);
+  res = server.checkStatus(request, DUMMY_ACSL, "s2", "");
+  ASSERT_EQ(CLOSED, res.status);
+  res = server.checkStatus(request, DUMMY_ACSL, "", "r");
+  ASSERT_EQ(CLOSED, res.status);
+  res = server.checkStatus(request, DUMMY_ACSL, "", "");
+  ASSERT_EQ(CLOSED, res.status);
+  ASSERT_EQ(0, server.wait(request, DUMMY_ACSL, "", "r", "", false, 1));
+}
+
 // sanity check
 TEST(CoreTest, PreventedInconsistencies_GetZeroValue) { 
   rendezvous::Server server(SID); 
@@ -0,0 +1,90 @@
+#include "../src/utils/flat_map.h"
+#include "gtest/gtest.h"
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// -------------
+// FLAT MAP TEST
+// -------------
+
+TEST(FlatMapTest, MatchesUnorderedMap) {
+  utils::FlatMap<int> map;
+  std::unordered_map<std::string, int> expected;
+  std::mt19937 random(42);
+
+  // mix of insertions, removals (tombstones) and lookups with rehashes along the way
+  for (int i = 0; i < 50000; i++) {
+    const std::string& key = "key_" + std::to_string(random() % 2000);
+    switch (random() % 3) {
+      case 0:
+        map[key] = i;
+        expected[key] = i;
+        break;
+      case 1:
+        ASSERT_EQ(expected.erase(key), map.erase(key));
+        break;
+      default:
+        auto it = map.find(key);
+        auto expected_it = expected.find(key);
+        ASSERT_EQ(expected_it == expected.end(), it == map.end());
+        if (it != map.end()) {
+          ASSERT_EQ(expected_it->second, it->second);
+        }
+    }
+    ASSERT_EQ(expected.size(), map.size());
+  }
+
+  size_t num_entries = 0;
+  for (const auto& it : map) {
+    ASSERT_EQ(expected[it.first], it.second);
+    num_entries++;
+  }
+  ASSERT_EQ(expected.size(), num_entries);
+}
+
+TEST(FlatMapTest, EraseWhileIterating) {
+  utils::FlatMap<int> map;
+  for (int i = 0; i < 100; i++) {
+    map["key_" + std::to_string(i)] = i;
+  }
+  int * value_ptr = &map.find("key_98")->second;
+
+  // same pattern as the garbage collector of requests
+  for (auto it = map.cbegin(); it != map.cend(); /* no increment */) {
+    if (it->second % 2 == 1) {
+      map.erase(it++);
+    }
+    else {
+      it++;
+    }
+  }
+  ASSERT_EQ(50, map.size());
+  ASSERT_EQ(0, map.count("key_99"));
+  // entries are not moved by removals
+  ASSERT_EQ(value_ptr, &map.find("key_98")->second);
+  ASSERT_EQ(98, *value_ptr);
+}
+
+TEST(FlatMapTest, StringViewLookup) {
+  utils::FlatMap<int> map;
+  auto it = map.try_emplace(std::string_view("eu:rid"), 1);
+  ASSERT_TRUE(it.second);
+  ASSERT_FALSE(map.try_emplace("eu:rid", 2).second);
+  ASSERT_EQ(1, map.at("eu:rid"));
+
+  // lookups with a piece of a larger string do not build temporary strings
+  const std::string full_id = "eu:rid:bid";
+  ASSERT_NE(map.end(), map.find(std::string_view(full_id).substr(0, 6)));
+  ASSERT_EQ(map.end(), map.find(std::string_view(full_id).substr(0, 5)));
+
+  // copies are independent
+  utils::FlatMap<int> copy = map;
+  copy["eu:rid"] = 3;
+  ASSERT_EQ(1, map["eu:rid"]);
+  map.clear();
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQ(0, map.bucket_count());
+  ASSERT_EQ(3, copy["eu:rid"]);
+}
@@ -0,0 +1,56 @@
+#include "../src/utils/log.h"
+#include "spdlog/sinks/ostream_sink.h"
+#include "gtest/gtest.h"
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// --------
+// LOG TEST
+// --------
+
+TEST(LogTest, RateLimiter) {
+  utils::LogRateLimiter limiter;
+  uint64_t suppressed = 0;
+  ASSERT_TRUE(limiter.allow(suppressed));
+  ASSERT_EQ(0, suppressed);
+
+  // repeated messages within the interval are only counted
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&limiter]() {
+      uint64_t suppressed;
+      for (int j = 0; j < 100; j++) {
+        ASSERT_FALSE(limiter.allow(suppressed));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::this_thread::sleep_for(utils::LOG_RATE_LIMIT_INTERVAL);
+  ASSERT_TRUE(limiter.allow(suppressed));
+  ASSERT_EQ(400, suppressed);
+  ASSERT_FALSE(limiter.allow(suppressed));
+}
+
+TEST(LogTest, SuppressedCountIsPrefixed) {
+  std::ostringstream stream;
+  auto logger = std::make_shared<spdlog::logger>("log_test", std::make_shared<spdlog::sinks::ostream_sink_mt>(stream));
+  logger->set_pattern("%v");
+  auto default_logger = spdlog::default_logger();
+  spdlog::set_default_logger(logger);
+
+  // call site with more arguments than placeholders
+  for (int i = 0; i < 3; i++) {
+    LOG_ERROR_RATE_LIMITED("error '{}'", i, "unused");
+    if (i == 1) {
+      std::this_thread::sleep_for(utils::LOG_RATE_LIMIT_INTERVAL);
+    }
+  }
+  spdlog::set_default_logger(default_logger);
+
+  std::string eol = spdlog::details::os::default_eol;
+  ASSERT_EQ("error '0'" + eol + "[suppressed 1 similar messages] error '2'" + eol, stream.str());
+}
@@ -0,0 +1,199 @@
+#include "../src/server.h"
+#include "../src/metrics/metrics.h"
+#include "../src/metrics/http_exporter.h"
+#include "../src/metrics/rpc_recorder.h"
+#include "../src/metrics/rpc_interceptor.h"
+#include "../src/services/client_service_impl.h"
+#include "gtest/gtest.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <string>
+#include <vector>
+#include "utils.h"
+
+// ------------
+// METRICS TEST
+// ------------
+
+static bool contains(const std::string& text, const std::string& line) {
+  return text.find(line + "\n") != std::string::npos;
+}
+
+TEST(MetricsTest, ConcurrentCounter) {
+  metrics::Registry registry;
+  metrics::Counter * counter = registry.counter("test_total", "Test counter", {{"label", "value"}});
+  ASSERT_EQ(counter, registry.counter("test_total", "Test counter", {{"label", "value"}}));
+  // family already exists with another type
+  ASSERT_EQ(nullptr, registry.gauge("test_total", "Test gauge"));
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; i++) {
+    threads.emplace_back([counter]() {
+      for (int j = 0; j < 1000; j++) {
+        counter->inc();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(8000, counter->value());
+  ASSERT_TRUE(contains(registry.serialize(), "test_total{label=\"value\"} 8000"));
+}
+
+TEST(MetricsTest, Histogram) {
+  metrics::Registry registry;
+  metrics::Histogram * histogram = registry.histogram("test_seconds", "Test histogram", {}, {0.1, 1});
+  histogram->observe(0.05);
+  histogram->observe(0.1);
+  histogram->observe(0.5);
+  histogram->observe(2);
+
+  auto snapshot = histogram->snapshot();
+  ASSERT_EQ(std::vector<uint64_t>({2, 3, 4}), snapshot.buckets);
+  ASSERT_EQ(4, snapshot.count);
+  ASSERT_NEAR(2.65, snapshot.sum, 1e-6);
+
+  const std::string& text = registry.serialize();
+  ASSERT_TRUE(contains(text, "# TYPE test_seconds histogram"));
+  ASSERT_TRUE(contains(text, "test_seconds_bucket{le=\"0.1\"} 2"));
+  ASSERT_TRUE(contains(text, "test_seconds_bucket{le=\"1\"} 3"));
+  ASSERT_TRUE(contains(text, "test_seconds_bucket{le=\"+Inf\"} 4"));
+  ASSERT_TRUE(contains(text, "test_seconds_sum 2.65"));
+  ASSERT_TRUE(contains(text, "test_seconds_count 4"));
+}
+
+TEST(MetricsTest, Collector) {
+  metrics::Registry registry;
+  int id = registry.addCollector("test_depth", "Test collector", "gauge", []() {
+    return std::vector<metrics::Registry::Sample>{{{{"name", "a\"b"}}, 3}};
+  });
+  ASSERT_TRUE(contains(registry.serialize(), "test_depth{name=\"a\\\"b\"} 3"));
+  registry.removeCollector(id);
+  ASSERT_EQ(std::string::npos, registry.serialize().find("test_depth"));
+}
+
+TEST(MetricsTest, ServerMetrics) {
+  rendezvous::Server server(SID);
+  server.initMetrics();
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+  const std::string& acsl_id = server.addNextACSL(request, ROOT_SUB_RID);
+  utils::ProtoVec regions;
+  server.registerBranchGTest(request, acsl_id, "s1", regions, EMPTY_TAG, "");
+  // branch is not closed so wait times out
+  ASSERT_EQ(TIMED_OUT, server.wait(request, ROOT_SUB_RID, "s1", "", "", false, 1));
+  server.getSubscriber("s1", "");
+
+  const std::string& text = metrics::Registry::get().serialize();
+  ASSERT_TRUE(contains(text, "rendezvous_requests{state=\"opened\"} 1"));
+  ASSERT_TRUE(contains(text, "rendezvous_subscriber_queue_depth{service=\"s1\",region=\"\",tags=\"\"} 0"));
+  ASSERT_NE(std::string::npos, text.find("rendezvous_wait_duration_seconds_count{outcome=\"timed_out\"}"));
+}
+
+TEST(MetricsTest, HttpExporter) {
+  metrics::Registry registry;
+  registry.counter("test_total", "Test counter")->inc(5);
+  int port = 19464;
+  metrics::HttpExporter exporter(registry, "127.0.0.1", port);
+  ASSERT_EQ(0, exporter.start());
+
+  int client = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+  ASSERT_EQ(0, connect(client, (sockaddr *) &addr, sizeof(addr)));
+  const std::string& request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  ASSERT_EQ((ssize_t) request.size(), send(client, request.data(), request.size(), 0));
+
+  std::string response;
+  char buffer[1024];
+  ssize_t n;
+  while ((n = recv(client, buffer, sizeof(buffer), 0)) > 0) {
+    response.append(buffer, n);
+  }
+  close(client);
+  exporter.stop();
+
+  ASSERT_EQ(0, response.rfind("HTTP/1.1 200 OK\r\n", 0));
+  ASSERT_TRUE(contains(response, "test_total 5"));
+}
+
+TEST(MetricsTest, RpcInterceptor) {
+  metrics::Registry registry;
+  auto server = std::make_shared<rendezvous::Server>(SID);
+  service::ClientServiceImpl client_service(server, {}, false);
+
+  std::vector<std::unique_ptr<grpc::experimental::ServerInterceptorFactoryInterface>> interceptor_creators;
+  interceptor_creators.push_back(std::make_unique<metrics::RpcInterceptorFactory>(registry,
+    std::vector<std::string>{ rendezvous::ClientService::service_full_name() }));
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort("localhost:8011", grpc::InsecureServerCredentials());
+  builder.RegisterService(&client_service);
+  builder.experimental().SetInterceptorCreators(std::move(interceptor_creators));
+  auto grpc_server = builder.BuildAndStart();
+  ASSERT_NE(nullptr, grpc_server);
+
+  // latency of every method is registered before serving RPCs
+  const metrics::Labels& labels = {{"service", "rendezvous.ClientService"}, {"method", "RegisterRequest"}};
+  metrics::Histogram * latency = registry.histogram("rendezvous_rpc_duration_seconds", "Latency of served RPCs", labels);
+  ASSERT_EQ(0, latency->snapshot().count);
+
+  auto stub = rendezvous::ClientService::NewStub(grpc::CreateChannel("localhost:8011", grpc::InsecureChannelCredentials()));
+  for (int i = 0; i < 2; i++) {
+    grpc::ClientContext context;
+    rendezvous::RegisterRequestMessage request;
+    rendezvous::RegisterRequestResponse response;
+    ASSERT_TRUE(stub->RegisterRequest(&context, request, &response).ok());
+  }
+  grpc_server->Shutdown();
+
+  ASSERT_EQ(2, latency->snapshot().count);
+  metrics::Labels handled_labels = labels;
+  handled_labels.emplace_back("code", "OK");
+  ASSERT_EQ(2, registry.counter("rendezvous_rpc_handled_total", "Number of served RPCs by status code", handled_labels)->value());
+}
+
+TEST(MetricsTest, RpcTraceRoundTrip) {
+  const std::string& filename = "/tmp/rendezvous_rpc_trace_test.bin";
+  {
+    metrics::RpcRecorder recorder(filename, 16);
+    ASSERT_TRUE(recorder.isOpen());
+    for (int i = 0; i < 3; i++) {
+      auto record = std::make_unique<rendezvous::TraceRecord>();
+      record->set_arrival_us(i * 10);
+      record->mutable_register_branch()->set_rid(getRid(i));
+      record->add_bids("b" + std::to_string(i));
+      ASSERT_TRUE(recorder.record(std::move(record)));
+    }
+  }
+
+  metrics::RpcTraceReader reader(filename);
+  ASSERT_TRUE(reader.isValid());
+  rendezvous::TraceRecord record;
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(reader.next(record));
+    ASSERT_EQ(i * 10, record.arrival_us());
+    ASSERT_EQ(getRid(i), record.register_branch().rid());
+    ASSERT_EQ("b" + std::to_string(i), record.bids(0));
+  }
+  ASSERT_FALSE(reader.next(record));
+
+  // truncated record (e.g. server killed while writing) ends the trace
+  std::ofstream(filename, std::ios::binary | std::ios::app).write("\x20\x01", 2);
+  metrics::RpcTraceReader truncated_reader(filename);
+  int count = 0;
+  while (truncated_reader.next(record)) {
+    count++;
+  }
+  ASSERT_EQ(3, count);
+
+  std::ofstream(filename, std::ios::binary | std::ios::trunc) << "not a trace";
+  ASSERT_FALSE(metrics::RpcTraceReader(filename).isValid());
+  std::remove(filename.c_str());
+}
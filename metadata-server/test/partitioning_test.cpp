@@ -0,0 +1,373 @@
+#include "../src/server.h"
+#include "../src/replicas/partition_client.h"
+#include "../src/services/client_service_impl.h"
+#include "../src/services/server_service_impl.h"
+#include "gtest/gtest.h"
+#include <grpcpp/grpcpp.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "utils.h"
+
+// -----------------
+// PARTITIONING TEST
+// -----------------
+
+static std::vector<replicas::ReplicaClient::Replica> getReplicas(const std::vector<std::string>& sids) {
+  std::vector<replicas::ReplicaClient::Replica> replicas;
+  int port = 8001;
+  for (const auto& sid : sids) {
+    replicas.push_back({ sid, "localhost:" + std::to_string(port++), { sid } });
+  }
+  return replicas;
+}
+
+TEST(PartitioningTest, OwnerIsConsistentAcrossReplicas) { 
+  rendezvous::Server server(SID);
+  replicas::PartitionClient eu("eu", getReplicas({"us", "ap"}));
+  replicas::PartitionClient us("us", getReplicas({"eu", "ap"}));
+  replicas::PartitionClient ap("ap", getReplicas({"eu", "us"}));
+
+  for (int i = 0; i < 1000; i++) {
+    std::string rid = server.genRid();
+    const std::string& owner = eu.getOwner(rid);
+    ASSERT_EQ(owner, us.getOwner(rid));
+    ASSERT_EQ(owner, ap.getOwner(rid));
+    // exactly one replica owns the request
+    ASSERT_EQ(1, eu.isOwner(rid) + us.isOwner(rid) + ap.isOwner(rid));
+  }
+}
+
+TEST(PartitioningTest, RequestsAreSpreadAmongReplicas) { 
+  rendezvous::Server server(SID);
+  replicas::PartitionClient eu("eu", getReplicas({"us", "ap"}));
+
+  std::unordered_map<std::string, int> owned;
+  int num_requests = 3000;
+  for (int i = 0; i < num_requests; i++) {
+    owned[eu.getOwner(server.genRid())]++;
+  }
+  ASSERT_EQ(3, owned.size());
+  for (const auto& it : owned) {
+    ASSERT_GT(it.second, num_requests / 6);
+  }
+}
+
+TEST(PartitioningTest, AddingReplicaOnlyMovesItsRequests) { 
+  rendezvous::Server server(SID);
+  replicas::PartitionClient before("eu", getReplicas({"us"}));
+  replicas::PartitionClient after("eu", getReplicas({"us", "ap"}));
+
+  for (int i = 0; i < 1000; i++) {
+    std::string rid = server.genRid();
+    const std::string& owner = after.getOwner(rid);
+    if (owner != "ap") {
+      ASSERT_EQ(before.getOwner(rid), owner);
+    }
+  }
+}
+
+TEST(PartitioningTest, SingleReplicaOwnsEverything) { 
+  rendezvous::Server server(SID);
+  replicas::PartitionClient eu("eu", getReplicas({}));
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(eu.isOwner(server.genRid()));
+  }
+}
+
+// replica of a partitioned cluster running in the current process
+typedef struct PartitionedNodeStruct {
+  std::shared_ptr<rendezvous::Server> server;
+  std::unique_ptr<service::ClientServiceImpl> client_service;
+  std::unique_ptr<service::ServerServiceImpl> server_service;
+  std::unique_ptr<grpc::Server> grpc_server;
+} PartitionedNode;
+
+static std::unique_ptr<PartitionedNode> startPartitionedNode(const std::string& sid, const std::string& addr,
+  std::vector<replicas::ReplicaClient::Replica> peers) {
+
+  json settings = {
+    {"cleanup_requests_interval_m", -1},
+    {"cleanup_requests_validity_m", -1},
+    {"cleanup_subscribers_interval_m", -1},
+    {"cleanup_subscribers_validity_m", -1},
+    {"subscribers_refresh_interval_s", 1},
+    {"subscribers_queue_capacity", 1024},
+    {"subscribers_overflow_policy", "drop_oldest"},
+    {"subscribers_spill_dir", "/tmp/rendezvous"},
+    {"wait_replica_timeout_s", 0},
+    {"selective_replication", false},
+    {"partitioned_mode", true},
+    {"wait_traces_file", ""}
+  };
+  auto node = std::make_unique<PartitionedNode>();
+  node->server = std::make_shared<rendezvous::Server>(sid, settings);
+  node->client_service = std::make_unique<service::ClientServiceImpl>(node->server, peers, false);
+  node->server_service = std::make_unique<service::ServerServiceImpl>(node->server, false);
+
+  grpc::ServerBuilder builder;
+  builder.AddListeningPort(addr, grpc::InsecureServerCredentials());
+  builder.RegisterService(node->client_service.get());
+  builder.RegisterService(node->server_service.get());
+  node->grpc_server = builder.BuildAndStart();
+  return node;
+}
+
+// subscribed services are announced to the remaining replicas in the background
+static bool waitRemoteSubscriber(PartitionedNode * node, const std::string& sid, const std::string& service) {
+  for (int i = 0; i < 500; i++) {
+    if (node->server->getRemoteSubscribers(service).count(sid) != 0) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+TEST(PartitioningTest, NonOwnerForwardsToOwner) { 
+  utils::ASYNC_REPLICATION = false;
+  std::vector<replicas::ReplicaClient::Replica> replicas = getReplicas({"eu", "us"});
+  auto eu = startPartitionedNode("eu", replicas[0].addr, { replicas[1] });
+  auto us = startPartitionedNode("us", replicas[1].addr, { replicas[0] });
+  ASSERT_NE(nullptr, eu->grpc_server);
+  ASSERT_NE(nullptr, us->grpc_server);
+
+  // request owned by the other replica
+  replicas::PartitionClient partition_client("eu", { replicas[1] });
+  std::string rid = eu->server->genRid();
+  while (partition_client.isOwner(rid)) {
+    rid = eu->server->genRid();
+  }
+  metadata::Subscriber * subscriber = eu->server->getSubscriber("service", "");
+  ASSERT_TRUE(waitRemoteSubscriber(us.get(), "eu", "service"));
+  auto stub = rendezvous::ClientService::NewStub(grpc::CreateChannel(replicas[0].addr, grpc::InsecureChannelCredentials()));
+
+  // register request
+  {
+    grpc::ClientContext context;
+    rendezvous::RegisterRequestMessage request;
+    rendezvous::RegisterRequestResponse response;
+    request.set_rid(rid);
+    ASSERT_TRUE(stub->RegisterRequest(&context, request, &response).ok());
+    ASSERT_EQ(rid, response.rid());
+  }
+  metadata::Request * owned_request = us->server->getRequest(rid);
+  ASSERT_NE(nullptr, owned_request);
+  ASSERT_EQ(nullptr, eu->server->getRequest(rid));
+
+  // register branch (owner publishes monitored branches to the subscribers of the non-owner)
+  std::string bid;
+  {
+    grpc::ClientContext context;
+    rendezvous::RegisterBranchMessage request;
+    rendezvous::RegisterBranchResponse response;
+    request.set_rid(rid);
+    request.set_service("service");
+    request.add_regions("EU");
+    request.set_monitor(true);
+    ASSERT_TRUE(stub->RegisterBranch(&context, request, &response).ok());
+    bid = response.bid();
+  }
+  std::string core_bid(us->server->parseFullId(bid).first);
+  ASSERT_NE(nullptr, owned_request->getBranch(core_bid));
+  ASSERT_EQ(nullptr, eu->server->getRequest(rid));
+  ASSERT_EQ(1, subscriber->getQueueStats().queued);
+
+  // register branches
+  std::vector<std::string> other_bids;
+  {
+    grpc::ClientContext context;
+    rendezvous::RegisterBranchesMessage request;
+    rendezvous::RegisterBranchesResponse response;
+    request.set_rid(rid);
+    auto branch = request.add_branches();
+    branch->set_service("service");
+    branch->add_regions("EU");
+    branch->set_monitor(true);
+    branch = request.add_branches();
+    branch->set_service("other-service");
+    ASSERT_TRUE(stub->RegisterBranches(&context, request, &response).ok());
+    ASSERT_EQ(2, response.bids_size());
+    for (const auto& other_bid : response.bids()) {
+      other_bids.emplace_back(us->server->parseFullId(other_bid).first);
+      ASSERT_NE(nullptr, owned_request->getBranch(other_bids.back()));
+    }
+  }
+  ASSERT_EQ(2, subscriber->getQueueStats().queued);
+
+  // close branch
+  {
+    grpc::ClientContext context;
+    rendezvous::CloseBranchMessage request;
+    rendezvous::Empty response;
+    request.set_bid(bid);
+    request.set_region("EU");
+    ASSERT_TRUE(stub->CloseBranch(&context, request, &response).ok());
+  }
+  ASSERT_TRUE(owned_request->getBranch(core_bid)->isGloballyClosed());
+  for (const auto& other_bid : other_bids) {
+    ASSERT_FALSE(owned_request->getBranch(other_bid)->isGloballyClosed());
+  }
+
+  // non-owner does not know the request so its subscribers keep the branch until it is acked
+  ASSERT_TRUE(us->server->isBranchClosed(bid, "EU"));
+  ASSERT_FALSE(eu->server->isBranchClosed(bid, "EU"));
+
+  eu->grpc_server->Shutdown();
+  us->grpc_server->Shutdown();
+}
+
+TEST(PartitioningTest, OwnerPublishesToSubscribedReplicas) { 
+  utils::ASYNC_REPLICATION = false;
+  std::vector<replicas::ReplicaClient::Replica> replicas = getReplicas({"eu", "us", "ap"});
+  auto eu = startPartitionedNode("eu", replicas[0].addr, { replicas[1], replicas[2] });
+  auto us = startPartitionedNode("us", replicas[1].addr, { replicas[0], replicas[2] });
+  auto ap = startPartitionedNode("ap", replicas[2].addr, { replicas[0], replicas[1] });
+  ASSERT_NE(nullptr, eu->grpc_server);
+  ASSERT_NE(nullptr, us->grpc_server);
+  ASSERT_NE(nullptr, ap->grpc_server);
+
+  // request owned by 'us' and forwarded by 'eu'
+  replicas::PartitionClient partition_client("eu", { replicas[1], replicas[2] });
+  std::string rid = eu->server->genRid();
+  while (partition_client.getOwner(rid) != "us") {
+    rid = eu->server->genRid();
+  }
+
+  // monitor is neither on the owner nor on the forwarding replica
+  metadata::Subscriber * subscriber = ap->server->getSubscriber("service", "EU");
+  ASSERT_TRUE(waitRemoteSubscriber(us.get(), "ap", "service"));
+  ASSERT_TRUE(waitRemoteSubscriber(eu.get(), "ap", "service"));
+
+  auto eu_stub = rendezvous::ClientService::NewStub(grpc::CreateChannel(replicas[0].addr, grpc::InsecureChannelCredentials()));
+  auto ap_stub = rendezvous::ClientService::NewStub(grpc::CreateChannel(replicas[2].addr, grpc::InsecureChannelCredentials()));
+  {
+    grpc::ClientContext context;
+    rendezvous::RegisterRequestMessage request;
+    rendezvous::RegisterRequestResponse response;
+    request.set_rid(rid);
+    ASSERT_TRUE(eu_stub->RegisterRequest(&context, request, &response).ok());
+  }
+  std::string bid;
+  {
+    grpc::ClientContext context;
+    rendezvous::RegisterBranchMessage request;
+    rendezvous::RegisterBranchResponse response;
+    request.set_rid(rid);
+    request.set_service("service");
+    request.add_regions("EU");
+    request.set_monitor(true);
+    ASSERT_TRUE(eu_stub->RegisterBranch(&context, request, &response).ok());
+    bid = response.bid();
+  }
+  ASSERT_EQ(1, subscriber->getQueueStats().queued);
+  grpc::ServerContext server_context;
+  ASSERT_EQ(1, subscriber->popBatch(&server_context, 10).size());
+
+  // monitor closes the branch in its region through its own replica
+  {
+    grpc::ClientContext context;
+    rendezvous::CloseBranchMessage request;
+    rendezvous::Empty response;
+    request.set_bid(bid);
+    request.set_region("EU");
+    ASSERT_TRUE(ap_stub->CloseBranch(&context, request, &response).ok());
+  }
+  std::string core_bid(us->server->parseFullId(bid).first);
+  ASSERT_TRUE(us->server->getRequest(rid)->getBranch(core_bid)->isGloballyClosed());
+
+  // request is unknown in the monitor's replica but the forwarded close acks the branch there
+  ASSERT_FALSE(ap->server->isBranchClosed(bid, "EU"));
+  subscriber->seek(subscriber->getCursor());
+  ASSERT_EQ(0, subscriber->getLogSize());
+
+  eu->grpc_server->Shutdown();
+  us->grpc_server->Shutdown();
+  ap->grpc_server->Shutdown();
+}
+
+TEST(PartitioningTest, MonitorForwardsAcksToOwners) { 
+  utils::ASYNC_REPLICATION = false;
+  std::vector<replicas::ReplicaClient::Replica> replicas = getReplicas({"eu", "us", "ap"});
+  auto eu = startPartitionedNode("eu", replicas[0].addr, { replicas[1], replicas[2] });
+  auto us = startPartitionedNode("us", replicas[1].addr, { replicas[0], replicas[2] });
+  auto ap = startPartitionedNode("ap", replicas[2].addr, { replicas[0], replicas[1] });
+  ASSERT_NE(nullptr, eu->grpc_server);
+  ASSERT_NE(nullptr, us->grpc_server);
+  ASSERT_NE(nullptr, ap->grpc_server);
+
+  // monitor is on a replica that does not own any of the requests
+  metadata::Subscriber * subscriber = ap->server->getSubscriber("service", "EU");
+  ASSERT_TRUE(waitRemoteSubscriber(us.get(), "ap", "service"));
+  ASSERT_TRUE(waitRemoteSubscriber(eu.get(), "ap", "service"));
+  auto ap_stub = rendezvous::ClientService::NewStub(grpc::CreateChannel(replicas[2].addr, grpc::InsecureChannelCredentials()));
+
+  grpc::ClientContext monitor_context;
+  auto stream = ap_stub->Monitor(&monitor_context);
+  rendezvous::MonitorMessage message;
+  message.mutable_subscribe()->set_service("service");
+  message.mutable_subscribe()->set_region("EU");
+  ASSERT_TRUE(stream->Write(message));
+
+  // two branches of a request owned by 'us' and one of a request owned by 'eu'
+  replicas::PartitionClient partition_client("ap", { replicas[0], replicas[1] });
+  std::unordered_map<std::string, std::string> rids;
+  while (rids.size() < 2) {
+    std::string rid = ap->server->genRid();
+    const std::string& owner = partition_client.getOwner(rid);
+    if (owner != "ap") {
+      rids.emplace(owner, rid);
+    }
+  }
+  for (const auto& [owner, rid] : rids) {
+    grpc::ClientContext context;
+    rendezvous::RegisterRequestMessage request;
+    rendezvous::RegisterRequestResponse response;
+    request.set_rid(rid);
+    ASSERT_TRUE(ap_stub->RegisterRequest(&context, request, &response).ok());
+  }
+  std::vector<std::pair<std::string, std::string>> owned_bids;
+  for (const std::string& owner : { "us", "us", "eu" }) {
+    grpc::ClientContext context;
+    rendezvous::RegisterBranchMessage request;
+    rendezvous::RegisterBranchResponse response;
+    request.set_rid(rids[owner]);
+    request.set_service("service");
+    request.add_regions("EU");
+    request.set_monitor(true);
+    ASSERT_TRUE(ap_stub->RegisterBranch(&context, request, &response).ok());
+    owned_bids.emplace_back(owner, response.bid());
+  }
+
+  // all acks are sent in a single message
+  rendezvous::SubscribeResponse response;
+  message.Clear();
+  for (size_t i = 0; i < owned_bids.size(); i++) {
+    ASSERT_TRUE(stream->Read(&response));
+    auto ack = message.add_acks();
+    ack->set_bid(response.bid());
+    ack->set_region("EU");
+  }
+  ASSERT_TRUE(stream->Write(message));
+  ASSERT_TRUE(stream->WritesDone());
+  ASSERT_TRUE(stream->Finish().ok());
+
+  // branches are closed by their owners and acked in the subscriber of the monitor
+  std::unordered_map<std::string, PartitionedNode *> owners = { { "eu", eu.get() }, { "us", us.get() } };
+  for (const auto& [owner, bid] : owned_bids) {
+    auto ids = owners[owner]->server->parseFullId(bid);
+    metadata::Request * request = owners[owner]->server->getRequest(ids.second);
+    ASSERT_NE(nullptr, request);
+    ASSERT_TRUE(request->getBranch(ids.first)->isGloballyClosed());
+  }
+  ASSERT_EQ(nullptr, ap->server->getRequest(rids["us"]));
+  subscriber->seek(subscriber->getCursor());
+  ASSERT_EQ(0, subscriber->getLogSize());
+  subscriber->releaseCursor();
+
+  eu->grpc_server->Shutdown();
+  us->grpc_server->Shutdown();
+  ap->grpc_server->Shutdown();
+}
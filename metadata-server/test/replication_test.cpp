@@ -0,0 +1,494 @@
+#include "../src/server.h"
+#include "../src/replicas/replica_client.h"
+#include "../src/services/client_service_impl.h"
+#include "../src/services/server_service_impl.h"
+#include "gtest/gtest.h"
+#include <grpcpp/grpcpp.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <chrono>
+#include <functional>
+#include "utils.h"
+
+// ---------------------------
+// SELECTIVE REPLICATION TEST
+// ---------------------------
+
+static std::vector<replicas::ReplicaClient::Replica> getRegionReplicas() {
+  return {
+    { "eu", "localhost:8001", { "EU" } },
+    { "us", "localhost:8002", { "US", "CA" } },
+  };
+}
+
+static replicas::ReplicaClient::BranchScope getScope(std::vector<std::string> regions,
+  std::unordered_set<std::string> subscribers = {}) {
+
+  replicas::ReplicaClient::BranchScope scope{};
+  scope.regions = regions;
+  scope.subscribers = subscribers;
+  return scope;
+}
+
+TEST(ReplicationTest, FullReplicasByRegion) {
+  auto replicas = getRegionReplicas();
+  replicas::ReplicaClient client(replicas, true);
+
+  // only the replica responsible for the region tracks the full metadata
+  ASSERT_TRUE(client.isFullReplica(replicas[0], getScope({"EU"})));
+  ASSERT_FALSE(client.isFullReplica(replicas[1], getScope({"EU"})));
+
+  ASSERT_FALSE(client.isFullReplica(replicas[0], getScope({"CA"})));
+  ASSERT_TRUE(client.isFullReplica(replicas[1], getScope({"CA"})));
+
+  // any of the regions of the branch
+  ASSERT_TRUE(client.isFullReplica(replicas[0], getScope({"AP", "EU"})));
+  ASSERT_TRUE(client.isFullReplica(replicas[1], getScope({"AP", "US"})));
+  ASSERT_FALSE(client.isFullReplica(replicas[0], getScope({"AP"})));
+  ASSERT_FALSE(client.isFullReplica(replicas[1], getScope({"AP"})));
+
+  // global region is visible in every region
+  ASSERT_TRUE(client.isFullReplica(replicas[0], getScope({})));
+  ASSERT_TRUE(client.isFullReplica(replicas[1], getScope({})));
+}
+
+TEST(ReplicationTest, FullReplicasBySubscribers) {
+  auto replicas = getRegionReplicas();
+  replicas::ReplicaClient client(replicas, true);
+
+  // replicas with subscribers for the service receive the full metadata outside their regions
+  ASSERT_FALSE(client.isFullReplica(replicas[1], getScope({"EU"})));
+  ASSERT_TRUE(client.isFullReplica(replicas[1], getScope({"EU"}, {"us"})));
+  ASSERT_FALSE(client.isFullReplica(replicas[0], getScope({"US"}, {"us"})));
+}
+
+TEST(ReplicationTest, FullReplicaForOrigin) {
+  auto replicas = getRegionReplicas();
+  replicas::ReplicaClient client(replicas, true);
+
+  // the replica that registered the branch always tracks its regions
+  auto scope = getScope({"US"});
+  scope.origin = "eu";
+  ASSERT_TRUE(client.isFullReplica(replicas[0], scope));
+  ASSERT_TRUE(client.isFullReplica(replicas[1], scope));
+}
+
+TEST(ReplicationTest, FullReplicasWithoutSelectiveReplication) {
+  auto replicas = getRegionReplicas();
+  replicas::ReplicaClient client(replicas, false);
+
+  ASSERT_TRUE(client.isFullReplica(replicas[0], getScope({"US"})));
+  ASSERT_TRUE(client.isFullReplica(replicas[1], getScope({"EU"})));
+}
+
+TEST(ReplicationTest, RemoteSubscribersVersions) {
+  rendezvous::Server server(SID);
+
+  ASSERT_TRUE(server.addRemoteSubscriber("eu", "service", 1));
+  ASSERT_EQ(1, server.getRemoteSubscribers("service").count("eu"));
+
+  ASSERT_TRUE(server.removeRemoteSubscriber("eu", "service", 2));
+  ASSERT_EQ(0, server.getRemoteSubscribers("service").count("eu"));
+
+  // outdated announcement (delivered after the removal) is ignored
+  ASSERT_FALSE(server.addRemoteSubscriber("eu", "service", 1));
+  ASSERT_EQ(0, server.getRemoteSubscribers("service").count("eu"));
+
+  ASSERT_TRUE(server.addRemoteSubscriber("eu", "service", 3));
+  ASSERT_TRUE(server.addRemoteSubscriber("us", "service", 1));
+  ASSERT_EQ(2, server.getRemoteSubscribers("service").size());
+
+  // outdated removal is ignored
+  ASSERT_FALSE(server.removeRemoteSubscriber("eu", "service", 2));
+  ASSERT_EQ(2, server.getRemoteSubscribers("service").size());
+}
+
+TEST(ReplicationTest, AnnounceFirstSubscriberOfService) {
+  rendezvous::Server server(SID);
+  std::vector<std::tuple<std::string, bool, uint64_t>> announcements;
+  server.setSubscribedServiceListener([&announcements](const std::string& service, bool subscribed, uint64_t version) {
+    announcements.emplace_back(service, subscribed, version);
+  });
+
+  server.getSubscriber("service", "EU");
+  server.getSubscriber("service", "EU");
+  server.getSubscriber("service", "US");
+  server.getSubscriber("service", "", {"tag"});
+  ASSERT_EQ(1, announcements.size());
+  ASSERT_EQ("service", std::get<0>(announcements[0]));
+  ASSERT_TRUE(std::get<1>(announcements[0]));
+
+  server.getSubscriber("other-service", "EU");
+  ASSERT_EQ(2, announcements.size());
+  ASSERT_EQ("other-service", std::get<0>(announcements[1]));
+  ASSERT_LT(std::get<2>(announcements[0]), std::get<2>(announcements[1]));
+
+  server.setSubscribedServiceListener(nullptr);
+}
+
+TEST(ReplicationTest, CloseBranchesBatch) {
+  auto server = std::make_shared<rendezvous::Server>(SID);
+  service::ServerServiceImpl server_service(server, true);
+  metadata::Request * request = server->getOrRegisterRequest(RID);
+
+  utils::ProtoVec regions;
+  regions.Add("EU");
+  regions.Add("US");
+  std::string bid_0 = server->registerBranchGTest(request, ROOT_SUB_RID, "service", regions, "", "");
+  std::string bid_1 = server->registerBranchGTest(request, ROOT_SUB_RID, "service", regions, "", "");
+
+  grpc::ServerContext context;
+  rendezvous_server::CloseBranchesMessage message;
+  rendezvous_server::Empty response;
+  auto add_close = [&message](const std::string& bid, const std::string& region) {
+    auto branch = message.add_branches();
+    branch->set_rid(RID);
+    branch->set_core_bid(bid);
+    branch->set_region(region);
+  };
+  add_close(bid_0, "EU");
+  add_close(bid_1, "AP");
+  add_close(bid_1, "US");
+
+  // invalid close is reported but remaining closes are still applied
+  grpc::Status status = server_service.CloseBranches(&context, &message, &response);
+  ASSERT_EQ(grpc::StatusCode::INVALID_ARGUMENT, status.error_code());
+  ASSERT_TRUE(request->getBranch(bid_0)->isGloballyClosed("EU"));
+  ASSERT_FALSE(request->getBranch(bid_0)->isGloballyClosed("US"));
+  ASSERT_FALSE(request->getBranch(bid_1)->isGloballyClosed("EU"));
+  ASSERT_TRUE(request->getBranch(bid_1)->isGloballyClosed("US"));
+}
+
+// replica of a cluster running in the current process
+typedef struct ReplicaNodeStruct {
+  std::shared_ptr<rendezvous::Server> server;
+  std::unique_ptr<service::ClientServiceImpl> client_service;
+  std::unique_ptr<service::ServerServiceImpl> server_service;
+  std::unique_ptr<grpc::Server> grpc_server;
+  std::unique_ptr<rendezvous::ClientService::Stub> stub;
+} ReplicaNode;
+
+static std::vector<std::unique_ptr<ReplicaNode>> startCluster(const std::vector<replicas::ReplicaClient::Replica>& replicas,
+  bool selective_replication, int wait_replica_timeout_s = 0) {
+
+  json settings = {
+    {"cleanup_requests_interval_m", -1},
+    {"cleanup_requests_validity_m", -1},
+    {"cleanup_subscribers_interval_m", -1},
+    {"cleanup_subscribers_validity_m", -1},
+    {"subscribers_refresh_interval_s", 1},
+    {"subscribers_queue_capacity", 1024},
+    {"subscribers_overflow_policy", "drop_oldest"},
+    {"subscribers_spill_dir", "/tmp/rendezvous"},
+    {"wait_replica_timeout_s", wait_replica_timeout_s},
+    {"selective_replication", selective_replication},
+    {"partitioned_mode", false},
+    {"wait_traces_file", ""}
+  };
+  std::vector<std::unique_ptr<ReplicaNode>> nodes;
+  for (const auto& replica : replicas) {
+    std::vector<replicas::ReplicaClient::Replica> peers;
+    for (const auto& peer : replicas) {
+      if (peer.sid != replica.sid) {
+        peers.emplace_back(peer);
+      }
+    }
+    auto node = std::make_unique<ReplicaNode>();
+    node->server = std::make_shared<rendezvous::Server>(replica.sid, settings);
+    node->client_service = std::make_unique<service::ClientServiceImpl>(node->server, peers, false);
+    node->server_service = std::make_unique<service::ServerServiceImpl>(node->server, false);
+
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(replica.addr, grpc::InsecureServerCredentials());
+    builder.RegisterService(node->client_service.get());
+    builder.RegisterService(node->server_service.get());
+    node->grpc_server = builder.BuildAndStart();
+    node->stub = rendezvous::ClientService::NewStub(grpc::CreateChannel(replica.addr, grpc::InsecureChannelCredentials()));
+    nodes.emplace_back(std::move(node));
+  }
+  return nodes;
+}
+
+static void stopCluster(std::vector<std::unique_ptr<ReplicaNode>>& nodes) {
+  for (auto& node : nodes) {
+    node->grpc_server->Shutdown();
+  }
+}
+
+// async replication is applied by the remaining replicas in the background
+static bool waitReplicated(const std::function<bool()>& replicated) {
+  for (int i = 0; i < 500; i++) {
+    if (replicated()) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+static std::string registerRequest(ReplicaNode * node) {
+  grpc::ClientContext context;
+  rendezvous::RegisterRequestMessage request;
+  rendezvous::RegisterRequestResponse response;
+  EXPECT_TRUE(node->stub->RegisterRequest(&context, request, &response).ok());
+  return response.rid();
+}
+
+static std::string registerBranch(ReplicaNode * node, const std::string& rid, const std::string& region) {
+  grpc::ClientContext context;
+  rendezvous::RegisterBranchMessage request;
+  rendezvous::RegisterBranchResponse response;
+  request.set_rid(rid);
+  request.set_service("service");
+  request.add_regions(region);
+  EXPECT_TRUE(node->stub->RegisterBranch(&context, request, &response).ok());
+  return response.bid();
+}
+
+static grpc::Status closeBranch(ReplicaNode * node, const std::string& bid, const std::string& region) {
+  grpc::ClientContext context;
+  rendezvous::CloseBranchMessage request;
+  rendezvous::Empty response;
+  request.set_bid(bid);
+  request.set_region(region);
+  return node->stub->CloseBranch(&context, request, &response);
+}
+
+TEST(ReplicationTest, SyncReplicationAppliedBeforeReply) {
+  utils::ASYNC_REPLICATION = false;
+  std::vector<replicas::ReplicaClient::Replica> replicas = {
+    { "eu", "localhost:8024", { "EU" } },
+    { "us", "localhost:8025", { "US" } },
+  };
+  auto nodes = startCluster(replicas, false);
+  auto& eu = nodes[0];
+  auto& us = nodes[1];
+  for (const auto& node : nodes) {
+    ASSERT_NE(nullptr, node->grpc_server);
+  }
+
+  // calls only return after every replica applied them
+  std::string rid = registerRequest(eu.get());
+  std::string bid = registerBranch(eu.get(), rid, "EU");
+  std::string core_bid(eu->server->parseFullId(bid).first);
+  metadata::Request * us_request = us->server->getRequest(rid);
+  ASSERT_NE(nullptr, us_request);
+  ASSERT_NE(nullptr, us_request->getBranch(core_bid));
+
+  ASSERT_TRUE(closeBranch(eu.get(), bid, "EU").ok());
+  ASSERT_TRUE(us_request->getBranch(core_bid)->isGloballyClosed());
+
+  // no versions are propagated without async replication
+  ASSERT_EQ(0, us_request->getVersionsRegistry()->getLocalVersion("eu"));
+
+  stopCluster(nodes);
+}
+
+TEST(ReplicationTest, AsyncReplicationPropagatesVersions) {
+  utils::ASYNC_REPLICATION = true;
+  std::vector<replicas::ReplicaClient::Replica> replicas = {
+    { "eu", "localhost:8026", { "EU" } },
+    { "us", "localhost:8027", { "US" } },
+  };
+  auto nodes = startCluster(replicas, false, 1);
+  auto& eu = nodes[0];
+  auto& us = nodes[1];
+  for (const auto& node : nodes) {
+    ASSERT_NE(nullptr, node->grpc_server);
+  }
+
+  // the mode is shared by every translation unit (services and replica client of both replicas)
+  std::string rid = registerRequest(eu.get());
+  std::string bid = registerBranch(eu.get(), rid, "EU");
+  std::string core_bid(eu->server->parseFullId(bid).first);
+  ASSERT_EQ(1, eu->server->getRequest(rid)->getVersionsRegistry()->getLocalVersion("eu"));
+  ASSERT_TRUE(waitReplicated([&us, &rid, &core_bid]() {
+    metadata::Request * request = us->server->getRequest(rid);
+    return request != nullptr && request->getBranch(core_bid) != nullptr;
+  }));
+
+  // replica applied the version sent with the branch
+  metadata::Request * us_request = us->server->getRequest(rid);
+  ASSERT_EQ(1, us_request->getVersionsRegistry()->getLocalVersion("eu"));
+
+  ASSERT_TRUE(closeBranch(eu.get(), bid, "EU").ok());
+  ASSERT_TRUE(waitReplicated([us_request, &core_bid]() {
+    return us_request->getBranch(core_bid)->isGloballyClosed();
+  }));
+
+  stopCluster(nodes);
+  utils::ASYNC_REPLICATION = false;
+}
+
+TEST(ReplicationTest, CompactReplicaClosedByConcurrentRegionCloses) {
+  utils::ASYNC_REPLICATION = false;
+  std::vector<replicas::ReplicaClient::Replica> replicas = {
+    { "eu", "localhost:8021", { "EU" } },
+    { "us", "localhost:8022", { "US" } },
+    { "ap", "localhost:8023", { "AP" } },
+  };
+  auto nodes = startCluster(replicas, true);
+  auto& eu = nodes[0];
+  auto& us = nodes[1];
+  auto& ap = nodes[2];
+  for (const auto& node : nodes) {
+    ASSERT_NE(nullptr, node->grpc_server);
+  }
+
+  std::string rid;
+  {
+    grpc::ClientContext context;
+    rendezvous::RegisterRequestMessage request;
+    rendezvous::RegisterRequestResponse response;
+    ASSERT_TRUE(eu->stub->RegisterRequest(&context, request, &response).ok());
+    rid = response.rid();
+  }
+
+  // branch of EU and US is only tracked by counters in the AP replica
+  std::string bid;
+  {
+    grpc::ClientContext context;
+    rendezvous::RegisterBranchMessage request;
+    rendezvous::RegisterBranchResponse response;
+    request.set_rid(rid);
+    request.set_service("service");
+    request.add_regions("EU");
+    request.add_regions("US");
+    ASSERT_TRUE(eu->stub->RegisterBranch(&context, request, &response).ok());
+    bid = response.bid();
+  }
+  std::string core_bid(eu->server->parseFullId(bid).first);
+  metadata::Request * ap_request = ap->server->getRequest(rid);
+  ASSERT_NE(nullptr, ap_request);
+  ASSERT_TRUE(ap_request->getBranch(core_bid)->isCompact());
+  ASSERT_TRUE(ap_request->getBranch(core_bid)->getRegions().empty());
+  ASSERT_FALSE(us->server->getRequest(rid)->getBranch(core_bid)->isCompact());
+
+  // each region is closed in its own replica before the close of the other region is replicated there
+  auto close = [&bid](ReplicaNode * node, const std::string& region) {
+    grpc::ClientContext context;
+    rendezvous::CloseBranchMessage request;
+    rendezvous::Empty response;
+    request.set_bid(bid);
+    request.set_region(region);
+    ASSERT_TRUE(node->stub->CloseBranch(&context, request, &response).ok());
+  };
+  std::thread close_eu(close, eu.get(), "EU");
+  std::thread close_us(close, us.get(), "US");
+  close_eu.join();
+  close_us.join();
+
+  for (const auto& node : nodes) {
+    metadata::Request * request = node->server->getRequest(rid);
+    ASSERT_TRUE(request->getBranch(core_bid)->isGloballyClosed());
+    ASSERT_EQ(CLOSED, node->server->checkStatus(request, ROOT_SUB_RID, "service", "").status);
+    ASSERT_EQ(CLOSED, node->server->checkStatus(request, ROOT_SUB_RID, "", "").status);
+  }
+
+  stopCluster(nodes);
+}
+
+TEST(ReplicationTest, CompactReplicaClosedByReplicaOutsideRegions) {
+  utils::ASYNC_REPLICATION = false;
+  std::vector<replicas::ReplicaClient::Replica> replicas = {
+    { "eu", "localhost:8028", { "EU" } },
+    { "us", "localhost:8029", { "US" } },
+    { "ap", "localhost:8030", { "AP" } },
+  };
+  auto nodes = startCluster(replicas, true);
+  auto& eu = nodes[0];
+  auto& us = nodes[1];
+  auto& ap = nodes[2];
+  for (const auto& node : nodes) {
+    ASSERT_NE(nullptr, node->grpc_server);
+  }
+
+  // branch registered in EU for the US region is only tracked by counters in the AP replica
+  std::string rid = registerRequest(eu.get());
+  std::string bid = registerBranch(eu.get(), rid, "US");
+  std::string core_bid(eu->server->parseFullId(bid).first);
+  ASSERT_EQ("eu", eu->server->parseBranchSid(core_bid));
+  metadata::Request * ap_request = ap->server->getRequest(rid);
+  ASSERT_TRUE(ap_request->getBranch(core_bid)->isCompact());
+  ASSERT_EQ(OPENED, ap->server->checkStatus(ap_request, ROOT_SUB_RID, "service", "").status);
+
+  // region is closed in US and the replica that registered the branch closes it in AP
+  ASSERT_TRUE(closeBranch(us.get(), bid, "US").ok());
+  for (const auto& node : nodes) {
+    metadata::Request * request = node->server->getRequest(rid);
+    ASSERT_TRUE(request->getBranch(core_bid)->isGloballyClosed());
+    ASSERT_EQ(CLOSED, node->server->checkStatus(request, ROOT_SUB_RID, "service", "").status);
+  }
+
+  stopCluster(nodes);
+}
+
+TEST(ReplicationTest, MonitorAcksCloseBranchesInReplicas) {
+  utils::ASYNC_REPLICATION = false;
+  std::vector<replicas::ReplicaClient::Replica> replicas = {
+    { "eu", "localhost:8031", { "EU" } },
+    { "us", "localhost:8032", { "US" } },
+  };
+  auto nodes = startCluster(replicas, false);
+  auto& eu = nodes[0];
+  auto& us = nodes[1];
+  for (const auto& node : nodes) {
+    ASSERT_NE(nullptr, node->grpc_server);
+  }
+
+  // subscriber is loaded before the monitor so that no branch is published before it
+  eu->server->getSubscriber("service", "EU");
+  grpc::ClientContext monitor_context;
+  auto stream = eu->stub->Monitor(&monitor_context);
+  rendezvous::MonitorMessage message;
+  message.mutable_subscribe()->set_service("service");
+  message.mutable_subscribe()->set_region("EU");
+  ASSERT_TRUE(stream->Write(message));
+
+  std::string rid = registerRequest(eu.get());
+  std::vector<std::string> bids;
+  for (int i = 0; i < 2; i++) {
+    grpc::ClientContext context;
+    rendezvous::RegisterBranchMessage request;
+    rendezvous::RegisterBranchResponse response;
+    request.set_rid(rid);
+    request.set_service("service");
+    request.add_regions("EU");
+    request.set_monitor(true);
+    ASSERT_TRUE(eu->stub->RegisterBranch(&context, request, &response).ok());
+    bids.emplace_back(response.bid());
+  }
+
+  // monitor receives the bids and acks all of them in a single message
+  rendezvous::SubscribeResponse response;
+  message.Clear();
+  for (const auto& bid : bids) {
+    ASSERT_TRUE(stream->Read(&response));
+    ASSERT_EQ(bid, response.bid());
+    auto ack = message.add_acks();
+    ack->set_bid(response.bid());
+    ack->set_region("EU");
+  }
+  ASSERT_TRUE(stream->Write(message));
+
+  // closes are applied locally and replicated
+  for (const auto& bid : bids) {
+    std::string core_bid(eu->server->parseFullId(bid).first);
+    for (const auto& node : nodes) {
+      ASSERT_TRUE(waitReplicated([&node, &rid, &core_bid]() {
+        metadata::Request * request = node->server->getRequest(rid);
+        return request != nullptr && request->getBranch(core_bid) != nullptr
+          && request->getBranch(core_bid)->isGloballyClosed();
+      }));
+    }
+  }
+  ASSERT_EQ(CLOSED, us->server->checkStatus(us->server->getRequest(rid), ROOT_SUB_RID, "service", "EU").status);
+
+  // monitor stops by closing its side of the stream
+  ASSERT_TRUE(stream->WritesDone());
+  ASSERT_TRUE(stream->Finish().ok());
+
+  stopCluster(nodes);
+}
@@ -137,3 +137,40 @@ TEST(ServiceTagsTest, CheckStatusDetailedDuplicateTag) {
   ASSERT_EQ(1, r.tagged.count("write_post"));
   ASSERT_EQ(CLOSED, r.tagged["write_post"]);
 }
+
+TEST(ServiceTagsTest, WaitTagDuplicateTag) {
+  rendezvous::Server server(SID);
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+
+  utils::ProtoVec regions_0;
+  regions_0.Add("EU");
+  regions_0.Add("US");
+  std::string bid_0 = server.registerBranchGTest(request, ROOT_SUB_RID, "post_storage", regions_0, "write_post", "");
+  ASSERT_EQ(getBid(0), bid_0);
+
+  utils::ProtoVec regions_1;
+  regions_1.Add("US");
+  std::string bid_1 = server.registerBranchGTest(request, ROOT_SUB_RID, "post_storage", regions_1, "write_post", "");
+  ASSERT_EQ(getBid(1), bid_1);
+
+  // branches of other tags are ignored
+  std::string bid_2 = server.registerBranchGTest(request, ROOT_SUB_RID, "post_storage", regions_0, "read_post", "");
+  ASSERT_EQ(getBid(2), bid_2);
+
+  ASSERT_EQ(1, server.closeBranch(request, bid_0, "EU"));
+  ASSERT_EQ(INCONSISTENCY_NOT_PREVENTED, server.wait(request, ROOT_SUB_RID, "post_storage", "EU", "write_post", false, 1));
+  ASSERT_EQ(TIMED_OUT, server.wait(request, ROOT_SUB_RID, "post_storage", "US", "write_post", false, 1));
+  ASSERT_EQ(TIMED_OUT, server.wait(request, ROOT_SUB_RID, "post_storage", "", "write_post", false, 1));
+
+  ASSERT_EQ(1, server.closeBranch(request, bid_0, "US"));
+  ASSERT_EQ(TIMED_OUT, server.wait(request, ROOT_SUB_RID, "post_storage", "US", "write_post", false, 1));
+
+  ASSERT_EQ(1, server.closeBranch(request, bid_1, "US"));
+  ASSERT_EQ(INCONSISTENCY_NOT_PREVENTED, server.wait(request, ROOT_SUB_RID, "post_storage", "US", "write_post", false, 1));
+  ASSERT_EQ(INCONSISTENCY_NOT_PREVENTED, server.wait(request, ROOT_SUB_RID, "post_storage", "", "write_post", false, 1));
+
+  utils::Status r = server.checkStatus(request, ROOT_SUB_RID, "post_storage", "", true);
+  ASSERT_EQ(2, r.tagged.size());
+  ASSERT_EQ(CLOSED, r.tagged["write_post"]);
+  ASSERT_EQ(OPENED, r.tagged["read_post"]);
+}
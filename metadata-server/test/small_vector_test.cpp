@@ -0,0 +1,41 @@
+#include "../src/utils/small_vector.h"
+#include "gtest/gtest.h"
+#include <string>
+
+// -----------------
+// SMALL VECTOR TEST
+// -----------------
+
+TEST(SmallVectorTest, InlineAndHeapStorage) {
+  utils::SmallVector<std::string, 2> vector;
+  vector.push_back("EU");
+  vector.emplace_back("US");
+  // elements that fit inline do not take heap memory
+  ASSERT_EQ(0, vector.heapBytes());
+
+  // growing moves the elements to the heap (arguments may be elements of the vector)
+  vector.push_back(vector[0]);
+  ASSERT_EQ(3, vector.size());
+  ASSERT_GT(vector.heapBytes(), 0);
+  ASSERT_EQ("EU", vector.back());
+
+  vector.erase(vector.begin());
+  ASSERT_EQ("US", vector.at(0));
+  ASSERT_EQ("EU", vector.at(1));
+  ASSERT_THROW(vector.at(2), std::out_of_range);
+
+  // copies are independent and moves take over the heap buffer
+  utils::SmallVector<std::string, 2> copy = vector;
+  copy[0] = "AP";
+  ASSERT_EQ("US", vector[0]);
+  utils::SmallVector<std::string, 2> moved = std::move(copy);
+  ASSERT_TRUE(copy.empty());
+  ASSERT_EQ(0, copy.heapBytes());
+  ASSERT_EQ("AP", moved[0]);
+
+  vector.clear();
+  ASSERT_TRUE(vector.empty());
+  vector = utils::SmallVector<std::string, 2>{"EU"};
+  ASSERT_EQ(1, vector.size());
+  ASSERT_EQ(0, vector.heapBytes());
+}
@@ -0,0 +1,88 @@
+#include "../src/server.h"
+#include "../src/metadata/request.h"
+#include "gtest/gtest.h"
+#include <string>
+#include "utils.h"
+
+// ----------
+// STATS TEST
+// ----------
+
+TEST(StatsTest, RequestFootprint) {
+  rendezvous::Server server(SID);
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+
+  // root service node and root acsl
+  auto initial = request->getFootprint();
+  ASSERT_EQ(0, initial.num_branches);
+  ASSERT_EQ(1, initial.num_service_nodes);
+  ASSERT_EQ(1, initial.num_acsls);
+  ASSERT_GT(initial.registry_bytes, 0);
+
+  utils::ProtoVec regions;
+  regions.Add("EU");
+  regions.Add("US");
+  server.registerBranchGTest(request, ROOT_SUB_RID, "s1", regions, EMPTY_TAG, "");
+  auto one_branch = request->getFootprint();
+  ASSERT_EQ(1, one_branch.num_branches);
+  ASSERT_EQ(2, one_branch.num_service_nodes);
+  ASSERT_GT(one_branch.branches_bytes, sizeof(metadata::Branch));
+  ASSERT_GT(one_branch.service_nodes_bytes, initial.service_nodes_bytes);
+  ASSERT_GT(one_branch.bytes, initial.bytes);
+
+  // new acsl and a second branch of the same service
+  const std::string& acsl_id = server.addNextACSL(request, ROOT_SUB_RID);
+  server.registerBranchGTest(request, acsl_id, "s1", regions, EMPTY_TAG, "");
+  auto two_branches = request->getFootprint();
+  ASSERT_EQ(2, two_branches.num_branches);
+  ASSERT_EQ(2, two_branches.num_service_nodes);
+  ASSERT_EQ(2, two_branches.num_acsls);
+  ASSERT_GT(two_branches.acsls_bytes, one_branch.acsls_bytes);
+  ASSERT_EQ(two_branches.bytes, sizeof(metadata::Request) + two_branches.branches_bytes + two_branches.service_nodes_bytes
+    + two_branches.acsls_bytes + two_branches.wait_logs_bytes + two_branches.registry_bytes + utils::stringBytes(RID));
+
+  // wait logs are released when the last wait call of the acsl returns
+  metadata::Request::ACSL * acsl = request->_validateACSL(acsl_id);
+  request->_addToWaitLogs(acsl);
+  request->_addToWaitLogs(acsl);
+  ASSERT_EQ(1, request->getFootprint().num_wait_logs);
+  ASSERT_GT(request->getFootprint().wait_logs_bytes, 0);
+  request->_removeFromWaitLogs(acsl);
+  ASSERT_EQ(1, request->getFootprint().num_wait_logs);
+  request->_removeFromWaitLogs(acsl);
+  ASSERT_EQ(0, request->getFootprint().num_wait_logs);
+  ASSERT_EQ(0, request->getFootprint().wait_logs_bytes);
+}
+
+TEST(StatsTest, ServerStats) {
+  rendezvous::Server server(SID);
+  utils::ProtoVec regions;
+  regions.Add("EU");
+
+  // request i has i branches
+  for (int i = 0; i < 5; i++) {
+    metadata::Request * request = server.getOrRegisterRequest(getRid(i));
+    for (int b = 0; b < i; b++) {
+      server.registerBranchGTest(request, ROOT_SUB_RID, "s" + std::to_string(b), regions, EMPTY_TAG, "");
+    }
+  }
+
+  auto stats = server.getStats(2);
+  ASSERT_EQ(5, stats.num_requests);
+  ASSERT_EQ(0, stats.num_closed_requests);
+  ASSERT_EQ(10, stats.total.num_branches);
+  ASSERT_EQ(5, stats.total.num_acsls);
+
+  // largest requests first
+  ASSERT_EQ(2, stats.top_requests.size());
+  ASSERT_EQ(getRid(4), stats.top_requests[0].rid);
+  ASSERT_EQ(getRid(3), stats.top_requests[1].rid);
+  ASSERT_GT(stats.top_requests[0].footprint.bytes, stats.top_requests[1].footprint.bytes);
+
+  // buckets of 0, 1, 2, 3-4 branches
+  ASSERT_EQ((std::map<int, int>{{0, 1}, {1, 1}, {2, 1}, {4, 2}}), stats.branches_per_request);
+  ASSERT_EQ((std::map<int, int>{{1, 5}}), stats.acsls_per_request);
+
+  ASSERT_EQ(0, server.getStats(0).top_requests.size());
+  ASSERT_EQ(5, server.getStats(10).top_requests.size());
+}
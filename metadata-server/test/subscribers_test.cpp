@@ -0,0 +1,418 @@
+#include "../src/server.h"
+#include "../src/metadata/subscriber.h"
+#include "../src/utils/mpsc_ring.h"
+#include "gtest/gtest.h"
+#include <thread>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include "utils.h"
+
+// ----------------
+// SUBSCRIBERS TEST
+// ----------------
+
+TEST(SubscribersTest, RingFull) { 
+  utils::MPSCRing<int> ring(4);
+  ASSERT_EQ(4, ring.capacity());
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(ring.tryPush(i));
+  }
+  ASSERT_FALSE(ring.tryPush(4));
+
+  int value;
+  ASSERT_TRUE(ring.tryPop(value));
+  ASSERT_EQ(0, value);
+  ASSERT_TRUE(ring.tryPush(4));
+  for (int i = 1; i <= 4; i++) {
+    ASSERT_TRUE(ring.tryPop(value));
+    ASSERT_EQ(i, value);
+  }
+  ASSERT_FALSE(ring.tryPop(value));
+}
+
+TEST(SubscribersTest, PopBatch) { 
+  grpc::ServerContext context;
+  metadata::Subscriber subscriber(1, 16);
+
+  for (int i = 0; i < 5; i++) {
+    ASSERT_TRUE(subscriber.push(getBid(i), TAG));
+  }
+
+  auto batch = subscriber.popBatch(&context, 3);
+  ASSERT_EQ(3, batch.size());
+  ASSERT_EQ(getBid(0), batch[0].bid);
+  ASSERT_EQ(TAG, batch[0].tag);
+  ASSERT_EQ(getBid(2), batch[2].bid);
+
+  batch = subscriber.popBatch(&context, 10);
+  ASSERT_EQ(2, batch.size());
+  ASSERT_EQ(getBid(4), batch[1].bid);
+}
+
+TEST(SubscribersTest, ConcurrentPublishers) { 
+  grpc::ServerContext context;
+  const int num_producers = 8;
+  const int num_branches = 5000;
+  // producers retry (instead of losing branches) while the queue is full
+  metadata::Subscriber subscriber(1, 256, nullptr, metadata::Subscriber::OVERFLOW_REJECT);
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < num_producers; p++) {
+    producers.emplace_back([&subscriber, p, num_branches]() {
+      for (int i = 0; i < num_branches; i++) {
+        // queue is smaller than the number of branches so we retry until consumer catches up
+        while (!subscriber.push(std::to_string(p) + ":" + std::to_string(i), TAG)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // branches of each producer must be received in order
+  std::vector<int> next(num_producers, 0);
+  int received = 0;
+  while (received < num_producers * num_branches) {
+    for (const auto& branch : subscriber.popBatch(&context, 64)) {
+      size_t delimiter = branch.bid.find(':');
+      int p = std::stoi(branch.bid.substr(0, delimiter));
+      int i = std::stoi(branch.bid.substr(delimiter + 1));
+      ASSERT_EQ(next[p], i);
+      next[p]++;
+      received++;
+    }
+  }
+
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  for (int p = 0; p < num_producers; p++) {
+    ASSERT_EQ(num_branches, next[p]);
+  }
+}
+
+TEST(SubscribersTest, ReplayFromOffset) { 
+  grpc::ServerContext context;
+  metadata::Subscriber subscriber(1, 16);
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(subscriber.push(getBid(i), TAG));
+  }
+  auto batch = subscriber.popBatch(&context, 4);
+  ASSERT_EQ(4, batch.size());
+  ASSERT_EQ(3, batch.back().offset);
+  ASSERT_EQ(4, subscriber.getCursor());
+
+  // subscriber reconnects after having only seen the first two branches
+  ASSERT_EQ(2, subscriber.seek(2));
+  batch = subscriber.popBatch(&context, 4);
+  ASSERT_EQ(2, batch.size());
+  ASSERT_EQ(getBid(2), batch[0].bid);
+  ASSERT_EQ(2, batch[0].offset);
+
+  // cannot resume after the last branch
+  ASSERT_EQ(4, subscriber.seek(100));
+}
+
+TEST(SubscribersTest, CancelWakesWaitingConsumer) { 
+  grpc::ServerContext context;
+  metadata::Subscriber subscriber(60, 16);
+
+  std::vector<metadata::Subscriber::SubscribedBranch> batch;
+  std::thread consumer([&subscriber, &context, &batch]() {
+    batch = subscriber.popBatch(&context, 4);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  // consumer returns without waiting for the refresh interval
+  auto start = std::chrono::steady_clock::now();
+  subscriber.cancel(&context);
+  consumer.join();
+  ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+  ASSERT_TRUE(batch.empty());
+
+  // released connections are served again
+  subscriber.release(&context);
+  ASSERT_TRUE(subscriber.push(getBid(0), TAG));
+  ASSERT_EQ(1, subscriber.popBatch(&context, 4).size());
+}
+
+TEST(SubscribersTest, RetentionBoundedByClosedBranches) { 
+  grpc::ServerContext context;
+  std::set<std::string> closed;
+  metadata::Subscriber subscriber(1, 16, [&closed](const std::string& bid) { return closed.count(bid) != 0; });
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(subscriber.push(getBid(i), TAG));
+  }
+  ASSERT_EQ(4, subscriber.popBatch(&context, 4).size());
+  ASSERT_EQ(4, subscriber.getLogSize());
+
+  // only the closed prefix of the log is discarded
+  closed.insert(getBid(0));
+  closed.insert(getBid(2));
+  subscriber.seek(4);
+  ASSERT_EQ(3, subscriber.getLogSize());
+
+  closed.insert(getBid(1));
+  subscriber.seek(4);
+  ASSERT_EQ(1, subscriber.getLogSize());
+
+  // replaying everything only returns branches that were not closed
+  subscriber.seek(0);
+  auto batch = subscriber.popBatch(&context, 4);
+  ASSERT_EQ(1, batch.size());
+  ASSERT_EQ(getBid(3), batch[0].bid);
+}
+
+TEST(SubscribersTest, RetentionBoundedByAckedBranches) { 
+  grpc::ServerContext context;
+  // status of the branches is unknown (e.g., requests owned by other replicas)
+  metadata::Subscriber subscriber(1, 16, [](const std::string&) { return false; });
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(subscriber.push(getBid(i), TAG));
+  }
+  ASSERT_EQ(4, subscriber.popBatch(&context, 4).size());
+  ASSERT_EQ(4, subscriber.getLogSize());
+
+  // only the acked prefix of the log is discarded
+  subscriber.ack({ getBid(0), getBid(2) });
+  subscriber.seek(4);
+  ASSERT_EQ(3, subscriber.getLogSize());
+  subscriber.ack({ getBid(1) });
+  subscriber.seek(4);
+  ASSERT_EQ(1, subscriber.getLogSize());
+
+  // replaying everything only returns branches that were not acked
+  subscriber.seek(0);
+  auto batch = subscriber.popBatch(&context, 4);
+  ASSERT_EQ(1, batch.size());
+  ASSERT_EQ(getBid(3), batch[0].bid);
+}
+
+TEST(SubscribersTest, RetentionReleasedByLastConsumer) { 
+  grpc::ServerContext context;
+  std::set<std::string> closed;
+  metadata::Subscriber subscriber(1, 16, [&closed](const std::string& bid) { return closed.count(bid) != 0; });
+
+  // two consumers without group share the cursor
+  subscriber.seek(0);
+  subscriber.seek(0);
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(subscriber.push(getBid(i), TAG));
+    closed.insert(getBid(i));
+  }
+  ASSERT_EQ(2, subscriber.popBatch(&context, 2).size());
+
+  // cursor bounds retention while one of the consumers is still connected
+  subscriber.releaseCursor();
+  ASSERT_EQ(2, subscriber.getLogSize());
+
+  // closed branches that were never delivered are no longer retained for the cursor
+  subscriber.releaseCursor();
+  ASSERT_EQ(0, subscriber.getLogSize());
+  subscriber.releaseCursor();
+  ASSERT_EQ(0, subscriber.getLogSize());
+}
+
+TEST(SubscribersTest, OverflowReject) { 
+  metadata::Subscriber subscriber(1, 4, nullptr, metadata::Subscriber::OVERFLOW_REJECT);
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(subscriber.push(getBid(i), TAG));
+  }
+  ASSERT_TRUE(subscriber.isFull());
+  ASSERT_FALSE(subscriber.push(getBid(4), TAG));
+
+  auto stats = subscriber.getQueueStats();
+  ASSERT_EQ(4, stats.queued);
+  ASSERT_EQ(1, stats.dropped);
+  ASSERT_EQ(0, stats.spilled);
+}
+
+TEST(SubscribersTest, OverflowDropOldest) { 
+  grpc::ServerContext context;
+  metadata::Subscriber subscriber(1, 4, nullptr, metadata::Subscriber::OVERFLOW_DROP_OLDEST);
+  subscriber.seek(0);
+
+  // ring and log hold 4 branches each so the oldest 12 branches are dropped
+  for (int i = 0; i < 20; i++) {
+    ASSERT_TRUE(subscriber.push(getBid(i), TAG));
+  }
+  auto stats = subscriber.getQueueStats();
+  ASSERT_EQ(20, stats.queued);
+  ASSERT_EQ(12, stats.dropped);
+
+  std::vector<std::string> bids;
+  while (bids.size() < 8) {
+    for (const auto& branch : subscriber.popBatch(&context, 16)) {
+      bids.emplace_back(branch.bid);
+    }
+  }
+  for (int i = 0; i < 8; i++) {
+    ASSERT_EQ(getBid(12 + i), bids[i]);
+  }
+}
+
+TEST(SubscribersTest, OverflowSpill) { 
+  grpc::ServerContext context;
+  metadata::Subscriber subscriber(1, 4, nullptr, metadata::Subscriber::OVERFLOW_SPILL, "/tmp/rendezvous_subscriber_test.log");
+  subscriber.seek(0);
+
+  // every branch after the ring is full goes to disk
+  for (int i = 0; i < 20; i++) {
+    ASSERT_TRUE(subscriber.push(getBid(i), TAG));
+  }
+  ASSERT_TRUE(subscriber.isFull());
+  auto stats = subscriber.getQueueStats();
+  ASSERT_EQ(20, stats.queued);
+  ASSERT_EQ(0, stats.dropped);
+  ASSERT_EQ(16, stats.spilled);
+
+  // spilled branches are delivered in order
+  std::vector<std::string> bids;
+  while (bids.size() < 20) {
+    for (const auto& branch : subscriber.popBatch(&context, 16)) {
+      bids.emplace_back(branch.bid);
+    }
+  }
+  for (int i = 0; i < 20; i++) {
+    ASSERT_EQ(getBid(i), bids[i]);
+  }
+
+  // new branches go back to the ring once the on-disk log is consumed
+  ASSERT_FALSE(subscriber.isFull());
+  ASSERT_TRUE(subscriber.push(getBid(20), TAG));
+  ASSERT_EQ(16, subscriber.getQueueStats().spilled);
+  auto batch = subscriber.popBatch(&context, 16);
+  ASSERT_EQ(1, batch.size());
+  ASSERT_EQ(getBid(20), batch[0].bid);
+}
+
+TEST(SubscribersTest, OverflowSpillBuffered) { 
+  grpc::ServerContext context;
+  metadata::Subscriber subscriber(1, 4, nullptr, metadata::Subscriber::OVERFLOW_SPILL, "/tmp/rendezvous_subscriber_test.log");
+  subscriber.seek(0);
+
+  // spilled branches take several buffers so they are written to disk in more than one batch
+  const std::string tag(1024, 't');
+  int num_branches = 4 + 4 * metadata::Subscriber::SPILL_BUFFER_SIZE / tag.size();
+  for (int i = 0; i < num_branches; i++) {
+    ASSERT_TRUE(subscriber.push(getBid(i), tag));
+  }
+  auto stats = subscriber.getQueueStats();
+  ASSERT_EQ(num_branches, stats.queued);
+  ASSERT_EQ(0, stats.dropped);
+  ASSERT_EQ(num_branches - 4, stats.spilled);
+
+  std::vector<metadata::Subscriber::SubscribedBranch> branches;
+  while ((int) branches.size() < num_branches) {
+    for (const auto& branch : subscriber.popBatch(&context, 16)) {
+      branches.emplace_back(branch);
+    }
+  }
+  for (int i = 0; i < num_branches; i++) {
+    ASSERT_EQ(getBid(i), branches[i].bid);
+    ASSERT_EQ(tag, branches[i].tag);
+  }
+  ASSERT_FALSE(subscriber.isFull());
+}
+
+TEST(SubscribersTest, ConsumerGroupPartitioning) { 
+  grpc::ServerContext context;
+  metadata::Subscriber subscriber(1, 64);
+  uint64_t member_0 = subscriber.joinGroup("group", 0);
+  uint64_t member_1 = subscriber.joinGroup("group", 0);
+  ASSERT_EQ(2, subscriber.getGroupSize("group"));
+
+  // two branches for each request
+  int num_requests = 16;
+  for (int i = 0; i < num_requests; i++) {
+    ASSERT_TRUE(subscriber.push("b0:" + getRid(i), TAG));
+    ASSERT_TRUE(subscriber.push("b1:" + getRid(i), TAG));
+  }
+
+  // each request is owned by a single member
+  std::map<std::string, uint64_t> owners;
+  int received = 0;
+  for (uint64_t member_id : {member_0, member_1}) {
+    for (const auto& branch : subscriber.popBatch(&context, 64, member_id)) {
+      std::string rid = branch.bid.substr(3);
+      auto it = owners.find(rid);
+      if (it != owners.end()) {
+        ASSERT_EQ(it->second, member_id);
+      }
+      owners[rid] = member_id;
+      received++;
+    }
+  }
+  ASSERT_EQ(2 * num_requests, received);
+  ASSERT_EQ(num_requests, owners.size());
+}
+
+TEST(SubscribersTest, ConsumerGroupRebalance) { 
+  grpc::ServerContext context;
+  metadata::Subscriber subscriber(1, 64);
+  uint64_t member_0 = subscriber.joinGroup("group", 0);
+  uint64_t member_1 = subscriber.joinGroup("group", 0);
+
+  int num_requests = 16;
+  for (int i = 0; i < num_requests; i++) {
+    ASSERT_TRUE(subscriber.push("b0:" + getRid(i), TAG));
+  }
+
+  // member 0 handles its partition and member 1 leaves before handling its own
+  int received = subscriber.popBatch(&context, 64, member_0).size();
+  ASSERT_LT(0, received);
+  ASSERT_GT(num_requests, received);
+  subscriber.leaveGroup(member_1);
+  ASSERT_EQ(1, subscriber.getGroupSize("group"));
+
+  // remaining member restarts at the offset of the slowest member and now owns all branches
+  ASSERT_EQ(0, subscriber.getCursor(member_0));
+  ASSERT_EQ(num_requests, subscriber.popBatch(&context, 64, member_0).size());
+
+  // members of other groups receive all branches
+  uint64_t other = subscriber.joinGroup("other", 0);
+  ASSERT_EQ(num_requests, subscriber.popBatch(&context, 64, other).size());
+
+  subscriber.leaveGroup(member_0);
+  ASSERT_EQ(0, subscriber.getGroupSize("group"));
+}
+
+TEST(SubscribersTest, PublishFilteredByRegionAndTag) { 
+  rendezvous::Server server(SID);
+  grpc::ServerContext context;
+
+  metadata::Subscriber * eu = server.getSubscriber("s", "eu");
+  metadata::Subscriber * us = server.getSubscriber("s", "us");
+  metadata::Subscriber * all = server.getSubscriber("s", "");
+  metadata::Subscriber * eu_tagged = server.getSubscriber("s", "eu", {"tag_B", "tag_A", "tag_A"});
+  ASSERT_EQ(eu, server.getSubscriber("s", "eu"));
+  ASSERT_EQ(eu_tagged, server.getSubscriber("s", "eu", {"tag_A", "tag_B"}));
+
+  utils::ProtoVec regions_global;
+  utils::ProtoVec regions_eu;
+  regions_eu.Add("eu");
+
+  server.publishBranches("s", "", "b0:" + RID, regions_global);
+  server.publishBranches("s", "tag_A", "b1:" + RID, regions_eu);
+  server.publishBranches("s", "tag_C", "b2:" + RID, regions_eu);
+  server.publishBranches("other", "", "b3:" + RID, regions_global);
+
+  ASSERT_EQ(3, eu->popBatch(&context, 10).size());
+  ASSERT_EQ(3, all->popBatch(&context, 10).size());
+
+  // branches registered only in eu are not delivered to us
+  auto batch = us->popBatch(&context, 10);
+  ASSERT_EQ(1, batch.size());
+  ASSERT_EQ("b0:" + RID, batch[0].bid);
+
+  // tagged subscriber only receives branches with its tags
+  batch = eu_tagged->popBatch(&context, 10);
+  ASSERT_EQ(1, batch.size());
+  ASSERT_EQ("b1:" + RID, batch[0].bid);
+  ASSERT_EQ("tag_A", batch[0].tag);
+}
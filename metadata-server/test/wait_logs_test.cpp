@@ -95,6 +95,34 @@ TEST(WaitLogsTest, PrecedingDetection) {
   ASSERT_EQ(request->_getGreaterACSLs(subrequest_r_c1).size(), 1);
   ASSERT_EQ(request->_getGreaterACSLs(subrequest_r_c1_d1).size(), 0);
 }
+
+TEST(WaitLogsTest, ACSLOrdering) {
+  // siblings are ordered by index and parents precede their children
+  ASSERT_LT(utils::encodeACSLKey("root:eu2"), utils::encodeACSLKey("root:eu10"));
+  ASSERT_LT(utils::encodeACSLKey("root:eu1:us9"), utils::encodeACSLKey("root:eu10"));
+  ASSERT_LT(utils::encodeACSLKey("root:eu239"), utils::encodeACSLKey("root:eu240"));
+  ASSERT_LT(utils::encodeACSLKey("root:eu255"), utils::encodeACSLKey("root:eu70000"));
+  ASSERT_LT(utils::encodeACSLKey(ROOT_SUB_RID), utils::encodeACSLKey("root:eu0"));
+  ASSERT_NE(utils::encodeACSLKey("root:eu01"), utils::encodeACSLKey("root:eu1"));
+
+  // ancestors are prefixes of their descendants
+  const std::string& parent = utils::encodeACSLKey("root:eu1");
+  ASSERT_EQ(0, utils::encodeACSLKey("root:eu1:us3:eu0").rfind(parent, 0));
+  ASSERT_NE(0, utils::encodeACSLKey("root:eu10:us3").rfind(parent, 0));
+
+  rendezvous::Server server("a");
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+  metadata::Request::ACSL * eu2 = request->_validateACSL(server.addNextACSL(request, "root:eu2", false));
+  metadata::Request::ACSL * eu10 = request->_validateACSL(server.addNextACSL(request, "root:eu10", false));
+  metadata::Request::ACSL * eu2_us0 = request->_validateACSL(server.addNextACSL(request, "root:eu2:us0", false));
+  request->_addToWaitLogs(eu10);
+  request->_addToWaitLogs(eu2_us0);
+  request->_addToWaitLogs(eu2);
+
+  ASSERT_EQ(2, request->_getGreaterACSLs(eu2).size());
+  ASSERT_EQ(eu10, request->_getGreaterACSLs(eu2_us0).front());
+  ASSERT_EQ(0, request->_getGreaterACSLs(eu10).size());
+}
 // --------------
 
 /* --------------------------------------------
@@ -0,0 +1,161 @@
+#include "../src/server.h"
+#include "../src/metadata/request.h"
+#include "../src/metadata/wait_trace.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <string>
+#include "utils.h"
+
+// ----------------
+// WAIT TRACES TEST
+// ----------------
+
+TEST(WaitTracesTest, NonBlocking) {
+  rendezvous::Server server(SID);
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+  const std::string& acsl_id = server.addNextACSL(request, ROOT_SUB_RID);
+
+  metadata::WaitTrace trace(RID, acsl_id);
+  ASSERT_EQ(INCONSISTENCY_NOT_PREVENTED, server.wait(request, acsl_id, "", "", "", false, 1, "", false, &trace));
+  trace.finish(INCONSISTENCY_NOT_PREVENTED);
+
+  rendezvous::WaitTraceSummary summary;
+  trace.toProto(&summary);
+  ASSERT_EQ(0, summary.num_wakeups());
+  ASSERT_EQ(0, summary.blocking_branches_size());
+}
+
+TEST(WaitTracesTest, BlockingBranches) {
+  std::vector<std::thread> threads;
+  rendezvous::Server server(SID);
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+  const std::string& acsl_id = server.addNextACSL(request, ROOT_SUB_RID);
+
+  utils::ProtoVec regions_us;
+  regions_us.Add("US");
+  utils::ProtoVec regions_eu;
+  regions_eu.Add("EU");
+  std::string bid_0 = server.registerBranchGTest(request, ROOT_SUB_RID, "s1", regions_us, EMPTY_TAG, "");
+  std::string bid_1 = server.registerBranchGTest(request, ROOT_SUB_RID, "s2", regions_eu, EMPTY_TAG, "");
+
+  threads.emplace_back([&server, request, bid_0, bid_1] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(1, server.closeBranch(request, bid_0, "US"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(1, server.closeBranch(request, bid_1, "EU"));
+  });
+
+  metadata::WaitTrace trace(RID, acsl_id);
+  ASSERT_EQ(INCONSISTENCY_PREVENTED, server.wait(request, acsl_id, "", "", "", false, 5, "", false, &trace));
+  trace.finish(INCONSISTENCY_PREVENTED);
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // both branches block the first wakeup and the last one only waits for bid_1
+  const auto& wakeups = trace.getWakeups();
+  ASSERT_GE(wakeups.size(), 2);
+  ASSERT_EQ(std::vector<std::string>({bid_0, bid_1}), wakeups.front().blocking_bids);
+  ASSERT_EQ(std::vector<std::string>({bid_1}), wakeups.back().blocking_bids);
+  ASSERT_GE(trace.getDurationMs(), 150);
+
+  rendezvous::WaitTraceSummary summary;
+  trace.toProto(&summary);
+  ASSERT_EQ(wakeups.size(), summary.num_wakeups());
+  ASSERT_EQ(2, summary.blocking_branches_size());
+  for (const auto& branch : summary.blocking_branches()) {
+    ASSERT_LE(branch.opened_ms(), 0);
+    ASSERT_GT(branch.closed_ms(), 0);
+  }
+  ASSERT_EQ(bid_1, summary.blocking_branches(1).bid());
+  ASSERT_EQ("s2", summary.blocking_branches(1).service());
+  ASSERT_EQ("EU", summary.blocking_branches(1).regions(0));
+  ASSERT_LT(summary.blocking_branches(0).closed_ms(), summary.blocking_branches(1).closed_ms());
+
+  // root span of the wait call and one child span for each blocking branch
+  const auto& otlp = trace.toOtlpJson(SID);
+  const auto& spans = otlp["resourceSpans"][0]["scopeSpans"][0]["spans"];
+  ASSERT_EQ(3, spans.size());
+  ASSERT_EQ(32, spans[0]["traceId"].get<std::string>().size());
+  ASSERT_EQ(16, spans[0]["spanId"].get<std::string>().size());
+  ASSERT_FALSE(spans[0].contains("parentSpanId"));
+  ASSERT_EQ(wakeups.size(), spans[0]["events"].size());
+  for (int i = 1; i < 3; i++) {
+    ASSERT_EQ(spans[0]["traceId"], spans[i]["traceId"]);
+    ASSERT_EQ(spans[0]["spanId"], spans[i]["parentSpanId"]);
+  }
+}
+
+TEST(WaitTracesTest, BlockingBranchesRegion) {
+  std::vector<std::thread> threads;
+  rendezvous::Server server(SID);
+  metadata::Request * request = server.getOrRegisterRequest(RID);
+  const std::string& acsl_id = server.addNextACSL(request, ROOT_SUB_RID);
+
+  utils::ProtoVec regions_us;
+  regions_us.Add("US");
+  utils::ProtoVec regions_eu;
+  regions_eu.Add("EU");
+  std::string bid_0 = server.registerBranchGTest(request, ROOT_SUB_RID, "s1", regions_us, EMPTY_TAG, "");
+  std::string bid_1 = server.registerBranchGTest(request, ROOT_SUB_RID, "s2", regions_eu, EMPTY_TAG, "");
+
+  threads.emplace_back([&server, request, bid_1] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(1, server.closeBranch(request, bid_1, "EU"));
+  });
+
+  // branch in region US does not block the call
+  metadata::WaitTrace trace(RID, acsl_id);
+  ASSERT_EQ(INCONSISTENCY_PREVENTED, server.wait(request, acsl_id, "", "EU", "", false, 5, "", false, &trace));
+  trace.finish(INCONSISTENCY_PREVENTED);
+
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  ASSERT_EQ(1, trace.getBranches().size());
+  ASSERT_EQ(1, trace.getBranches().count(bid_1));
+  ASSERT_EQ("service= region=EU tag=", trace.getWakeups().front().context);
+}
+
+TEST(WaitTracesTest, ExportToFile) {
+  const std::string& filename = "/tmp/rendezvous_wait_traces_test.json";
+  std::remove(filename.c_str());
+  json settings = {
+    {"cleanup_requests_interval_m", -1},
+    {"cleanup_requests_validity_m", -1},
+    {"cleanup_subscribers_interval_m", -1},
+    {"cleanup_subscribers_validity_m", -1},
+    {"subscribers_refresh_interval_s", 1},
+    {"subscribers_queue_capacity", 1024},
+    {"subscribers_overflow_policy", "drop_oldest"},
+    {"subscribers_spill_dir", "/tmp/rendezvous"},
+    {"wait_replica_timeout_s", 0},
+    {"selective_replication", false},
+    {"partitioned_mode", false},
+    {"wait_traces_file", filename}
+  };
+
+  // traces are written to the stream kept open by the server (flushed when it is destroyed)
+  {
+    rendezvous::Server server(SID, settings);
+    for (int i = 0; i < 3; i++) {
+      metadata::WaitTrace trace(RID, utils::ROOT_ACSL_ID);
+      trace.finish(INCONSISTENCY_NOT_PREVENTED);
+      server.exportWaitTrace(&trace);
+    }
+  }
+
+  std::ifstream file(filename);
+  std::string line;
+  int num_lines = 0;
+  while (std::getline(file, line)) {
+    ASSERT_TRUE(json::accept(line));
+    num_lines++;
+  }
+  ASSERT_EQ(3, num_lines);
+  std::remove(filename.c_str());
+}
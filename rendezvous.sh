@@ -22,7 +22,7 @@ AWS_REGION="eu-central-1"
 
 usage() {
     echo "Usage:"
-    echo "> ./rendezvous.sh local {clean, build [{--debug, --config, --tests, --py}], run {server <replica id> <config>, tests, client, rv-lib, monitor}}"
+    echo "> ./rendezvous.sh local {clean, build [{--debug, --config, --tests, --py, --lock-profiling}], run {server <replica id> <config>, tests, benchmarks, loadgen [<args>], replay [<args>], client, rv-lib, monitor}}"
     echo "> ./rendezvous.sh remote {deploy, update, start {dynamo, s3, cache, mysql} [-ncc], stop}"
     echo "> ./rendezvous.sh docker {build, deploy, start {dynamo, s3, cache, mysql}, stop}"
     echo "[INFO] Available config files: remote.json, docker.json, local.json, single.json"
@@ -62,7 +62,7 @@ local_build_debug() {
   cd metadata-server
   mkdir -p cmake/build
   cd cmake/build 
-  cmake -DCMAKE_BUILD_TYPE=Debug ../..
+  cmake -DCMAKE_BUILD_TYPE=Debug -DLOG_LEVEL=TRACE ../..
   make
   echo done!
 }
@@ -75,6 +75,15 @@ local_build_config() {
   echo done!
 }
 
+local_build_lock_profiling() {
+  cd metadata-server
+  mkdir -p cmake/build
+  cd cmake/build
+  cmake -DLOCK_PROFILING=ON ../..
+  make
+  echo done!
+}
+
 local_build_tests() {
   cd metadata-server
   mkdir -p cmake/build
@@ -136,6 +145,21 @@ local_run_tests() {
   ./tests
 }
 
+local_run_benchmarks() {
+  cd metadata-server/cmake/build/benchmarks
+  ./benchmarks --benchmark_out=benchmarks.json --benchmark_out_format=json
+}
+
+local_run_loadgen() {
+  cd metadata-server/cmake/build/loadgen
+  ./rendezvous-loadgen "$@"
+}
+
+local_run_replay() {
+  cd metadata-server/cmake/build/loadgen
+  ./rendezvous-replay "$@"
+}
+
 # -------
 # REMOTE
 # -------
@@ -359,6 +383,8 @@ elif [ "$#" -eq 3 ] && [ $1 = "local" ] && [ $2 = "build" ] && [ $3 = "--debug"
   local_build_debug
 elif [ "$#" -eq 3 ] && [ $1 = "local" ] && [ $2 = "build" ] && [ $3 = "--config" ]; then
   local_build_config
+elif [ "$#" -eq 3 ] && [ $1 = "local" ] && [ $2 = "build" ] && [ $3 = "--lock-profiling" ]; then
+  local_build_lock_profiling
 elif [ "$#" -eq 3 ] && [ $1 = "local" ] && [ $2 = "build" ] && [ $3 = "--tests" ]; then
   local_build_tests
 elif [ "$#" -eq 3 ] && [ $1 = "local" ] && [ $2 = "build" ] && [ $3 = "--py" ]; then
@@ -373,6 +399,12 @@ elif [ "$#" -eq 3 ] && [ $1 = "local" ] && [ $2 = "run" ] && [ $3 = "monitor" ];
   local_run_monitor
 elif [ "$#" -eq 3 ] && [ $1 = "local" ] && [ $2 = "run" ] && [ $3 = "tests" ]; then
   local_run_tests
+elif [ "$#" -eq 3 ] && [ $1 = "local" ] && [ $2 = "run" ] && [ $3 = "benchmarks" ]; then
+  local_run_benchmarks
+elif [ "$#" -ge 3 ] && [ $1 = "local" ] && [ $2 = "run" ] && [ $3 = "loadgen" ]; then
+  local_run_loadgen "${@:4}"
+elif [ "$#" -ge 3 ] && [ $1 = "local" ] && [ $2 = "run" ] && [ $3 = "replay" ]; then
+  local_run_replay "${@:4}"
 # -------
 # REMOTE
 # -------